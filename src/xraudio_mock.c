@@ -0,0 +1,956 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Mock implementation of the xraudio API.  It replaces libxraudio (and the audio HAL) so the speech router can be
+// exercised on a build server.  Audio is played from a WAV or raw file (or generated silence) into the destination
+// pipes at real-time or accelerated rate and keyword, EOS, stream time minimum and error events are fired according
+// to a script.  The script is read from the "mock" object of the xraudio json configuration and may be overridden
+// with a json file named by the XRAUDIO_MOCK_CONFIG environment variable.
+//
+//   "mock" : {
+//      "audio_file"       : "/tmp/utterance.wav", // WAV or raw file (raw must match the requested stream format)
+//      "audio_duration"   : 3000,                 // duration of generated silence in ms when no file is specified
+//      "rate"             : 1.0,                  // playback rate (1.0 is real-time, 0 is as fast as possible)
+//      "keyword_delay"    : 0,                    // ms after detection is started to fire a keyword (0 disables)
+//      "keyword_source"   : "mic",                // "mic", "ptt" or "ff"
+//      "keyword_error"    : false,                // fire a keyword detect error instead of a detection
+//      "eos_offset"       : -1,                   // ms into the stream to fire EOS (-1 is end of audio)
+//      "error_offset"     : -1,                   // ms into the stream to fire a stream error (-1 disables)
+//      "frame_size"       : 95                    // bytes per frame for non-PCM encodings
+//   }
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <jansson.h>
+#include <rdkx_logger.h>
+#include <xraudio.h>
+
+#define XRAUDIO_MOCK_IDENTIFIER            (0x4D4F434B)
+#define XRAUDIO_MOCK_DST_QTY_MAX           (1)
+#define XRAUDIO_MOCK_FRAME_SIZE_MAX        (4096)
+#define XRAUDIO_MOCK_FRAME_SIZE_DEFAULT    (95)
+#define XRAUDIO_MOCK_AUDIO_DURATION        (3000)
+#define XRAUDIO_MOCK_STREAM_ID_LEN_MAX     (64)
+#define XRAUDIO_MOCK_INVALID_STR_LEN       (24)
+
+#define XRAUDIO_MOCK_ENV_CONFIG            "XRAUDIO_MOCK_CONFIG"
+
+#define JSON_OBJ_NAME_MOCK                 "mock"
+#define JSON_STR_NAME_MOCK_AUDIO_FILE      "audio_file"
+#define JSON_INT_NAME_MOCK_AUDIO_DURATION  "audio_duration"
+#define JSON_REAL_NAME_MOCK_RATE           "rate"
+#define JSON_INT_NAME_MOCK_KEYWORD_DELAY   "keyword_delay"
+#define JSON_STR_NAME_MOCK_KEYWORD_SOURCE  "keyword_source"
+#define JSON_BOOL_NAME_MOCK_KEYWORD_ERROR  "keyword_error"
+#define JSON_INT_NAME_MOCK_EOS_OFFSET      "eos_offset"
+#define JSON_INT_NAME_MOCK_ERROR_OFFSET    "error_offset"
+#define JSON_INT_NAME_MOCK_FRAME_SIZE      "frame_size"
+
+typedef struct {
+   char                    audio_file[256];
+   uint32_t                audio_duration;
+   double                  rate;
+   uint32_t                keyword_delay;
+   xraudio_devices_input_t keyword_source;
+   bool                    keyword_error;
+   int32_t                 eos_offset;
+   int32_t                 error_offset;
+   uint32_t                frame_size;
+} xraudio_mock_script_t;
+
+typedef struct {
+   bool                          active;
+   bool                          ended;
+   xraudio_devices_input_t       source;
+   int                           pipes[XRAUDIO_MOCK_DST_QTY_MAX];
+   audio_in_callback_t           callback;
+   void                         *param;
+   xraudio_input_format_t        format;
+   int                           fd_audio;
+   uint32_t                      audio_bytes_remaining;
+   uint32_t                      frame_size;
+   uint32_t                      frame_period; // in microseconds
+   xraudio_stream_latency_mode_t latency_mode;
+   uint8_t                       frame_group_qty;
+   uint16_t                      stream_time_min;
+   bool                          stream_time_min_fired;
+   uint32_t                      keyword_begin;
+   uint32_t                      keyword_duration;
+   bool                          keyword_info_fired;
+   char                          identifier[XRAUDIO_MOCK_STREAM_ID_LEN_MAX];
+   uint64_t                      bytes_streamed;
+   xraudio_audio_stats_t         stats;
+   struct timespec               time_next;
+} xraudio_mock_stream_t;
+
+typedef struct {
+   uint32_t                      identifier;
+   pthread_t                     thread;
+   pthread_mutex_t               mutex;
+   pthread_cond_t                cond;
+   bool                          running;
+   bool                          opened;
+   xraudio_mock_script_t         script;
+   xraudio_power_mode_t          power_mode;
+   bool                          privacy_mode;
+   xraudio_devices_input_t       device_input;
+   xraudio_devices_output_t      device_output;
+   xraudio_input_format_t        format;
+   xraudio_keyword_phrase_t      keyword_phrase;
+   xraudio_keyword_sensitivity_t keyword_sensitivity;
+   bool                          detecting;
+   keyword_callback_t            keyword_callback;
+   void                         *keyword_param;
+   struct timespec               keyword_time;
+   xraudio_thread_poll_func_t    poll_func;
+   xraudio_mock_stream_t         stream;
+} xraudio_mock_obj_t;
+
+static char g_xraudio_mock_invalid_str[XRAUDIO_MOCK_INVALID_STR_LEN];
+
+static bool  xraudio_mock_object_is_valid(xraudio_mock_obj_t *obj);
+static void  xraudio_mock_script_defaults(xraudio_mock_script_t *script);
+static void  xraudio_mock_script_parse(xraudio_mock_script_t *script, const json_t *json_obj_mock);
+static void *xraudio_mock_thread(void *param);
+static void  xraudio_mock_stream_reset(xraudio_mock_stream_t *stream);
+static void  xraudio_mock_stream_close(xraudio_mock_stream_t *stream);
+static bool  xraudio_mock_stream_open_audio(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream);
+static void  xraudio_mock_stream_process(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream);
+static void  xraudio_mock_stream_event(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream, audio_in_callback_event_t event, void *event_param);
+static void  xraudio_mock_timespec_add_us(struct timespec *ts, uint64_t usecs);
+static bool  xraudio_mock_timespec_due(const struct timespec *ts, const struct timespec *now);
+static const char *xraudio_mock_invalid_return(int value);
+
+xraudio_object_t xraudio_object_create(const json_t *json_obj_xraudio_config) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)malloc(sizeof(xraudio_mock_obj_t));
+
+   if(obj == NULL) {
+      XLOGD_ERROR("Out of memory.");
+      return(NULL);
+   }
+   memset(obj, 0, sizeof(*obj));
+
+   obj->identifier    = XRAUDIO_MOCK_IDENTIFIER;
+   obj->device_input  = XRAUDIO_DEVICE_INPUT_NONE;
+   obj->device_output = XRAUDIO_DEVICE_OUTPUT_NONE;
+   xraudio_mock_stream_reset(&obj->stream);
+
+   xraudio_mock_script_defaults(&obj->script);
+   if(json_obj_xraudio_config != NULL) {
+      xraudio_mock_script_parse(&obj->script, json_object_get(json_obj_xraudio_config, JSON_OBJ_NAME_MOCK));
+   }
+   const char *config_file = getenv(XRAUDIO_MOCK_ENV_CONFIG);
+   if(config_file != NULL && config_file[0] != '\0') {
+      json_error_t error;
+      json_t *json_obj_file = json_load_file(config_file, 0, &error);
+      if(json_obj_file == NULL) {
+         XLOGD_ERROR("unable to load <%s> line <%d> <%s>", config_file, error.line, error.text);
+      } else {
+         json_t *json_obj_mock = json_object_get(json_obj_file, JSON_OBJ_NAME_MOCK);
+         xraudio_mock_script_parse(&obj->script, (json_obj_mock != NULL) ? json_obj_mock : json_obj_file);
+         json_decref(json_obj_file);
+      }
+   }
+
+   XLOGD_INFO("audio file <%s> duration <%u> rate <%f> keyword delay <%u> source <%s> error <%s> eos offset <%d> error offset <%d>", obj->script.audio_file[0] ? obj->script.audio_file : "silence", obj->script.audio_duration, obj->script.rate, obj->script.keyword_delay, xraudio_devices_input_str(obj->script.keyword_source), obj->script.keyword_error ? "YES" : "NO", obj->script.eos_offset, obj->script.error_offset);
+
+   pthread_condattr_t attr;
+   pthread_condattr_init(&attr);
+   pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+   pthread_cond_init(&obj->cond, &attr);
+   pthread_condattr_destroy(&attr);
+   pthread_mutex_init(&obj->mutex, NULL);
+
+   obj->running = true;
+   if(0 != pthread_create(&obj->thread, NULL, xraudio_mock_thread, obj)) {
+      XLOGD_ERROR("unable to launch thread");
+      pthread_cond_destroy(&obj->cond);
+      pthread_mutex_destroy(&obj->mutex);
+      free(obj);
+      return(NULL);
+   }
+
+   return((xraudio_object_t)obj);
+}
+
+void xraudio_object_destroy(xraudio_object_t object) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      XLOGD_ERROR("invalid object");
+      return;
+   }
+   xraudio_close(object);
+
+   pthread_mutex_lock(&obj->mutex);
+   obj->running = false;
+   pthread_cond_signal(&obj->cond);
+   pthread_mutex_unlock(&obj->mutex);
+
+   pthread_join(obj->thread, NULL);
+   pthread_cond_destroy(&obj->cond);
+   pthread_mutex_destroy(&obj->mutex);
+
+   obj->identifier = 0;
+   free(obj);
+}
+
+bool xraudio_mock_object_is_valid(xraudio_mock_obj_t *obj) {
+   if(obj != NULL && obj->identifier == XRAUDIO_MOCK_IDENTIFIER) {
+      return(true);
+   }
+   return(false);
+}
+
+void xraudio_mock_script_defaults(xraudio_mock_script_t *script) {
+   memset(script, 0, sizeof(*script));
+   script->audio_duration = XRAUDIO_MOCK_AUDIO_DURATION;
+   script->rate           = 1.0;
+   script->keyword_delay  = 0;
+   script->keyword_source = XRAUDIO_DEVICE_INPUT_SINGLE;
+   script->keyword_error  = false;
+   script->eos_offset     = -1;
+   script->error_offset   = -1;
+   script->frame_size     = XRAUDIO_MOCK_FRAME_SIZE_DEFAULT;
+}
+
+void xraudio_mock_script_parse(xraudio_mock_script_t *script, const json_t *json_obj_mock) {
+   if(json_obj_mock == NULL || !json_is_object(json_obj_mock)) {
+      return;
+   }
+   json_t *json_obj = json_object_get(json_obj_mock, JSON_STR_NAME_MOCK_AUDIO_FILE);
+   if(json_obj != NULL && json_is_string(json_obj)) {
+      snprintf(script->audio_file, sizeof(script->audio_file), "%s", json_string_value(json_obj));
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_INT_NAME_MOCK_AUDIO_DURATION);
+   if(json_obj != NULL && json_is_integer(json_obj) && json_integer_value(json_obj) >= 0) {
+      script->audio_duration = json_integer_value(json_obj);
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_REAL_NAME_MOCK_RATE);
+   if(json_obj != NULL && json_is_number(json_obj) && json_number_value(json_obj) >= 0.0) {
+      script->rate = json_number_value(json_obj);
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_INT_NAME_MOCK_KEYWORD_DELAY);
+   if(json_obj != NULL && json_is_integer(json_obj) && json_integer_value(json_obj) >= 0) {
+      script->keyword_delay = json_integer_value(json_obj);
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_STR_NAME_MOCK_KEYWORD_SOURCE);
+   if(json_obj != NULL && json_is_string(json_obj)) {
+      const char *source = json_string_value(json_obj);
+      if(0 == strcmp(source, "ptt")) {
+         script->keyword_source = XRAUDIO_DEVICE_INPUT_PTT;
+      } else if(0 == strcmp(source, "ff")) {
+         script->keyword_source = XRAUDIO_DEVICE_INPUT_FF;
+      } else {
+         script->keyword_source = XRAUDIO_DEVICE_INPUT_SINGLE;
+      }
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_BOOL_NAME_MOCK_KEYWORD_ERROR);
+   if(json_obj != NULL && json_is_boolean(json_obj)) {
+      script->keyword_error = json_is_true(json_obj) ? true : false;
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_INT_NAME_MOCK_EOS_OFFSET);
+   if(json_obj != NULL && json_is_integer(json_obj)) {
+      script->eos_offset = json_integer_value(json_obj);
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_INT_NAME_MOCK_ERROR_OFFSET);
+   if(json_obj != NULL && json_is_integer(json_obj)) {
+      script->error_offset = json_integer_value(json_obj);
+   }
+   json_obj = json_object_get(json_obj_mock, JSON_INT_NAME_MOCK_FRAME_SIZE);
+   if(json_obj != NULL && json_is_integer(json_obj) && json_integer_value(json_obj) > 0 && json_integer_value(json_obj) <= XRAUDIO_MOCK_FRAME_SIZE_MAX) {
+      script->frame_size = json_integer_value(json_obj);
+   }
+}
+
+void xraudio_version(xraudio_version_info_t *version_info, uint32_t *qty) {
+   if(version_info == NULL || qty == NULL || *qty < 1) {
+      return;
+   }
+   version_info->name      = "xraudio-mock";
+   version_info->version   = "1.0";
+   version_info->branch    = "";
+   version_info->commit_id = "";
+   *qty = 1;
+}
+
+xraudio_result_t xraudio_available_devices_get(xraudio_object_t object, xraudio_devices_input_t *inputs, uint32_t input_qty_max, xraudio_devices_output_t *outputs, uint32_t output_qty_max) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   if(inputs == NULL || input_qty_max < 1) {
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+   inputs[0] = XRAUDIO_DEVICE_INPUT_SINGLE;
+   if(outputs != NULL && output_qty_max > 0) {
+      outputs[0] = XRAUDIO_DEVICE_OUTPUT_NONE;
+   }
+   return(XRAUDIO_RESULT_OK);
+}
+
+#ifdef XRAUDIO_RESOURCE_MGMT
+xraudio_result_t xraudio_resource_request(xraudio_object_t object, xraudio_devices_input_t input, xraudio_devices_output_t output, xraudio_resource_priority_t priority, xraudio_resource_notification_t callback, void *param) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   // Resources are always available, grant immediately
+   if(callback != NULL) {
+      (*callback)(XRAUDIO_RESOURCE_EVENT_GRANTED, param);
+   }
+   return(XRAUDIO_RESULT_OK);
+}
+
+void xraudio_resource_release(xraudio_object_t object) {
+}
+#endif
+
+xraudio_result_t xraudio_open(xraudio_object_t object, xraudio_power_mode_t power_mode, bool privacy_mode, xraudio_devices_input_t input, xraudio_devices_output_t output, xraudio_input_format_t *format) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   if(obj->opened) {
+      pthread_mutex_unlock(&obj->mutex);
+      return(XRAUDIO_RESULT_ERROR_STATE);
+   }
+   obj->opened        = true;
+   obj->power_mode    = power_mode;
+   obj->privacy_mode  = privacy_mode;
+   obj->device_input  = input;
+   obj->device_output = output;
+   if(format != NULL) {
+      obj->format = *format;
+   }
+   pthread_mutex_unlock(&obj->mutex);
+
+   XLOGD_INFO("input <%s> output <%s> power mode <%s>", xraudio_devices_input_str(input), xraudio_devices_output_str(output), xraudio_power_mode_str(power_mode));
+   return(XRAUDIO_RESULT_OK);
+}
+
+void xraudio_close(xraudio_object_t object) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return;
+   }
+   pthread_mutex_lock(&obj->mutex);
+   xraudio_mock_stream_close(&obj->stream);
+   obj->detecting        = false;
+   obj->keyword_callback = NULL;
+   obj->opened           = false;
+   pthread_mutex_unlock(&obj->mutex);
+}
+
+xraudio_result_t xraudio_power_mode_update(xraudio_object_t object, xraudio_power_mode_t power_mode) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->power_mode = power_mode;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_privacy_mode_update(xraudio_object_t object, xraudio_devices_input_t input, bool enable) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->privacy_mode = enable;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_privacy_mode_get(xraudio_object_t object, xraudio_devices_input_t input, bool *enabled) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   if(enabled == NULL) {
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+   *enabled = obj->privacy_mode;
+   return(XRAUDIO_RESULT_OK);
+}
+
+void xraudio_thread_poll(xraudio_object_t object, xraudio_thread_poll_func_t func) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return;
+   }
+   // Call the function from the mock thread to prove that it is responsive
+   pthread_mutex_lock(&obj->mutex);
+   obj->poll_func = func;
+   pthread_cond_signal(&obj->cond);
+   pthread_mutex_unlock(&obj->mutex);
+}
+
+void xraudio_internal_capture_params_set(xraudio_object_t object, xraudio_internal_capture_params_t *params) {
+}
+
+void xraudio_internal_capture_delete_files(xraudio_object_t object, const char *dir_path) {
+}
+
+xraudio_result_t xraudio_capture_to_file_start(xraudio_object_t object, xraudio_capture_t capture, xraudio_container_t container, const char *audio_file_path, bool raw_mic_enable, audio_in_capture_callback_t callback, void *param) {
+   XLOGD_WARN("capture not supported");
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_capture_stop(xraudio_object_t object) {
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_detect_params(xraudio_object_t object, xraudio_keyword_phrase_t keyword_phrase, xraudio_keyword_sensitivity_t keyword_sensitivity) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->keyword_phrase      = keyword_phrase;
+   obj->keyword_sensitivity = keyword_sensitivity;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_detect_sensitivity_limits_get(xraudio_object_t object, xraudio_keyword_sensitivity_t *keyword_sensitivity_min, xraudio_keyword_sensitivity_t *keyword_sensitivity_max) {
+   if(keyword_sensitivity_min == NULL || keyword_sensitivity_max == NULL) {
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+   *keyword_sensitivity_min = 0.0;
+   *keyword_sensitivity_max = 1.0;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_detect_keyword(xraudio_object_t object, keyword_callback_t callback, void *param) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   if(!obj->opened) {
+      pthread_mutex_unlock(&obj->mutex);
+      return(XRAUDIO_RESULT_ERROR_STATE);
+   }
+   obj->detecting        = true;
+   obj->keyword_callback = callback;
+   obj->keyword_param    = param;
+   clock_gettime(CLOCK_MONOTONIC, &obj->keyword_time);
+   xraudio_mock_timespec_add_us(&obj->keyword_time, ((uint64_t)obj->script.keyword_delay) * 1000);
+   pthread_cond_signal(&obj->cond);
+   pthread_mutex_unlock(&obj->mutex);
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_detect_stop(xraudio_object_t object) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   obj->detecting        = false;
+   obj->keyword_callback = NULL;
+   pthread_mutex_unlock(&obj->mutex);
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_latency_mode_set(xraudio_object_t object, xraudio_devices_input_t source, xraudio_stream_latency_mode_t latency_mode) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->stream.latency_mode = latency_mode;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_frame_group_quantity_set(xraudio_object_t object, xraudio_devices_input_t source, uint8_t quantity) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   if(quantity == 0) {
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   obj->stream.frame_group_qty = quantity;
+   pthread_mutex_unlock(&obj->mutex);
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_identifier_set(xraudio_object_t object, xraudio_devices_input_t source, const char *identifier) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   snprintf(obj->stream.identifier, sizeof(obj->stream.identifier), "%s", (identifier != NULL) ? identifier : "");
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_time_minimum(xraudio_object_t object, xraudio_devices_input_t source, uint16_t ms) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->stream.stream_time_min = ms;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_keyword_info(xraudio_object_t object, xraudio_devices_input_t source, uint32_t keyword_begin, uint32_t keyword_duration) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   obj->stream.keyword_begin    = keyword_begin;
+   obj->stream.keyword_duration = keyword_duration;
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_to_pipe(xraudio_object_t object, xraudio_devices_input_t source, xraudio_dst_pipe_t dsts[], xraudio_input_format_t *format_decoded, audio_in_callback_t callback, void *param) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   if(dsts == NULL) {
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   xraudio_mock_stream_t *stream = &obj->stream;
+   if(!obj->opened || stream->active) {
+      pthread_mutex_unlock(&obj->mutex);
+      return(XRAUDIO_RESULT_ERROR_STATE);
+   }
+
+   stream->source   = source;
+   stream->callback = callback;
+   stream->param    = param;
+   stream->format   = (format_decoded != NULL) ? *format_decoded : obj->format;
+
+   for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+      stream->pipes[index] = dsts[index].pipe;
+      if(stream->pipes[index] < 0) {
+         break;
+      }
+      // Never block the mock thread on a slow reader, drop audio instead like the real implementation
+      int flags = fcntl(stream->pipes[index], F_GETFL);
+      if(flags < 0 || fcntl(stream->pipes[index], F_SETFL, flags | O_NONBLOCK) < 0) {
+         XLOGD_WARN("unable to set pipe <%d> non-blocking", stream->pipes[index]);
+      }
+   }
+
+   if(!xraudio_mock_stream_open_audio(obj, stream)) {
+      for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+         stream->pipes[index] = -1; // the caller closes the pipes on failure
+      }
+      pthread_mutex_unlock(&obj->mutex);
+      return(XRAUDIO_RESULT_ERROR_PARAMS);
+   }
+
+   if(stream->frame_group_qty == 0) {
+      stream->frame_group_qty = 1;
+   }
+   stream->active = true;
+   clock_gettime(CLOCK_MONOTONIC, &stream->time_next);
+
+   XLOGD_INFO("stream id <%s> source <%s> frame size <%u> group qty <%u> period <%u> usecs", stream->identifier, xraudio_devices_input_str(source), stream->frame_size, stream->frame_group_qty, stream->frame_period);
+   pthread_cond_signal(&obj->cond);
+   pthread_mutex_unlock(&obj->mutex);
+   return(XRAUDIO_RESULT_OK);
+}
+
+xraudio_result_t xraudio_stream_stop(xraudio_object_t object, xraudio_devices_input_t source, int32_t index) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)object;
+   if(!xraudio_mock_object_is_valid(obj)) {
+      return(XRAUDIO_RESULT_ERROR_OBJECT);
+   }
+   pthread_mutex_lock(&obj->mutex);
+   xraudio_mock_stream_t *stream = &obj->stream;
+   if(index < 0) {
+      xraudio_mock_stream_close(stream);
+   } else if(index < XRAUDIO_MOCK_DST_QTY_MAX) {
+      if(stream->pipes[index] >= 0) {
+         close(stream->pipes[index]);
+         stream->pipes[index] = -1;
+      }
+      bool remaining = false;
+      for(uint32_t i = 0; i < XRAUDIO_MOCK_DST_QTY_MAX; i++) {
+         if(stream->pipes[i] >= 0) {
+            remaining = true;
+         }
+      }
+      if(!remaining) {
+         xraudio_mock_stream_close(stream);
+      }
+   }
+   pthread_mutex_unlock(&obj->mutex);
+   return(XRAUDIO_RESULT_OK);
+}
+
+void xraudio_mock_stream_reset(xraudio_mock_stream_t *stream) {
+   memset(stream, 0, sizeof(*stream));
+   for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+      stream->pipes[index] = -1;
+   }
+   stream->fd_audio     = -1;
+   stream->latency_mode = XRAUDIO_STREAM_LATENCY_NORMAL;
+}
+
+void xraudio_mock_stream_close(xraudio_mock_stream_t *stream) {
+   for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+      if(stream->pipes[index] >= 0) {
+         close(stream->pipes[index]);
+      }
+   }
+   if(stream->fd_audio >= 0) {
+      close(stream->fd_audio);
+   }
+   xraudio_mock_stream_reset(stream);
+}
+
+bool xraudio_mock_stream_open_audio(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream) {
+   xraudio_input_format_t *format = &stream->format;
+   bool pcm = (format->encoding == XRAUDIO_ENCODING_PCM || format->encoding == XRAUDIO_ENCODING_PCM_RAW);
+
+   if(pcm) {
+      stream->frame_size   = (format->sample_rate * format->sample_size * format->channel_qty * XRAUDIO_INPUT_FRAME_PERIOD) / 1000;
+      stream->frame_period = XRAUDIO_INPUT_FRAME_PERIOD * 1000;
+   } else {
+      // Encoded audio is forwarded as-is from the file in fixed size frames
+      stream->frame_size   = obj->script.frame_size;
+      stream->frame_period = 1000 * 1000 * XRAUDIO_INPUT_ADPCM_XVP_FRAME_SAMPLE_QTY / ((format->sample_rate > 0) ? format->sample_rate : XRAUDIO_INPUT_DEFAULT_SAMPLE_RATE);
+   }
+   if(stream->frame_size == 0 || stream->frame_size > XRAUDIO_MOCK_FRAME_SIZE_MAX) {
+      XLOGD_ERROR("invalid frame size <%u>", stream->frame_size);
+      return(false);
+   }
+
+   if(obj->script.audio_file[0] == '\0') {
+      if(!pcm) {
+         XLOGD_ERROR("audio file required for encoding <%s>", xraudio_encoding_str(format->encoding));
+         return(false);
+      }
+      stream->fd_audio              = -1;
+      stream->audio_bytes_remaining = (uint32_t)(((uint64_t)obj->script.audio_duration * stream->frame_size) / XRAUDIO_INPUT_FRAME_PERIOD);
+      return(true);
+   }
+
+   stream->fd_audio = open(obj->script.audio_file, O_RDONLY);
+   if(stream->fd_audio < 0) {
+      int errsv = errno;
+      XLOGD_ERROR("unable to open <%s> <%s>", obj->script.audio_file, strerror(errsv));
+      return(false);
+   }
+   off_t size = lseek(stream->fd_audio, 0, SEEK_END);
+   lseek(stream->fd_audio, 0, SEEK_SET);
+   stream->audio_bytes_remaining = (size > 0) ? size : 0;
+
+   // Skip the WAV header to the start of the data chunk
+   uint8_t header[12];
+   if(read(stream->fd_audio, header, sizeof(header)) == sizeof(header) && 0 == memcmp(header, "RIFF", 4) && 0 == memcmp(&header[8], "WAVE", 4)) {
+      uint8_t chunk[8];
+      bool    found = false;
+      while(read(stream->fd_audio, chunk, sizeof(chunk)) == sizeof(chunk)) {
+         uint32_t chunk_size = chunk[4] | (chunk[5] << 8) | (chunk[6] << 16) | ((uint32_t)chunk[7] << 24);
+         if(0 == memcmp(chunk, "data", 4)) {
+            stream->audio_bytes_remaining = chunk_size;
+            found = true;
+            break;
+         }
+         if(lseek(stream->fd_audio, chunk_size + (chunk_size & 1), SEEK_CUR) < 0) {
+            break;
+         }
+      }
+      if(!found) {
+         XLOGD_ERROR("no data chunk in <%s>", obj->script.audio_file);
+         close(stream->fd_audio);
+         stream->fd_audio = -1;
+         return(false);
+      }
+   } else {
+      lseek(stream->fd_audio, 0, SEEK_SET);
+   }
+   return(true);
+}
+
+void xraudio_mock_stream_event(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream, audio_in_callback_event_t event, void *event_param) {
+   audio_in_callback_t     callback = stream->callback;
+   void                   *param    = stream->param;
+   xraudio_devices_input_t source   = stream->source;
+
+   XLOGD_INFO("source <%s> event <%s>", xraudio_devices_input_str(source), audio_in_callback_event_str(event));
+
+   if(callback != NULL) { // Call without the lock held since the handler may call back into the api
+      pthread_mutex_unlock(&obj->mutex);
+      (*callback)(source, event, event_param, param);
+      pthread_mutex_lock(&obj->mutex);
+   }
+}
+
+void xraudio_mock_stream_process(xraudio_mock_obj_t *obj, xraudio_mock_stream_t *stream) {
+   uint8_t  buffer[XRAUDIO_MOCK_FRAME_SIZE_MAX];
+   uint32_t group_qty = stream->frame_group_qty;
+
+   for(uint32_t frame = 0; frame < group_qty && stream->active && !stream->ended; frame++) {
+      uint32_t size     = (stream->audio_bytes_remaining < stream->frame_size) ? stream->audio_bytes_remaining : stream->frame_size;
+      uint32_t bytes_ms = stream->frame_size / ((stream->frame_period >= 1000) ? (stream->frame_period / 1000) : 1);
+      uint32_t ms       = (bytes_ms > 0) ? (uint32_t)(stream->bytes_streamed / bytes_ms) : 0;
+      bool     eos      = (size == 0) || (obj->script.eos_offset >= 0 && ms >= (uint32_t)obj->script.eos_offset);
+
+      if(obj->script.error_offset >= 0 && ms >= (uint32_t)obj->script.error_offset) {
+         stream->ended = true;
+         xraudio_mock_stream_event(obj, stream, AUDIO_IN_CALLBACK_EVENT_ERROR, NULL);
+         return;
+      }
+
+      if(eos) {
+         xraudio_audio_stats_t stats = stream->stats;
+         stream->ended = true;
+         // Close the pipes so the readers see EOF after the remaining audio
+         for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+            if(stream->pipes[index] >= 0) {
+               close(stream->pipes[index]);
+               stream->pipes[index] = -1;
+            }
+         }
+         xraudio_mock_stream_event(obj, stream, AUDIO_IN_CALLBACK_EVENT_EOS, &stats);
+         return;
+      }
+
+      if(stream->fd_audio >= 0) {
+         int rc = read(stream->fd_audio, buffer, size);
+         if(rc <= 0) {
+            stream->audio_bytes_remaining = 0;
+            continue;
+         }
+         size = rc;
+      } else {
+         memset(buffer, 0, size);
+      }
+      stream->audio_bytes_remaining -= size;
+
+      uint32_t sample_bytes = stream->format.sample_size * stream->format.channel_qty;
+      uint32_t samples      = (sample_bytes > 0) ? size / sample_bytes : 0;
+
+      for(uint32_t index = 0; index < XRAUDIO_MOCK_DST_QTY_MAX; index++) {
+         if(stream->pipes[index] < 0) {
+            break;
+         }
+         int rc = write(stream->pipes[index], buffer, size);
+         if(rc != size) {
+            stream->stats.packets_lost++;
+            stream->stats.samples_lost += samples;
+         }
+      }
+      stream->stats.packets_processed++;
+      stream->stats.samples_processed += samples;
+      stream->bytes_streamed          += size;
+
+      if(stream->keyword_duration > 0 && !stream->keyword_info_fired && stream->bytes_streamed >= (uint64_t)stream->keyword_duration * sample_bytes) {
+         xraudio_stream_keyword_info_t kwd_info;
+         memset(&kwd_info, 0, sizeof(kwd_info));
+         kwd_info.byte_qty = stream->keyword_duration * sample_bytes;
+         stream->keyword_info_fired = true;
+         xraudio_mock_stream_event(obj, stream, AUDIO_IN_CALLBACK_EVENT_STREAM_KWD_INFO, &kwd_info);
+      }
+
+      if(stream->stream_time_min > 0 && !stream->stream_time_min_fired && bytes_ms > 0 && (stream->bytes_streamed / bytes_ms) >= stream->stream_time_min) {
+         stream->stream_time_min_fired = true;
+         xraudio_mock_stream_event(obj, stream, AUDIO_IN_CALLBACK_EVENT_STREAM_TIME_MINIMUM, NULL);
+      }
+   }
+}
+
+void *xraudio_mock_thread(void *param) {
+   xraudio_mock_obj_t *obj = (xraudio_mock_obj_t *)param;
+
+   pthread_mutex_lock(&obj->mutex);
+   while(obj->running) {
+      struct timespec  now;
+      struct timespec *timeout = NULL;
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      if(obj->poll_func != NULL) {
+         xraudio_thread_poll_func_t func = obj->poll_func;
+         obj->poll_func = NULL;
+         pthread_mutex_unlock(&obj->mutex);
+         (*func)();
+         pthread_mutex_lock(&obj->mutex);
+      }
+
+      if(obj->detecting && obj->keyword_callback != NULL && obj->script.keyword_delay > 0) {
+         if(xraudio_mock_timespec_due(&obj->keyword_time, &now)) {
+            keyword_callback_t      callback = obj->keyword_callback;
+            void                   *cb_param = obj->keyword_param;
+            xraudio_input_format_t  format   = obj->format;
+            xraudio_devices_input_t source   = obj->script.keyword_source;
+
+            if(source == XRAUDIO_DEVICE_INPUT_SINGLE) { // report the local microphone that is open
+               source = (XRAUDIO_DEVICE_INPUT_LOCAL_GET(obj->device_input) != XRAUDIO_DEVICE_INPUT_NONE) ? XRAUDIO_DEVICE_INPUT_LOCAL_GET(obj->device_input) : XRAUDIO_DEVICE_INPUT_SINGLE;
+            }
+            obj->detecting        = false;
+            obj->keyword_callback = NULL;
+
+            XLOGD_INFO("keyword %s source <%s>", obj->script.keyword_error ? "error" : "detected", xraudio_devices_input_str(source));
+            pthread_mutex_unlock(&obj->mutex);
+            (*callback)(source, obj->script.keyword_error ? KEYWORD_CALLBACK_EVENT_ERROR : KEYWORD_CALLBACK_EVENT_DETECTED, cb_param, NULL, format);
+            pthread_mutex_lock(&obj->mutex);
+            continue;
+         }
+         timeout = &obj->keyword_time;
+      }
+
+      xraudio_mock_stream_t *stream = &obj->stream;
+      if(stream->active && !stream->ended) {
+         if(xraudio_mock_timespec_due(&stream->time_next, &now)) {
+            xraudio_mock_stream_process(obj, stream);
+            if(obj->script.rate > 0.0) {
+               xraudio_mock_timespec_add_us(&stream->time_next, (uint64_t)((stream->frame_period * stream->frame_group_qty) / obj->script.rate));
+            } else {
+               stream->time_next = now;
+            }
+            continue;
+         }
+         if(timeout == NULL || !xraudio_mock_timespec_due(timeout, &stream->time_next)) {
+            timeout = &stream->time_next;
+         }
+      }
+
+      if(timeout == NULL) {
+         pthread_cond_wait(&obj->cond, &obj->mutex);
+      } else {
+         struct timespec deadline = *timeout;
+         pthread_cond_timedwait(&obj->cond, &obj->mutex, &deadline);
+      }
+   }
+   pthread_mutex_unlock(&obj->mutex);
+   return(NULL);
+}
+
+void xraudio_mock_timespec_add_us(struct timespec *ts, uint64_t usecs) {
+   uint64_t nsecs = ts->tv_nsec + (usecs * 1000);
+   ts->tv_sec  += nsecs / 1000000000;
+   ts->tv_nsec  = nsecs % 1000000000;
+}
+
+bool xraudio_mock_timespec_due(const struct timespec *ts, const struct timespec *now) {
+   if(now->tv_sec > ts->tv_sec) {
+      return(true);
+   }
+   return(now->tv_sec == ts->tv_sec && now->tv_nsec >= ts->tv_nsec);
+}
+
+const char *xraudio_mock_invalid_return(int value) {
+   snprintf(g_xraudio_mock_invalid_str, XRAUDIO_MOCK_INVALID_STR_LEN, "INVALID(%d)", value);
+   g_xraudio_mock_invalid_str[XRAUDIO_MOCK_INVALID_STR_LEN - 1] = '\0';
+   return(g_xraudio_mock_invalid_str);
+}
+
+const char *xraudio_result_str(xraudio_result_t type) {
+   switch(type) {
+      case XRAUDIO_RESULT_OK:              return("OK");
+      case XRAUDIO_RESULT_ERROR_OBJECT:    return("ERROR_OBJECT");
+      case XRAUDIO_RESULT_ERROR_PARAMS:    return("ERROR_PARAMS");
+      case XRAUDIO_RESULT_ERROR_STATE:     return("ERROR_STATE");
+      case XRAUDIO_RESULT_ERROR_MIC_OPEN:  return("ERROR_MIC_OPEN");
+      case XRAUDIO_RESULT_ERROR_INVALID:   return("ERROR_INVALID");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_devices_input_str(xraudio_devices_input_t type) {
+   switch(type) {
+      case XRAUDIO_DEVICE_INPUT_NONE:    return("NONE");
+      case XRAUDIO_DEVICE_INPUT_SINGLE:  return("SINGLE");
+      case XRAUDIO_DEVICE_INPUT_TRI:     return("TRI");
+      case XRAUDIO_DEVICE_INPUT_QUAD:    return("QUAD");
+      case XRAUDIO_DEVICE_INPUT_PTT:     return("PTT");
+      case XRAUDIO_DEVICE_INPUT_FF:      return("FF");
+      case XRAUDIO_DEVICE_INPUT_MIC_TAP: return("MIC_TAP");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_devices_output_str(xraudio_devices_output_t type) {
+   if(type == XRAUDIO_DEVICE_OUTPUT_NONE) {
+      return("NONE");
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_power_mode_str(xraudio_power_mode_t type) {
+   switch(type) {
+      case XRAUDIO_POWER_MODE_FULL:    return("FULL");
+      case XRAUDIO_POWER_MODE_LOW:     return("LOW");
+      case XRAUDIO_POWER_MODE_SLEEP:   return("SLEEP");
+      case XRAUDIO_POWER_MODE_INVALID: return("INVALID");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_encoding_str(xraudio_encoding_t type) {
+   switch(type) {
+      case XRAUDIO_ENCODING_PCM:       return("PCM");
+      case XRAUDIO_ENCODING_PCM_RAW:   return("PCM_RAW");
+      case XRAUDIO_ENCODING_ADPCM:     return("ADPCM");
+      case XRAUDIO_ENCODING_ADPCM_XVP: return("ADPCM_XVP");
+      case XRAUDIO_ENCODING_ADPCM_SKY: return("ADPCM_SKY");
+      case XRAUDIO_ENCODING_OPUS:      return("OPUS");
+      case XRAUDIO_ENCODING_OPUS_XVP:  return("OPUS_XVP");
+      case XRAUDIO_ENCODING_INVALID:   return("INVALID");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_keyword_phrase_str(xraudio_keyword_phrase_t type) {
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_stream_latency_mode_str(xraudio_stream_latency_mode_t type) {
+   switch(type) {
+      case XRAUDIO_STREAM_LATENCY_NORMAL: return("NORMAL");
+      case XRAUDIO_STREAM_LATENCY_LOW:    return("LOW");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *xraudio_resource_event_str(xraudio_resource_event_t type) {
+   return(xraudio_mock_invalid_return(type));
+}
+
+const char *audio_in_callback_event_str(audio_in_callback_event_t type) {
+   switch(type) {
+      case AUDIO_IN_CALLBACK_EVENT_EOS:                 return("EOS");
+      case AUDIO_IN_CALLBACK_EVENT_EOS_TIMEOUT_INITIAL: return("EOS_TIMEOUT_INITIAL");
+      case AUDIO_IN_CALLBACK_EVENT_EOS_TIMEOUT_END:     return("EOS_TIMEOUT_END");
+      case AUDIO_IN_CALLBACK_EVENT_STREAM_TIME_MINIMUM: return("STREAM_TIME_MINIMUM");
+      case AUDIO_IN_CALLBACK_EVENT_STREAM_KWD_INFO:     return("STREAM_KWD_INFO");
+      case AUDIO_IN_CALLBACK_EVENT_ERROR:               return("ERROR");
+      default: break;
+   }
+   return(xraudio_mock_invalid_return(type));
+}
@@ -40,6 +40,8 @@
 #define XRSR_KEYWORD_PHRASE (XRAUDIO_KEYWORD_PHRASE_HEY_XFINITY)
 #endif
 
+#define XRSR_TRACE_DUMP_QTY_ERROR (64) // trace records written per thread when a session ends with an error
+
 typedef enum {
    XRSR_THREAD_MAIN = 0,
    XRSR_THREAD_QTY  = 1,
@@ -57,14 +59,31 @@ typedef union {
    #ifdef SDT_ENABLED
    xrsr_state_sdt_t  sdt;
    #endif
+   #ifdef UNIX_ENABLED
+   xrsr_state_unix_t unx;
+   #endif
 } xrsr_conn_state_t;
 
 typedef struct {
    bool                         initialized;
    xrsr_url_parts_t             url_parts;
+   xrsr_url_parts_t             url_parts_hedge;
+   xrsr_endpoint_pool_t         endpoints;
+   xrsr_url_parts_t             url_parts_fallback;
+   xrsr_circuit_t               circuit;
+   bool                         fast_fail;
+   bool                         fallback;
+   xrsr_grouping_t              grouping;
+   xrsr_format_link_t           format_link;
+   xrsr_audio_format_t          format;        // outgoing audio format selected for the current session
+   xrsr_format_reason_t         format_reason;
    xrsr_route_handler_t         handler;
    xrsr_handlers_t              handlers;
    xrsr_audio_format_t          formats;
+   uint32_t                     sample_rate;   // rate of the audio sent to the destination or zero for the xraudio rate
+   bool                         trim_silence;
+   xrsr_stage_t                 stages[XRSR_STAGE_QTY_MAX];
+   uint32_t                     stage_qty;
    uint16_t                     stream_time_min;
    xraudio_input_record_from_t  stream_from;
    int32_t                      stream_offset;
@@ -110,6 +129,26 @@ typedef struct {
    bool      val_ipv4_fallback;
    uint32_t *ptr_backoff_delay;
    uint32_t  val_backoff_delay;
+   uint32_t *ptr_reconnect_buffer_size;
+   uint32_t  val_reconnect_buffer_size;
+   uint32_t *ptr_send_queue_size;
+   uint32_t  val_send_queue_size;
+   uint32_t *ptr_send_queue_latency;
+   uint32_t  val_send_queue_latency;
+   uint32_t *ptr_hedge_delay;
+   uint32_t  val_hedge_delay;
+   xrsr_socket_profile_t *ptr_socket_profile;
+   xrsr_socket_profile_t  val_socket_profile;
+   bool *    ptr_deflate;
+   bool      val_deflate;
+   bool *    ptr_deflate_no_context_takeover;
+   bool      val_deflate_no_context_takeover;
+   uint32_t *ptr_circuit_threshold;
+   uint32_t  val_circuit_threshold;
+   uint32_t *ptr_circuit_open_period;
+   uint32_t  val_circuit_open_period;
+   uint32_t *ptr_ping_interval;
+   uint32_t  val_ping_interval;
 } xrsr_ws_json_config_t;
 #endif
 
@@ -118,6 +157,13 @@ typedef struct {
    xrsr_src_t                    src;
    xraudio_devices_input_t       xraudio_device_input;
    int                           pipe_fds_rd[XRSR_DST_QTY_MAX]; // cache the read side of the pipes since the stream requests
+   int32_t                       chan_selected;                 // keyword detector's channel (less than zero if not detected)
+   float                         gain_db;                       // keyword and dynamic gain of the selected channel
+   xrsr_pipeline_t *             pipelines[XRSR_DST_QTY_MAX];   // audio processing between xraudio and the destinations which need it
+   uint32_t                      frame_sizes[XRSR_DST_QTY_MAX]; // size of an xraudio frame in each destination's stream (0 if frames can't be located)
+   uint32_t                      group_size;                    // frame group size applied to xraudio for all destinations
+   bool                          eos_rxd;
+   rdkx_timestamp_t              eos_timestamp;                 // time that xraudio detected the end of speech
 } xrsr_session_t;
 
 typedef struct {
@@ -135,6 +181,10 @@ typedef struct {
    xrsr_ws_json_config_t          ws_json_config_fpm;
    xrsr_ws_json_config_t          ws_json_config_lpm;
    #endif
+   #ifdef OPUS_ENABLED
+   xrsr_encoder_config_t          encoder_config;
+   #endif
+   xrsr_trim_config_t             trim_config;
 } xrsr_global_t;
 
 static void xrsr_session_stream_kwd(const uuid_t uuid, const char *uuid_str, xrsr_src_t src, uint32_t dst_index);
@@ -163,6 +213,7 @@ static void xrsr_msg_session_terminate                      (const xrsr_thread_p
 static void xrsr_msg_session_capture_start                  (const xrsr_thread_params_t *params, xrsr_thread_state_t *state, void *msg);
 static void xrsr_msg_session_capture_stop                   (const xrsr_thread_params_t *params, xrsr_thread_state_t *state, void *msg);
 static void xrsr_msg_thread_poll                            (const xrsr_thread_params_t *params, xrsr_thread_state_t *state, void *msg);
+static void xrsr_msg_circuit_probe                          (const xrsr_thread_params_t *params, xrsr_thread_state_t *state, void *msg);
 
 static bool     xrsr_is_source_active(xrsr_src_t src);
 static bool     xrsr_is_group_active(uint32_t group);
@@ -189,6 +240,7 @@ static const xrsr_msg_handler_t g_xrsr_msg_handlers[XRSR_QUEUE_MSG_TYPE_INVALID]
    xrsr_msg_session_capture_start,
    xrsr_msg_session_capture_stop,
    xrsr_msg_thread_poll,
+   xrsr_msg_circuit_probe,
 };
 
 static xrsr_global_t g_xrsr;
@@ -199,8 +251,19 @@ static void *xrsr_thread_main(void *param);
 static void xrsr_route_free_all(void);
 static void xrsr_route_free(xrsr_src_t src, bool closing);
 static void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_thread_state_t *state);
+#ifdef WS_ENABLED
+static void xrsr_circuit_params_update(xrsr_dst_int_t *dst, xrsr_power_mode_t power_mode);
+#endif
 
-static xrsr_audio_format_t xrsr_audio_format_get(uint32_t formats_supported_dst, xraudio_input_format_t format_src);
+static xrsr_audio_format_t xrsr_dst_format_select(xrsr_dst_int_t *dst, xraudio_input_format_t format_src);
+static uint32_t xrsr_dst_sample_rate(xrsr_dst_int_t *dst, uint32_t sample_rate_src);
+static void xrsr_speech_stream_format_pcm(const xrsr_session_t *session, xraudio_input_format_t native_format, xraudio_input_format_t *xraudio_format);
+static bool xrsr_speech_stream_stages_open(xrsr_session_t *session, xrsr_src_t src, const xraudio_input_format_t *xraudio_format, bool user_initiated);
+static void xrsr_speech_stream_stages_close(xrsr_session_t *session);
+static void xrsr_speech_stream_stage_close(xrsr_session_t *session, uint32_t dst_index, xrsr_stream_stats_t *stats);
+static xrsr_pipeline_t *xrsr_speech_stream_pipeline(xrsr_src_t src, uint32_t dst_index, int fd);
+static bool xrsr_speech_stream_group_size(xrsr_src_t src, uint32_t *group_size);
+static void xrsr_speech_stream_grouping_end(xrsr_src_t src);
 
 void xrsr_version(xrsr_version_info_t *version_info, uint32_t *qty) {
    if(qty == NULL || *qty < XRSR_VERSION_QTY_MAX || version_info == NULL) {
@@ -294,6 +357,21 @@ bool xrsr_open(const char *host_name, const xrsr_route_t routes[], const xrsr_ke
       for(uint32_t dst_index = 0; dst_index < routes[index].dst_qty; dst_index++) {
          const xrsr_dst_t *dst = &routes[index].dsts[dst_index];
          XLOGD_INFO("dst <%s>", dst->url);
+         if(dst->url_hedge != NULL) {
+            XLOGD_INFO("dst hedge <%s>", dst->url_hedge);
+         }
+         if(dst->url_fallback != NULL) {
+            XLOGD_INFO("dst fallback <%s>", dst->url_fallback);
+         }
+         if(dst->sample_rate != 0) {
+            XLOGD_INFO("dst sample rate <%u>", dst->sample_rate);
+         }
+         if(dst->trim_silence) {
+            XLOGD_INFO("dst trim silence <YES>");
+         }
+         if(dst->stage_qty != 0) {
+            XLOGD_INFO("dst stages <%u>", dst->stage_qty);
+         }
       }
       index++;
    } while(1);
@@ -306,9 +384,12 @@ bool xrsr_open(const char *host_name, const xrsr_route_t routes[], const xrsr_ke
       session->first_stream_req     = true;
       session->src                  = XRSR_SRC_INVALID;
       session->xraudio_device_input = XRAUDIO_DEVICE_INPUT_NONE;
+      session->group_size           = 0;
 
       for(index = 0; index < XRSR_DST_QTY_MAX; index++) {
          session->pipe_fds_rd[index] = -1;
+         session->pipelines[index]   = NULL;
+         session->frame_sizes[index] = 0;
       }
    }
 
@@ -399,6 +480,90 @@ bool xrsr_open(const char *host_name, const xrsr_route_t routes[], const xrsr_ke
                XLOGD_INFO("ws fpm json: backoff delay <%d> ms", g_xrsr.ws_json_config_fpm.val_backoff_delay);
             }
          }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_RECONNECT_BUFFER_SIZE);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+               g_xrsr.ws_json_config_fpm.val_reconnect_buffer_size = value;
+               g_xrsr.ws_json_config_fpm.ptr_reconnect_buffer_size = &g_xrsr.ws_json_config_fpm.val_reconnect_buffer_size;
+               XLOGD_INFO("ws fpm json: reconnect buffer size <%d> bytes", g_xrsr.ws_json_config_fpm.val_reconnect_buffer_size);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_SEND_QUEUE_SIZE);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+               g_xrsr.ws_json_config_fpm.val_send_queue_size = value;
+               g_xrsr.ws_json_config_fpm.ptr_send_queue_size = &g_xrsr.ws_json_config_fpm.val_send_queue_size;
+               XLOGD_INFO("ws fpm json: send queue size <%d> bytes", g_xrsr.ws_json_config_fpm.val_send_queue_size);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_SEND_QUEUE_LATENCY);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 60000) {
+               g_xrsr.ws_json_config_fpm.val_send_queue_latency = value;
+               g_xrsr.ws_json_config_fpm.ptr_send_queue_latency = &g_xrsr.ws_json_config_fpm.val_send_queue_latency;
+               XLOGD_INFO("ws fpm json: send queue latency <%d> ms", g_xrsr.ws_json_config_fpm.val_send_queue_latency);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_HEDGE_DELAY);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 10000) {
+               g_xrsr.ws_json_config_fpm.val_hedge_delay = value;
+               g_xrsr.ws_json_config_fpm.ptr_hedge_delay = &g_xrsr.ws_json_config_fpm.val_hedge_delay;
+               XLOGD_INFO("ws fpm json: hedge delay <%d> ms", g_xrsr.ws_json_config_fpm.val_hedge_delay);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_STR_NAME_WS_FPM_SOCKET_PROFILE);
+         if(json_obj != NULL && json_is_string(json_obj)) {
+            xrsr_socket_profile_t value = xrsr_socket_profile_from_str(json_string_value(json_obj));
+            if(value < XRSR_SOCKET_PROFILE_INVALID) {
+               g_xrsr.ws_json_config_fpm.val_socket_profile = value;
+               g_xrsr.ws_json_config_fpm.ptr_socket_profile = &g_xrsr.ws_json_config_fpm.val_socket_profile;
+               XLOGD_INFO("ws fpm json: socket profile <%s>", xrsr_socket_profile_str(g_xrsr.ws_json_config_fpm.val_socket_profile));
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_BOOL_NAME_WS_FPM_DEFLATE);
+         if(json_obj != NULL && json_is_boolean(json_obj)) {
+            g_xrsr.ws_json_config_fpm.val_deflate = json_is_true(json_obj) ? true : false;
+            g_xrsr.ws_json_config_fpm.ptr_deflate = &g_xrsr.ws_json_config_fpm.val_deflate;
+            XLOGD_INFO("ws fpm json: deflate <%s>", g_xrsr.ws_json_config_fpm.val_deflate ? "YES" : "NO");
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_BOOL_NAME_WS_FPM_DEFLATE_CONTEXT_TAKEOVER);
+         if(json_obj != NULL && json_is_boolean(json_obj)) {
+            g_xrsr.ws_json_config_fpm.val_deflate_no_context_takeover = json_is_true(json_obj) ? false : true;
+            g_xrsr.ws_json_config_fpm.ptr_deflate_no_context_takeover = &g_xrsr.ws_json_config_fpm.val_deflate_no_context_takeover;
+            XLOGD_INFO("ws fpm json: deflate context takeover <%s>", g_xrsr.ws_json_config_fpm.val_deflate_no_context_takeover ? "NO" : "YES");
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_CIRCUIT_THRESHOLD);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 100) {
+               g_xrsr.ws_json_config_fpm.val_circuit_threshold = value;
+               g_xrsr.ws_json_config_fpm.ptr_circuit_threshold = &g_xrsr.ws_json_config_fpm.val_circuit_threshold;
+               XLOGD_INFO("ws fpm json: circuit threshold <%d>", g_xrsr.ws_json_config_fpm.val_circuit_threshold);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_CIRCUIT_OPEN_PERIOD);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 1000 && value <= 300000) {
+               g_xrsr.ws_json_config_fpm.val_circuit_open_period = value;
+               g_xrsr.ws_json_config_fpm.ptr_circuit_open_period = &g_xrsr.ws_json_config_fpm.val_circuit_open_period;
+               XLOGD_INFO("ws fpm json: circuit open period <%d> ms", g_xrsr.ws_json_config_fpm.val_circuit_open_period);
+            }
+         }
+         json_obj = json_object_get(json_obj_fpm, JSON_INT_NAME_WS_FPM_PING_INTERVAL);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 60000) {
+               g_xrsr.ws_json_config_fpm.val_ping_interval = value;
+               g_xrsr.ws_json_config_fpm.ptr_ping_interval = &g_xrsr.ws_json_config_fpm.val_ping_interval;
+               XLOGD_INFO("ws fpm json: ping interval <%d> ms", g_xrsr.ws_json_config_fpm.val_ping_interval);
+            }
+         }
       }
 
       json_t *json_obj_lpm = json_object_get(json_obj_ws, JSON_OBJ_NAME_WS_LPM);
@@ -456,10 +621,160 @@ bool xrsr_open(const char *host_name, const xrsr_route_t routes[], const xrsr_ke
                XLOGD_INFO("ws lpm json: backoff delay <%d> ms", g_xrsr.ws_json_config_lpm.val_backoff_delay);
             }
          }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_RECONNECT_BUFFER_SIZE);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+               g_xrsr.ws_json_config_lpm.val_reconnect_buffer_size = value;
+               g_xrsr.ws_json_config_lpm.ptr_reconnect_buffer_size = &g_xrsr.ws_json_config_lpm.val_reconnect_buffer_size;
+               XLOGD_INFO("ws lpm json: reconnect buffer size <%d> bytes", g_xrsr.ws_json_config_lpm.val_reconnect_buffer_size);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_SEND_QUEUE_SIZE);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+               g_xrsr.ws_json_config_lpm.val_send_queue_size = value;
+               g_xrsr.ws_json_config_lpm.ptr_send_queue_size = &g_xrsr.ws_json_config_lpm.val_send_queue_size;
+               XLOGD_INFO("ws lpm json: send queue size <%d> bytes", g_xrsr.ws_json_config_lpm.val_send_queue_size);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_SEND_QUEUE_LATENCY);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 60000) {
+               g_xrsr.ws_json_config_lpm.val_send_queue_latency = value;
+               g_xrsr.ws_json_config_lpm.ptr_send_queue_latency = &g_xrsr.ws_json_config_lpm.val_send_queue_latency;
+               XLOGD_INFO("ws lpm json: send queue latency <%d> ms", g_xrsr.ws_json_config_lpm.val_send_queue_latency);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_HEDGE_DELAY);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 10000) {
+               g_xrsr.ws_json_config_lpm.val_hedge_delay = value;
+               g_xrsr.ws_json_config_lpm.ptr_hedge_delay = &g_xrsr.ws_json_config_lpm.val_hedge_delay;
+               XLOGD_INFO("ws lpm json: hedge delay <%d> ms", g_xrsr.ws_json_config_lpm.val_hedge_delay);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_STR_NAME_WS_LPM_SOCKET_PROFILE);
+         if(json_obj != NULL && json_is_string(json_obj)) {
+            xrsr_socket_profile_t value = xrsr_socket_profile_from_str(json_string_value(json_obj));
+            if(value < XRSR_SOCKET_PROFILE_INVALID) {
+               g_xrsr.ws_json_config_lpm.val_socket_profile = value;
+               g_xrsr.ws_json_config_lpm.ptr_socket_profile = &g_xrsr.ws_json_config_lpm.val_socket_profile;
+               XLOGD_INFO("ws lpm json: socket profile <%s>", xrsr_socket_profile_str(g_xrsr.ws_json_config_lpm.val_socket_profile));
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_BOOL_NAME_WS_LPM_DEFLATE);
+         if(json_obj != NULL && json_is_boolean(json_obj)) {
+            g_xrsr.ws_json_config_lpm.val_deflate = json_is_true(json_obj) ? true : false;
+            g_xrsr.ws_json_config_lpm.ptr_deflate = &g_xrsr.ws_json_config_lpm.val_deflate;
+            XLOGD_INFO("ws lpm json: deflate <%s>", g_xrsr.ws_json_config_lpm.val_deflate ? "YES" : "NO");
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_BOOL_NAME_WS_LPM_DEFLATE_CONTEXT_TAKEOVER);
+         if(json_obj != NULL && json_is_boolean(json_obj)) {
+            g_xrsr.ws_json_config_lpm.val_deflate_no_context_takeover = json_is_true(json_obj) ? false : true;
+            g_xrsr.ws_json_config_lpm.ptr_deflate_no_context_takeover = &g_xrsr.ws_json_config_lpm.val_deflate_no_context_takeover;
+            XLOGD_INFO("ws lpm json: deflate context takeover <%s>", g_xrsr.ws_json_config_lpm.val_deflate_no_context_takeover ? "NO" : "YES");
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_CIRCUIT_THRESHOLD);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 100) {
+               g_xrsr.ws_json_config_lpm.val_circuit_threshold = value;
+               g_xrsr.ws_json_config_lpm.ptr_circuit_threshold = &g_xrsr.ws_json_config_lpm.val_circuit_threshold;
+               XLOGD_INFO("ws lpm json: circuit threshold <%d>", g_xrsr.ws_json_config_lpm.val_circuit_threshold);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_CIRCUIT_OPEN_PERIOD);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 1000 && value <= 300000) {
+               g_xrsr.ws_json_config_lpm.val_circuit_open_period = value;
+               g_xrsr.ws_json_config_lpm.ptr_circuit_open_period = &g_xrsr.ws_json_config_lpm.val_circuit_open_period;
+               XLOGD_INFO("ws lpm json: circuit open period <%d> ms", g_xrsr.ws_json_config_lpm.val_circuit_open_period);
+            }
+         }
+         json_obj = json_object_get(json_obj_lpm, JSON_INT_NAME_WS_LPM_PING_INTERVAL);
+         if(json_obj != NULL && json_is_integer(json_obj)) {
+            json_int_t value = json_integer_value(json_obj);
+            if(value >= 0 && value <= 60000) {
+               g_xrsr.ws_json_config_lpm.val_ping_interval = value;
+               g_xrsr.ws_json_config_lpm.ptr_ping_interval = &g_xrsr.ws_json_config_lpm.val_ping_interval;
+               XLOGD_INFO("ws lpm json: ping interval <%d> ms", g_xrsr.ws_json_config_lpm.val_ping_interval);
+            }
+         }
       }
    }
    #endif
 
+   #ifdef OPUS_ENABLED
+   g_xrsr.encoder_config.bitrate        = JSON_INT_VALUE_OPUS_BITRATE;
+   g_xrsr.encoder_config.frame_duration = JSON_INT_VALUE_OPUS_FRAME_DURATION;
+   g_xrsr.encoder_config.complexity     = JSON_INT_VALUE_OPUS_COMPLEXITY;
+
+   json_t *json_obj_opus = json_object_get(json_obj_vsdk, JSON_OBJ_NAME_OPUS);
+   if(NULL == json_obj_opus || !json_is_object(json_obj_opus)) {
+      XLOGD_INFO("opus json object not found, using defaults");
+   } else {
+      json_t *json_obj_int = json_object_get(json_obj_opus, JSON_INT_NAME_OPUS_BITRATE);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value >= 6000 && value <= 510000) {
+            g_xrsr.encoder_config.bitrate = value;
+         }
+      }
+      json_obj_int = json_object_get(json_obj_opus, JSON_INT_NAME_OPUS_FRAME_DURATION);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value == 10 || value == 20 || value == 40 || value == 60) {
+            g_xrsr.encoder_config.frame_duration = value;
+         }
+      }
+      json_obj_int = json_object_get(json_obj_opus, JSON_INT_NAME_OPUS_COMPLEXITY);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value >= 0 && value <= 10) {
+            g_xrsr.encoder_config.complexity = value;
+         }
+      }
+   }
+   XLOGD_INFO("opus json: bitrate <%u> frame duration <%u> ms complexity <%u>", g_xrsr.encoder_config.bitrate, g_xrsr.encoder_config.frame_duration, g_xrsr.encoder_config.complexity);
+   #endif
+
+   g_xrsr.trim_config.threshold = JSON_INT_VALUE_TRIM_THRESHOLD;
+   g_xrsr.trim_config.lead      = JSON_INT_VALUE_TRIM_LEAD;
+   g_xrsr.trim_config.tail      = JSON_INT_VALUE_TRIM_TAIL;
+
+   json_t *json_obj_trim = json_object_get(json_obj_vsdk, JSON_OBJ_NAME_TRIM);
+   if(NULL == json_obj_trim || !json_is_object(json_obj_trim)) {
+      XLOGD_INFO("trim json object not found, using defaults");
+   } else {
+      json_t *json_obj_int = json_object_get(json_obj_trim, JSON_INT_NAME_TRIM_THRESHOLD);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value >= 3 && value <= 40) {
+            g_xrsr.trim_config.threshold = value;
+         }
+      }
+      json_obj_int = json_object_get(json_obj_trim, JSON_INT_NAME_TRIM_LEAD);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value >= 0 && value <= 2000) {
+            g_xrsr.trim_config.lead = value;
+         }
+      }
+      json_obj_int = json_object_get(json_obj_trim, JSON_INT_NAME_TRIM_TAIL);
+      if(json_obj_int != NULL && json_is_integer(json_obj_int)) {
+         json_int_t value = json_integer_value(json_obj_int);
+         if(value >= 0 && value <= 5000) {
+            g_xrsr.trim_config.tail = value;
+         }
+      }
+   }
+   XLOGD_INFO("trim json: threshold <%.0f> dB lead <%u> ms tail <%u> ms", g_xrsr.trim_config.threshold, g_xrsr.trim_config.lead, g_xrsr.trim_config.tail);
+
    xraudio_power_mode_t xraudio_power_mode;
 
    switch(power_mode) {
@@ -547,6 +862,7 @@ void xrsr_close(void) {
    g_xrsr.xrsr_xraudio_object = NULL;
 
    xrsr_route_free_all();
+   xrsr_trace_term();
 
    if(g_xrsr.capture_dir_path != NULL) {
       free(g_xrsr.capture_dir_path);
@@ -683,13 +999,26 @@ void xrsr_route_free(xrsr_src_t src, bool closing) {
                break;
             }
             #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_unix_term(&dst->conn_state.unx);
+               dst->initialized = false;
+               break;
+            }
+            #endif
             default: {
                break;
             }
          }
       }
       dst->handler  = NULL;
-      xrsr_url_free(&dst->url_parts);
+      xrsr_circuit_term(&dst->circuit);
+      xrsr_endpoint_pool_free(&dst->endpoints); // url parts are owned by the endpoint pool
+      memset(&dst->url_parts, 0, sizeof(dst->url_parts));
+      dst->url_parts.prot   = XRSR_PROTOCOL_INVALID;
+      dst->url_parts.family = XRSR_ADDRESS_FAMILY_INVALID;
+      xrsr_url_free(&dst->url_parts_hedge);
+      xrsr_url_free(&dst->url_parts_fallback);
    }
 }
 
@@ -745,16 +1074,49 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
          stream_until = XRAUDIO_INPUT_RECORD_UNTIL_END_OF_KEYWORD;
       }
 
-      // Parse url
-      xrsr_url_parts_t url_parts;
-      if(!xrsr_url_parse(url, &url_parts)) {
-         XLOGD_ERROR("invalid url <%s>", url);
+      xrsr_dst_int_t *dst_int = &g_xrsr.routes[src].dsts[index];
+
+      // Parse the url and any additional candidate urls
+      if(!xrsr_endpoint_pool_init(&dst_int->endpoints, url, dst->urls)) {
          return;
       }
+      xrsr_url_parts_t url_parts = dst_int->endpoints.endpoints[0].url_parts;
+
+      XLOGD_DEBUG("src <%s> dst qty <%u> index <%u> url <%s> endpoints <%u> session begin <%p>", xrsr_src_str(route->src), route->dst_qty, dst_index, dst->url, dst_int->endpoints.qty, dst->handlers.session_begin);
+
+      // Parse the alternate url which is raced against the url when connecting is slow
+      memset(&dst_int->url_parts_hedge, 0, sizeof(dst_int->url_parts_hedge));
+      if(dst->url_hedge != NULL) {
+         if(url_parts.prot != XRSR_PROTOCOL_WS && url_parts.prot != XRSR_PROTOCOL_WSS) {
+            XLOGD_WARN("hedged connections not supported for protocol <%s>", xrsr_protocol_str(url_parts.prot));
+         } else if(!xrsr_url_parse(dst->url_hedge, &dst_int->url_parts_hedge)) {
+            XLOGD_ERROR("invalid hedge url <%s>", dst->url_hedge);
+            xrsr_url_free(&dst_int->url_parts_hedge);
+         } else if(dst_int->url_parts_hedge.prot != XRSR_PROTOCOL_WS && dst_int->url_parts_hedge.prot != XRSR_PROTOCOL_WSS) {
+            XLOGD_ERROR("invalid hedge protocol <%s>", xrsr_protocol_str(dst_int->url_parts_hedge.prot));
+            xrsr_url_free(&dst_int->url_parts_hedge);
+         }
+      }
 
-      XLOGD_DEBUG("src <%s> dst qty <%u> index <%u> url <%s> session begin <%p>", xrsr_src_str(route->src), route->dst_qty, dst_index, dst->url, dst->handlers.session_begin);
+      // Parse the url which handles sessions while the circuit breaker is open
+      memset(&dst_int->url_parts_fallback, 0, sizeof(dst_int->url_parts_fallback));
+      if(dst->url_fallback != NULL) {
+         if(url_parts.prot != XRSR_PROTOCOL_WS && url_parts.prot != XRSR_PROTOCOL_WSS) {
+            XLOGD_WARN("circuit breaker not supported for protocol <%s>", xrsr_protocol_str(url_parts.prot));
+         } else if(!xrsr_url_parse(dst->url_fallback, &dst_int->url_parts_fallback)) {
+            XLOGD_ERROR("invalid fallback url <%s>", dst->url_fallback);
+            xrsr_url_free(&dst_int->url_parts_fallback);
+         } else if(!xrsr_endpoint_prot_match(dst_int->url_parts_fallback.prot, url_parts.prot)) {
+            XLOGD_ERROR("invalid fallback protocol <%s>", xrsr_protocol_str(dst_int->url_parts_fallback.prot));
+            xrsr_url_free(&dst_int->url_parts_fallback);
+         }
+      }
 
-      xrsr_dst_int_t *dst_int = &g_xrsr.routes[src].dsts[index];
+      xrsr_circuit_init(&dst_int->circuit, src, index, state->timer_obj, &dst_int->endpoints.endpoints[0].url_parts);
+      dst_int->fast_fail = false;
+      dst_int->fallback  = false;
+      xrsr_grouping_init(&dst_int->grouping);
+      xrsr_format_link_init(&dst_int->format_link);
 
       switch(url_parts.prot) {
          #ifdef HTTP_ENABLED
@@ -766,6 +1128,11 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
                XLOGD_ERROR("http init");
                return;
             }
+            for(int i = 0; i < XRSR_POWER_MODE_INVALID; i++) {
+               dst_int->dst_param_ptrs[i].socket_profile = (dst->params[i] != NULL && dst->params[i]->socket_profile) ? &dst->params[i]->socket_profile : NULL;
+               dst_int->dst_param_ptrs[i].http2_disabled = (dst->params[i] != NULL) ? &dst->params[i]->http2_disabled : NULL;
+            }
+            xrsr_http_update_dst_params(&dst_int->conn_state.http, &dst_int->dst_param_ptrs[g_xrsr.power_mode]);
             dst_int->initialized = true;
             break;
          }
@@ -785,6 +1152,19 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
                   dst_int->dst_param_ptrs[i].timeout_session        = &dst->params[i]->timeout_session;
                   dst_int->dst_param_ptrs[i].ipv4_fallback          = &dst->params[i]->ipv4_fallback;
                   dst_int->dst_param_ptrs[i].backoff_delay          = &dst->params[i]->backoff_delay;
+                  dst_int->dst_param_ptrs[i].deflate                = &dst->params[i]->deflate;
+                  dst_int->dst_param_ptrs[i].deflate_no_context_takeover = &dst->params[i]->deflate_no_context_takeover;
+
+                  // Params added after the structure was published use the json config when they are zero
+                  xrsr_dst_params_t *dst_params = dst->params[i];
+                  dst_int->dst_param_ptrs[i].reconnect_buffer_size  = dst_params->reconnect_buffer_size ? &dst_params->reconnect_buffer_size : g_xrsr.ws_json_config->ptr_reconnect_buffer_size;
+                  dst_int->dst_param_ptrs[i].send_queue_size        = dst_params->send_queue_size       ? &dst_params->send_queue_size       : g_xrsr.ws_json_config->ptr_send_queue_size;
+                  dst_int->dst_param_ptrs[i].send_queue_latency     = dst_params->send_queue_latency    ? &dst_params->send_queue_latency    : g_xrsr.ws_json_config->ptr_send_queue_latency;
+                  dst_int->dst_param_ptrs[i].hedge_delay            = dst_params->hedge_delay           ? &dst_params->hedge_delay           : g_xrsr.ws_json_config->ptr_hedge_delay;
+                  dst_int->dst_param_ptrs[i].socket_profile         = dst_params->socket_profile        ? &dst_params->socket_profile        : g_xrsr.ws_json_config->ptr_socket_profile;
+                  dst_int->dst_param_ptrs[i].circuit_threshold      = dst_params->circuit_threshold     ? &dst_params->circuit_threshold     : g_xrsr.ws_json_config->ptr_circuit_threshold;
+                  dst_int->dst_param_ptrs[i].circuit_open_period    = dst_params->circuit_open_period   ? &dst_params->circuit_open_period   : g_xrsr.ws_json_config->ptr_circuit_open_period;
+                  dst_int->dst_param_ptrs[i].ping_interval          = dst_params->ping_interval         ? &dst_params->ping_interval         : g_xrsr.ws_json_config->ptr_ping_interval;
                } else {
                   dst_int->dst_param_ptrs[i].debug                  = g_xrsr.ws_json_config->ptr_debug;
                   dst_int->dst_param_ptrs[i].connect_check_interval = g_xrsr.ws_json_config->ptr_connect_check_interval;
@@ -793,6 +1173,16 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
                   dst_int->dst_param_ptrs[i].timeout_session        = g_xrsr.ws_json_config->ptr_timeout_session;
                   dst_int->dst_param_ptrs[i].ipv4_fallback          = g_xrsr.ws_json_config->ptr_ipv4_fallback;
                   dst_int->dst_param_ptrs[i].backoff_delay          = g_xrsr.ws_json_config->ptr_backoff_delay;
+                  dst_int->dst_param_ptrs[i].reconnect_buffer_size  = g_xrsr.ws_json_config->ptr_reconnect_buffer_size;
+                  dst_int->dst_param_ptrs[i].send_queue_size        = g_xrsr.ws_json_config->ptr_send_queue_size;
+                  dst_int->dst_param_ptrs[i].send_queue_latency     = g_xrsr.ws_json_config->ptr_send_queue_latency;
+                  dst_int->dst_param_ptrs[i].hedge_delay            = g_xrsr.ws_json_config->ptr_hedge_delay;
+                  dst_int->dst_param_ptrs[i].socket_profile         = g_xrsr.ws_json_config->ptr_socket_profile;
+                  dst_int->dst_param_ptrs[i].deflate                = g_xrsr.ws_json_config->ptr_deflate;
+                  dst_int->dst_param_ptrs[i].deflate_no_context_takeover = g_xrsr.ws_json_config->ptr_deflate_no_context_takeover;
+                  dst_int->dst_param_ptrs[i].circuit_threshold      = g_xrsr.ws_json_config->ptr_circuit_threshold;
+                  dst_int->dst_param_ptrs[i].circuit_open_period    = g_xrsr.ws_json_config->ptr_circuit_open_period;
+                  dst_int->dst_param_ptrs[i].ping_interval          = g_xrsr.ws_json_config->ptr_ping_interval;
                }
             }
 
@@ -801,12 +1191,15 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
             params.host_name          = host_name;
             params.timer_obj          = state->timer_obj;
             params.dst_params         = &dst_int->dst_param_ptrs[g_xrsr.power_mode];
+            params.url_parts_hedge    = (dst_int->url_parts_hedge.urle != NULL) ? &dst_int->url_parts_hedge : NULL;
 
             if(!xrsr_ws_init(&dst_int->conn_state.ws, &params)) {
                XLOGD_ERROR("ws init");
                return;
             }
             dst_int->initialized = true;
+
+            xrsr_circuit_params_update(dst_int, g_xrsr.power_mode);
             break;
          }
          #endif
@@ -825,9 +1218,31 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
             break;
          }
          #endif
+         #ifdef UNIX_ENABLED
+         case XRSR_PROTOCOL_UNIX: {
+            dst_int->handler = xrsr_protocol_handler_unix;
+
+            for(int i = 0; i < XRSR_POWER_MODE_INVALID; i++) {
+               dst_int->dst_param_ptrs[i].timeout_inactivity = (dst->params[i] != NULL) ? &dst->params[i]->timeout_inactivity : NULL;
+               dst_int->dst_param_ptrs[i].fd_passing         = (dst->params[i] != NULL) ? &dst->params[i]->fd_passing : NULL;
+            }
+
+            xrsr_unix_params_t params;
+            params.prot       = url_parts.prot;
+            params.timer_obj  = state->timer_obj;
+            params.dst_params = &dst_int->dst_param_ptrs[g_xrsr.power_mode];
+
+            if(!xrsr_unix_init(&dst_int->conn_state.unx, &params)) {
+               XLOGD_ERROR("xrsr unix init failed");
+               return;
+            }
+            dst_int->initialized = true;
+            break;
+         }
+         #endif
          default: {
             XLOGD_ERROR("invalid protocol <%s>", xrsr_protocol_str(url_parts.prot));
-            xrsr_url_free(&url_parts);
+            xrsr_endpoint_pool_free(&dst_int->endpoints);
             return;
          }
       }
@@ -836,6 +1251,20 @@ void xrsr_route_update(const char *host_name, const xrsr_route_t *route, xrsr_th
       dst_int->url_parts        = url_parts;
       dst_int->handlers         = dst->handlers;
       dst_int->formats          = dst->formats;
+      dst_int->sample_rate      = dst->sample_rate;
+      dst_int->trim_silence     = dst->trim_silence;
+      dst_int->stage_qty        = 0;
+      for(uint32_t stage_index = 0; stage_index < dst->stage_qty && dst->stages != NULL; stage_index++) {
+         if(dst_int->stage_qty >= XRSR_PIPELINE_STAGE_QTY_APP) {
+            XLOGD_ERROR("stage qty <%u> exceeds maximum <%u>", dst->stage_qty, XRSR_PIPELINE_STAGE_QTY_APP);
+            break;
+         }
+         if(dst->stages[stage_index].process == NULL) {
+            XLOGD_ERROR("stage <%u> process handler is NULL", stage_index);
+            continue;
+         }
+         dst_int->stages[dst_int->stage_qty++] = dst->stages[stage_index];
+      }
       dst_int->stream_time_min  = stream_time_min;
       dst_int->stream_from      = stream_from;
       dst_int->stream_offset    = dst->stream_offset;
@@ -1091,6 +1520,116 @@ bool xrsr_mask_pii(void) {
    return(g_xrsr.mask_pii);
 }
 
+void xrsr_thread_fds_set(int *nfds, fd_set *rfds, fd_set *wfds) {
+   for(uint32_t index_src = 0; index_src < XRSR_SRC_INVALID; index_src++) {
+      for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
+         xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
+
+         if(dst->handler == NULL) {
+            continue;
+         }
+         switch(dst->url_parts.prot) {
+            #ifdef HTTP_ENABLED
+            case XRSR_PROTOCOL_HTTP:
+            case XRSR_PROTOCOL_HTTPS: {
+               xrsr_state_http_t *http = &dst->conn_state.http;
+
+               if(xrsr_http_is_connected(http)) {
+                  xrsr_http_fd_set(http, 1, nfds, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef WS_ENABLED
+            case XRSR_PROTOCOL_WS:
+            case XRSR_PROTOCOL_WSS: {
+               xrsr_state_ws_t *ws = &dst->conn_state.ws;
+               if(xrsr_ws_is_established(ws)) {
+                  xrsr_ws_fd_set(ws, nfds, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef SDT_ENABLED
+            case XRSR_PROTOCOL_SDT: {
+               xrsr_state_sdt_t *sdt = &dst->conn_state.sdt;
+               if(xrsr_sdt_is_established(sdt)) {
+                  xrsr_sdt_fd_set(sdt, nfds, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_state_unix_t *unx = &dst->conn_state.unx;
+               if(xrsr_unix_is_connected(unx)) {
+                  xrsr_unix_fd_set(unx, nfds, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+
+            default: {
+               break;
+            }
+         }
+      }
+   }
+}
+
+void xrsr_thread_fds_handle(fd_set *rfds, fd_set *wfds) {
+   for(uint32_t index_src = 0; index_src < XRSR_SRC_INVALID; index_src++) {
+      for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
+         xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
+
+         switch(dst->url_parts.prot) {
+            #ifdef HTTP_ENABLED
+            case XRSR_PROTOCOL_HTTP:
+            case XRSR_PROTOCOL_HTTPS: {
+               xrsr_state_http_t *http = &dst->conn_state.http;
+               if(xrsr_http_is_connected(http)) {
+                  xrsr_http_handle_fds(http, 1, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef WS_ENABLED
+            case XRSR_PROTOCOL_WS:
+            case XRSR_PROTOCOL_WSS: {
+               xrsr_state_ws_t *ws = &dst->conn_state.ws;
+               if(!xrsr_ws_is_disconnected(ws)) {
+                  xrsr_ws_handle_fds(ws, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef SDT_ENABLED
+            case XRSR_PROTOCOL_SDT: {
+               xrsr_state_sdt_t *sdt = &dst->conn_state.sdt;
+               if(!xrsr_sdt_is_disconnected(sdt)) {
+                  xrsr_sdt_handle_fds(sdt, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_state_unix_t *unx = &dst->conn_state.unx;
+               if(!xrsr_unix_is_disconnected(unx)) {
+                  xrsr_unix_handle_fds(unx, rfds, wfds, NULL);
+               }
+               break;
+            }
+            #endif
+
+            default: {
+               break;
+            }
+         }
+      }
+   }
+}
+
 void *xrsr_thread_main(void *param) {
    xrsr_thread_params_t params = *((xrsr_thread_params_t *)param);
    char msg[XRSR_MSG_QUEUE_MSG_SIZE_MAX];
@@ -1122,51 +1661,7 @@ void *xrsr_thread_main(void *param) {
       FD_ZERO(&wfds);
 
       // Add fd's for all open connections
-      for(uint32_t index_src = 0; index_src < XRSR_SRC_INVALID; index_src++) {
-         for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
-            xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
-
-            if(dst->handler == NULL) {
-               continue;
-            }
-            switch(dst->url_parts.prot) {
-               #ifdef HTTP_ENABLED
-               case XRSR_PROTOCOL_HTTP:
-               case XRSR_PROTOCOL_HTTPS: {
-                  xrsr_state_http_t *http = &dst->conn_state.http;
-
-                  if(xrsr_http_is_connected(http)) {
-                     xrsr_http_fd_set(http, 1, &nfds, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-               #ifdef WS_ENABLED
-               case XRSR_PROTOCOL_WS:
-               case XRSR_PROTOCOL_WSS: {
-                  xrsr_state_ws_t *ws = &dst->conn_state.ws;
-                  if(xrsr_ws_is_established(ws)) {
-                     xrsr_ws_fd_set(ws, &nfds, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-               #ifdef SDT_ENABLED
-               case XRSR_PROTOCOL_SDT: {
-                  xrsr_state_sdt_t *sdt = &dst->conn_state.sdt;
-                  if(xrsr_sdt_is_established(sdt)) {
-                     xrsr_sdt_fd_set(sdt, &nfds, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-
-               default: {
-                  break;
-               }
-            }
-         }
-      }
+      xrsr_thread_fds_set(&nfds, &rfds, &wfds);
 
       struct timeval tv;
       rdkx_timer_handler_t handler = NULL;
@@ -1220,47 +1715,7 @@ void *xrsr_thread_main(void *param) {
       }
 
       // Check fd's for all open connections
-      for(uint32_t index_src = 0; index_src < XRSR_SRC_INVALID; index_src++) {
-         for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
-            xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
-
-            switch(dst->url_parts.prot) {
-               #ifdef HTTP_ENABLED
-               case XRSR_PROTOCOL_HTTP:
-               case XRSR_PROTOCOL_HTTPS: {
-                  xrsr_state_http_t *http = &dst->conn_state.http;
-                  if(xrsr_http_is_connected(http)) {
-                     xrsr_http_handle_fds(http, 1, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-               #ifdef WS_ENABLED
-               case XRSR_PROTOCOL_WS:
-               case XRSR_PROTOCOL_WSS: {
-                  xrsr_state_ws_t *ws = &dst->conn_state.ws;
-                  if(!xrsr_ws_is_disconnected(ws)) {
-                     xrsr_ws_handle_fds(ws, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-               #ifdef SDT_ENABLED
-               case XRSR_PROTOCOL_SDT: {
-                  xrsr_state_sdt_t *sdt = &dst->conn_state.sdt;
-                  if(!xrsr_sdt_is_disconnected(sdt)) {
-                     xrsr_sdt_handle_fds(sdt, &rfds, &wfds, NULL);
-                  }
-                  break;
-               }
-               #endif
-
-               default: {
-                  break;
-               }
-            }
-         }
-      }
+      xrsr_thread_fds_handle(&rfds, &wfds);
    } while(state.running);
 
    // Terminate all open connections
@@ -1268,6 +1723,9 @@ void *xrsr_thread_main(void *param) {
       for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
          xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
 
+         // Probes post their result to this thread's message queue, which is closed once the thread exits
+         xrsr_circuit_term(&dst->circuit);
+
          switch(dst->url_parts.prot) {
             #ifdef HTTP_ENABLED
             case XRSR_PROTOCOL_HTTP:
@@ -1291,6 +1749,13 @@ void *xrsr_thread_main(void *param) {
                break;
             }
             #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_state_unix_t *unx = &dst->conn_state.unx;
+               xrsr_unix_term(unx);
+               break;
+            }
+            #endif
 
             default: {
                break;
@@ -1517,6 +1982,20 @@ void xrsr_msg_power_mode_update(const xrsr_thread_params_t *params, xrsr_thread_
             case XRSR_PROTOCOL_WSS: {
                xrsr_state_ws_t *ws = &dst->conn_state.ws;
                xrsr_ws_update_dst_params(ws, &dst->dst_param_ptrs[power_mode_update->power_mode]);
+               xrsr_circuit_params_update(dst, power_mode_update->power_mode);
+               break;
+            }
+            #endif
+            #ifdef HTTP_ENABLED
+            case XRSR_PROTOCOL_HTTP:
+            case XRSR_PROTOCOL_HTTPS: {
+               xrsr_http_update_dst_params(&dst->conn_state.http, &dst->dst_param_ptrs[power_mode_update->power_mode]);
+               break;
+            }
+            #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_unix_update_dst_params(&dst->conn_state.unx, &dst->dst_param_ptrs[power_mode_update->power_mode]);
                break;
             }
             #endif
@@ -1600,16 +2079,27 @@ void xrsr_msg_xraudio_event(const xrsr_thread_params_t *params, xrsr_thread_stat
          #endif
          return;
       }
-      uint32_t index_src = src;
+      uint32_t        index_src = src;
+      xrsr_session_t *session   = &g_xrsr.sessions[xrsr_source_to_group(src)];
+      if(event->event.event == XRSR_EVENT_EOS && !session->eos_rxd) {
+         rdkx_timestamp_get(&session->eos_timestamp);
+         session->eos_rxd = true;
+      }
       for(uint32_t index_dst = 0; index_dst < XRSR_DST_QTY_MAX; index_dst++) {
          xrsr_dst_int_t *dst = &g_xrsr.routes[index_src].dsts[index_dst];
 
+         // The keyword position is reported in bytes from xraudio, so it is moved to the destination's audio
+         xrsr_speech_event_t speech_event = event->event;
+         if(speech_event.event == XRSR_EVENT_STREAM_KWD_INFO && session->pipelines[index_dst] != NULL) {
+            speech_event.data.byte_qty = xrsr_pipeline_position(session->pipelines[index_dst], speech_event.data.byte_qty);
+         }
+
          switch(dst->url_parts.prot) {
             #ifdef HTTP_ENABLED
             case XRSR_PROTOCOL_HTTP:
             case XRSR_PROTOCOL_HTTPS: {
                xrsr_state_http_t *http = &dst->conn_state.http;
-               xrsr_http_handle_speech_event(http, &event->event);
+               xrsr_http_handle_speech_event(http, &speech_event);
                break;
             }
             #endif
@@ -1617,14 +2107,21 @@ void xrsr_msg_xraudio_event(const xrsr_thread_params_t *params, xrsr_thread_stat
             case XRSR_PROTOCOL_WS:
             case XRSR_PROTOCOL_WSS: {
                xrsr_state_ws_t *ws = &dst->conn_state.ws;
-               xrsr_ws_handle_speech_event(ws, &event->event);
+               xrsr_ws_handle_speech_event(ws, &speech_event);
                break;
             }
             #endif
             #ifdef SDT_ENABLED
             case XRSR_PROTOCOL_SDT: {
                xrsr_state_sdt_t *sdt = &dst->conn_state.sdt;
-               xrsr_sdt_handle_speech_event(sdt, &event->event);
+               xrsr_sdt_handle_speech_event(sdt, &speech_event);
+               break;
+            }
+            #endif
+            #ifdef UNIX_ENABLED
+            case XRSR_PROTOCOL_UNIX: {
+               xrsr_state_unix_t *unx = &dst->conn_state.unx;
+               xrsr_unix_handle_speech_event(unx, &speech_event);
                break;
             }
             #endif
@@ -1721,6 +2218,8 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
       return;
    }
    session->src                  = begin->src;
+   session->chan_selected        = -1;
+   session->gain_db              = 0.0;
 
    xrsr_keyword_detector_result_t *detector_result_ptr = NULL;
    xrsr_keyword_detector_result_t  detector_result;
@@ -1740,6 +2239,8 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
          detector_result.dynamic_gain     = begin->detector_result.channels[begin->detector_result.chan_selected].dynamic_gain;
 
          detector_result_ptr   = &detector_result;
+         session->chan_selected = begin->detector_result.chan_selected;
+         session->gain_db       = detector_result.kwd_gain + detector_result.dynamic_gain;
 
          XLOGD_INFO("selected kwd channel <%u> gain <%f> buf begin <%d> kwd begin <%d> end <%d>", begin->detector_result.chan_selected, detector_result.kwd_gain, detector_result.offset_buf_begin, detector_result.offset_kwd_begin, detector_result.offset_kwd_end);
          for(uint32_t chan = 0; chan < XRAUDIO_INPUT_MAX_CHANNEL_QTY; chan++) {
@@ -1762,6 +2263,22 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
       if(dst->handler == NULL) {
          continue;
       }
+      if(!begin->retry) { // Each new session uses the best performing endpoint
+         dst->url_parts = *xrsr_endpoint_select(&dst->endpoints);
+         dst->fast_fail = false;
+         dst->fallback  = false;
+
+         if(!xrsr_circuit_allow(&dst->circuit)) { // Destination is failing so don't make the user wait for it
+            if(dst->url_parts_fallback.urle != NULL) {
+               XLOGD_INFO("src <%s(%u)> circuit <%s> use fallback url", xrsr_src_str(session->src), dst_index, xrsr_circuit_state_str(dst->circuit.state));
+               dst->url_parts = dst->url_parts_fallback;
+               dst->fallback  = true;
+            } else {
+               XLOGD_INFO("src <%s(%u)> circuit <%s> fail fast", xrsr_src_str(session->src), dst_index, xrsr_circuit_state_str(dst->circuit.state));
+               dst->fast_fail = true;
+            }
+         }
+      }
       xrsr_protocol_t prot = dst->url_parts.prot;
 
       switch(prot) {
@@ -1782,7 +2299,9 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
             char uuid_str[37] = {'\0'};
             uuid_unparse_lower(http->uuid, uuid_str);
 
-            session_config->format            = xrsr_audio_format_get(dst->formats, begin->xraudio_format);
+            session_config->format            = xrsr_dst_format_select(dst, begin->xraudio_format);
+
+            session_config->format_reason     = dst->format_reason;
             session_config->user_initiated    = begin->user_initiated;
             session_config->cb_session_config = xrsr_callback_session_config_in_http;
 
@@ -1838,7 +2357,9 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
                char uuid_str[37] = {'\0'};
                uuid_unparse_lower(ws->uuid, uuid_str);
 
-               session_config->format            = xrsr_audio_format_get(dst->formats, begin->xraudio_format);
+               session_config->format            = xrsr_dst_format_select(dst, begin->xraudio_format);
+
+               session_config->format_reason     = dst->format_reason;
                session_config->user_initiated    = begin->user_initiated;
                session_config->cb_session_config = xrsr_callback_session_config_in_ws;
 
@@ -1888,7 +2409,9 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
                char uuid_str[37] = {'\0'};
                uuid_unparse_lower(sdt->uuid, uuid_str);
 
-               session_config->format            = xrsr_audio_format_get(dst->formats, begin->xraudio_format);
+               session_config->format            = xrsr_dst_format_select(dst, begin->xraudio_format);
+
+               session_config->format_reason     = dst->format_reason;
                session_config->cb_session_config = NULL;
 
                XLOGD_INFO("src <%s(%u)> prot <%s> uuid <%s> format <%s>", xrsr_src_str(session->src), dst_index, xrsr_protocol_str(prot), uuid_str, xrsr_audio_format_str(session_config->format));
@@ -1927,6 +2450,53 @@ void xrsr_msg_session_begin(const xrsr_thread_params_t *params, xrsr_thread_stat
            break;
          }
          #endif
+         #ifdef UNIX_ENABLED
+         case XRSR_PROTOCOL_UNIX: {
+            xrsr_state_unix_t *unx = &dst->conn_state.unx;
+            if(!xrsr_unix_is_disconnected(unx)) {
+               XLOGD_ERROR("invalid state");
+               break;
+            }
+            xrsr_session_config_out_t *session_config = &unx->session_config_out;
+            uuid_generate(unx->uuid);
+            unx->stream_time_min_rxd = false;
+
+            char uuid_str[37] = {'\0'};
+            uuid_unparse_lower(unx->uuid, uuid_str);
+
+            session_config->format            = xrsr_dst_format_select(dst, begin->xraudio_format);
+            session_config->format_reason     = dst->format_reason;
+            session_config->cb_session_config = NULL;
+
+            XLOGD_INFO("src <%s(%u)> prot <%s> uuid <%s> format <%s>", xrsr_src_str(session->src), dst_index, xrsr_protocol_str(prot), uuid_str, xrsr_audio_format_str(session_config->format));
+
+            // Set the handlers based on source
+            unx->handlers    = dst->handlers;
+            unx->dst_index   = dst_index;
+            unx->low_latency = begin->low_latency;
+
+            session_config->user_initiated = begin->user_initiated;
+
+            if(unx->handlers.session_begin != NULL) { // Call session begin handler
+               (*unx->handlers.session_begin)(unx->handlers.data, unx->uuid, session->src, dst_index, detector_result_ptr, &unx->session_config_out, &unx->session_config_in, &begin->timestamp, transcription_in);
+            }
+
+            int pipe_fd_read = -1;
+            if(!xrsr_speech_stream_begin(unx->uuid, session->src, unx->dst_index, begin->xraudio_format, begin->user_initiated, begin->low_latency, &pipe_fd_read)) {
+               XLOGD_ERROR("xrsr_speech_stream_begin failed");
+               xrsr_unix_speech_session_end(unx, XRSR_SESSION_END_REASON_ERROR_AUDIO_BEGIN);
+               break;
+            }
+            unx->audio_pipe_fd_read = pipe_fd_read;
+
+            bool deferred = (dst->stream_time_min == 0) ? false : !unx->stream_time_min_rxd;
+
+            if(!xrsr_unix_connect(unx, &dst->url_parts, session->src, begin->xraudio_format, xrsr_dst_sample_rate(dst, begin->xraudio_format.sample_rate), begin->user_initiated, deferred)) {
+               XLOGD_ERROR("unix connect");
+            }
+            break;
+         }
+         #endif
          default: {
             XLOGD_ERROR("invalid protocol <%s>", xrsr_protocol_str(prot));
             return;
@@ -2164,7 +2734,9 @@ void xrsr_msg_session_config_in(const xrsr_thread_params_t *params, xrsr_thread_
                   ws->audio_pipe_fd_read = pipe_fd_read;
                }
 
-               bool deferred = ((dst->stream_time_min == 0) || ws->is_session_by_text) ? false : !ws->stream_time_min_rxd;
+               bool deferred = ((dst->stream_time_min == 0) || ws->is_session_by_text || dst->fast_fail) ? false : !ws->stream_time_min_rxd;
+
+               ws->fast_fail = dst->fast_fail;
 
                if(!xrsr_ws_connect(ws, &dst->url_parts, session->src, ws->xraudio_format, ws->session_config_out.user_initiated, false, deferred, ws->session_config_in.ws.query_strs)) {
                   XLOGD_ERROR("ws connect");
@@ -2211,6 +2783,21 @@ void xrsr_session_end(const uuid_t uuid, const char *uuid_str, xrsr_src_t src, u
 
    xrsr_dst_int_t *dst = &g_xrsr.routes[src].dsts[dst_index];
 
+   if(stats != NULL) {
+      stats->fast_fail         = dst->fast_fail;
+      stats->fallback          = dst->fallback;
+      stats->format            = dst->format;
+      stats->format_reason     = dst->format_reason;
+      stats->uplink_throughput = dst->format_link.uplink_bps;
+   }
+
+   xrsr_endpoint_result(&dst->endpoints, stats);
+   xrsr_circuit_result(&dst->circuit, stats);
+
+   if(stats != NULL && stats->reason >= XRSR_SESSION_END_REASON_ERROR_INTERNAL && stats->reason < XRSR_SESSION_END_REASON_INVALID) {
+      xrsr_trace_dump(XRSR_TRACE_DUMP_QTY_ERROR);
+   }
+
    // Call session end handler
    if(dst->handlers.session_end != NULL) {
       (*dst->handlers.session_end)(dst->handlers.data, uuid, stats, &timestamp);
@@ -2257,6 +2844,15 @@ void xrsr_session_end(const uuid_t uuid, const char *uuid_str, xrsr_src_t src, u
             break;
          }
          #endif
+         #ifdef UNIX_ENABLED
+         case XRSR_PROTOCOL_UNIX: {
+            xrsr_state_unix_t *unx = &dst->conn_state.unx;
+            if(!xrsr_unix_is_disconnected(unx)) {
+               session_in_progress = true;
+            }
+            break;
+         }
+         #endif
          default: {
          }
       }
@@ -2324,6 +2920,15 @@ void xrsr_msg_session_terminate(const xrsr_thread_params_t *params, xrsr_thread_
             break;
          }
          #endif
+         #ifdef UNIX_ENABLED
+         case XRSR_PROTOCOL_UNIX: {
+            xrsr_state_unix_t *unx = &dst->conn_state.unx;
+            if(!xrsr_unix_is_disconnected(unx)) {
+               xrsr_unix_terminate(unx);
+            }
+            break;
+         }
+         #endif
          default: {
             break;
          }
@@ -2536,6 +3141,13 @@ xrsr_result_t xrsr_conn_send(void *param, const uint8_t *buffer, uint32_t length
          break;
       }
       #endif
+      #ifdef UNIX_ENABLED
+      case XRSR_PROTOCOL_UNIX: {
+         xrsr_state_unix_t *unx = (xrsr_state_unix_t *)param;
+         ret = xrsr_unix_send_text(unx, buffer, length);
+         break;
+      }
+      #endif
       default: {
          XLOGD_ERROR("protocol not supportted");
          break;
@@ -2551,6 +3163,7 @@ bool xrsr_speech_stream_begin(const uuid_t uuid, xrsr_src_t src, uint32_t dst_in
       return(true);
    }
    session->first_stream_req = false;
+   session->eos_rxd          = false;
 
    xraudio_dst_pipe_t dsts[XRSR_DST_QTY_MAX];
 
@@ -2613,14 +3226,17 @@ bool xrsr_speech_stream_begin(const uuid_t uuid, xrsr_src_t src, uint32_t dst_in
 
    xraudio_input_format_t xraudio_format = native_format;
 
-   switch(xrsr_audio_format_get(dst->formats, xraudio_format)) {
-      case XRSR_AUDIO_FORMAT_PCM:              { xraudio_format.encoding = XRAUDIO_ENCODING_PCM;     xraudio_format.sample_size = XRAUDIO_INPUT_DEFAULT_SAMPLE_SIZE; xraudio_format.channel_qty = XRAUDIO_INPUT_DEFAULT_CHANNEL_QTY; break; }
+   switch(dst->format) {
+      case XRSR_AUDIO_FORMAT_PCM:              { xrsr_speech_stream_format_pcm(session, native_format, &xraudio_format); break; }
       case XRSR_AUDIO_FORMAT_PCM_32_BIT:       { xraudio_format.encoding = XRAUDIO_ENCODING_PCM;     xraudio_format.sample_size = XRAUDIO_INPUT_MAX_SAMPLE_SIZE;     xraudio_format.channel_qty = XRAUDIO_INPUT_DEFAULT_CHANNEL_QTY; break; }
       case XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI: { xraudio_format.encoding = XRAUDIO_ENCODING_PCM;     xraudio_format.sample_size = XRAUDIO_INPUT_MAX_SAMPLE_SIZE;     xraudio_format.channel_qty = XRAUDIO_INPUT_MAX_CHANNEL_QTY;     break; }
       case XRSR_AUDIO_FORMAT_PCM_RAW:          { xraudio_format.encoding = XRAUDIO_ENCODING_PCM_RAW; xraudio_format.sample_size = XRAUDIO_INPUT_MAX_SAMPLE_SIZE;     xraudio_format.channel_qty = XRAUDIO_INPUT_MAX_CHANNEL_QTY;     break; }
       // This forwards all ADPCM / OPUS as it's native format. If we need to change this, then xrsr_audio_format_t will need to support the different versions.
       case XRSR_AUDIO_FORMAT_ADPCM:            { if(xraudio_format.encoding != XRAUDIO_ENCODING_ADPCM_XVP && xraudio_format.encoding != XRAUDIO_ENCODING_ADPCM_SKY) xraudio_format.encoding = XRAUDIO_ENCODING_ADPCM; break; }
       case XRSR_AUDIO_FORMAT_OPUS:             { if(xraudio_format.encoding != XRAUDIO_ENCODING_OPUS_XVP)  xraudio_format.encoding = XRAUDIO_ENCODING_OPUS;  break; }
+      #ifdef OPUS_ENABLED
+      case XRSR_AUDIO_FORMAT_OPUS_CBR:         { xrsr_speech_stream_format_pcm(session, native_format, &xraudio_format); break; } // PCM is encoded by the router
+      #endif
       default: {
          xraudio_format.encoding = XRAUDIO_ENCODING_INVALID;
          break;
@@ -2641,8 +3257,34 @@ bool xrsr_speech_stream_begin(const uuid_t uuid, xrsr_src_t src, uint32_t dst_in
       frame_duration = XRAUDIO_INPUT_FRAME_PERIOD * 1000;
    }
    
+   if(!xrsr_speech_stream_stages_open(session, src, &xraudio_format, user_initiated)) {
+      for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
+         if(dsts[index].pipe >= 0) {
+            close(dsts[index].pipe);
+         }
+         if(session->pipe_fds_rd[index] >= 0) {
+            close(session->pipe_fds_rd[index]);
+            session->pipe_fds_rd[index] = -1;
+         }
+      }
+      session->first_stream_req     = true;
+      session->xraudio_device_input = XRAUDIO_DEVICE_INPUT_NONE;
+      return(false);
+   }
+
+   // Each destination adapts its own grouping.  The destination which begins the stream sets the initial group size
+   // until the destinations report their network conditions.
+   for(uint32_t index = 0; index < XRSR_DST_QTY_MAX && dsts[index].pipe >= 0; index++) {
+      if(index != dst_index) {
+         xrsr_grouping_begin(&g_xrsr.routes[src].dsts[index].grouping, low_latency);
+      }
+   }
+   session->group_size = xrsr_grouping_begin(&dst->grouping, low_latency);
+
    // Make a single call to start streaming to all destinations
-   if(!xrsr_xraudio_stream_begin(g_xrsr.xrsr_xraudio_object, uuid_str, session->xraudio_device_input, user_initiated, &xraudio_format, dsts, dst->stream_time_min, user_initiated ? 0 : dst->keyword_begin, user_initiated ? 0 : dst->keyword_duration, frame_duration, low_latency)) {
+   if(!xrsr_xraudio_stream_begin(g_xrsr.xrsr_xraudio_object, uuid_str, session->xraudio_device_input, user_initiated, &xraudio_format, dsts, dst->stream_time_min, user_initiated ? 0 : dst->keyword_begin, user_initiated ? 0 : dst->keyword_duration, frame_duration, low_latency, session->group_size)) {
+      xrsr_speech_stream_grouping_end(src);
+      xrsr_speech_stream_stages_close(session);
       for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
          if(dsts[index].pipe >= 0) {
             close(dsts[index].pipe);
@@ -2662,6 +3304,173 @@ bool xrsr_speech_stream_begin(const uuid_t uuid, xrsr_src_t src, uint32_t dst_in
    return(true);
 }
 
+// Single channel 16-bit audio for the destination.  For a keyword initiated stream from multi-channel 32-bit input,
+// xraudio sends its processed channels and the router's convert stage extracts the keyword detector's selected channel
+// and applies its gain.  Otherwise xraudio produces the 16-bit audio.
+void xrsr_speech_stream_format_pcm(const xrsr_session_t *session, xraudio_input_format_t native_format, xraudio_input_format_t *xraudio_format) {
+   xraudio_format->encoding = XRAUDIO_ENCODING_PCM;
+   if(session->chan_selected >= 0 && native_format.sample_size == XRAUDIO_INPUT_MAX_SAMPLE_SIZE && native_format.channel_qty > 1) {
+      xraudio_format->sample_size = XRAUDIO_INPUT_MAX_SAMPLE_SIZE;
+      xraudio_format->channel_qty = XRAUDIO_INPUT_MAX_CHANNEL_QTY;
+   } else {
+      xraudio_format->sample_size = XRAUDIO_INPUT_DEFAULT_SAMPLE_SIZE;
+      xraudio_format->channel_qty = XRAUDIO_INPUT_DEFAULT_CHANNEL_QTY;
+   }
+}
+
+// Destinations which need their audio processed read the xraudio pipe through a pipeline.  The pipeline
+// converts 32-bit audio to single channel 16-bit audio, resamples it, trims silence, runs the application's stages and
+// encodes it.
+bool xrsr_speech_stream_stages_open(xrsr_session_t *session, xrsr_src_t src, const xraudio_input_format_t *xraudio_format, bool user_initiated) {
+   bool pcm    = (xraudio_format->encoding == XRAUDIO_ENCODING_PCM || xraudio_format->encoding == XRAUDIO_ENCODING_PCM_RAW);
+   bool wide   = (pcm && xraudio_format->sample_size == XRAUDIO_INPUT_MAX_SAMPLE_SIZE);
+   bool narrow = (pcm && xraudio_format->channel_qty == XRAUDIO_INPUT_DEFAULT_CHANNEL_QTY && xraudio_format->sample_size == XRAUDIO_INPUT_DEFAULT_SAMPLE_SIZE);
+
+   uint32_t frame_size_in = pcm ? xraudio_format->channel_qty * xraudio_format->sample_size : 1;
+
+   for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
+      // Frames can't be located in the stream once the pipeline has resampled, trimmed or encoded it
+      session->frame_sizes[index] = pcm ? (xraudio_format->sample_rate * frame_size_in * XRAUDIO_INPUT_FRAME_PERIOD) / 1000 : 0;
+
+      if(session->pipe_fds_rd[index] < 0) {
+         continue;
+      }
+      xrsr_dst_int_t *    dst         = &g_xrsr.routes[src].dsts[index];
+      xrsr_audio_format_t format      = dst->format;
+      uint32_t            sample_rate = xraudio_format->sample_rate;
+      bool                encode      = false;
+      #ifdef OPUS_ENABLED
+      encode = (format == XRSR_AUDIO_FORMAT_OPUS_CBR);
+      #endif
+      bool convert  = (wide && (format == XRSR_AUDIO_FORMAT_PCM || encode));
+      bool mono     = (convert || narrow); // single channel 16-bit audio is available to the stages
+      bool trim     = (mono && dst->trim_silence);
+      encode        = (encode && mono);
+
+      uint32_t sample_rate_out = xrsr_dst_sample_rate(dst, xraudio_format->sample_rate);
+      bool     resample        = (mono && sample_rate_out != xraudio_format->sample_rate);
+
+      if(!convert && !resample && !trim && !encode && dst->stage_qty == 0) {
+         continue;
+      }
+      xrsr_pipeline_t *pipeline = NULL;
+
+      if(!xrsr_pipeline_create(&pipeline, frame_size_in)) {
+         XLOGD_ERROR("dst index <%u> pipeline create failed", index);
+         xrsr_speech_stream_stages_close(session);
+         return(false);
+      }
+      xrsr_stage_t stage;
+      bool         result = true;
+
+      if(convert) {
+         // The keyword detector's channel is sent from processed audio, otherwise the channels are mixed
+         xrsr_convert_params_t params;
+         params.channel_qty = xraudio_format->channel_qty;
+         params.channel     = (xraudio_format->encoding == XRAUDIO_ENCODING_PCM) ? session->chan_selected : -1;
+         params.gain_db     = session->gain_db;
+
+         result = xrsr_convert_stage_create(&stage, &params) && xrsr_pipeline_stage_add(pipeline, &stage, XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI, sample_rate);
+      }
+      if(result && resample) {
+         result      = xrsr_resample_stage_create(&stage, sample_rate, sample_rate_out) && xrsr_pipeline_stage_add(pipeline, &stage, XRSR_AUDIO_FORMAT_PCM, sample_rate);
+         sample_rate = sample_rate_out;
+      }
+      if(result && trim) {
+         // The keyword is never trimmed, so that its position in the stream is only changed by the sample rate
+         uint32_t protect_qty = 0;
+         if(!user_initiated) {
+            protect_qty = (uint32_t)(((uint64_t)(dst->keyword_begin + dst->keyword_duration) * sample_rate) / xraudio_format->sample_rate);
+         }
+         result = xrsr_trim_stage_create(&stage, &g_xrsr.trim_config, sample_rate, protect_qty) && xrsr_pipeline_stage_add(pipeline, &stage, XRSR_AUDIO_FORMAT_PCM, sample_rate);
+      }
+      for(uint32_t stage_index = 0; result && stage_index < dst->stage_qty; stage_index++) {
+         result = xrsr_pipeline_stage_add(pipeline, &dst->stages[stage_index], mono ? XRSR_AUDIO_FORMAT_PCM : format, sample_rate);
+      }
+      #ifdef OPUS_ENABLED
+      if(result && encode) {
+         result = xrsr_encoder_stage_create(&stage, &g_xrsr.encoder_config, sample_rate) && xrsr_pipeline_stage_add(pipeline, &stage, XRSR_AUDIO_FORMAT_PCM, sample_rate);
+      }
+      #endif
+      if(!result) {
+         XLOGD_ERROR("dst index <%u> stage create failed", index);
+         xrsr_pipeline_destroy(pipeline, NULL);
+         xrsr_speech_stream_stages_close(session);
+         return(false);
+      }
+      if(xrsr_pipeline_stage_qty(pipeline) == 0) { // every application stage declined the stream
+         xrsr_pipeline_destroy(pipeline, NULL);
+         continue;
+      }
+
+      // Byte rates of the audio entering the first stage and leaving the last stage
+      uint32_t byte_rate_in = xraudio_format->sample_rate * frame_size_in;
+      uint32_t byte_rate_out;
+      if(encode) {
+         byte_rate_out = g_xrsr.encoder_config.bitrate / 8;
+      } else if(mono) {
+         byte_rate_out = sample_rate * sizeof(int16_t);
+      } else {
+         byte_rate_out = sample_rate * frame_size_in;
+      }
+
+      if(!xrsr_pipeline_start(pipeline, session->pipe_fds_rd[index], byte_rate_in, byte_rate_out)) {
+         XLOGD_ERROR("dst index <%u> pipeline start failed", index);
+         xrsr_pipeline_destroy(pipeline, NULL);
+         xrsr_speech_stream_stages_close(session);
+         return(false);
+      }
+      session->pipelines[index]   = pipeline; // the protocol reads the pipe from xraudio through the pipeline
+      session->frame_sizes[index] = 0;
+   }
+   return(true);
+}
+
+void xrsr_speech_stream_stages_close(xrsr_session_t *session) {
+   for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
+      xrsr_speech_stream_stage_close(session, index, NULL);
+   }
+}
+
+void xrsr_speech_stream_stage_close(xrsr_session_t *session, uint32_t dst_index, xrsr_stream_stats_t *stats) {
+   xrsr_pipeline_destroy(session->pipelines[dst_index], stats);
+   session->pipelines[dst_index] = NULL;
+}
+
+// Returns the pipeline which processes the audio read from fd, or NULL if the audio is read directly
+xrsr_pipeline_t *xrsr_speech_stream_pipeline(xrsr_src_t src, uint32_t dst_index, int fd) {
+   if(((uint32_t) src) >= (uint32_t)XRSR_SRC_INVALID || dst_index >= XRSR_DST_QTY_MAX || fd < 0) {
+      return(NULL);
+   }
+   xrsr_pipeline_t *pipeline = g_xrsr.sessions[xrsr_source_to_group(src)].pipelines[dst_index];
+   return((pipeline != NULL && pipeline->fd_in == fd) ? pipeline : NULL);
+}
+
+// Protocols read the destination's audio here instead of reading the pipe.  Audio which needs processing is passed
+// through the destination's pipeline on the protocol's thread.  Returns -1 with errno EAGAIN when the pipeline is
+// holding all of the audio available so far.
+int xrsr_speech_stream_read(xrsr_src_t src, uint32_t dst_index, int fd, uint8_t *buffer, uint32_t size) {
+   xrsr_pipeline_t *pipeline = xrsr_speech_stream_pipeline(src, dst_index, fd);
+   if(pipeline == NULL) {
+      return(read(fd, buffer, size));
+   }
+   return(xrsr_pipeline_read(pipeline, buffer, size));
+}
+
+// Translates the bytes waiting in the destination's pipe to bytes of the destination's audio
+uint32_t xrsr_speech_stream_backlog(xrsr_src_t src, uint32_t dst_index, int fd, uint32_t bytes) {
+   xrsr_pipeline_t *pipeline = xrsr_speech_stream_pipeline(src, dst_index, fd);
+   return((pipeline == NULL) ? bytes : xrsr_pipeline_backlog(pipeline, bytes));
+}
+
+uint32_t xrsr_speech_stream_frame_size(xrsr_src_t src, uint32_t dst_index) {
+   if(((uint32_t) src) >= (uint32_t)XRSR_SRC_INVALID || dst_index >= XRSR_DST_QTY_MAX) {
+      return(0);
+   }
+   xrsr_session_t *session = &g_xrsr.sessions[xrsr_source_to_group(src)];
+   return(session->frame_sizes[dst_index]);
+}
+
 bool xrsr_speech_stream_kwd(const uuid_t uuid, xrsr_src_t src, uint32_t dst_index) {
    char uuid_str[37] = {'\0'};
    uuid_unparse_lower(uuid, uuid_str);
@@ -2671,6 +3480,55 @@ bool xrsr_speech_stream_kwd(const uuid_t uuid, xrsr_src_t src, uint32_t dst_inde
    return(true);
 }
 
+// Adjust the frame grouping during the stream based on the destination's network conditions
+void xrsr_speech_stream_metrics(xrsr_src_t src, uint32_t dst_index, const xrsr_grouping_metrics_t *metrics) {
+   if(((uint32_t) src) >= (uint32_t)XRSR_SRC_INVALID || dst_index >= XRSR_DST_QTY_MAX || metrics == NULL) {
+      return;
+   }
+   xrsr_dst_int_t *dst = &g_xrsr.routes[src].dsts[dst_index];
+
+   xrsr_format_link_update(&dst->format_link, metrics);
+
+   bool measured = dst->grouping.measured;
+   if(xrsr_grouping_update(&dst->grouping, metrics) || (!measured && dst->grouping.measured)) {
+      xrsr_session_t *session = &g_xrsr.sessions[xrsr_source_to_group(src)];
+      uint32_t group_size;
+      if(xrsr_speech_stream_group_size(src, &group_size) && group_size != session->group_size) {
+         session->group_size = group_size;
+         xrsr_xraudio_stream_group_size_set(g_xrsr.xrsr_xraudio_object, session->xraudio_device_input, group_size);
+      }
+   }
+}
+
+// xraudio groups the frames for all of the session's destinations, so the smallest group size requested by the
+// streams which have reported their network conditions is used.  Returns false if none have reported.
+bool xrsr_speech_stream_group_size(xrsr_src_t src, uint32_t *group_size) {
+   bool found = false;
+   for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
+      const xrsr_grouping_t *grouping = &g_xrsr.routes[src].dsts[index].grouping;
+      if(g_xrsr.routes[src].dsts[index].handler == NULL) {
+         break;
+      }
+      if(!grouping->active || !grouping->measured) {
+         continue;
+      }
+      if(!found || grouping->size < *group_size) {
+         *group_size = grouping->size;
+         found       = true;
+      }
+   }
+   return(found);
+}
+
+void xrsr_speech_stream_grouping_end(xrsr_src_t src) {
+   for(uint32_t index = 0; index < XRSR_DST_QTY_MAX; index++) {
+      if(g_xrsr.routes[src].dsts[index].handler == NULL) {
+         break;
+      }
+      xrsr_grouping_end(&g_xrsr.routes[src].dsts[index].grouping, NULL);
+   }
+}
+
 bool xrsr_speech_stream_end(const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_stream_end_reason_t reason, bool detect_resume, xrsr_audio_stats_t *audio_stats) {
    bool result = true;
 
@@ -2720,7 +3578,25 @@ bool xrsr_speech_stream_end(const uuid_t uuid, xrsr_src_t src, uint32_t dst_inde
       if(audio_stats) {
          stats.audio_stats = *audio_stats;
       }
+      if(session->eos_rxd && reason == XRSR_STREAM_END_REASON_AUDIO_EOF) {
+         rdkx_timestamp_t timestamp;
+         rdkx_timestamp_get(&timestamp);
+         stats.eos_latency = rdkx_timestamp_subtract_us(session->eos_timestamp, timestamp);
+         XLOGD_INFO("dst index <%u> eos to last byte <%u> us", dst_index, stats.eos_latency);
+      }
+      xrsr_grouping_end(&dst->grouping, &stats);
+      xrsr_speech_stream_stage_close(session, dst_index, &stats);
       xrsr_session_stream_end(uuid, uuid_str, src, dst_index, &stats);
+   } else {
+      xrsr_grouping_end(&dst->grouping, NULL);
+      xrsr_speech_stream_stage_close(session, dst_index, NULL);
+   }
+
+   // The remaining streams may allow a larger group now that this one no longer limits it
+   uint32_t group_size;
+   if(more_streams && xrsr_speech_stream_group_size(src, &group_size) && group_size != session->group_size) {
+      session->group_size = group_size;
+      xrsr_xraudio_stream_group_size_set(g_xrsr.xrsr_xraudio_object, session->xraudio_device_input, group_size);
    }
 
    return(result);
@@ -2747,15 +3623,25 @@ void xrsr_msg_thread_poll(const xrsr_thread_params_t *params, xrsr_thread_state_
    }
 }
 
-xrsr_audio_format_t xrsr_audio_format_get(uint32_t formats_supported_dst, xraudio_input_format_t format_src) {
-   xrsr_audio_format_t ret = XRSR_AUDIO_FORMAT_NONE;
-   xrsr_audio_format_t src = xrsr_xraudio_format_to_xrsr(format_src);
-   if(src & formats_supported_dst) {
-      ret = src;
-   } else if(XRSR_AUDIO_FORMAT_PCM & formats_supported_dst) {
-      ret = XRSR_AUDIO_FORMAT_PCM;
+// Select the session's outgoing format from the formats the destination supports and its measured uplink
+xrsr_audio_format_t xrsr_dst_format_select(xrsr_dst_int_t *dst, xraudio_input_format_t format_src) {
+   uint32_t opus_bitrate = 0;
+   #ifdef OPUS_ENABLED
+   opus_bitrate = g_xrsr.encoder_config.bitrate;
+   #endif
+   dst->format = xrsr_format_select(&dst->format_link, dst->formats, format_src, g_xrsr.power_mode, opus_bitrate, &dst->format_reason);
+   return(dst->format);
+}
+
+// Rate of the audio sent to the destination in the selected format
+uint32_t xrsr_dst_sample_rate(xrsr_dst_int_t *dst, uint32_t sample_rate_src) {
+   uint32_t sample_rate = (dst->sample_rate != 0) ? dst->sample_rate : sample_rate_src;
+   #ifdef OPUS_ENABLED
+   if(dst->format == XRSR_AUDIO_FORMAT_OPUS_CBR) { // opus only supports a few sample rates
+      sample_rate = xrsr_encoder_sample_rate(sample_rate);
    }
-   return(ret);
+   #endif
+   return(sample_rate);
 }
 
 bool xrsr_is_source_active(xrsr_src_t src) {
@@ -2793,3 +3679,42 @@ bool xrsr_has_keyword_detector(xrsr_src_t src) {
    #endif
    return(true);
 }
+
+void xrsr_msg_circuit_probe(const xrsr_thread_params_t *params, xrsr_thread_state_t *state, void *msg) {
+   xrsr_queue_msg_circuit_probe_t *probe = (xrsr_queue_msg_circuit_probe_t *)msg;
+
+   if((uint32_t)probe->src >= XRSR_SRC_INVALID || probe->dst_index >= XRSR_DST_QTY_MAX) {
+      XLOGD_ERROR("invalid src <%s> dst index <%u>", xrsr_src_str(probe->src), probe->dst_index);
+      return;
+   }
+   xrsr_dst_int_t *dst = &g_xrsr.routes[probe->src].dsts[probe->dst_index];
+   if(dst->handler == NULL) { // route was removed while probing
+      return;
+   }
+   xrsr_circuit_probe_result(&dst->circuit, probe->probe_id, probe->result);
+}
+
+void xrsr_circuit_state_notify(xrsr_src_t src, uint32_t dst_index, xrsr_circuit_state_t state) {
+   if((uint32_t)src >= XRSR_SRC_INVALID || dst_index >= XRSR_DST_QTY_MAX) {
+      return;
+   }
+   xrsr_dst_int_t *dst = &g_xrsr.routes[src].dsts[dst_index];
+
+   if(dst->handlers.circuit_state != NULL) {
+      rdkx_timestamp_t timestamp;
+      rdkx_timestamp_get_realtime(&timestamp);
+      (*dst->handlers.circuit_state)(dst->handlers.data, src, dst_index, state, &timestamp);
+   }
+}
+
+#ifdef WS_ENABLED
+void xrsr_circuit_params_update(xrsr_dst_int_t *dst, xrsr_power_mode_t power_mode) {
+   xrsr_dst_param_ptrs_t *params = &dst->dst_param_ptrs[power_mode];
+
+   uint32_t threshold     = (params->circuit_threshold   != NULL) ? *params->circuit_threshold   : JSON_INT_VALUE_WS_FPM_CIRCUIT_THRESHOLD;
+   uint32_t open_period   = (params->circuit_open_period != NULL) ? *params->circuit_open_period : JSON_INT_VALUE_WS_FPM_CIRCUIT_OPEN_PERIOD;
+   uint32_t timeout_probe = (params->timeout_connect     != NULL) ? *params->timeout_connect     : JSON_INT_VALUE_WS_FPM_TIMEOUT_CONNECT;
+
+   xrsr_circuit_params_set(&dst->circuit, threshold, open_period, timeout_probe);
+}
+#endif
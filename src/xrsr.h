@@ -59,6 +59,10 @@
 
 #define XRSR_QUERY_STRING_QTY_MAX         (24)    ///< Maximum quantity of query strings supported
 
+#define XRSR_STAGE_QTY_MAX                (8)     ///< Maximum quantity of stages in a destination's audio pipeline, including the speech router's conversion, resampling and encoding stages
+#define XRSR_STAGE_NAME_LEN_MAX           (16)    ///< Maximum length of the NULL-terminated stage name in the stream statistics
+#define XRSR_STAGE_FRAME_SIZE_MAX         (16384) ///< Capacity of the frame buffers passed to the audio pipeline stages (in bytes)
+
 /// @}
 
 /// @addtogroup XRSR_ENUMS
@@ -131,6 +135,7 @@ typedef enum {
    XRSR_PROTOCOL_WSS     = 3, ///< Secure websockets protocol
    XRSR_PROTOCOL_SDT     = 4, ///< SDT Protocol
    XRSR_PROTOCOL_INVALID = 5, ///< An invalid protocol
+   XRSR_PROTOCOL_UNIX    = 6, ///< Unix domain socket protocol for on-device engines (after INVALID to keep the existing values)
 } xrsr_protocol_t;
 
 /// @brief XRSR receive message types
@@ -158,8 +163,9 @@ typedef enum {
    XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI = 1 << 2, ///< 32-bit PCM format (multi-channel)
    XRSR_AUDIO_FORMAT_PCM_RAW          = 1 << 3, ///< Raw 32-bit PCM format (unprocessed)
    XRSR_AUDIO_FORMAT_ADPCM            = 1 << 4, ///< ADPCM format
-   XRSR_AUDIO_FORMAT_OPUS             = 1 << 5, ///< OPUS format
-   XRSR_AUDIO_FORMAT_MAX              = 1 << 6  ///< The end of the audio format values (this must be the highest bit)
+   XRSR_AUDIO_FORMAT_OPUS             = 1 << 5, ///< OPUS format (as provided by xraudio)
+   XRSR_AUDIO_FORMAT_OPUS_CBR         = 1 << 6, ///< Constant bitrate OPUS packets encoded by the speech router and sent back to back without framing.  Each packet is bitrate * frame duration / 8000 bytes, from the opus configuration in the json config.
+   XRSR_AUDIO_FORMAT_MAX              = 1 << 7  ///< The end of the audio format values (this must be the highest bit)
 } xrsr_audio_format_t;
 
 
@@ -198,6 +204,33 @@ typedef enum {
    XRSR_RECV_EVENT_NONE              = 2,
    XRSR_RECV_EVENT_INVALID           = 3,
 } xrsr_recv_event_t;
+
+/// @brief XRSR circuit breaker state types
+/// @details The circuit state enumeration indicates whether sessions are sent to a destination's url.
+typedef enum {
+   XRSR_CIRCUIT_STATE_CLOSED    = 0, ///< Destination is healthy and sessions use its url
+   XRSR_CIRCUIT_STATE_OPEN      = 1, ///< Destination is failing so sessions use the fallback url or fail immediately
+   XRSR_CIRCUIT_STATE_HALF_OPEN = 2, ///< Destination is being probed for recovery and a single trial session may use its url
+   XRSR_CIRCUIT_STATE_INVALID   = 3, ///< An invalid circuit state
+} xrsr_circuit_state_t;
+
+/// @brief XRSR audio format selection reasons
+/// @details The format reason enumeration indicates why the outgoing audio format was selected for a session.
+typedef enum {
+   XRSR_FORMAT_REASON_DEFAULT   = 0, ///< Source format, or PCM if the destination doesn't support it (no processing beyond decoding)
+   XRSR_FORMAT_REASON_BANDWIDTH = 1, ///< Lower bitrate format selected since the measured uplink is constrained
+   XRSR_FORMAT_REASON_CPU       = 2, ///< A lower bitrate format was not selected since power mode or CPU headroom doesn't allow encoding
+   XRSR_FORMAT_REASON_INVALID   = 3, ///< An invalid format reason
+} xrsr_format_reason_t;
+
+/// @brief XRSR socket profiles
+/// @details The socket profile enumeration selects the TCP options applied to a destination's connections.
+typedef enum {
+   XRSR_SOCKET_PROFILE_DEFAULT     = 0, ///< Operating system defaults except that Nagle's algorithm is disabled
+   XRSR_SOCKET_PROFILE_LOW_LATENCY = 1, ///< Small unsent backlog, fast failure detection and interactive DSCP marking
+   XRSR_SOCKET_PROFILE_BULK        = 2, ///< Large buffers with audio frames batched into full segments
+   XRSR_SOCKET_PROFILE_INVALID     = 3, ///< An invalid socket profile
+} xrsr_socket_profile_t;
 /// @}
 
 /// @addtogroup XRSR_STRUCTS
@@ -257,6 +290,7 @@ typedef void (*xrsr_callback_session_config_t)(const uuid_t uuid, xrsr_session_c
 /// @details The session configuration output data structure provides detailed information to be used in a speech router session.
 typedef struct {
    xrsr_audio_format_t            format;                         ///< Outgoing audio format
+   xrsr_format_reason_t           format_reason;                  ///< Reason why the outgoing audio format was selected
    bool                           user_initiated;                 ///< Indicates whether the session was initiated directly by the user (ie. pressing a button)
    xrsr_callback_session_config_t cb_session_config;              ///< If not NULL, function for the application to return input session config
 } xrsr_session_config_out_t;
@@ -273,6 +307,25 @@ typedef struct {
    uint32_t samples_buffered_max; ///< Maximum quantity of samples buffered
 } xrsr_audio_stats_t;
 
+/// @brief XRSR socket stats structure
+/// @details The socket statistics data structure indicates the socket options in effect for a session's connection, as
+/// read back from the socket after the profile was applied.
+typedef struct {
+   bool                  valid;              ///< True if the options were read from the connection's socket
+   xrsr_socket_profile_t profile;            ///< Socket profile applied to the connection
+   bool                  nodelay;            ///< True if Nagle's algorithm is disabled
+   uint32_t              notsent_lowat;      ///< Limit on unsent data held by the socket (in bytes, 0 if not limited)
+   uint32_t              sndbuf;             ///< Send buffer size (in bytes)
+   uint32_t              rcvbuf;             ///< Receive buffer size (in bytes)
+   uint32_t              user_timeout;       ///< Time that sent data may remain unacknowledged before the connection is closed (in milliseconds, 0 for the system default)
+   bool                  keepalive;          ///< True if keepalive probes are enabled
+   uint32_t              keepalive_idle;     ///< Idle time before the first keepalive probe (in seconds)
+   uint32_t              keepalive_interval; ///< Time between keepalive probes (in seconds)
+   uint32_t              keepalive_count;    ///< Quantity of unanswered keepalive probes before the connection is closed
+   uint8_t               tos;                ///< IP type of service byte (DSCP in the upper six bits)
+   bool                  cork;               ///< True if batches of audio frames are corked into full segments
+} xrsr_socket_stats_t;
+
 /// @brief XRSR session stats structure
 /// @details The session statistics data structure indicates the statistics for an audio session.
 typedef struct {
@@ -283,14 +336,63 @@ typedef struct {
    char                      server_ip[XRSR_SESSION_IP_LEN_MAX]; ///< NULL-terminated string indicating the server's IP address
    double                    time_connect;                       ///< Amount of time elapsed during server connection (in seconds)
    double                    time_dns;                           ///< Amount of time elapsed during DNS lookup (in seconds)
+   uint32_t                  reconnect_qty;                      ///< Quantity of times the connection was re-established during the stream
+   uint32_t                  replay_bytes;                       ///< Quantity of audio bytes sent again after reconnecting
+   uint32_t                  send_queue_max;                     ///< Maximum quantity of audio bytes waiting in the send queue while the connection was not writable
+   uint32_t                  text_txd_bytes;                     ///< Quantity of outgoing text message bytes before compression
+   uint32_t                  text_txd_compressed_bytes;          ///< Quantity of bytes sent for outgoing text messages which were compressed with permessage-deflate
+   uint32_t                  text_rxd_bytes;                     ///< Quantity of incoming text message bytes after decompression
+   uint32_t                  text_rxd_compressed_bytes;          ///< Quantity of bytes received for incoming text messages which were compressed with permessage-deflate (RSV1 set)
+   bool                      hedged;                             ///< True if a hedged connection to the alternate URL was started
+   bool                      hedge_won;                          ///< True if the hedged connection was used for the session
+   double                    time_response;                      ///< Amount of time elapsed from connection until the first server response (in seconds)
+   bool                      fast_fail;                          ///< True if the session failed immediately since the destination's circuit was open
+   bool                      fallback;                           ///< True if the session used the fallback url since the destination's circuit was open
+   double                    rtt_smoothed;                       ///< Smoothed round trip time to the server measured with pings (in seconds, 0 if not measured)
+   double                    rtt_variance;                       ///< Round trip time variation measured with pings (in seconds)
+   xrsr_audio_format_t       format;                             ///< Outgoing audio format selected for the session
+   xrsr_format_reason_t      format_reason;                      ///< Reason why the outgoing audio format was selected
+   double                    uplink_throughput;                  ///< Estimated uplink throughput to the destination when the format was selected (in bytes per second, 0 if not measured)
+   xrsr_socket_stats_t       socket;                             ///< Socket options in effect for the connection
+   uint32_t                  http_version;                       ///< HTTP version used for the session (ie. 11 for HTTP/1.1, 20 for HTTP/2, 0 if not HTTP)
+   bool                      connection_reused;                  ///< True if the session was sent on an existing connection
+   uint32_t                  header_txd_bytes;                   ///< Quantity of request header bytes before header compression
+   uint32_t                  header_rxd_bytes;                   ///< Quantity of response header bytes after header decompression
+   uint32_t                  header_saved_bytes;                 ///< Estimated quantity of request header bytes saved by HTTP/2 header compression on a reused connection
 } xrsr_session_stats_t;
 
+/// @brief XRSR audio frame structure
+/// @details The frame data structure holds audio passed between the stages of a destination's pipeline.  The buffers are
+/// allocated when the pipeline is created.
+typedef struct {
+   uint8_t * buffer;   ///< Audio data
+   uint32_t  size;     ///< Quantity of audio bytes in the buffer
+   uint32_t  capacity; ///< Size of the buffer (in bytes)
+} xrsr_frame_t;
+
+/// @brief XRSR stage stats structure
+/// @details The stage stats data structure indicates the statistics for one stage of a destination's audio pipeline.
+typedef struct {
+   char     name[XRSR_STAGE_NAME_LEN_MAX]; ///< NULL-terminated name of the stage
+   uint32_t frame_qty;                     ///< Quantity of frames processed by the stage
+   uint32_t bytes_in;                      ///< Quantity of audio bytes received by the stage
+   uint32_t bytes_out;                     ///< Quantity of audio bytes produced by the stage
+   uint32_t time_avg;                      ///< Average time to process a frame (in microseconds)
+   uint32_t time_max;                      ///< Maximum time to process a frame (in microseconds)
+} xrsr_stage_stats_t;
+
 /// @brief XRSR stream stats structure
 /// @details The stream stats data structure indicates the statistics for the session's stream.
 typedef struct {
    bool               result;      ///< True if the stream was successful, otherwise false.
    xrsr_protocol_t    prot;        ///< Protocol used for the stream
    xrsr_audio_stats_t audio_stats; ///< Audio statistics for the stream
+   uint32_t           group_size_begin; ///< Audio frame group size chosen at the beginning of the stream (in bytes, 0 is a single frame)
+   uint32_t           group_size_end;   ///< Audio frame group size at the end of the stream (in bytes)
+   uint32_t           group_adjust_qty; ///< Quantity of times the group size was adjusted during the stream
+   uint32_t           eos_latency;      ///< Time from the end of speech to the last audio byte sent to the destination (in microseconds, 0 if end of speech was not detected)
+   uint32_t           stage_qty;                      ///< Quantity of stages in the destination's audio pipeline (0 if the audio was sent as received from xraudio)
+   xrsr_stage_stats_t stages[XRSR_STAGE_QTY_MAX];     ///< Statistics for each stage in the order that the audio passed through them
 } xrsr_stream_stats_t;
 
 /// @brief XRSR keyword detector result structure
@@ -309,7 +411,9 @@ typedef struct {
 } xrsr_keyword_detector_result_t;
 
 /// @brief XRSR destination params structure
-/// @details The destination params data structure provided for a destination.
+/// @details The destination params data structure provided for a destination.  The structure must be zero-initialized
+/// (ie. with memset) before the fields are set, since fields are added to it over time.  A field which is zero keeps the
+/// feature disabled or uses the default from the speech router's configuration.
 typedef struct {
    bool     debug;
    uint32_t connect_check_interval;
@@ -318,6 +422,18 @@ typedef struct {
    uint32_t timeout_session;
    bool     ipv4_fallback;
    uint32_t backoff_delay;
+   uint32_t reconnect_buffer_size;       ///< Audio kept for replay after reconnecting (in bytes, 0 for the configured default)
+   uint32_t send_queue_size;             ///< Audio queued while the socket is not writable (in bytes, 0 for the configured default)
+   uint32_t send_queue_latency;          ///< Time that queued audio may wait before the connection is abandoned (in ms, 0 for the configured default)
+   uint32_t hedge_delay;                 ///< Time before connecting to the hedge url (in ms, 0 for the configured default)
+   xrsr_socket_profile_t socket_profile; ///< Socket profile (XRSR_SOCKET_PROFILE_DEFAULT for the default profile of the protocol)
+   bool     deflate;                     ///< True to offer permessage-deflate (websocket only)
+   bool     deflate_no_context_takeover; ///< True to reset the compression context for each message (websocket only)
+   bool     http2_disabled;              ///< True to use HTTP/1.1 only.  Otherwise HTTP/2 is used when the server supports it.
+   bool     fd_passing;                  ///< True to pass the audio pipe to the engine instead of copying the audio (unix only)
+   uint32_t circuit_threshold;           ///< Consecutive session failures which open the circuit breaker (0 for the configured default)
+   uint32_t circuit_open_period;         ///< Time the circuit stays open before probing (in ms, 0 for the configured default)
+   uint32_t ping_interval;               ///< Time between websocket pings (in ms, 0 for the configured default)
 } xrsr_dst_params_t;
 
 /// @}
@@ -387,7 +503,7 @@ typedef void (*xrsr_handler_stream_end_t)(void *data, const uuid_t uuid, xrsr_st
 typedef void (*xrsr_handler_source_error_t)(void *data, xrsr_src_t src);
 
 /// @brief XRSR connected handler
-/// @details Callback function prototype for handling server connect events.
+/// @details Callback function prototype for handling server connect events.  It is called again with the same uuid when a websocket stream resumes on a new connection.
 /// @param[in] send  Function handler to send data during the session
 /// @param[in] param Pass-thru parameter to be used when calling the send handler
 /// @return The function returns true if successful or false otherwise.
@@ -409,6 +525,41 @@ typedef void (*xrsr_handler_disconnected_t)(void *data, const uuid_t uuid, xrsr_
 /// @return The function returns true if successful or false otherwise.
 typedef bool (*xrsr_handler_recv_msg_t)(void *data, xrsr_recv_msg_t type, const uint8_t *buffer, uint32_t length, xrsr_recv_event_t *event);
 
+/// @brief XRSR circuit state handler
+/// @details Callback function prototype for handling changes to a destination's circuit breaker state.
+/// @param[in] src       Source type of the route
+/// @param[in] dst_index Index of the destination within the route
+/// @param[in] state     The new circuit state
+/// @return The function has no return value.
+typedef void (*xrsr_handler_circuit_state_t)(void *data, xrsr_src_t src, uint32_t dst_index, xrsr_circuit_state_t state, rdkx_timestamp_t *timestamp);
+
+/// @brief XRSR stage open handler
+/// @details Callback function prototype for preparing a pipeline stage when a destination's audio stream begins.
+/// @param[in] format      Format of the audio received by the stage
+/// @param[in] sample_rate Sample rate of the audio received by the stage
+/// @return The function returns true if the stage processes the stream or false to leave it out of the pipeline.
+typedef bool (*xrsr_stage_open_t)(void *data, xrsr_audio_format_t format, uint32_t sample_rate);
+
+/// @brief XRSR stage process handler
+/// @details Callback function prototype for processing a frame of audio in a pipeline stage.  The stage may retain audio and
+/// output nothing (out->size of 0), which ends the pipeline for the frame.
+/// @param[in]    in  Audio received from the previous stage
+/// @param[inout] out Preallocated buffer for the audio to pass to the next stage.  The size is zero on entry.
+/// @return The function returns true if successful or false to end the stream.
+typedef bool (*xrsr_stage_process_t)(void *data, const xrsr_frame_t *in, xrsr_frame_t *out);
+
+/// @brief XRSR stage flush handler
+/// @details Callback function prototype for outputting audio retained by a pipeline stage at the end of the stream.  The
+/// handler is called again while it fills the output buffer, so a stage may output more than one frame of audio.
+/// @param[inout] out Preallocated buffer for the audio to pass to the next stage.  The size is zero on entry.
+/// @return The function returns true if successful or false otherwise.
+typedef bool (*xrsr_stage_flush_t)(void *data, xrsr_frame_t *out);
+
+/// @brief XRSR stage close handler
+/// @details Callback function prototype for releasing a pipeline stage when a destination's audio stream ends.
+/// @return The function has no return value.
+typedef void (*xrsr_stage_close_t)(void *data);
+
 /// @brief XRSR thread poll handler
 /// @details Callback function prototype for polling XRSR thread.
 /// @return The function has no return value.
@@ -428,8 +579,22 @@ typedef int (*xrsr_handler_stream_audio_t)(unsigned char* buffer,uint32_t length
 /// @brief Structures
 /// @details The speech router provides structures for grouping of values.
 
+/// @brief XRSR pipeline stage structure
+/// @details The stage data structure describes a step which processes a destination's audio before it is sent.  Stages
+/// run on the speech router's thread as the protocol reads the audio, so a stage must not block.  The handlers are called
+/// for each stream, so a stage must not keep state from a previous stream unless open resets it.
+typedef struct {
+   const char *         name;    ///< Name of the stage used in logs and statistics
+   void *               data;    ///< Optional parameter passed to each handler
+   xrsr_stage_open_t    open;    ///< Optional, called when the stream begins
+   xrsr_stage_process_t process; ///< Called for each frame of audio
+   xrsr_stage_flush_t   flush;   ///< Optional, called at the end of the stream
+   xrsr_stage_close_t   close;   ///< Optional, called when the stream ends
+} xrsr_stage_t;
+
 /// @brief XRSR handlers structure
-/// @details The handlers data structure is used to store the callback function handlers for a given route.
+/// @details The handlers data structure is used to store the callback function handlers for a given route.  The structure
+/// must be zero-initialized before the handlers are set, since any handler which is not NULL is called.
 typedef struct {
    void *                        data;           ///< Optional parameter passed to each handler
    xrsr_handler_session_begin_t  session_begin;  ///< Called when a session begins
@@ -443,10 +608,12 @@ typedef struct {
    xrsr_handler_connected_t      connected;      ///< Called when the protocol connects to the server
    xrsr_handler_disconnected_t   disconnected;   ///< Called when the protocol disconnects from the server
    xrsr_handler_recv_msg_t       recv_msg;       ///< Called when a message payload is received from the server
+   xrsr_handler_circuit_state_t  circuit_state;  ///< Called when the destination's circuit breaker changes state
 } xrsr_handlers_t;
 
 /// @brief XRSR route structure
-/// @details The route data structure provides detailed information about a route.
+/// @details The route data structure provides detailed information about a route.  The structure must be
+/// zero-initialized before the fields are set.  Optional fields which are zero are not used.
 typedef struct {
    const char *        url;                             ///< URL for the server which will handle requests
    xrsr_handlers_t     handlers;                        ///< Callback function handlers
@@ -456,6 +623,13 @@ typedef struct {
    int32_t             stream_offset;                   ///< Offset in samples from the stream from point
    xrsr_stream_until_t stream_until;                    ///< Continue streaming until this condition is encountered or an errror occurs
    xrsr_dst_params_t * params[XRSR_POWER_MODE_INVALID]; ///< Optional parameters for the route
+   const char *        url_hedge;                       ///< Optional alternate URL which is raced against url when connecting is slow (websocket only)
+   const char **       urls;                            ///< Optional NULL terminated list of additional candidate URLs.  Each session uses the best performing candidate.
+   const char *        url_fallback;                    ///< Optional URL used while the circuit breaker is open.  Otherwise sessions fail immediately (websocket only).
+   uint32_t            sample_rate;                     ///< Optional sample rate of the PCM or OPUS audio sent to the destination.  Zero uses the microphone's rate.
+   bool                trim_silence;                    ///< True to drop silence before and after the utterance from PCM or OPUS audio.  Pauses within the utterance are kept.  Audio up to the end of the keyword is always sent.
+   const xrsr_stage_t *stages;                          ///< Optional stages which process the audio after conversion, resampling and trimming, and before encoding
+   uint32_t            stage_qty;                       ///< Quantity of stages in the stages array (up to XRSR_STAGE_QTY_MAX - 4)
 } xrsr_dst_t;
 
 /// @brief XRSR route structure
@@ -603,6 +777,12 @@ void xrsr_close(void);
 /// @return The function has no return value.
 void xrsr_thread_poll(xrsr_thread_poll_func_t func);
 
+/// @brief Writes the audio path trace to the log
+/// @details Audio path events are recorded in a binary trace for each thread instead of being logged.  This function formats the most recent records of each thread and writes them to the log.  It may be called from any thread.  The trace is also written when a session ends with an error.
+/// @param[in] record_qty Maximum quantity of records to write for each thread or zero for all records
+/// @return The function has no return value.
+void xrsr_trace_dump(uint32_t record_qty);
+
 /// @brief Convert enum to a string
 /// @details Returns a NULL-terminated string representation of the source type.
 /// @param[in] src Source type
@@ -639,6 +819,24 @@ const char *xrsr_protocol_str(xrsr_protocol_t type);
 /// @return The function returns a read-only string representation of the receive message type.
 const char *xrsr_recv_msg_str(xrsr_recv_msg_t type);
 
+/// @brief Convert enum to a string
+/// @details Returns a NULL-terminated string representation of the circuit state type.
+/// @param[in] type Circuit state type
+/// @return The function returns a read-only string representation of the circuit state type.
+const char *xrsr_circuit_state_str(xrsr_circuit_state_t type);
+
+/// @brief Convert enum to a string
+/// @details Returns a NULL-terminated string representation of the audio format selection reason.
+/// @param[in] type Format reason type
+/// @return The function returns a read-only string representation of the format reason type.
+const char *xrsr_format_reason_str(xrsr_format_reason_t type);
+
+/// @brief Convert enum to a string
+/// @details Returns a NULL-terminated string representation of the socket profile.
+/// @param[in] profile Socket profile
+/// @return The function returns a read-only string representation of the socket profile.
+const char *xrsr_socket_profile_str(xrsr_socket_profile_t profile);
+
 /// @brief Convert enum to a string
 /// @details Returns a NULL-terminated string representation of the audio container type.
 /// @param[in] container Container type
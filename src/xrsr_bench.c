@@ -0,0 +1,501 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// End-to-end latency benchmark.  The speech router is opened against the local stand-in server (ws:// and http://)
+// and the sdt:// protocol, with sessions injected by the mock xraudio backend's scripted keyword detections.  Each
+// session is timed from the keyword detection through the route's handlers and the server's events.  Results are
+// written as json percentiles (in microseconds) so builds can be compared.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <pthread.h>
+#include <uuid/uuid.h>
+#include <jansson.h>
+#include <rdkx_logger.h>
+#include <xr_timestamp.h>
+#include <xrsr.h>
+#include "xrsr_bench_server.h"
+
+#define XRSR_BENCH_SESSION_QTY_DEFAULT   (20)
+#define XRSR_BENCH_AUDIO_DURATION        (2000)
+#define XRSR_BENCH_KEYWORD_DELAY         (250)
+#define XRSR_BENCH_SESSION_TIMEOUT       (15000)
+#define XRSR_BENCH_LOSS_RTO              (200)
+#define XRSR_BENCH_EOS_IDLE              (100)
+#define XRSR_BENCH_URL_LEN_MAX           (64)
+
+typedef enum {
+   XRSR_BENCH_METRIC_KEYWORD_TO_CONNECTED = 0, // keyword detection until the connected handler
+   XRSR_BENCH_METRIC_FIRST_BYTE           = 1, // keyword detection until the first audio byte reaches the destination
+   XRSR_BENCH_METRIC_EOS_TO_RESPONSE      = 2, // local end of stream until the first response message
+   XRSR_BENCH_METRIC_SESSION_END          = 3, // keyword detection until the session end handler
+   XRSR_BENCH_METRIC_QTY                  = 4,
+} xrsr_bench_metric_t;
+
+// Indices of the raw timestamps recorded per session
+#define XRSR_BENCH_TIME_KEYWORD    (0)
+#define XRSR_BENCH_TIME_CONNECTED  (1)
+#define XRSR_BENCH_TIME_FIRST_BYTE (2)
+#define XRSR_BENCH_TIME_EOS        (3)
+#define XRSR_BENCH_TIME_RESPONSE   (4)
+#define XRSR_BENCH_TIME_END        (5)
+#define XRSR_BENCH_TIME_QTY        (6)
+
+typedef struct {
+   bool             active;
+   rdkx_timestamp_t time[XRSR_BENCH_TIME_QTY];
+   bool             valid[XRSR_BENCH_TIME_QTY];
+} xrsr_bench_session_t;
+
+typedef struct {
+   const char *name;
+   const char *scheme;
+   bool        server;
+} xrsr_bench_protocol_t;
+
+typedef struct {
+   uint32_t                   session_qty;
+   uint32_t                   audio_duration;
+   double                     rate;
+   uint32_t                   keyword_delay;
+   uint32_t                   session_timeout;
+   const char *               protocols;
+   const char *               output;
+   xrsr_bench_server_params_t server;
+} xrsr_bench_params_t;
+
+typedef struct {
+   pthread_mutex_t      mutex;
+   pthread_cond_t       cond;
+   xrsr_bench_session_t session;
+   uint32_t             completed;
+   uint32_t             failed;
+   uint32_t             sample_max;
+   uint32_t             sample_qty[XRSR_BENCH_METRIC_QTY];
+   int64_t *            samples[XRSR_BENCH_METRIC_QTY];
+} xrsr_bench_state_t;
+
+static const xrsr_bench_protocol_t g_xrsr_bench_protocols[] = {
+   { "ws",   "ws",   true  },
+   { "http", "http", true  },
+   { "sdt",  "sdt",  false },
+};
+
+static const char *g_xrsr_bench_metric_names[XRSR_BENCH_METRIC_QTY] = {
+   "keyword_to_connected",
+   "first_byte",
+   "eos_to_response",
+   "session_end",
+};
+
+static xrsr_bench_state_t g_xrsr_bench;
+
+static void    xrsr_bench_usage(const char *name);
+static bool    xrsr_bench_run(const xrsr_bench_params_t *params, const xrsr_bench_protocol_t *protocol, uint16_t port, json_t *json_results);
+static void    xrsr_bench_record(uint32_t index, bool first_only);
+static void    xrsr_bench_session_complete(bool success);
+static json_t *xrsr_bench_stats(int64_t *samples, uint32_t qty);
+static int     xrsr_bench_compare(const void *a, const void *b);
+
+static void xrsr_bench_server_handler(void *data, xrsr_bench_server_conn_t type, xrsr_bench_server_event_t event, uint64_t bytes);
+static void xrsr_bench_handler_session_begin(void *data, const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_keyword_detector_result_t *detector_result, xrsr_session_config_out_t *config_out, xrsr_session_config_in_t *config_in, rdkx_timestamp_t *timestamp, const char *transcription_in);
+static void xrsr_bench_handler_session_end(void *data, const uuid_t uuid, xrsr_session_stats_t *stats, rdkx_timestamp_t *timestamp);
+static void xrsr_bench_handler_stream_end(void *data, const uuid_t uuid, xrsr_stream_stats_t *stats, rdkx_timestamp_t *timestamp);
+static int  xrsr_bench_handler_stream_audio(unsigned char *buffer, uint32_t length);
+static bool xrsr_bench_handler_connected(void *data, const uuid_t uuid, xrsr_handler_send_t send, void *param, rdkx_timestamp_t *timestamp);
+static bool xrsr_bench_handler_recv_msg(void *data, xrsr_recv_msg_t type, const uint8_t *buffer, uint32_t length, xrsr_recv_event_t *event);
+
+int main(int argc, char *argv[]) {
+   xrsr_bench_params_t params;
+   int                 opt;
+
+   memset(&params, 0, sizeof(params));
+   params.session_qty     = XRSR_BENCH_SESSION_QTY_DEFAULT;
+   params.audio_duration  = XRSR_BENCH_AUDIO_DURATION;
+   params.rate            = 1.0;
+   params.keyword_delay   = XRSR_BENCH_KEYWORD_DELAY;
+   params.session_timeout = XRSR_BENCH_SESSION_TIMEOUT;
+   params.protocols       = "ws,http,sdt";
+   params.server.loss_rto = XRSR_BENCH_LOSS_RTO;
+   params.server.eos_idle = XRSR_BENCH_EOS_IDLE;
+   params.server.seed     = 1;
+   params.server.handler  = xrsr_bench_server_handler;
+
+   while((opt = getopt(argc, argv, "p:n:a:r:k:T:c:d:e:l:R:t:s:o:h")) != -1) {
+      switch(opt) {
+         case 'p': params.protocols             = optarg;                       break;
+         case 'n': params.session_qty           = strtoul(optarg, NULL, 10);    break;
+         case 'a': params.audio_duration        = strtoul(optarg, NULL, 10);    break;
+         case 'r': params.rate                  = strtod(optarg, NULL);         break;
+         case 'k': params.keyword_delay         = strtoul(optarg, NULL, 10);    break;
+         case 'T': params.session_timeout       = strtoul(optarg, NULL, 10);    break;
+         case 'c': params.server.delay_connect  = strtoul(optarg, NULL, 10);    break;
+         case 'd': params.server.delay_response = strtoul(optarg, NULL, 10);    break;
+         case 'e': params.server.eos_idle       = strtoul(optarg, NULL, 10);    break;
+         case 'l': params.server.loss           = strtod(optarg, NULL) / 100.0; break;
+         case 'R': params.server.loss_rto       = strtoul(optarg, NULL, 10);    break;
+         case 't': params.server.throughput     = strtoul(optarg, NULL, 10);    break;
+         case 's': params.server.seed           = strtoul(optarg, NULL, 10);    break;
+         case 'o': params.output                = optarg;                       break;
+         default: {
+            xrsr_bench_usage(argv[0]);
+            return((opt == 'h') ? 0 : 1);
+         }
+      }
+   }
+   if(params.session_qty == 0 || params.keyword_delay == 0 || params.server.loss < 0.0 || params.server.loss > 1.0) {
+      xrsr_bench_usage(argv[0]);
+      return(1);
+   }
+
+   pthread_mutex_init(&g_xrsr_bench.mutex, NULL);
+   pthread_cond_init(&g_xrsr_bench.cond, NULL);
+   g_xrsr_bench.sample_max = params.session_qty;
+   for(uint32_t index = 0; index < XRSR_BENCH_METRIC_QTY; index++) {
+      g_xrsr_bench.samples[index] = (int64_t *)calloc(params.session_qty, sizeof(int64_t));
+      if(g_xrsr_bench.samples[index] == NULL) {
+         XLOGD_ERROR("out of memory");
+         return(1);
+      }
+   }
+
+   xrsr_bench_server_t server = xrsr_bench_server_create(&params.server);
+   if(server == NULL) {
+      XLOGD_ERROR("unable to start server");
+      return(1);
+   }
+   uint16_t port = xrsr_bench_server_port(server);
+
+   json_t *json_results   = json_object();
+   json_t *json_params    = json_object();
+   json_t *json_protocols = json_object();
+
+   json_object_set_new(json_params, "sessions",       json_integer(params.session_qty));
+   json_object_set_new(json_params, "audio_duration", json_integer(params.audio_duration));
+   json_object_set_new(json_params, "rate",           json_real(params.rate));
+   json_object_set_new(json_params, "keyword_delay",  json_integer(params.keyword_delay));
+   json_object_set_new(json_params, "delay_connect",  json_integer(params.server.delay_connect));
+   json_object_set_new(json_params, "delay_response", json_integer(params.server.delay_response));
+   json_object_set_new(json_params, "eos_idle",       json_integer(params.server.eos_idle));
+   json_object_set_new(json_params, "loss",           json_real(params.server.loss));
+   json_object_set_new(json_params, "loss_rto",       json_integer(params.server.loss_rto));
+   json_object_set_new(json_params, "throughput",     json_integer(params.server.throughput));
+   json_object_set_new(json_results, "units",    json_string("us"));
+   json_object_set_new(json_results, "params",   json_params);
+   json_object_set_new(json_results, "protocols", json_protocols);
+
+   bool result = true;
+   for(uint32_t index = 0; index < sizeof(g_xrsr_bench_protocols) / sizeof(g_xrsr_bench_protocols[0]); index++) {
+      const xrsr_bench_protocol_t *protocol = &g_xrsr_bench_protocols[index];
+      char list[64];
+      bool selected = false;
+
+      snprintf(list, sizeof(list), "%s", params.protocols);
+      for(char *save = NULL, *token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+         if(0 == strcmp(token, protocol->name)) {
+            selected = true;
+         }
+      }
+      if(selected && !xrsr_bench_run(&params, protocol, port, json_protocols)) {
+         result = false;
+      }
+   }
+
+   xrsr_bench_server_destroy(server);
+
+   FILE *file = (params.output != NULL) ? fopen(params.output, "w") : stdout;
+   if(file == NULL) {
+      XLOGD_ERROR("unable to open <%s> <%s>", params.output, strerror(errno));
+      result = false;
+   } else {
+      json_dumpf(json_results, file, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+      fprintf(file, "\n");
+      if(file != stdout) {
+         fclose(file);
+      }
+   }
+   json_decref(json_results);
+
+   for(uint32_t index = 0; index < XRSR_BENCH_METRIC_QTY; index++) {
+      free(g_xrsr_bench.samples[index]);
+   }
+   pthread_cond_destroy(&g_xrsr_bench.cond);
+   pthread_mutex_destroy(&g_xrsr_bench.mutex);
+   return(result ? 0 : 1);
+}
+
+void xrsr_bench_usage(const char *name) {
+   printf("usage: %s [options]\n", name);
+   printf("   -p <list>  protocols to run (default ws,http,sdt)\n");
+   printf("   -n <qty>   sessions per protocol (default %u)\n", XRSR_BENCH_SESSION_QTY_DEFAULT);
+   printf("   -a <ms>    utterance duration (default %u)\n", XRSR_BENCH_AUDIO_DURATION);
+   printf("   -r <rate>  audio source rate, 1.0 is real-time and 0 is unthrottled (default 1.0)\n");
+   printf("   -k <ms>    delay between sessions (default %u)\n", XRSR_BENCH_KEYWORD_DELAY);
+   printf("   -T <ms>    session timeout (default %u)\n", XRSR_BENCH_SESSION_TIMEOUT);
+   printf("   -c <ms>    server connect delay (default 0)\n");
+   printf("   -d <ms>    server response delay (default 0)\n");
+   printf("   -e <ms>    server websocket end of stream idle time (default %u)\n", XRSR_BENCH_EOS_IDLE);
+   printf("   -l <pct>   server inbound segment loss (default 0)\n");
+   printf("   -R <ms>    server stall per lost segment (default %u)\n", XRSR_BENCH_LOSS_RTO);
+   printf("   -t <kbps>  server inbound throughput limit (default unlimited)\n");
+   printf("   -s <seed>  loss generator seed (default 1)\n");
+   printf("   -o <file>  json output file (default stdout)\n");
+}
+
+bool xrsr_bench_run(const xrsr_bench_params_t *params, const xrsr_bench_protocol_t *protocol, uint16_t port, json_t *json_protocols) {
+   char              url[XRSR_BENCH_URL_LEN_MAX];
+   xrsr_dst_params_t dst_params;
+   xrsr_route_t      routes[2];
+
+   if(protocol->server) {
+      snprintf(url, sizeof(url), "%s://127.0.0.1:%u/bench", protocol->scheme, port);
+   } else {
+      snprintf(url, sizeof(url), "%s://127.0.0.1/bench", protocol->scheme);
+   }
+
+   memset(&dst_params, 0, sizeof(dst_params));
+   dst_params.connect_check_interval = 50;
+   dst_params.timeout_connect        = params->session_timeout;
+   dst_params.timeout_inactivity     = params->session_timeout;
+   dst_params.timeout_session        = params->session_timeout;
+   dst_params.ipv4_fallback          = true;
+
+   memset(routes, 0, sizeof(routes));
+   routes[0].src     = XRSR_SRC_MICROPHONE;
+   routes[0].dst_qty = 1;
+   routes[1].src     = XRSR_SRC_INVALID;
+
+   xrsr_dst_t *dst = &routes[0].dsts[0];
+   dst->url                     = url;
+   dst->handlers.session_begin  = xrsr_bench_handler_session_begin;
+   dst->handlers.session_end    = xrsr_bench_handler_session_end;
+   dst->handlers.stream_end     = xrsr_bench_handler_stream_end;
+   dst->handlers.stream_audio   = xrsr_bench_handler_stream_audio;
+   dst->handlers.connected      = xrsr_bench_handler_connected;
+   dst->handlers.recv_msg       = xrsr_bench_handler_recv_msg;
+   dst->formats                 = XRSR_AUDIO_FORMAT_PCM;
+   dst->stream_from             = XRSR_STREAM_FROM_BEGINNING;
+   dst->stream_until            = XRSR_STREAM_UNTIL_END_OF_SPEECH;
+   for(uint32_t index = 0; index < XRSR_POWER_MODE_INVALID; index++) {
+      dst->params[index] = &dst_params;
+   }
+
+   // Keyword detections are scripted in the mock xraudio backend and resume after every session
+   json_t *json_vsdk    = json_object();
+   json_t *json_xraudio = json_object();
+   json_t *json_mock    = json_object();
+   json_object_set_new(json_mock, "audio_duration", json_integer(params->audio_duration));
+   json_object_set_new(json_mock, "rate",           json_real(params->rate));
+   json_object_set_new(json_mock, "keyword_delay",  json_integer(params->keyword_delay));
+   json_object_set_new(json_mock, "keyword_source", json_string("mic"));
+   json_object_set_new(json_xraudio, "mock", json_mock);
+   json_object_set_new(json_vsdk, "xraudio", json_xraudio);
+
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   memset(&g_xrsr_bench.session, 0, sizeof(g_xrsr_bench.session));
+   memset(g_xrsr_bench.sample_qty, 0, sizeof(g_xrsr_bench.sample_qty));
+   g_xrsr_bench.completed = 0;
+   g_xrsr_bench.failed    = 0;
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+
+   XLOGD_INFO("protocol <%s> url <%s> sessions <%u>", protocol->name, url, params->session_qty);
+
+   if(!xrsr_open(NULL, routes, NULL, NULL, XRSR_POWER_MODE_FULL, false, false, json_vsdk)) {
+      XLOGD_ERROR("unable to open speech router");
+      json_decref(json_vsdk);
+      return(false);
+   }
+
+   bool     timeout = false;
+   uint32_t total   = 0;
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   while(g_xrsr_bench.completed + g_xrsr_bench.failed < params->session_qty) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec  += (params->session_timeout + params->keyword_delay) / 1000;
+      deadline.tv_nsec += ((params->session_timeout + params->keyword_delay) % 1000) * 1000000;
+      if(deadline.tv_nsec >= 1000000000) {
+         deadline.tv_sec++;
+         deadline.tv_nsec -= 1000000000;
+      }
+      total = g_xrsr_bench.completed + g_xrsr_bench.failed;
+      int rc = 0;
+      while(rc == 0 && total == g_xrsr_bench.completed + g_xrsr_bench.failed) {
+         rc = pthread_cond_timedwait(&g_xrsr_bench.cond, &g_xrsr_bench.mutex, &deadline);
+      }
+      if(rc == ETIMEDOUT) {
+         XLOGD_ERROR("protocol <%s> session timeout", protocol->name);
+         timeout = true;
+         break;
+      }
+   }
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+
+   xrsr_close();
+   json_decref(json_vsdk);
+
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   json_t *json_protocol = json_object();
+   json_t *json_metrics  = json_object();
+   json_object_set_new(json_protocol, "url",       json_string(url));
+   json_object_set_new(json_protocol, "completed", json_integer(g_xrsr_bench.completed));
+   json_object_set_new(json_protocol, "failed",    json_integer(g_xrsr_bench.failed));
+   json_object_set_new(json_protocol, "timeout",   json_boolean(timeout));
+   for(uint32_t index = 0; index < XRSR_BENCH_METRIC_QTY; index++) {
+      if(g_xrsr_bench.sample_qty[index] > 0) {
+         json_object_set_new(json_metrics, g_xrsr_bench_metric_names[index], xrsr_bench_stats(g_xrsr_bench.samples[index], g_xrsr_bench.sample_qty[index]));
+      }
+   }
+   json_object_set_new(json_protocol, "metrics", json_metrics);
+   json_object_set_new(json_protocols, protocol->name, json_protocol);
+   bool result = (!timeout && g_xrsr_bench.failed == 0);
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+
+   return(result);
+}
+
+void xrsr_bench_record(uint32_t index, bool first_only) {
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   if(g_xrsr_bench.session.active && (!first_only || !g_xrsr_bench.session.valid[index])) {
+      rdkx_timestamp_get_realtime(&g_xrsr_bench.session.time[index]);
+      g_xrsr_bench.session.valid[index] = true;
+   }
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+}
+
+// Called with the mutex locked
+void xrsr_bench_session_complete(bool success) {
+   static const uint32_t pairs[XRSR_BENCH_METRIC_QTY][2] = {
+      { XRSR_BENCH_TIME_KEYWORD, XRSR_BENCH_TIME_CONNECTED  },
+      { XRSR_BENCH_TIME_KEYWORD, XRSR_BENCH_TIME_FIRST_BYTE },
+      { XRSR_BENCH_TIME_EOS,     XRSR_BENCH_TIME_RESPONSE   },
+      { XRSR_BENCH_TIME_KEYWORD, XRSR_BENCH_TIME_END        },
+   };
+   xrsr_bench_session_t *session = &g_xrsr_bench.session;
+
+   if(success) {
+      for(uint32_t index = 0; index < XRSR_BENCH_METRIC_QTY; index++) {
+         uint32_t begin = pairs[index][0];
+         uint32_t end   = pairs[index][1];
+         if(session->valid[begin] && session->valid[end] && g_xrsr_bench.sample_qty[index] < g_xrsr_bench.sample_max) {
+            g_xrsr_bench.samples[index][g_xrsr_bench.sample_qty[index]++] = rdkx_timestamp_subtract_us(session->time[begin], session->time[end]);
+         }
+      }
+      g_xrsr_bench.completed++;
+   } else {
+      g_xrsr_bench.failed++;
+   }
+   session->active = false;
+   pthread_cond_signal(&g_xrsr_bench.cond);
+}
+
+json_t *xrsr_bench_stats(int64_t *samples, uint32_t qty) {
+   json_t *json_obj = json_object();
+   int64_t sum      = 0;
+
+   qsort(samples, qty, sizeof(int64_t), xrsr_bench_compare);
+   for(uint32_t index = 0; index < qty; index++) {
+      sum += samples[index];
+   }
+   // Nearest rank percentiles
+   #define XRSR_BENCH_PERCENTILE(pct) samples[(((pct) * qty + 99) / 100) - 1]
+
+   json_object_set_new(json_obj, "count", json_integer(qty));
+   json_object_set_new(json_obj, "min",   json_integer(samples[0]));
+   json_object_set_new(json_obj, "mean",  json_integer(sum / qty));
+   json_object_set_new(json_obj, "p50",   json_integer(XRSR_BENCH_PERCENTILE(50)));
+   json_object_set_new(json_obj, "p90",   json_integer(XRSR_BENCH_PERCENTILE(90)));
+   json_object_set_new(json_obj, "p99",   json_integer(XRSR_BENCH_PERCENTILE(99)));
+   json_object_set_new(json_obj, "max",   json_integer(samples[qty - 1]));
+   return(json_obj);
+}
+
+int xrsr_bench_compare(const void *a, const void *b) {
+   int64_t value_a = *(const int64_t *)a;
+   int64_t value_b = *(const int64_t *)b;
+   return((value_a > value_b) - (value_a < value_b));
+}
+
+void xrsr_bench_server_handler(void *data, xrsr_bench_server_conn_t type, xrsr_bench_server_event_t event, uint64_t bytes) {
+   XLOGD_DEBUG("type <%s> event <%s> bytes <%llu>", xrsr_bench_server_conn_str(type), xrsr_bench_server_event_str(event), (unsigned long long)bytes);
+   if(event == XRSR_BENCH_SERVER_EVENT_FIRST_BYTE) {
+      xrsr_bench_record(XRSR_BENCH_TIME_FIRST_BYTE, true);
+   }
+}
+
+void xrsr_bench_handler_session_begin(void *data, const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_keyword_detector_result_t *detector_result, xrsr_session_config_out_t *config_out, xrsr_session_config_in_t *config_in, rdkx_timestamp_t *timestamp, const char *transcription_in) {
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   memset(&g_xrsr_bench.session, 0, sizeof(g_xrsr_bench.session));
+   g_xrsr_bench.session.active = true;
+   if(timestamp != NULL) { // time of the keyword detection
+      g_xrsr_bench.session.time[XRSR_BENCH_TIME_KEYWORD] = *timestamp;
+   } else {
+      rdkx_timestamp_get_realtime(&g_xrsr_bench.session.time[XRSR_BENCH_TIME_KEYWORD]);
+   }
+   g_xrsr_bench.session.valid[XRSR_BENCH_TIME_KEYWORD] = true;
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+
+   if(config_in != NULL && src != XRSR_SRC_INVALID) {
+      config_in->src = src;
+   }
+}
+
+void xrsr_bench_handler_session_end(void *data, const uuid_t uuid, xrsr_session_stats_t *stats, rdkx_timestamp_t *timestamp) {
+   xrsr_bench_record(XRSR_BENCH_TIME_END, false);
+
+   bool success = (stats != NULL && (stats->reason == XRSR_SESSION_END_REASON_EOS || stats->reason == XRSR_SESSION_END_REASON_EOT || stats->reason == XRSR_SESSION_END_REASON_DISCONNECT_REMOTE));
+   if(!success) {
+      XLOGD_WARN("session failed reason <%s>", (stats != NULL) ? xrsr_session_end_reason_str(stats->reason) : "NULL");
+   }
+   pthread_mutex_lock(&g_xrsr_bench.mutex);
+   if(g_xrsr_bench.session.active) {
+      xrsr_bench_session_complete(success);
+   }
+   pthread_mutex_unlock(&g_xrsr_bench.mutex);
+}
+
+void xrsr_bench_handler_stream_end(void *data, const uuid_t uuid, xrsr_stream_stats_t *stats, rdkx_timestamp_t *timestamp) {
+   xrsr_bench_record(XRSR_BENCH_TIME_EOS, true);
+}
+
+int xrsr_bench_handler_stream_audio(unsigned char *buffer, uint32_t length) {
+   // The sdt protocol has no server so the audio handler is the destination
+   xrsr_bench_record(XRSR_BENCH_TIME_FIRST_BYTE, true);
+   return(length);
+}
+
+bool xrsr_bench_handler_connected(void *data, const uuid_t uuid, xrsr_handler_send_t send, void *param, rdkx_timestamp_t *timestamp) {
+   xrsr_bench_record(XRSR_BENCH_TIME_CONNECTED, true);
+   return(true);
+}
+
+bool xrsr_bench_handler_recv_msg(void *data, xrsr_recv_msg_t type, const uint8_t *buffer, uint32_t length, xrsr_recv_event_t *event) {
+   xrsr_bench_record(XRSR_BENCH_TIME_RESPONSE, true);
+   if(event != NULL) { // the stand-in server sends a single response per session
+      *event = XRSR_RECV_EVENT_EOS_SERVER;
+   }
+   return(false);
+}
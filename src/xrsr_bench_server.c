@@ -0,0 +1,1006 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Local stand-in for the websocket and HTTP speech servers.  A single listening socket on 127.0.0.1 accepts both
+// protocols (websocket is selected by the upgrade header).  Audio payload is counted and discarded.  End of stream
+// is the terminating chunk for HTTP and an idle period for websocket, after which a single text response is
+// returned and the connection is closed.  Connect delay, response delay, segment loss and inbound throughput are
+// configurable so field conditions can be reproduced without a network.
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <rdkx_logger.h>
+#include "xrsr_bench_server.h"
+
+#define XRSR_BENCH_SERVER_IDENTIFIER        (0x42454E43)
+#define XRSR_BENCH_SERVER_CONN_QTY_MAX      (8)
+#define XRSR_BENCH_SERVER_RX_BUF_SIZE       (32 * 1024)
+#define XRSR_BENCH_SERVER_TX_TIMEOUT        (100)  // ms to wait for socket space when sending a response
+#define XRSR_BENCH_SERVER_CLOSE_TIMEOUT     (1000) // ms to wait for the client to close after the response
+#define XRSR_BENCH_SERVER_BURST_MS          (50)   // token bucket depth (in ms of throughput)
+#define XRSR_BENCH_SERVER_BURST_MIN         (1500) // token bucket depth minimum (in bytes)
+#define XRSR_BENCH_SERVER_INVALID_STR_LEN   (24)
+
+#define XRSR_BENCH_SERVER_WS_GUID           "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+#define XRSR_BENCH_SERVER_RESPONSE_DEFAULT  "{\"msgType\":\"result\",\"transcription\":\"bench\"}"
+
+#define XRSR_BENCH_SERVER_WS_OPCODE_TEXT    (0x1)
+#define XRSR_BENCH_SERVER_WS_OPCODE_BINARY  (0x2)
+#define XRSR_BENCH_SERVER_WS_OPCODE_CLOSE   (0x8)
+#define XRSR_BENCH_SERVER_WS_OPCODE_PING    (0x9)
+#define XRSR_BENCH_SERVER_WS_OPCODE_PONG    (0xA)
+
+typedef enum {
+   XRSR_BENCH_SERVER_STATE_IDLE      = 0, // slot is not in use
+   XRSR_BENCH_SERVER_STATE_HEADERS   = 1, // receiving the request line and headers
+   XRSR_BENCH_SERVER_STATE_HANDSHAKE = 2, // headers received, waiting for the connect delay
+   XRSR_BENCH_SERVER_STATE_BODY      = 3, // receiving audio payload
+   XRSR_BENCH_SERVER_STATE_RESPOND   = 4, // end of stream, waiting for the response delay
+   XRSR_BENCH_SERVER_STATE_CLOSING   = 5, // response sent, waiting for the client to close
+} xrsr_bench_server_state_t;
+
+typedef enum {
+   XRSR_BENCH_SERVER_CHUNK_SIZE    = 0,
+   XRSR_BENCH_SERVER_CHUNK_DATA    = 1,
+   XRSR_BENCH_SERVER_CHUNK_CRLF    = 2,
+   XRSR_BENCH_SERVER_CHUNK_TRAILER = 3,
+} xrsr_bench_server_chunk_t;
+
+typedef struct {
+   int                       fd;
+   xrsr_bench_server_conn_t  type;
+   xrsr_bench_server_state_t state;
+   struct timespec           time_accept;
+   struct timespec           time_deadline;
+   struct timespec           time_last_rx;
+   struct timespec           time_stall;
+   struct timespec           time_refill;
+   double                    tokens;
+   uint64_t                  bytes;
+   char                      ws_key[64];
+   uint64_t                  ws_remaining;   // payload bytes remaining in the current data frame
+   bool                      chunked;
+   xrsr_bench_server_chunk_t chunk_state;
+   uint64_t                  chunk_remaining;
+   uint64_t                  content_length;
+   uint32_t                  rx_len;
+   uint8_t                   rx[XRSR_BENCH_SERVER_RX_BUF_SIZE];
+} xrsr_bench_server_conn_obj_t;
+
+typedef struct {
+   uint32_t                     identifier;
+   xrsr_bench_server_params_t   params;
+   int                          fd_listen;
+   int                          pipe_wake[2];
+   uint16_t                     port;
+   pthread_t                    thread;
+   unsigned int                 seed;
+   uint32_t                     reject_qty;     // quantity of upcoming connections to close without a response
+   xrsr_bench_server_conn_obj_t conns[XRSR_BENCH_SERVER_CONN_QTY_MAX];
+} xrsr_bench_server_obj_t;
+
+static bool  xrsr_bench_server_object_is_valid(xrsr_bench_server_obj_t *obj);
+static void *xrsr_bench_server_thread(void *param);
+static void  xrsr_bench_server_accept(xrsr_bench_server_obj_t *obj, const struct timespec *now);
+static void  xrsr_bench_server_conn_read(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static void  xrsr_bench_server_conn_process(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static void  xrsr_bench_server_conn_timers(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static bool  xrsr_bench_server_conn_headers(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn);
+static bool  xrsr_bench_server_conn_handshake(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn);
+static bool  xrsr_bench_server_conn_body_ws(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static bool  xrsr_bench_server_conn_body_http(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static void  xrsr_bench_server_conn_payload(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, uint64_t bytes, const struct timespec *now);
+static void  xrsr_bench_server_conn_eos(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static void  xrsr_bench_server_conn_respond(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now);
+static void  xrsr_bench_server_conn_close(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn);
+static bool  xrsr_bench_server_conn_readable(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now, int *timeout);
+static void  xrsr_bench_server_conn_consume(xrsr_bench_server_conn_obj_t *conn, uint32_t bytes);
+static void  xrsr_bench_server_event(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, xrsr_bench_server_event_t event);
+static bool  xrsr_bench_server_send(int fd, const uint8_t *buffer, size_t length);
+static bool  xrsr_bench_server_send_ws(int fd, uint8_t opcode, const uint8_t *payload, size_t length);
+static bool  xrsr_bench_server_header_get(const char *headers, const char *name, char *value, size_t size);
+static void  xrsr_bench_server_sha1(const uint8_t *data, size_t length, uint8_t digest[20]);
+static void  xrsr_bench_server_base64(const uint8_t *data, size_t length, char *out, size_t size);
+static void  xrsr_bench_server_ts_add_ms(struct timespec *ts, uint32_t ms);
+static int64_t xrsr_bench_server_ts_diff_ms(const struct timespec *a, const struct timespec *b);
+static void  xrsr_bench_server_timeout_min(int *timeout, int64_t ms);
+static const char *xrsr_bench_server_invalid_return(int value);
+
+xrsr_bench_server_t xrsr_bench_server_create(const xrsr_bench_server_params_t *params) {
+   if(params == NULL) {
+      XLOGD_ERROR("invalid params");
+      return(NULL);
+   }
+   if(params->loss < 0.0 || params->loss > 1.0) {
+      XLOGD_ERROR("invalid loss <%f>", params->loss);
+      return(NULL);
+   }
+   xrsr_bench_server_obj_t *obj = (xrsr_bench_server_obj_t *)calloc(1, sizeof(xrsr_bench_server_obj_t));
+   if(obj == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(NULL);
+   }
+   obj->identifier   = XRSR_BENCH_SERVER_IDENTIFIER;
+   obj->params       = *params;
+   obj->seed         = params->seed;
+   obj->fd_listen    = -1;
+   obj->pipe_wake[0] = -1;
+   obj->pipe_wake[1] = -1;
+   if(obj->params.response == NULL) {
+      obj->params.response = XRSR_BENCH_SERVER_RESPONSE_DEFAULT;
+   }
+   for(uint32_t index = 0; index < XRSR_BENCH_SERVER_CONN_QTY_MAX; index++) {
+      obj->conns[index].fd = -1;
+   }
+
+   struct sockaddr_in addr;
+   socklen_t          addr_len = sizeof(addr);
+   int                enable   = 1;
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family      = AF_INET;
+   addr.sin_port        = htons(params->port);
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+   obj->fd_listen = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if(obj->fd_listen < 0) {
+      XLOGD_ERROR("socket <%s>", strerror(errno));
+      goto error;
+   }
+   if(setsockopt(obj->fd_listen, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) < 0) {
+      XLOGD_WARN("SO_REUSEADDR <%s>", strerror(errno));
+   }
+   if(bind(obj->fd_listen, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      XLOGD_ERROR("bind port <%u> <%s>", params->port, strerror(errno));
+      goto error;
+   }
+   if(listen(obj->fd_listen, XRSR_BENCH_SERVER_CONN_QTY_MAX) < 0) {
+      XLOGD_ERROR("listen <%s>", strerror(errno));
+      goto error;
+   }
+   if(getsockname(obj->fd_listen, (struct sockaddr *)&addr, &addr_len) < 0) {
+      XLOGD_ERROR("getsockname <%s>", strerror(errno));
+      goto error;
+   }
+   obj->port = ntohs(addr.sin_port);
+
+   if(pipe2(obj->pipe_wake, O_CLOEXEC | O_NONBLOCK) < 0) {
+      XLOGD_ERROR("pipe <%s>", strerror(errno));
+      goto error;
+   }
+
+   if(pthread_create(&obj->thread, NULL, xrsr_bench_server_thread, obj) != 0) {
+      XLOGD_ERROR("unable to create thread");
+      goto error;
+   }
+
+   XLOGD_INFO("listening on 127.0.0.1:%u delay connect <%u> response <%u> ms eos idle <%u> ms loss <%.3f> rto <%u> ms throughput <%u> kbps", obj->port, params->delay_connect, params->delay_response, params->eos_idle, params->loss, params->loss_rto, params->throughput);
+   return((xrsr_bench_server_t)obj);
+
+error:
+   if(obj->fd_listen >= 0) {
+      close(obj->fd_listen);
+   }
+   if(obj->pipe_wake[0] >= 0) {
+      close(obj->pipe_wake[0]);
+      close(obj->pipe_wake[1]);
+   }
+   obj->identifier = 0;
+   free(obj);
+   return(NULL);
+}
+
+uint16_t xrsr_bench_server_port(xrsr_bench_server_t server) {
+   xrsr_bench_server_obj_t *obj = (xrsr_bench_server_obj_t *)server;
+   if(!xrsr_bench_server_object_is_valid(obj)) {
+      XLOGD_ERROR("invalid object");
+      return(0);
+   }
+   return(obj->port);
+}
+
+void xrsr_bench_server_reject(xrsr_bench_server_t server, uint32_t qty) {
+   xrsr_bench_server_obj_t *obj = (xrsr_bench_server_obj_t *)server;
+   if(!xrsr_bench_server_object_is_valid(obj)) {
+      XLOGD_ERROR("invalid object");
+      return;
+   }
+   __atomic_store_n(&obj->reject_qty, qty, __ATOMIC_SEQ_CST);
+}
+
+void xrsr_bench_server_destroy(xrsr_bench_server_t server) {
+   xrsr_bench_server_obj_t *obj = (xrsr_bench_server_obj_t *)server;
+   if(!xrsr_bench_server_object_is_valid(obj)) {
+      XLOGD_ERROR("invalid object");
+      return;
+   }
+   uint8_t wake = 0;
+   if(write(obj->pipe_wake[1], &wake, sizeof(wake)) != sizeof(wake)) {
+      XLOGD_ERROR("unable to wake thread <%s>", strerror(errno));
+   }
+   pthread_join(obj->thread, NULL);
+
+   for(uint32_t index = 0; index < XRSR_BENCH_SERVER_CONN_QTY_MAX; index++) {
+      if(obj->conns[index].fd >= 0) {
+         xrsr_bench_server_conn_close(obj, &obj->conns[index]);
+      }
+   }
+   close(obj->fd_listen);
+   close(obj->pipe_wake[0]);
+   close(obj->pipe_wake[1]);
+   obj->identifier = 0;
+   free(obj);
+}
+
+bool xrsr_bench_server_object_is_valid(xrsr_bench_server_obj_t *obj) {
+   return(obj != NULL && obj->identifier == XRSR_BENCH_SERVER_IDENTIFIER);
+}
+
+void *xrsr_bench_server_thread(void *param) {
+   xrsr_bench_server_obj_t *obj = (xrsr_bench_server_obj_t *)param;
+   struct pollfd            pfds[XRSR_BENCH_SERVER_CONN_QTY_MAX + 2];
+   int                      indices[XRSR_BENCH_SERVER_CONN_QTY_MAX + 2];
+
+   while(1) {
+      struct timespec now;
+      nfds_t          nfds    = 0;
+      int             timeout = -1;
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      pfds[nfds].fd     = obj->pipe_wake[0];
+      pfds[nfds].events = POLLIN;
+      indices[nfds++]   = -1;
+      pfds[nfds].fd     = obj->fd_listen;
+      pfds[nfds].events = POLLIN;
+      indices[nfds++]   = -1;
+
+      for(uint32_t index = 0; index < XRSR_BENCH_SERVER_CONN_QTY_MAX; index++) {
+         xrsr_bench_server_conn_obj_t *conn = &obj->conns[index];
+         if(conn->fd < 0) {
+            continue;
+         }
+         if(conn->state == XRSR_BENCH_SERVER_STATE_HANDSHAKE || conn->state == XRSR_BENCH_SERVER_STATE_RESPOND || conn->state == XRSR_BENCH_SERVER_STATE_CLOSING) {
+            xrsr_bench_server_timeout_min(&timeout, xrsr_bench_server_ts_diff_ms(&conn->time_deadline, &now));
+         }
+         if(conn->type == XRSR_BENCH_SERVER_CONN_WS && conn->state == XRSR_BENCH_SERVER_STATE_BODY && conn->bytes > 0) {
+            struct timespec eos = conn->time_last_rx;
+            xrsr_bench_server_ts_add_ms(&eos, obj->params.eos_idle);
+            xrsr_bench_server_timeout_min(&timeout, xrsr_bench_server_ts_diff_ms(&eos, &now));
+         }
+         if(xrsr_bench_server_conn_readable(obj, conn, &now, &timeout)) {
+            pfds[nfds].fd     = conn->fd;
+            pfds[nfds].events = POLLIN;
+            indices[nfds++]   = index;
+         }
+      }
+
+      int rc = poll(pfds, nfds, timeout);
+      if(rc < 0) {
+         if(errno == EINTR) {
+            continue;
+         }
+         XLOGD_ERROR("poll <%s>", strerror(errno));
+         break;
+      }
+      if(pfds[0].revents & POLLIN) { // destroy requested
+         break;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+
+      if(pfds[1].revents & POLLIN) {
+         xrsr_bench_server_accept(obj, &now);
+      }
+      for(nfds_t index = 2; index < nfds; index++) {
+         if(pfds[index].revents != 0) {
+            xrsr_bench_server_conn_read(obj, &obj->conns[indices[index]], &now);
+         }
+      }
+      for(uint32_t index = 0; index < XRSR_BENCH_SERVER_CONN_QTY_MAX; index++) {
+         if(obj->conns[index].fd >= 0) {
+            xrsr_bench_server_conn_timers(obj, &obj->conns[index], &now);
+         }
+      }
+   }
+   return(NULL);
+}
+
+void xrsr_bench_server_accept(xrsr_bench_server_obj_t *obj, const struct timespec *now) {
+   int fd = accept4(obj->fd_listen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+   if(fd < 0) {
+      if(errno != EAGAIN && errno != EWOULDBLOCK) {
+         XLOGD_ERROR("accept <%s>", strerror(errno));
+      }
+      return;
+   }
+   uint32_t reject_qty = __atomic_load_n(&obj->reject_qty, __ATOMIC_SEQ_CST);
+   while(reject_qty > 0) {
+      if(__atomic_compare_exchange_n(&obj->reject_qty, &reject_qty, reject_qty - 1, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+         XLOGD_INFO("rejecting fd <%d>", fd);
+         close(fd);
+         return;
+      }
+   }
+   for(uint32_t index = 0; index < XRSR_BENCH_SERVER_CONN_QTY_MAX; index++) {
+      xrsr_bench_server_conn_obj_t *conn = &obj->conns[index];
+      if(conn->fd >= 0) {
+         continue;
+      }
+      memset(conn, 0, offsetof(xrsr_bench_server_conn_obj_t, rx));
+      conn->fd          = fd;
+      conn->type        = XRSR_BENCH_SERVER_CONN_INVALID;
+      conn->state       = XRSR_BENCH_SERVER_STATE_HEADERS;
+      conn->time_accept = *now;
+      conn->time_refill = *now;
+      conn->time_stall  = *now;
+      XLOGD_DEBUG("accepted fd <%d> slot <%u>", fd, index);
+      return;
+   }
+   XLOGD_WARN("connection limit reached");
+   close(fd);
+}
+
+bool xrsr_bench_server_conn_readable(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now, int *timeout) {
+   if(conn->state == XRSR_BENCH_SERVER_STATE_HANDSHAKE || conn->state == XRSR_BENCH_SERVER_STATE_RESPOND) {
+      return(false);
+   }
+   if(conn->state == XRSR_BENCH_SERVER_STATE_CLOSING) {
+      return(true);
+   }
+   // A lost segment stalls the connection like a TCP retransmission would
+   int64_t stall = xrsr_bench_server_ts_diff_ms(&conn->time_stall, now);
+   if(stall > 0) {
+      xrsr_bench_server_timeout_min(timeout, stall);
+      return(false);
+   }
+   if(conn->rx_len >= sizeof(conn->rx)) {
+      return(false);
+   }
+   if(obj->params.throughput > 0) {
+      double rate  = ((double)obj->params.throughput * 1000.0) / 8.0; // bytes per second
+      double burst = rate * XRSR_BENCH_SERVER_BURST_MS / 1000.0;
+      double secs  = (double)xrsr_bench_server_ts_diff_ms(now, &conn->time_refill) / 1000.0;
+
+      if(burst < XRSR_BENCH_SERVER_BURST_MIN) {
+         burst = XRSR_BENCH_SERVER_BURST_MIN;
+      }
+      if(secs > 0.0) {
+         conn->tokens += secs * rate;
+         if(conn->tokens > burst) {
+            conn->tokens = burst;
+         }
+         conn->time_refill = *now;
+      }
+      if(conn->tokens < 1.0) {
+         xrsr_bench_server_timeout_min(timeout, (int64_t)(((1.0 - conn->tokens) * 1000.0) / rate) + 1);
+         return(false);
+      }
+   }
+   return(true);
+}
+
+void xrsr_bench_server_conn_read(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   size_t space = sizeof(conn->rx) - conn->rx_len;
+   if(obj->params.throughput > 0 && conn->state != XRSR_BENCH_SERVER_STATE_CLOSING && (double)space > conn->tokens) {
+      space = (size_t)conn->tokens;
+   }
+   if(space == 0) {
+      return;
+   }
+   ssize_t rc = recv(conn->fd, &conn->rx[conn->rx_len], space, 0);
+   if(rc < 0) {
+      if(errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+         return;
+      }
+      XLOGD_ERROR("recv fd <%d> <%s>", conn->fd, strerror(errno));
+      xrsr_bench_server_conn_close(obj, conn);
+      return;
+   }
+   if(rc == 0) {
+      if(conn->state == XRSR_BENCH_SERVER_STATE_BODY && conn->type == XRSR_BENCH_SERVER_CONN_WS && conn->bytes > 0) {
+         xrsr_bench_server_conn_eos(obj, conn, now);
+      }
+      xrsr_bench_server_conn_close(obj, conn);
+      return;
+   }
+   if(conn->state == XRSR_BENCH_SERVER_STATE_CLOSING) { // discard anything the client sends after the response
+      return;
+   }
+   conn->rx_len += rc;
+   if(obj->params.throughput > 0) {
+      conn->tokens -= rc;
+   }
+   if(obj->params.loss > 0.0 && ((double)rand_r(&obj->seed) / (double)RAND_MAX) < obj->params.loss) {
+      conn->time_stall = *now;
+      xrsr_bench_server_ts_add_ms(&conn->time_stall, obj->params.loss_rto);
+   }
+   xrsr_bench_server_conn_process(obj, conn, now);
+}
+
+void xrsr_bench_server_conn_process(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   bool progress = true;
+   while(progress && conn->fd >= 0) {
+      switch(conn->state) {
+         case XRSR_BENCH_SERVER_STATE_HEADERS: {
+            progress = xrsr_bench_server_conn_headers(obj, conn);
+            if(progress) {
+               conn->state         = XRSR_BENCH_SERVER_STATE_HANDSHAKE;
+               conn->time_deadline = conn->time_accept;
+               xrsr_bench_server_ts_add_ms(&conn->time_deadline, obj->params.delay_connect);
+               if(xrsr_bench_server_ts_diff_ms(&conn->time_deadline, now) > 0) {
+                  progress = false;
+               } else if(!xrsr_bench_server_conn_handshake(obj, conn)) {
+                  progress = false;
+               }
+            }
+            break;
+         }
+         case XRSR_BENCH_SERVER_STATE_BODY: {
+            if(conn->type == XRSR_BENCH_SERVER_CONN_WS) {
+               progress = xrsr_bench_server_conn_body_ws(obj, conn, now);
+            } else {
+               progress = xrsr_bench_server_conn_body_http(obj, conn, now);
+            }
+            break;
+         }
+         default: {
+            progress = false;
+            break;
+         }
+      }
+   }
+}
+
+void xrsr_bench_server_conn_timers(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   switch(conn->state) {
+      case XRSR_BENCH_SERVER_STATE_HANDSHAKE: {
+         if(xrsr_bench_server_ts_diff_ms(&conn->time_deadline, now) <= 0) {
+            if(xrsr_bench_server_conn_handshake(obj, conn)) {
+               xrsr_bench_server_conn_process(obj, conn, now);
+            }
+         }
+         break;
+      }
+      case XRSR_BENCH_SERVER_STATE_BODY: {
+         if(conn->type == XRSR_BENCH_SERVER_CONN_WS && conn->bytes > 0) {
+            struct timespec eos = conn->time_last_rx;
+            xrsr_bench_server_ts_add_ms(&eos, obj->params.eos_idle);
+            if(xrsr_bench_server_ts_diff_ms(&eos, now) <= 0) {
+               xrsr_bench_server_conn_eos(obj, conn, now);
+            }
+         }
+         break;
+      }
+      case XRSR_BENCH_SERVER_STATE_RESPOND: {
+         if(xrsr_bench_server_ts_diff_ms(&conn->time_deadline, now) <= 0) {
+            xrsr_bench_server_conn_respond(obj, conn, now);
+         }
+         break;
+      }
+      case XRSR_BENCH_SERVER_STATE_CLOSING: {
+         if(xrsr_bench_server_ts_diff_ms(&conn->time_deadline, now) <= 0) {
+            XLOGD_WARN("fd <%d> client did not close", conn->fd);
+            xrsr_bench_server_conn_close(obj, conn);
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+bool xrsr_bench_server_conn_headers(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn) {
+   char *end = memmem(conn->rx, conn->rx_len, "\r\n\r\n", 4);
+   if(end == NULL) {
+      if(conn->rx_len >= sizeof(conn->rx)) {
+         XLOGD_ERROR("fd <%d> headers too large", conn->fd);
+         xrsr_bench_server_conn_close(obj, conn);
+      }
+      return(false);
+   }
+   uint32_t length = (end - (char *)conn->rx) + 4;
+   char     value[64];
+   char     headers[length + 1];
+
+   memcpy(headers, conn->rx, length);
+   headers[length] = '\0';
+   xrsr_bench_server_conn_consume(conn, length);
+
+   if(xrsr_bench_server_header_get(headers, "Upgrade", value, sizeof(value)) && 0 == strcasecmp(value, "websocket")) {
+      if(!xrsr_bench_server_header_get(headers, "Sec-WebSocket-Key", conn->ws_key, sizeof(conn->ws_key))) {
+         XLOGD_ERROR("fd <%d> websocket key missing", conn->fd);
+         xrsr_bench_server_conn_close(obj, conn);
+         return(false);
+      }
+      conn->type = XRSR_BENCH_SERVER_CONN_WS;
+   } else {
+      conn->type = XRSR_BENCH_SERVER_CONN_HTTP;
+      if(xrsr_bench_server_header_get(headers, "Transfer-Encoding", value, sizeof(value)) && NULL != strcasestr(value, "chunked")) {
+         conn->chunked     = true;
+         conn->chunk_state = XRSR_BENCH_SERVER_CHUNK_SIZE;
+      } else if(xrsr_bench_server_header_get(headers, "Content-Length", value, sizeof(value))) {
+         conn->content_length = strtoull(value, NULL, 10);
+      }
+   }
+   XLOGD_DEBUG("fd <%d> type <%s>", conn->fd, xrsr_bench_server_conn_str(conn->type));
+   return(true);
+}
+
+bool xrsr_bench_server_conn_handshake(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn) {
+   if(conn->type == XRSR_BENCH_SERVER_CONN_WS) {
+      char    key[sizeof(conn->ws_key) + sizeof(XRSR_BENCH_SERVER_WS_GUID)];
+      uint8_t digest[20];
+      char    accept[32];
+      char    response[256];
+
+      int length = snprintf(key, sizeof(key), "%s%s", conn->ws_key, XRSR_BENCH_SERVER_WS_GUID);
+      xrsr_bench_server_sha1((const uint8_t *)key, length, digest);
+      xrsr_bench_server_base64(digest, sizeof(digest), accept, sizeof(accept));
+
+      length = snprintf(response, sizeof(response), "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n", accept);
+      if(!xrsr_bench_server_send(conn->fd, (const uint8_t *)response, length)) {
+         xrsr_bench_server_conn_close(obj, conn);
+         return(false);
+      }
+   }
+   conn->state = XRSR_BENCH_SERVER_STATE_BODY;
+   xrsr_bench_server_event(obj, conn, XRSR_BENCH_SERVER_EVENT_CONNECTED);
+   return(true);
+}
+
+bool xrsr_bench_server_conn_body_ws(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   if(conn->ws_remaining > 0) { // data frame payload is counted and discarded without unmasking
+      uint64_t bytes = (conn->rx_len < conn->ws_remaining) ? conn->rx_len : conn->ws_remaining;
+      if(bytes == 0) {
+         return(false);
+      }
+      xrsr_bench_server_conn_consume(conn, bytes);
+      conn->ws_remaining -= bytes;
+      xrsr_bench_server_conn_payload(obj, conn, bytes, now);
+      return(true);
+   }
+   if(conn->rx_len < 2) {
+      return(false);
+   }
+   uint8_t  opcode = conn->rx[0] & 0x0F;
+   bool     masked = (conn->rx[1] & 0x80) != 0;
+   uint64_t length = conn->rx[1] & 0x7F;
+   uint32_t header = 2;
+
+   if(length == 126) {
+      if(conn->rx_len < 4) {
+         return(false);
+      }
+      length  = ((uint64_t)conn->rx[2] << 8) | conn->rx[3];
+      header += 2;
+   } else if(length == 127) {
+      if(conn->rx_len < 10) {
+         return(false);
+      }
+      length = 0;
+      for(uint32_t index = 0; index < 8; index++) {
+         length = (length << 8) | conn->rx[2 + index];
+      }
+      header += 8;
+   }
+   uint8_t mask[4] = {0};
+   if(masked) {
+      if(conn->rx_len < header + 4) {
+         return(false);
+      }
+      memcpy(mask, &conn->rx[header], sizeof(mask));
+      header += 4;
+   }
+
+   if(opcode < XRSR_BENCH_SERVER_WS_OPCODE_CLOSE) { // data or continuation frame
+      xrsr_bench_server_conn_consume(conn, header);
+      conn->ws_remaining = length;
+      if(length == 0) {
+         conn->time_last_rx = *now;
+      }
+      return(true);
+   }
+
+   // Control frames are at most 125 bytes and are processed once complete
+   if(conn->rx_len < header + length) {
+      return(false);
+   }
+   uint8_t payload[125];
+   if(length > sizeof(payload)) {
+      XLOGD_ERROR("fd <%d> invalid control frame length <%llu>", conn->fd, (unsigned long long)length);
+      xrsr_bench_server_conn_close(obj, conn);
+      return(false);
+   }
+   for(uint32_t index = 0; index < length; index++) {
+      payload[index] = conn->rx[header + index] ^ mask[index & 3];
+   }
+   xrsr_bench_server_conn_consume(conn, header + length);
+
+   switch(opcode) {
+      case XRSR_BENCH_SERVER_WS_OPCODE_CLOSE: {
+         if(conn->bytes > 0) {
+            xrsr_bench_server_conn_eos(obj, conn, now);
+         }
+         xrsr_bench_server_send_ws(conn->fd, XRSR_BENCH_SERVER_WS_OPCODE_CLOSE, payload, (length >= 2) ? 2 : 0);
+         xrsr_bench_server_conn_close(obj, conn);
+         return(false);
+      }
+      case XRSR_BENCH_SERVER_WS_OPCODE_PING: {
+         xrsr_bench_server_send_ws(conn->fd, XRSR_BENCH_SERVER_WS_OPCODE_PONG, payload, length);
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+   return(true);
+}
+
+bool xrsr_bench_server_conn_body_http(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   if(!conn->chunked) {
+      uint64_t bytes = (conn->rx_len < conn->content_length) ? conn->rx_len : conn->content_length;
+      if(bytes > 0) {
+         xrsr_bench_server_conn_consume(conn, bytes);
+         conn->content_length -= bytes;
+         xrsr_bench_server_conn_payload(obj, conn, bytes, now);
+      }
+      if(conn->content_length == 0) {
+         xrsr_bench_server_conn_eos(obj, conn, now);
+      }
+      return(false);
+   }
+
+   switch(conn->chunk_state) {
+      case XRSR_BENCH_SERVER_CHUNK_SIZE:
+      case XRSR_BENCH_SERVER_CHUNK_TRAILER: {
+         char *eol = memmem(conn->rx, conn->rx_len, "\r\n", 2);
+         if(eol == NULL) {
+            return(false);
+         }
+         uint32_t length = (eol - (char *)conn->rx) + 2;
+         if(conn->chunk_state == XRSR_BENCH_SERVER_CHUNK_TRAILER) {
+            xrsr_bench_server_conn_consume(conn, length);
+            if(length == 2) { // empty line terminates the body
+               xrsr_bench_server_conn_eos(obj, conn, now);
+               return(false);
+            }
+            return(true);
+         }
+         conn->chunk_remaining = strtoull((const char *)conn->rx, NULL, 16);
+         xrsr_bench_server_conn_consume(conn, length);
+         conn->chunk_state = (conn->chunk_remaining == 0) ? XRSR_BENCH_SERVER_CHUNK_TRAILER : XRSR_BENCH_SERVER_CHUNK_DATA;
+         return(true);
+      }
+      case XRSR_BENCH_SERVER_CHUNK_DATA: {
+         uint64_t bytes = (conn->rx_len < conn->chunk_remaining) ? conn->rx_len : conn->chunk_remaining;
+         if(bytes == 0) {
+            return(false);
+         }
+         xrsr_bench_server_conn_consume(conn, bytes);
+         conn->chunk_remaining -= bytes;
+         xrsr_bench_server_conn_payload(obj, conn, bytes, now);
+         if(conn->chunk_remaining == 0) {
+            conn->chunk_state = XRSR_BENCH_SERVER_CHUNK_CRLF;
+         }
+         return(true);
+      }
+      case XRSR_BENCH_SERVER_CHUNK_CRLF: {
+         if(conn->rx_len < 2) {
+            return(false);
+         }
+         xrsr_bench_server_conn_consume(conn, 2);
+         conn->chunk_state = XRSR_BENCH_SERVER_CHUNK_SIZE;
+         return(true);
+      }
+   }
+   return(false);
+}
+
+void xrsr_bench_server_conn_payload(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, uint64_t bytes, const struct timespec *now) {
+   bool first = (conn->bytes == 0);
+   conn->bytes       += bytes;
+   conn->time_last_rx = *now;
+   if(first) {
+      xrsr_bench_server_event(obj, conn, XRSR_BENCH_SERVER_EVENT_FIRST_BYTE);
+   }
+}
+
+void xrsr_bench_server_conn_eos(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   if(conn->state != XRSR_BENCH_SERVER_STATE_BODY) {
+      return;
+   }
+   XLOGD_DEBUG("fd <%d> eos bytes <%llu>", conn->fd, (unsigned long long)conn->bytes);
+   xrsr_bench_server_event(obj, conn, XRSR_BENCH_SERVER_EVENT_EOS);
+   conn->state         = XRSR_BENCH_SERVER_STATE_RESPOND;
+   conn->time_deadline = *now;
+   xrsr_bench_server_ts_add_ms(&conn->time_deadline, obj->params.delay_response);
+}
+
+void xrsr_bench_server_conn_respond(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, const struct timespec *now) {
+   const char *response = obj->params.response;
+   size_t      length   = strlen(response);
+   bool        result;
+
+   if(conn->type == XRSR_BENCH_SERVER_CONN_WS) {
+      uint8_t status[2] = { 1000 >> 8, 1000 & 0xFF };
+      result = xrsr_bench_server_send_ws(conn->fd, XRSR_BENCH_SERVER_WS_OPCODE_TEXT, (const uint8_t *)response, length);
+      if(result) {
+         result = xrsr_bench_server_send_ws(conn->fd, XRSR_BENCH_SERVER_WS_OPCODE_CLOSE, status, sizeof(status));
+      }
+   } else {
+      char header[128];
+      int  header_len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", length);
+      result = xrsr_bench_server_send(conn->fd, (const uint8_t *)header, header_len);
+      if(result) {
+         result = xrsr_bench_server_send(conn->fd, (const uint8_t *)response, length);
+      }
+      shutdown(conn->fd, SHUT_WR);
+   }
+   if(!result) {
+      xrsr_bench_server_conn_close(obj, conn);
+      return;
+   }
+   xrsr_bench_server_event(obj, conn, XRSR_BENCH_SERVER_EVENT_RESPONSE);
+   conn->state         = XRSR_BENCH_SERVER_STATE_CLOSING;
+   conn->time_deadline = *now;
+   xrsr_bench_server_ts_add_ms(&conn->time_deadline, XRSR_BENCH_SERVER_CLOSE_TIMEOUT);
+}
+
+void xrsr_bench_server_conn_close(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn) {
+   XLOGD_DEBUG("fd <%d> type <%s> bytes <%llu>", conn->fd, xrsr_bench_server_conn_str(conn->type), (unsigned long long)conn->bytes);
+   close(conn->fd);
+   conn->fd    = -1;
+   conn->state = XRSR_BENCH_SERVER_STATE_IDLE;
+   xrsr_bench_server_event(obj, conn, XRSR_BENCH_SERVER_EVENT_CLOSED);
+}
+
+void xrsr_bench_server_conn_consume(xrsr_bench_server_conn_obj_t *conn, uint32_t bytes) {
+   if(bytes >= conn->rx_len) {
+      conn->rx_len = 0;
+      return;
+   }
+   memmove(conn->rx, &conn->rx[bytes], conn->rx_len - bytes);
+   conn->rx_len -= bytes;
+}
+
+void xrsr_bench_server_event(xrsr_bench_server_obj_t *obj, xrsr_bench_server_conn_obj_t *conn, xrsr_bench_server_event_t event) {
+   if(obj->params.handler != NULL && conn->type != XRSR_BENCH_SERVER_CONN_INVALID) {
+      (*obj->params.handler)(obj->params.data, conn->type, event, conn->bytes);
+   }
+}
+
+bool xrsr_bench_server_send(int fd, const uint8_t *buffer, size_t length) {
+   while(length > 0) {
+      ssize_t rc = send(fd, buffer, length, MSG_NOSIGNAL);
+      if(rc < 0) {
+         if(errno == EAGAIN || errno == EWOULDBLOCK) {
+            struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+            if(poll(&pfd, 1, XRSR_BENCH_SERVER_TX_TIMEOUT) <= 0) {
+               XLOGD_ERROR("fd <%d> send timeout", fd);
+               return(false);
+            }
+            continue;
+         }
+         if(errno == EINTR) {
+            continue;
+         }
+         XLOGD_ERROR("fd <%d> send <%s>", fd, strerror(errno));
+         return(false);
+      }
+      buffer += rc;
+      length -= rc;
+   }
+   return(true);
+}
+
+bool xrsr_bench_server_send_ws(int fd, uint8_t opcode, const uint8_t *payload, size_t length) {
+   uint8_t header[10];
+   size_t  header_len = 2;
+
+   header[0] = 0x80 | opcode; // final fragment, server frames are not masked
+   if(length < 126) {
+      header[1] = length;
+   } else if(length <= 0xFFFF) {
+      header[1] = 126;
+      header[2] = length >> 8;
+      header[3] = length & 0xFF;
+      header_len += 2;
+   } else {
+      header[1] = 127;
+      for(uint32_t index = 0; index < 8; index++) {
+         header[2 + index] = ((uint64_t)length >> (56 - (index * 8))) & 0xFF;
+      }
+      header_len += 8;
+   }
+   if(!xrsr_bench_server_send(fd, header, header_len)) {
+      return(false);
+   }
+   return(length == 0 || xrsr_bench_server_send(fd, payload, length));
+}
+
+bool xrsr_bench_server_header_get(const char *headers, const char *name, char *value, size_t size) {
+   size_t      name_len = strlen(name);
+   const char *line     = strstr(headers, "\r\n"); // skip the request line
+
+   while(line != NULL) {
+      line += 2;
+      if(0 == strncasecmp(line, name, name_len) && line[name_len] == ':') {
+         const char *begin = &line[name_len + 1];
+         const char *end   = strstr(begin, "\r\n");
+         while(*begin == ' ' || *begin == '\t') {
+            begin++;
+         }
+         if(end == NULL) {
+            end = begin + strlen(begin);
+         }
+         while(end > begin && (end[-1] == ' ' || end[-1] == '\t')) {
+            end--;
+         }
+         snprintf(value, size, "%.*s", (int)(end - begin), begin);
+         return(true);
+      }
+      line = strstr(line, "\r\n");
+   }
+   return(false);
+}
+
+#define XRSR_BENCH_SERVER_ROL(value, bits) (((value) << (bits)) | ((value) >> (32 - (bits))))
+
+void xrsr_bench_server_sha1(const uint8_t *data, size_t length, uint8_t digest[20]) {
+   uint32_t h[5]   = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+   uint64_t bits   = (uint64_t)length * 8;
+   size_t   total  = ((length + 8) / 64 + 1) * 64;
+   uint8_t  block[64];
+
+   for(size_t offset = 0; offset < total; offset += 64) {
+      uint32_t w[80];
+      for(size_t index = 0; index < 64; index++) { // message, 0x80 terminator, zero padding and bit length
+         size_t pos = offset + index;
+         if(pos < length) {
+            block[index] = data[pos];
+         } else if(pos == length) {
+            block[index] = 0x80;
+         } else if(pos >= total - 8) {
+            block[index] = (bits >> ((total - 1 - pos) * 8)) & 0xFF;
+         } else {
+            block[index] = 0;
+         }
+      }
+      for(uint32_t index = 0; index < 16; index++) {
+         w[index] = ((uint32_t)block[index * 4] << 24) | ((uint32_t)block[index * 4 + 1] << 16) | ((uint32_t)block[index * 4 + 2] << 8) | block[index * 4 + 3];
+      }
+      for(uint32_t index = 16; index < 80; index++) {
+         w[index] = XRSR_BENCH_SERVER_ROL(w[index - 3] ^ w[index - 8] ^ w[index - 14] ^ w[index - 16], 1);
+      }
+      uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+      for(uint32_t index = 0; index < 80; index++) {
+         uint32_t f, k;
+         if(index < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+         } else if(index < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+         } else if(index < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+         } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+         }
+         uint32_t temp = XRSR_BENCH_SERVER_ROL(a, 5) + f + e + k + w[index];
+         e = d;
+         d = c;
+         c = XRSR_BENCH_SERVER_ROL(b, 30);
+         b = a;
+         a = temp;
+      }
+      h[0] += a;
+      h[1] += b;
+      h[2] += c;
+      h[3] += d;
+      h[4] += e;
+   }
+   for(uint32_t index = 0; index < 20; index++) {
+      digest[index] = (h[index / 4] >> (24 - (index % 4) * 8)) & 0xFF;
+   }
+}
+
+void xrsr_bench_server_base64(const uint8_t *data, size_t length, char *out, size_t size) {
+   static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+   size_t pos = 0;
+
+   for(size_t index = 0; index < length && pos + 4 < size; index += 3) {
+      uint32_t value = (uint32_t)data[index] << 16;
+      if(index + 1 < length) {
+         value |= (uint32_t)data[index + 1] << 8;
+      }
+      if(index + 2 < length) {
+         value |= data[index + 2];
+      }
+      out[pos++] = table[(value >> 18) & 0x3F];
+      out[pos++] = table[(value >> 12) & 0x3F];
+      out[pos++] = (index + 1 < length) ? table[(value >> 6) & 0x3F] : '=';
+      out[pos++] = (index + 2 < length) ? table[value & 0x3F] : '=';
+   }
+   out[pos] = '\0';
+}
+
+void xrsr_bench_server_ts_add_ms(struct timespec *ts, uint32_t ms) {
+   uint64_t nsecs = ts->tv_nsec + ((uint64_t)ms * 1000000);
+   ts->tv_sec    += nsecs / 1000000000;
+   ts->tv_nsec    = nsecs % 1000000000;
+}
+
+int64_t xrsr_bench_server_ts_diff_ms(const struct timespec *a, const struct timespec *b) {
+   return(((int64_t)(a->tv_sec - b->tv_sec) * 1000) + ((int64_t)(a->tv_nsec - b->tv_nsec) / 1000000));
+}
+
+void xrsr_bench_server_timeout_min(int *timeout, int64_t ms) {
+   if(ms < 0) {
+      ms = 0;
+   }
+   if(*timeout < 0 || ms < *timeout) {
+      *timeout = (int)ms;
+   }
+}
+
+const char *xrsr_bench_server_invalid_return(int value) {
+   static char invalid_str[XRSR_BENCH_SERVER_INVALID_STR_LEN];
+   snprintf(invalid_str, XRSR_BENCH_SERVER_INVALID_STR_LEN, "INVALID(%d)", value);
+   return(invalid_str);
+}
+
+const char *xrsr_bench_server_conn_str(xrsr_bench_server_conn_t type) {
+   switch(type) {
+      case XRSR_BENCH_SERVER_CONN_WS:      return("WS");
+      case XRSR_BENCH_SERVER_CONN_HTTP:    return("HTTP");
+      case XRSR_BENCH_SERVER_CONN_INVALID: return("INVALID");
+   }
+   return(xrsr_bench_server_invalid_return(type));
+}
+
+const char *xrsr_bench_server_event_str(xrsr_bench_server_event_t type) {
+   switch(type) {
+      case XRSR_BENCH_SERVER_EVENT_CONNECTED:  return("CONNECTED");
+      case XRSR_BENCH_SERVER_EVENT_FIRST_BYTE: return("FIRST_BYTE");
+      case XRSR_BENCH_SERVER_EVENT_EOS:        return("EOS");
+      case XRSR_BENCH_SERVER_EVENT_RESPONSE:   return("RESPONSE");
+      case XRSR_BENCH_SERVER_EVENT_CLOSED:     return("CLOSED");
+      case XRSR_BENCH_SERVER_EVENT_INVALID:    return("INVALID");
+   }
+   return(xrsr_bench_server_invalid_return(type));
+}
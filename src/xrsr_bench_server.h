@@ -0,0 +1,72 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#ifndef __XRSR_BENCH_SERVER_H__
+#define __XRSR_BENCH_SERVER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+   XRSR_BENCH_SERVER_CONN_WS      = 0, ///< Websocket connection
+   XRSR_BENCH_SERVER_CONN_HTTP    = 1, ///< HTTP connection
+   XRSR_BENCH_SERVER_CONN_INVALID = 2, ///< Connection type not determined yet
+} xrsr_bench_server_conn_t;
+
+typedef enum {
+   XRSR_BENCH_SERVER_EVENT_CONNECTED  = 0, ///< Handshake or request headers were accepted
+   XRSR_BENCH_SERVER_EVENT_FIRST_BYTE = 1, ///< First byte of audio payload was received
+   XRSR_BENCH_SERVER_EVENT_EOS        = 2, ///< End of the audio stream was detected
+   XRSR_BENCH_SERVER_EVENT_RESPONSE   = 3, ///< Response was sent to the client
+   XRSR_BENCH_SERVER_EVENT_CLOSED     = 4, ///< Connection was closed
+   XRSR_BENCH_SERVER_EVENT_INVALID    = 5, ///< An invalid event
+} xrsr_bench_server_event_t;
+
+/// @brief Server event handler
+/// @details Called in the server thread context.  The byte count is the quantity of payload received so far.
+typedef void (*xrsr_bench_server_handler_t)(void *data, xrsr_bench_server_conn_t type, xrsr_bench_server_event_t event, uint64_t bytes);
+
+/// @brief Stand-in server parameters
+/// @details Shapes the server's behavior to reproduce field conditions without a network.
+typedef struct {
+   uint16_t                    port;           ///< Listening port on 127.0.0.1 (0 selects an ephemeral port)
+   uint32_t                    delay_connect;  ///< Delay before answering the handshake or request headers (in ms)
+   uint32_t                    delay_response; ///< Delay between end of audio and the response (in ms)
+   uint32_t                    eos_idle;       ///< Websocket audio idle time which marks end of stream (in ms)
+   double                      loss;           ///< Probability (0.0 - 1.0) that an inbound segment is lost
+   uint32_t                    loss_rto;       ///< Time that a connection stalls for each lost segment (in ms)
+   uint32_t                    throughput;     ///< Inbound throughput limit (in kbit/s, 0 is unlimited)
+   unsigned int                seed;           ///< Seed for the loss generator
+   const char *                response;       ///< Response payload (NULL for the default)
+   xrsr_bench_server_handler_t handler;        ///< Optional event handler
+   void *                      data;           ///< Parameter passed to the event handler
+} xrsr_bench_server_params_t;
+
+typedef void * xrsr_bench_server_t;
+
+xrsr_bench_server_t xrsr_bench_server_create(const xrsr_bench_server_params_t *params);
+uint16_t            xrsr_bench_server_port(xrsr_bench_server_t server);
+void                xrsr_bench_server_reject(xrsr_bench_server_t server, uint32_t qty);
+void                xrsr_bench_server_destroy(xrsr_bench_server_t server);
+
+const char *        xrsr_bench_server_conn_str(xrsr_bench_server_conn_t type);
+const char *        xrsr_bench_server_event_str(xrsr_bench_server_event_t type);
+
+#endif
@@ -0,0 +1,331 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <netdb.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include "xrsr_private.h"
+
+#define XRSR_CIRCUIT_OPEN_PERIOD_MAX (300000) // limit for the open period as it doubles (in ms)
+
+typedef struct {
+   xrsr_src_t            src;
+   uint32_t              dst_index;
+   uint32_t              probe_id;
+   uint32_t              timeout;
+   xrsr_address_family_t family;
+   char *                host;
+   char *                port;
+} xrsr_circuit_probe_t;
+
+static void  xrsr_circuit_open(xrsr_circuit_t *circuit, bool backoff);
+static void  xrsr_circuit_close(xrsr_circuit_t *circuit);
+static void  xrsr_circuit_state_set(xrsr_circuit_t *circuit, xrsr_circuit_state_t state);
+static void  xrsr_circuit_timeout(void *data);
+static void  xrsr_circuit_timer_remove(xrsr_circuit_t *circuit);
+static void  xrsr_circuit_probe_start(xrsr_circuit_t *circuit);
+static void  xrsr_circuit_probe_join(xrsr_circuit_t *circuit);
+static void *xrsr_circuit_probe_thread(void *data);
+static bool  xrsr_circuit_probe_connect(const struct addrinfo *addr, uint32_t timeout);
+
+void xrsr_circuit_init(xrsr_circuit_t *circuit, xrsr_src_t src, uint32_t dst_index, rdkx_timer_object_t timer_obj, const xrsr_url_parts_t *url_parts) {
+   memset(circuit, 0, sizeof(*circuit));
+   circuit->src       = src;
+   circuit->dst_index = dst_index;
+   circuit->timer_obj = timer_obj;
+   circuit->timer_id  = RDXK_TIMER_ID_INVALID;
+   circuit->state     = XRSR_CIRCUIT_STATE_CLOSED;
+   circuit->url_parts = url_parts;
+}
+
+// Waits for a probe in progress, so that the probe doesn't post its result after the message queue is closed
+void xrsr_circuit_term(xrsr_circuit_t *circuit) {
+   xrsr_circuit_timer_remove(circuit);
+   circuit->probe_id++; // ignore the result of a probe in progress
+   xrsr_circuit_probe_join(circuit);
+   circuit->threshold = 0;
+   circuit->state     = XRSR_CIRCUIT_STATE_CLOSED;
+}
+
+void xrsr_circuit_params_set(xrsr_circuit_t *circuit, uint32_t threshold, uint32_t open_period, uint32_t timeout_probe) {
+   XLOGD_INFO("src <%s> dst index <%u> threshold <%u> open period <%u> ms probe timeout <%u> ms", xrsr_src_str(circuit->src), circuit->dst_index, threshold, open_period, timeout_probe);
+
+   circuit->threshold       = threshold;
+   circuit->open_period     = open_period;
+   circuit->open_period_cur = open_period;
+   circuit->timeout_probe   = timeout_probe;
+
+   if(threshold == 0 && circuit->state != XRSR_CIRCUIT_STATE_CLOSED) { // circuit breaker was disabled
+      xrsr_circuit_close(circuit);
+   }
+}
+
+bool xrsr_circuit_allow(xrsr_circuit_t *circuit) {
+   if(circuit->threshold == 0) {
+      return(true);
+   }
+   switch(circuit->state) {
+      case XRSR_CIRCUIT_STATE_CLOSED: {
+         return(true);
+      }
+      case XRSR_CIRCUIT_STATE_HALF_OPEN: {
+         if(!circuit->trial) { // a single session is allowed to test the destination
+            XLOGD_INFO("src <%s> dst index <%u> trial session", xrsr_src_str(circuit->src), circuit->dst_index);
+            circuit->trial = true;
+            return(true);
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+   return(false);
+}
+
+void xrsr_circuit_result(xrsr_circuit_t *circuit, const xrsr_session_stats_t *stats) {
+   if(circuit->threshold == 0 || stats == NULL) {
+      return;
+   }
+   if(stats->fast_fail || stats->fallback) { // the session did not use the destination
+      return;
+   }
+   if(stats->reason == XRSR_SESSION_END_REASON_TERMINATE || stats->reason == XRSR_SESSION_END_REASON_ERROR_AUDIO_BEGIN || stats->reason == XRSR_SESSION_END_REASON_ERROR_AUDIO_DURATION) {
+      circuit->trial = false; // not a reflection of the destination
+      return;
+   }
+   bool failure = xrsr_endpoint_is_failure(stats->reason);
+
+   switch(circuit->state) {
+      case XRSR_CIRCUIT_STATE_CLOSED: {
+         if(!failure) {
+            circuit->failure_run = 0;
+         } else if(++circuit->failure_run >= circuit->threshold) {
+            XLOGD_WARN("src <%s> dst index <%u> failures <%u> reason <%s>", xrsr_src_str(circuit->src), circuit->dst_index, circuit->failure_run, xrsr_session_end_reason_str(stats->reason));
+            xrsr_circuit_open(circuit, false);
+         }
+         break;
+      }
+      case XRSR_CIRCUIT_STATE_HALF_OPEN: {
+         circuit->trial = false;
+         if(failure) {
+            xrsr_circuit_open(circuit, true);
+         } else {
+            xrsr_circuit_close(circuit);
+         }
+         break;
+      }
+      case XRSR_CIRCUIT_STATE_OPEN: { // session began before the circuit opened
+         if(!failure) {
+            xrsr_circuit_close(circuit);
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void xrsr_circuit_probe_result(xrsr_circuit_t *circuit, uint32_t probe_id, bool result) {
+   if(probe_id != circuit->probe_id || circuit->state != XRSR_CIRCUIT_STATE_HALF_OPEN) {
+      XLOGD_DEBUG("src <%s> dst index <%u> stale probe <%u>", xrsr_src_str(circuit->src), circuit->dst_index, probe_id);
+      return;
+   }
+   XLOGD_INFO("src <%s> dst index <%u> probe <%u> result <%s>", xrsr_src_str(circuit->src), circuit->dst_index, probe_id, result ? "SUCCESS" : "FAILURE");
+
+   if(result) {
+      xrsr_circuit_close(circuit);
+   } else {
+      xrsr_circuit_open(circuit, true);
+   }
+}
+
+void xrsr_circuit_open(xrsr_circuit_t *circuit, bool backoff) {
+   if(backoff) { // destination did not recover
+      circuit->open_period_cur *= 2;
+      if(circuit->open_period_cur > XRSR_CIRCUIT_OPEN_PERIOD_MAX) {
+         circuit->open_period_cur = XRSR_CIRCUIT_OPEN_PERIOD_MAX;
+      }
+   } else {
+      circuit->open_period_cur = circuit->open_period;
+   }
+   circuit->trial = false;
+   circuit->probe_id++;
+
+   rdkx_timestamp_t timeout;
+   rdkx_timestamp_get(&timeout);
+   rdkx_timestamp_add_ms(&timeout, circuit->open_period_cur);
+
+   if(circuit->timer_id >= 0) {
+      if(!rdkx_timer_update(circuit->timer_obj, circuit->timer_id, timeout)) {
+         XLOGD_ERROR("src <%s> timer update", xrsr_src_str(circuit->src));
+      }
+   } else if(circuit->timer_obj != NULL) {
+      circuit->timer_id = rdkx_timer_insert(circuit->timer_obj, timeout, xrsr_circuit_timeout, circuit);
+   }
+
+   XLOGD_WARN("src <%s> dst index <%u> open for <%u> ms", xrsr_src_str(circuit->src), circuit->dst_index, circuit->open_period_cur);
+   xrsr_circuit_state_set(circuit, XRSR_CIRCUIT_STATE_OPEN);
+}
+
+void xrsr_circuit_close(xrsr_circuit_t *circuit) {
+   xrsr_circuit_timer_remove(circuit);
+   circuit->failure_run     = 0;
+   circuit->trial           = false;
+   circuit->open_period_cur = circuit->open_period;
+   circuit->probe_id++;
+
+   xrsr_circuit_state_set(circuit, XRSR_CIRCUIT_STATE_CLOSED);
+}
+
+void xrsr_circuit_state_set(xrsr_circuit_t *circuit, xrsr_circuit_state_t state) {
+   if(circuit->state == state) {
+      return;
+   }
+   XLOGD_INFO("src <%s> dst index <%u> state <%s> -> <%s>", xrsr_src_str(circuit->src), circuit->dst_index, xrsr_circuit_state_str(circuit->state), xrsr_circuit_state_str(state));
+   circuit->state = state;
+
+   xrsr_circuit_state_notify(circuit->src, circuit->dst_index, state);
+}
+
+void xrsr_circuit_timeout(void *data) {
+   xrsr_circuit_t *circuit = (xrsr_circuit_t *)data;
+
+   xrsr_circuit_timer_remove(circuit);
+
+   if(circuit->state != XRSR_CIRCUIT_STATE_OPEN) {
+      return;
+   }
+   xrsr_circuit_state_set(circuit, XRSR_CIRCUIT_STATE_HALF_OPEN);
+   xrsr_circuit_probe_start(circuit);
+}
+
+void xrsr_circuit_timer_remove(xrsr_circuit_t *circuit) {
+   if(circuit->timer_obj != NULL && circuit->timer_id >= 0) {
+      if(!rdkx_timer_remove(circuit->timer_obj, circuit->timer_id)) {
+         XLOGD_ERROR("src <%s> timer remove", xrsr_src_str(circuit->src));
+      }
+   }
+   circuit->timer_id = RDXK_TIMER_ID_INVALID;
+}
+
+// The probe resolves and connects to the destination in a thread so the xrsr thread is not blocked.  The result is
+// returned in a message which is discarded if the circuit has changed state since the probe started.  The thread is
+// joined before the next probe starts or when the circuit is terminated.
+void xrsr_circuit_probe_start(xrsr_circuit_t *circuit) {
+   if(circuit->url_parts == NULL || circuit->url_parts->host == NULL) {
+      XLOGD_ERROR("src <%s> no destination to probe", xrsr_src_str(circuit->src));
+      return;
+   }
+   xrsr_circuit_probe_join(circuit); // the previous probe ended within its timeout unless it is still resolving
+   xrsr_circuit_probe_t *probe = (xrsr_circuit_probe_t *)malloc(sizeof(xrsr_circuit_probe_t));
+   if(probe == NULL) {
+      XLOGD_ERROR("src <%s> out of memory", xrsr_src_str(circuit->src));
+      return;
+   }
+   probe->src       = circuit->src;
+   probe->dst_index = circuit->dst_index;
+   probe->probe_id  = ++circuit->probe_id;
+   probe->timeout   = circuit->timeout_probe;
+   probe->family    = circuit->url_parts->family;
+   probe->host      = strdup(circuit->url_parts->host);
+   probe->port      = strdup(circuit->url_parts->port_str);
+
+   if(probe->host == NULL || probe->port == NULL || 0 != pthread_create(&circuit->probe_thread, NULL, xrsr_circuit_probe_thread, probe)) {
+      XLOGD_ERROR("src <%s> unable to start probe", xrsr_src_str(circuit->src));
+      free(probe->host);
+      free(probe->port);
+      free(probe);
+   } else {
+      circuit->probe_started = true;
+      XLOGD_INFO("src <%s> dst index <%u> probe <%u> host <%s> port <%s>", xrsr_src_str(circuit->src), circuit->dst_index, circuit->probe_id, xrsr_mask_pii() ? "***" : circuit->url_parts->host, circuit->url_parts->port_str);
+   }
+}
+
+void xrsr_circuit_probe_join(xrsr_circuit_t *circuit) {
+   if(!circuit->probe_started) {
+      return;
+   }
+   pthread_join(circuit->probe_thread, NULL);
+   circuit->probe_started = false;
+}
+
+void *xrsr_circuit_probe_thread(void *data) {
+   xrsr_circuit_probe_t *probe = (xrsr_circuit_probe_t *)data;
+   struct addrinfo       hints;
+   struct addrinfo *     addrs = NULL;
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = (probe->family == XRSR_ADDRESS_FAMILY_IPV4) ? AF_INET : (probe->family == XRSR_ADDRESS_FAMILY_IPV6) ? AF_INET6 : AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+
+   xrsr_queue_msg_circuit_probe_t msg;
+   msg.header.type = XRSR_QUEUE_MSG_TYPE_CIRCUIT_PROBE;
+   msg.src         = probe->src;
+   msg.dst_index   = probe->dst_index;
+   msg.probe_id    = probe->probe_id;
+   msg.result      = false;
+
+   int rc = getaddrinfo(probe->host, probe->port, &hints, &addrs);
+   if(rc != 0) {
+      XLOGD_WARN("probe <%u> getaddrinfo <%s>", probe->probe_id, gai_strerror(rc));
+   } else {
+      for(struct addrinfo *addr = addrs; addr != NULL && !msg.result; addr = addr->ai_next) {
+         msg.result = xrsr_circuit_probe_connect(addr, probe->timeout);
+      }
+      freeaddrinfo(addrs);
+   }
+
+   xrsr_queue_msg_push(xrsr_msgq_fd_get(), (const char *)&msg, sizeof(msg));
+
+   free(probe->host);
+   free(probe->port);
+   free(probe);
+   return(NULL);
+}
+
+bool xrsr_circuit_probe_connect(const struct addrinfo *addr, uint32_t timeout) {
+   int fd = socket(addr->ai_family, addr->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, addr->ai_protocol);
+   if(fd < 0) {
+      return(false);
+   }
+   bool result = false;
+   if(connect(fd, addr->ai_addr, addr->ai_addrlen) == 0) {
+      result = true;
+   } else if(errno == EINPROGRESS) {
+      struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+      if(poll(&pfd, 1, timeout) == 1) {
+         int       error = 0;
+         socklen_t len   = sizeof(error);
+         if(getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+            result = true;
+         }
+      }
+   }
+   close(fd);
+   return(result);
+}
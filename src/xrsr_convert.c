@@ -0,0 +1,329 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "xrsr_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XRSR_CONVERT_X86
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define XRSR_CONVERT_NEON
+#endif
+
+#define XRSR_CONVERT_GAIN_MAX     (30.0)    // gain is limited to +/- this value (in dB)
+
+// Audio samples are converted to float, scaled and rounded to nearest even.  Each kernel performs the same operations
+// in the same order so that their output is identical.
+typedef void (*xrsr_convert_func_t)(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+
+typedef struct {
+   xrsr_convert_kernel_t kernel;
+   uint32_t              channel_qty;
+   int32_t               channel;
+   float                 scale;
+} xrsr_convert_stage_t;
+
+static void  xrsr_convert_scalar(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+#ifdef XRSR_CONVERT_X86
+static void  xrsr_convert_sse2(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+static void  xrsr_convert_avx2(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+#endif
+#ifdef XRSR_CONVERT_NEON
+static void  xrsr_convert_neon(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+#endif
+static bool  xrsr_convert_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out);
+static void  xrsr_convert_stage_close(void *data);
+
+bool xrsr_convert_kernel_available(xrsr_convert_kernel_t kernel) {
+   switch(kernel) {
+      case XRSR_CONVERT_KERNEL_SCALAR: return(true);
+      #ifdef XRSR_CONVERT_X86
+      case XRSR_CONVERT_KERNEL_SSE2:   return(__builtin_cpu_supports("sse2"));
+      case XRSR_CONVERT_KERNEL_AVX2:   return(__builtin_cpu_supports("avx2"));
+      #endif
+      #ifdef XRSR_CONVERT_NEON
+      case XRSR_CONVERT_KERNEL_NEON:   return(true);
+      #endif
+      default: break;
+   }
+   return(false);
+}
+
+xrsr_convert_kernel_t xrsr_convert_kernel_best(void) {
+   if(xrsr_convert_kernel_available(XRSR_CONVERT_KERNEL_NEON)) {
+      return(XRSR_CONVERT_KERNEL_NEON);
+   }
+   if(xrsr_convert_kernel_available(XRSR_CONVERT_KERNEL_AVX2)) {
+      return(XRSR_CONVERT_KERNEL_AVX2);
+   }
+   if(xrsr_convert_kernel_available(XRSR_CONVERT_KERNEL_SSE2)) {
+      return(XRSR_CONVERT_KERNEL_SSE2);
+   }
+   return(XRSR_CONVERT_KERNEL_SCALAR);
+}
+
+// Full scale 32-bit samples are scaled to 16-bit with the gain applied
+float xrsr_convert_scale(float gain_db) {
+   if(gain_db > XRSR_CONVERT_GAIN_MAX) {
+      gain_db = XRSR_CONVERT_GAIN_MAX;
+   } else if(gain_db < -XRSR_CONVERT_GAIN_MAX) {
+      gain_db = -XRSR_CONVERT_GAIN_MAX;
+   }
+   return(powf(10.0f, gain_db / 20.0f) / 65536.0f);
+}
+
+// Converts interleaved 32-bit frames to mono 16-bit.  A channel less than zero averages all of the channels.
+void xrsr_convert_s32_to_s16(xrsr_convert_kernel_t kernel, const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty) {
+   xrsr_convert_func_t func = xrsr_convert_scalar;
+   switch(kernel) {
+      #ifdef XRSR_CONVERT_X86
+      case XRSR_CONVERT_KERNEL_SSE2: func = xrsr_convert_sse2; break;
+      case XRSR_CONVERT_KERNEL_AVX2: func = xrsr_convert_avx2; break;
+      #endif
+      #ifdef XRSR_CONVERT_NEON
+      case XRSR_CONVERT_KERNEL_NEON: func = xrsr_convert_neon; break;
+      #endif
+      default: break;
+   }
+   if(channel < 0 && channel_qty > 1) {
+      scale /= channel_qty;
+   } else if(channel < 0 || (uint32_t)channel >= channel_qty) {
+      channel = 0;
+   }
+   (*func)(in, channel_qty, channel, scale, out, frame_qty);
+}
+
+static inline int16_t xrsr_convert_sample(float value) {
+   long sample = lrintf(value);
+   if(sample > INT16_MAX) {
+      return(INT16_MAX);
+   } else if(sample < INT16_MIN) {
+      return(INT16_MIN);
+   }
+   return((int16_t)sample);
+}
+
+void xrsr_convert_scalar(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty) {
+   for(uint32_t frame = 0; frame < frame_qty; frame++, in += channel_qty) {
+      float value;
+      if(channel < 0) {
+         value = (float)in[0];
+         for(uint32_t chan = 1; chan < channel_qty; chan++) {
+            value += (float)in[chan];
+         }
+      } else {
+         value = (float)in[channel];
+      }
+      out[frame] = xrsr_convert_sample(value * scale);
+   }
+}
+
+#ifdef XRSR_CONVERT_X86
+// Four frames of one channel, or of all channels summed
+__attribute__((target("sse2")))
+static inline __m128 xrsr_convert_sse2_load(const int32_t *in, uint32_t channel_qty, int32_t channel) {
+   if(channel_qty == 1) {
+      return(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)in)));
+   }
+   if(channel_qty == 4) {
+      __m128 r0 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&in[0]));
+      __m128 r1 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&in[4]));
+      __m128 r2 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&in[8]));
+      __m128 r3 = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)&in[12]));
+      _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+      switch(channel) {
+         case 0:  return(r0);
+         case 1:  return(r1);
+         case 2:  return(r2);
+         case 3:  return(r3);
+         default: return(_mm_add_ps(_mm_add_ps(_mm_add_ps(r0, r1), r2), r3));
+      }
+   }
+   if(channel >= 0) {
+      const int32_t *src = &in[channel];
+      return(_mm_cvtepi32_ps(_mm_set_epi32(src[3 * channel_qty], src[2 * channel_qty], src[channel_qty], src[0])));
+   }
+   __m128 sum = _mm_cvtepi32_ps(_mm_set_epi32(in[3 * channel_qty], in[2 * channel_qty], in[channel_qty], in[0]));
+   for(uint32_t chan = 1; chan < channel_qty; chan++) {
+      const int32_t *src = &in[chan];
+      sum = _mm_add_ps(sum, _mm_cvtepi32_ps(_mm_set_epi32(src[3 * channel_qty], src[2 * channel_qty], src[channel_qty], src[0])));
+   }
+   return(sum);
+}
+
+__attribute__((target("sse2")))
+void xrsr_convert_sse2(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty) {
+   __m128   scale_v = _mm_set1_ps(scale);
+   uint32_t frame   = 0;
+
+   for(; frame + 8 <= frame_qty; frame += 8) {
+      __m128i lo = _mm_cvtps_epi32(_mm_mul_ps(xrsr_convert_sse2_load(&in[frame * channel_qty], channel_qty, channel), scale_v));
+      __m128i hi = _mm_cvtps_epi32(_mm_mul_ps(xrsr_convert_sse2_load(&in[(frame + 4) * channel_qty], channel_qty, channel), scale_v));
+      _mm_storeu_si128((__m128i *)&out[frame], _mm_packs_epi32(lo, hi)); // saturates to 16-bit
+   }
+   xrsr_convert_scalar(&in[frame * channel_qty], channel_qty, channel, scale, &out[frame], frame_qty - frame);
+}
+
+// Eight frames of one channel, or of all channels summed
+__attribute__((target("avx2")))
+static inline __m256 xrsr_convert_avx2_load(const int32_t *in, __m256i index, uint32_t channel_qty, int32_t channel) {
+   if(channel_qty == 1) {
+      return(_mm256_cvtepi32_ps(_mm256_loadu_si256((const __m256i *)in)));
+   }
+   if(channel >= 0) {
+      return(_mm256_cvtepi32_ps(_mm256_i32gather_epi32((const int *)&in[channel], index, 4)));
+   }
+   __m256 sum = _mm256_cvtepi32_ps(_mm256_i32gather_epi32((const int *)in, index, 4));
+   for(uint32_t chan = 1; chan < channel_qty; chan++) {
+      sum = _mm256_add_ps(sum, _mm256_cvtepi32_ps(_mm256_i32gather_epi32((const int *)&in[chan], index, 4)));
+   }
+   return(sum);
+}
+
+__attribute__((target("avx2")))
+void xrsr_convert_avx2(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty) {
+   __m256   scale_v = _mm256_set1_ps(scale);
+   __m256i  index   = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channel_qty));
+   uint32_t frame   = 0;
+
+   for(; frame + 16 <= frame_qty; frame += 16) {
+      __m256i lo = _mm256_cvtps_epi32(_mm256_mul_ps(xrsr_convert_avx2_load(&in[frame * channel_qty], index, channel_qty, channel), scale_v));
+      __m256i hi = _mm256_cvtps_epi32(_mm256_mul_ps(xrsr_convert_avx2_load(&in[(frame + 8) * channel_qty], index, channel_qty, channel), scale_v));
+      // The pack operates on each 128-bit lane, so restore the frame order afterwards
+      __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+      _mm256_storeu_si256((__m256i *)&out[frame], packed);
+   }
+   xrsr_convert_scalar(&in[frame * channel_qty], channel_qty, channel, scale, &out[frame], frame_qty - frame);
+}
+#endif
+
+#ifdef XRSR_CONVERT_NEON
+static inline int32x4_t xrsr_convert_neon_round(float32x4_t value) {
+   #ifdef __aarch64__
+   return(vcvtnq_s32_f32(value));
+   #else
+   // Adding 1.5 * 2^23 rounds to nearest even for values within +/- 2^22, which holds for the limited gain
+   const float32x4_t magic = vdupq_n_f32(12582912.0f);
+   return(vcvtq_s32_f32(vsubq_f32(vaddq_f32(value, magic), magic)));
+   #endif
+}
+
+// Four frames of one channel, or of all channels summed.  Interleaved channels are separated by the structured loads.
+static inline float32x4_t xrsr_convert_neon_load(const int32_t *in, uint32_t channel_qty, int32_t channel, bool *ok) {
+   *ok = true;
+   switch(channel_qty) {
+      case 1: {
+         return(vcvtq_f32_s32(vld1q_s32(in)));
+      }
+      case 2: {
+         int32x4x2_t v = vld2q_s32(in);
+         if(channel >= 0) {
+            return(vcvtq_f32_s32(v.val[channel]));
+         }
+         return(vaddq_f32(vcvtq_f32_s32(v.val[0]), vcvtq_f32_s32(v.val[1])));
+      }
+      case 3: {
+         int32x4x3_t v = vld3q_s32(in);
+         if(channel >= 0) {
+            return(vcvtq_f32_s32(v.val[channel]));
+         }
+         return(vaddq_f32(vaddq_f32(vcvtq_f32_s32(v.val[0]), vcvtq_f32_s32(v.val[1])), vcvtq_f32_s32(v.val[2])));
+      }
+      case 4: {
+         int32x4x4_t v = vld4q_s32(in);
+         if(channel >= 0) {
+            return(vcvtq_f32_s32(v.val[channel]));
+         }
+         return(vaddq_f32(vaddq_f32(vaddq_f32(vcvtq_f32_s32(v.val[0]), vcvtq_f32_s32(v.val[1])), vcvtq_f32_s32(v.val[2])), vcvtq_f32_s32(v.val[3])));
+      }
+      default: {
+         break;
+      }
+   }
+   *ok = false;
+   return(vdupq_n_f32(0.0f));
+}
+
+void xrsr_convert_neon(const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty) {
+   uint32_t frame = 0;
+
+   for(; frame + 8 <= frame_qty; frame += 8) {
+      bool ok_lo, ok_hi;
+      float32x4_t lo = xrsr_convert_neon_load(&in[frame * channel_qty], channel_qty, channel, &ok_lo);
+      float32x4_t hi = xrsr_convert_neon_load(&in[(frame + 4) * channel_qty], channel_qty, channel, &ok_hi);
+      if(!ok_lo || !ok_hi) { // no structured load for this many channels
+         break;
+      }
+      int16x4_t lo_s16 = vqmovn_s32(xrsr_convert_neon_round(vmulq_n_f32(lo, scale))); // saturates to 16-bit
+      int16x4_t hi_s16 = vqmovn_s32(xrsr_convert_neon_round(vmulq_n_f32(hi, scale)));
+      vst1q_s16(&out[frame], vcombine_s16(lo_s16, hi_s16));
+   }
+   xrsr_convert_scalar(&in[frame * channel_qty], channel_qty, channel, scale, &out[frame], frame_qty - frame);
+}
+#endif
+
+// Creates a stage which converts multi-channel 32-bit audio from xraudio to single channel 16-bit audio
+bool xrsr_convert_stage_create(xrsr_stage_t *stage, const xrsr_convert_params_t *params) {
+   if(stage == NULL || params == NULL || params->channel_qty == 0 || params->channel_qty > XRAUDIO_INPUT_MAX_CHANNEL_QTY) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   xrsr_convert_stage_t *obj = (xrsr_convert_stage_t *)malloc(sizeof(xrsr_convert_stage_t));
+   if(obj == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   obj->kernel      = xrsr_convert_kernel_best();
+   obj->channel_qty = params->channel_qty;
+   obj->channel     = params->channel;
+   obj->scale       = xrsr_convert_scale(params->gain_db);
+
+   XLOGD_INFO("kernel <%s> channels <%u> channel <%d> gain <%.1f> dB", xrsr_convert_kernel_str(obj->kernel), obj->channel_qty, obj->channel, params->gain_db);
+
+   memset(stage, 0, sizeof(*stage));
+   stage->name    = "convert";
+   stage->data    = obj;
+   stage->process = xrsr_convert_stage_process;
+   stage->close   = xrsr_convert_stage_close;
+   return(true);
+}
+
+bool xrsr_convert_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out) {
+   xrsr_convert_stage_t *obj = (xrsr_convert_stage_t *)data;
+   uint32_t frame_qty = in->size / (obj->channel_qty * sizeof(int32_t));
+
+   if(frame_qty * sizeof(int16_t) > out->capacity) {
+      XLOGD_ERROR("frame qty <%u> exceeds capacity <%u>", frame_qty, out->capacity);
+      return(false);
+   }
+   xrsr_convert_s32_to_s16(obj->kernel, (const int32_t *)in->buffer, obj->channel_qty, obj->channel, obj->scale, (int16_t *)out->buffer, frame_qty);
+   out->size = frame_qty * sizeof(int16_t);
+   return(true);
+}
+
+void xrsr_convert_stage_close(void *data) {
+   free(data);
+}
@@ -0,0 +1,203 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <opus/opus.h>
+#include "xrsr_private.h"
+
+#define XRSR_ENCODER_PACKET_SIZE_MAX (1276)  // largest opus packet for a single frame
+
+typedef struct {
+   OpusEncoder * opus;
+   uint32_t      frame_bytes_in;  // PCM bytes per encoded frame
+   uint32_t      frame_bytes_out; // constant bitrate packet size
+   uint32_t      buffered;        // PCM bytes waiting for a complete frame
+   uint8_t *     pcm;
+} xrsr_encoder_t;
+
+static bool xrsr_encoder_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out);
+static bool xrsr_encoder_stage_flush(void *data, xrsr_frame_t *out);
+static void xrsr_encoder_stage_close(void *data);
+static bool xrsr_encoder_frame(xrsr_encoder_t *encoder, const uint8_t *pcm, xrsr_frame_t *out);
+static bool xrsr_encoder_params_valid(const xrsr_encoder_config_t *config, uint32_t sample_rate);
+
+// Encoding is only possible when xraudio provides PCM
+bool xrsr_encoder_supported(xrsr_audio_format_t native) {
+   switch(native) {
+      case XRSR_AUDIO_FORMAT_PCM:
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT:
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI:
+      case XRSR_AUDIO_FORMAT_PCM_RAW: {
+         return(true);
+      }
+      default: {
+         break;
+      }
+   }
+   return(false);
+}
+
+// Returns the lowest sample rate supported by opus which is at least the requested rate
+uint32_t xrsr_encoder_sample_rate(uint32_t sample_rate) {
+   static const uint32_t rates[] = { 8000, 12000, 16000, 24000, 48000 };
+   for(uint32_t index = 0; index < sizeof(rates) / sizeof(rates[0]); index++) {
+      if(sample_rate <= rates[index]) {
+         return(rates[index]);
+      }
+   }
+   return(rates[sizeof(rates) / sizeof(rates[0]) - 1]);
+}
+
+// Creates a stage which encodes 16-bit mono PCM to constant bitrate opus packets (XRSR_AUDIO_FORMAT_OPUS_CBR), so the
+// protocol can send them without framing.
+bool xrsr_encoder_stage_create(xrsr_stage_t *stage, const xrsr_encoder_config_t *config, uint32_t sample_rate) {
+   if(stage == NULL || config == NULL) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   if(!xrsr_encoder_params_valid(config, sample_rate)) {
+      XLOGD_ERROR("invalid config bitrate <%u> frame duration <%u> sample rate <%u>", config->bitrate, config->frame_duration, sample_rate);
+      return(false);
+   }
+
+   xrsr_encoder_t *obj = (xrsr_encoder_t *)malloc(sizeof(xrsr_encoder_t));
+   if(obj == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   memset(obj, 0, sizeof(*obj));
+   obj->frame_bytes_in  = (sample_rate * config->frame_duration / 1000) * sizeof(int16_t);
+   obj->frame_bytes_out = (config->bitrate * config->frame_duration) / 8000;
+   obj->pcm             = (uint8_t *)malloc(obj->frame_bytes_in);
+   if(obj->pcm == NULL) {
+      XLOGD_ERROR("out of memory");
+      free(obj);
+      return(false);
+   }
+
+   int error = OPUS_OK;
+   obj->opus = opus_encoder_create(sample_rate, 1, OPUS_APPLICATION_VOIP, &error);
+   if(obj->opus == NULL || error != OPUS_OK) {
+      XLOGD_ERROR("opus encoder create <%s>", opus_strerror(error));
+      free(obj->pcm);
+      free(obj);
+      return(false);
+   }
+   // Hard constant bitrate keeps every packet the same size
+   opus_encoder_ctl(obj->opus, OPUS_SET_BITRATE(config->bitrate));
+   opus_encoder_ctl(obj->opus, OPUS_SET_VBR(0));
+   opus_encoder_ctl(obj->opus, OPUS_SET_COMPLEXITY(config->complexity));
+   opus_encoder_ctl(obj->opus, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+
+   XLOGD_INFO("bitrate <%u> frame duration <%u> ms complexity <%u> packet size <%u>", config->bitrate, config->frame_duration, config->complexity, obj->frame_bytes_out);
+
+   memset(stage, 0, sizeof(*stage));
+   stage->name    = "encode";
+   stage->data    = obj;
+   stage->process = xrsr_encoder_stage_process;
+   stage->flush   = xrsr_encoder_stage_flush;
+   stage->close   = xrsr_encoder_stage_close;
+   return(true);
+}
+
+bool xrsr_encoder_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out) {
+   xrsr_encoder_t *encoder = (xrsr_encoder_t *)data;
+   const uint8_t * pcm     = in->buffer;
+   uint32_t        size    = in->size;
+
+   while(size > 0) {
+      if(encoder->buffered == 0 && size >= encoder->frame_bytes_in) { // encode directly from the input
+         if(!xrsr_encoder_frame(encoder, pcm, out)) {
+            return(false);
+         }
+         pcm  += encoder->frame_bytes_in;
+         size -= encoder->frame_bytes_in;
+         continue;
+      }
+      uint32_t qty = encoder->frame_bytes_in - encoder->buffered;
+      if(qty > size) {
+         qty = size;
+      }
+      memcpy(&encoder->pcm[encoder->buffered], pcm, qty);
+      encoder->buffered += qty;
+      pcm               += qty;
+      size              -= qty;
+
+      if(encoder->buffered == encoder->frame_bytes_in) {
+         encoder->buffered = 0;
+         if(!xrsr_encoder_frame(encoder, encoder->pcm, out)) {
+            return(false);
+         }
+      }
+   }
+   return(true);
+}
+
+// Pad the last frame with silence
+bool xrsr_encoder_stage_flush(void *data, xrsr_frame_t *out) {
+   xrsr_encoder_t *encoder = (xrsr_encoder_t *)data;
+   if(encoder->buffered == 0) {
+      return(true);
+   }
+   memset(&encoder->pcm[encoder->buffered], 0, encoder->frame_bytes_in - encoder->buffered);
+   encoder->buffered = 0;
+   return(xrsr_encoder_frame(encoder, encoder->pcm, out));
+}
+
+void xrsr_encoder_stage_close(void *data) {
+   xrsr_encoder_t *encoder = (xrsr_encoder_t *)data;
+   opus_encoder_destroy(encoder->opus);
+   free(encoder->pcm);
+   free(encoder);
+}
+
+bool xrsr_encoder_frame(xrsr_encoder_t *encoder, const uint8_t *pcm, xrsr_frame_t *out) {
+   if(out->size + encoder->frame_bytes_out > out->capacity) {
+      XLOGD_ERROR("packet exceeds capacity <%u>", out->capacity);
+      return(false);
+   }
+   opus_int32 rc = opus_encode(encoder->opus, (const opus_int16 *)pcm, encoder->frame_bytes_in / sizeof(int16_t), &out->buffer[out->size], encoder->frame_bytes_out);
+   if(rc < 0) {
+      XLOGD_ERROR("opus encode <%s>", opus_strerror(rc));
+      return(false);
+   }
+   if(rc < (opus_int32)encoder->frame_bytes_out && opus_packet_pad(&out->buffer[out->size], rc, encoder->frame_bytes_out) != OPUS_OK) { // keep every packet the same size
+      XLOGD_ERROR("opus packet pad");
+      return(false);
+   }
+   out->size += encoder->frame_bytes_out;
+   return(true);
+}
+
+bool xrsr_encoder_params_valid(const xrsr_encoder_config_t *config, uint32_t sample_rate) {
+   if(xrsr_encoder_sample_rate(sample_rate) != sample_rate) {
+      return(false);
+   }
+   switch(config->frame_duration) {
+      case 10: case 20: case 40: case 60: break;
+      default: return(false);
+   }
+   if(config->bitrate < 6000 || config->bitrate > 510000 || config->complexity > 10) {
+      return(false);
+   }
+   return((config->bitrate * config->frame_duration) / 8000 <= XRSR_ENCODER_PACKET_SIZE_MAX);
+}
@@ -0,0 +1,34 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#ifndef __XRSR_ENCODER_H__
+#define __XRSR_ENCODER_H__
+
+typedef struct {
+   uint32_t bitrate;        // in bits per second
+   uint32_t frame_duration; // 10, 20, 40 or 60 (in milliseconds)
+   uint32_t complexity;     // 0 to 10
+} xrsr_encoder_config_t;
+
+bool     xrsr_encoder_supported(xrsr_audio_format_t native);
+uint32_t xrsr_encoder_sample_rate(uint32_t sample_rate);
+bool     xrsr_encoder_stage_create(xrsr_stage_t *stage, const xrsr_encoder_config_t *config, uint32_t sample_rate);
+
+#endif
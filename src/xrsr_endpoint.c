@@ -0,0 +1,203 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "xrsr_private.h"
+
+#define XRSR_ENDPOINT_EWMA_WEIGHT       (0.2)   // weight of the most recent session in the moving averages
+#define XRSR_ENDPOINT_FAILURE_PENALTY   (5.0)   // score penalty for an endpoint which always fails (in seconds)
+#define XRSR_ENDPOINT_EXPLORE_INTERVAL  (10)    // every Nth selection uses the least recently selected endpoint
+#define XRSR_ENDPOINT_FAILURE_RUN_MAX   (3)     // consecutive failures after which an endpoint is unhealthy
+#define XRSR_ENDPOINT_SKIP_PERIOD       (30000) // time that an unhealthy endpoint is skipped (in ms, doubles on each failed probe)
+#define XRSR_ENDPOINT_SKIP_PERIOD_MAX   (480000)
+
+static double xrsr_endpoint_score(const xrsr_endpoint_t *endpoint);
+static double xrsr_endpoint_average(double average, double value, bool first);
+
+bool xrsr_endpoint_pool_init(xrsr_endpoint_pool_t *pool, const char *url, const char **urls) {
+   memset(pool, 0, sizeof(*pool));
+
+   if(!xrsr_url_parse(url, &pool->endpoints[0].url_parts)) {
+      XLOGD_ERROR("invalid url <%s>", url);
+      return(false);
+   }
+   pool->qty = 1;
+
+   while(urls != NULL && *urls != NULL) {
+      xrsr_endpoint_t *endpoint = &pool->endpoints[pool->qty];
+
+      if(pool->qty >= XRSR_ENDPOINT_QTY_MAX) {
+         XLOGD_WARN("maximum endpoints reached <%u>", XRSR_ENDPOINT_QTY_MAX);
+         break;
+      }
+      if(!xrsr_url_parse(*urls, &endpoint->url_parts)) {
+         XLOGD_ERROR("invalid url <%s>", *urls);
+      } else if(!xrsr_endpoint_prot_match(endpoint->url_parts.prot, pool->endpoints[0].url_parts.prot)) {
+         XLOGD_ERROR("protocol mismatch <%s> url <%s>", xrsr_protocol_str(endpoint->url_parts.prot), *urls);
+         xrsr_url_free(&endpoint->url_parts);
+      } else {
+         pool->qty++;
+      }
+      urls++;
+   }
+   return(true);
+}
+
+void xrsr_endpoint_pool_free(xrsr_endpoint_pool_t *pool) {
+   for(uint32_t index = 0; index < pool->qty; index++) {
+      xrsr_url_free(&pool->endpoints[index].url_parts);
+   }
+   pool->qty   = 0;
+   pool->index = 0;
+}
+
+xrsr_url_parts_t *xrsr_endpoint_select(xrsr_endpoint_pool_t *pool) {
+   pool->index = 0;
+   if(pool->qty <= 1) {
+      return(&pool->endpoints[0].url_parts);
+   }
+
+   rdkx_timestamp_t now;
+   rdkx_timestamp_get(&now);
+
+   pool->selection_cnt++;
+
+   int32_t best     = -1;
+   int32_t stale    = -1;
+   int32_t recovery = -1;
+   double  best_score = 0.0;
+
+   for(uint32_t index = 0; index < pool->qty; index++) {
+      xrsr_endpoint_t *endpoint = &pool->endpoints[index];
+
+      if(endpoint->failure_run >= XRSR_ENDPOINT_FAILURE_RUN_MAX && rdkx_timestamp_cmp(now, endpoint->skip_until) < 0) { // unhealthy
+         if(recovery < 0 || rdkx_timestamp_cmp(endpoint->skip_until, pool->endpoints[recovery].skip_until) < 0) {
+            recovery = index;
+         }
+         continue;
+      }
+      double score = xrsr_endpoint_score(endpoint);
+      if(best < 0 || score < best_score) {
+         best       = index;
+         best_score = score;
+      }
+      if(stale < 0 || endpoint->selected_last < pool->endpoints[stale].selected_last) {
+         stale = index;
+      }
+   }
+
+   if(best < 0) { // all endpoints are unhealthy so use the one which is probed soonest
+      best = recovery;
+   } else if((pool->selection_cnt % XRSR_ENDPOINT_EXPLORE_INTERVAL) == 0) { // periodically refresh the estimates of the other endpoints
+      best = stale;
+   }
+
+   xrsr_endpoint_t *endpoint = &pool->endpoints[best];
+   endpoint->selected_last   = pool->selection_cnt;
+   pool->index               = best;
+
+   XLOGD_INFO("endpoint <%d> url <%s> sessions <%u> connect <%.3f> response <%.3f> failure rate <%.2f>", best, xrsr_mask_pii() ? "***" : endpoint->url_parts.urle, endpoint->session_qty, endpoint->time_connect, endpoint->time_response, endpoint->failure_rate);
+
+   return(&endpoint->url_parts);
+}
+
+void xrsr_endpoint_result(xrsr_endpoint_pool_t *pool, const xrsr_session_stats_t *stats) {
+   if(pool->qty <= 1 || pool->index >= pool->qty || stats == NULL) {
+      return;
+   }
+   if(stats->hedge_won || stats->fallback || stats->fast_fail) { // the session did not use the selected endpoint
+      return;
+   }
+   if(stats->reason == XRSR_SESSION_END_REASON_TERMINATE || stats->reason == XRSR_SESSION_END_REASON_ERROR_AUDIO_BEGIN || stats->reason == XRSR_SESSION_END_REASON_ERROR_AUDIO_DURATION) {
+      return; // not a reflection of the endpoint
+   }
+   xrsr_endpoint_t *endpoint = &pool->endpoints[pool->index];
+   bool failure = xrsr_endpoint_is_failure(stats->reason);
+   bool first   = (endpoint->session_qty == 0);
+
+   endpoint->failure_rate = xrsr_endpoint_average(endpoint->failure_rate, failure ? 1.0 : 0.0, first);
+
+   if(failure) {
+      endpoint->failure_run++;
+      if(endpoint->failure_run >= XRSR_ENDPOINT_FAILURE_RUN_MAX) {
+         uint32_t shift  = endpoint->failure_run - XRSR_ENDPOINT_FAILURE_RUN_MAX;
+         uint32_t period = XRSR_ENDPOINT_SKIP_PERIOD_MAX;
+         if(shift < 4) {
+            period = XRSR_ENDPOINT_SKIP_PERIOD << shift;
+         }
+         rdkx_timestamp_get(&endpoint->skip_until);
+         rdkx_timestamp_add_ms(&endpoint->skip_until, period);
+         XLOGD_WARN("endpoint <%u> unhealthy - failures <%u> skip <%u> ms", pool->index, endpoint->failure_run, period);
+      }
+   } else {
+      endpoint->failure_run = 0;
+      if(stats->time_connect > 0.0) {
+         endpoint->time_connect = xrsr_endpoint_average(endpoint->time_connect, stats->time_connect, first);
+      }
+      if(stats->time_response > 0.0) {
+         endpoint->time_response = xrsr_endpoint_average(endpoint->time_response, stats->time_response, first);
+      }
+   }
+   endpoint->session_qty++;
+
+   XLOGD_INFO("endpoint <%u> reason <%s> connect <%.3f> response <%.3f> failure rate <%.2f>", pool->index, xrsr_session_end_reason_str(stats->reason), endpoint->time_connect, endpoint->time_response, endpoint->failure_rate);
+}
+
+bool xrsr_endpoint_is_failure(xrsr_session_end_reason_t reason) {
+   switch(reason) {
+      case XRSR_SESSION_END_REASON_ERROR_WS_SEND:
+      case XRSR_SESSION_END_REASON_ERROR_CONNECT_FAILURE:
+      case XRSR_SESSION_END_REASON_ERROR_CONNECT_TIMEOUT:
+      case XRSR_SESSION_END_REASON_ERROR_SESSION_TIMEOUT:
+      case XRSR_SESSION_END_REASON_ERROR_DISCONNECT_REMOTE: {
+         return(true);
+      }
+      default: {
+         break;
+      }
+   }
+   return(false);
+}
+
+// Lower is better.  Endpoints without any sessions score best so that each candidate is tried.
+double xrsr_endpoint_score(const xrsr_endpoint_t *endpoint) {
+   if(endpoint->session_qty == 0) {
+      return(0.0);
+   }
+   return(endpoint->time_connect + endpoint->time_response + (endpoint->failure_rate * XRSR_ENDPOINT_FAILURE_PENALTY));
+}
+
+double xrsr_endpoint_average(double average, double value, bool first) {
+   if(first) {
+      return(value);
+   }
+   return(average + (XRSR_ENDPOINT_EWMA_WEIGHT * (value - average)));
+}
+
+// Candidates share the destination's connection state so they must use the same protocol, with or without TLS
+bool xrsr_endpoint_prot_match(xrsr_protocol_t a, xrsr_protocol_t b) {
+   if(a == XRSR_PROTOCOL_WSS)   { a = XRSR_PROTOCOL_WS;   }
+   if(b == XRSR_PROTOCOL_WSS)   { b = XRSR_PROTOCOL_WS;   }
+   if(a == XRSR_PROTOCOL_HTTPS) { a = XRSR_PROTOCOL_HTTP; }
+   if(b == XRSR_PROTOCOL_HTTPS) { b = XRSR_PROTOCOL_HTTP; }
+   return(a == b);
+}
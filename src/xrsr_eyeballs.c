@@ -0,0 +1,300 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "xrsr_private.h"
+
+// Dual stack connection racing (RFC 8305).  Addresses are attempted in order, alternating between address families and
+// starting with the family which last won for the host (IPv6 by default).  Each attempt is started after the attempt
+// delay or as soon as the previous attempt fails, and the first connection to complete is kept.
+
+#define XRSR_EYEBALLS_CACHE_QTY    (8)
+#define XRSR_EYEBALLS_CACHE_PERIOD (600000) // time that the winning family is remembered for a host (in ms)
+#define XRSR_EYEBALLS_HOST_LEN_MAX (256)
+
+typedef struct {
+   char                  host[XRSR_EYEBALLS_HOST_LEN_MAX];
+   xrsr_address_family_t family;
+   rdkx_timestamp_t      expires;
+} xrsr_eyeballs_cache_entry_t;
+
+static xrsr_eyeballs_cache_entry_t g_xrsr_eyeballs_cache[XRSR_EYEBALLS_CACHE_QTY];
+
+static bool                  xrsr_eyeballs_attempt(xrsr_eyeballs_t *race);
+static void                  xrsr_eyeballs_won(xrsr_eyeballs_t *race, uint32_t index);
+static xrsr_address_family_t xrsr_eyeballs_family(const struct sockaddr_storage *addr);
+static xrsr_eyeballs_cache_entry_t *xrsr_eyeballs_cache_find(const char *host);
+
+bool xrsr_eyeballs_start(xrsr_eyeballs_t *race, const char *host, const char *port, uint32_t attempt_delay) {
+   struct addrinfo  hints;
+   struct addrinfo *addrs = NULL;
+
+   xrsr_eyeballs_cancel(race);
+
+   memset(&hints, 0, sizeof(hints));
+   hints.ai_family   = AF_UNSPEC;
+   hints.ai_socktype = SOCK_STREAM;
+
+   int rc = getaddrinfo(host, port, &hints, &addrs);
+   if(rc != 0) {
+      XLOGD_ERROR("getaddrinfo <%s>", gai_strerror(rc));
+      return(false);
+   }
+
+   // Interleave the address families starting with the preferred family
+   xrsr_address_family_t preferred = xrsr_eyeballs_family_get(host);
+   int family_first  = (preferred == XRSR_ADDRESS_FAMILY_IPV4) ? AF_INET  : AF_INET6;
+   int family_second = (preferred == XRSR_ADDRESS_FAMILY_IPV4) ? AF_INET6 : AF_INET;
+
+   struct addrinfo *first  = addrs;
+   struct addrinfo *second = addrs;
+   bool             turn   = true;
+
+   while(race->qty < XRSR_EYEBALLS_ADDR_QTY_MAX) {
+      int              family = turn ? family_first : family_second;
+      struct addrinfo **cursor = turn ? &first : &second;
+
+      while(*cursor != NULL && (*cursor)->ai_family != family) {
+         *cursor = (*cursor)->ai_next;
+      }
+      if(*cursor == NULL) {
+         if((turn ? second : first) == NULL) { // both families exhausted
+            break;
+         }
+      } else if((*cursor)->ai_addrlen <= sizeof(race->addrs[0])) {
+         memcpy(&race->addrs[race->qty], (*cursor)->ai_addr, (*cursor)->ai_addrlen);
+         race->addr_lens[race->qty] = (*cursor)->ai_addrlen;
+         race->qty++;
+         *cursor = (*cursor)->ai_next;
+      } else {
+         *cursor = (*cursor)->ai_next;
+      }
+      turn = !turn;
+   }
+   freeaddrinfo(addrs);
+
+   if(race->qty == 0) {
+      XLOGD_ERROR("no addresses for host <%s>", xrsr_mask_pii() ? "***" : host);
+      return(false);
+   }
+
+   race->host          = host;
+   race->attempt_delay = attempt_delay;
+
+   XLOGD_INFO("host <%s> addresses <%u> preferred family <%s>", xrsr_mask_pii() ? "***" : host, race->qty, xrsr_address_family_str(xrsr_eyeballs_family(&race->addrs[0])));
+
+   while(race->next < race->qty) {
+      if(xrsr_eyeballs_attempt(race)) {
+         return(true);
+      }
+   }
+   xrsr_eyeballs_cancel(race);
+   return(false);
+}
+
+int xrsr_eyeballs_poll(xrsr_eyeballs_t *race, bool *failed) {
+   struct pollfd pfds[XRSR_EYEBALLS_ADDR_QTY_MAX];
+   uint32_t      indices[XRSR_EYEBALLS_ADDR_QTY_MAX];
+   nfds_t        nfds = 0;
+
+   *failed = false;
+
+   for(uint32_t index = 0; index < race->next; index++) {
+      if(race->fds[index] >= 0) {
+         pfds[nfds].fd      = race->fds[index];
+         pfds[nfds].events  = POLLOUT;
+         pfds[nfds].revents = 0;
+         indices[nfds++]    = index;
+      }
+   }
+
+   if(nfds > 0 && poll(pfds, nfds, 0) > 0) {
+      for(nfds_t i = 0; i < nfds; i++) {
+         if(pfds[i].revents == 0) {
+            continue;
+         }
+         uint32_t  index = indices[i];
+         int       error = 0;
+         socklen_t len   = sizeof(error);
+
+         if(getsockopt(race->fds[index], SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+            int fd = race->fds[index];
+            xrsr_eyeballs_won(race, index);
+            return(fd);
+         }
+         XLOGD_INFO("attempt <%u> family <%s> failed <%s>", index, xrsr_address_family_str(xrsr_eyeballs_family(&race->addrs[index])), strerror(error));
+         close(race->fds[index]);
+         race->fds[index] = -1;
+         rdkx_timestamp_get(&race->attempt_next); // start the next attempt now
+      }
+   }
+
+   rdkx_timestamp_t now;
+   rdkx_timestamp_get(&now);
+
+   if(race->next < race->qty && rdkx_timestamp_cmp(now, race->attempt_next) >= 0) {
+      while(race->next < race->qty && !xrsr_eyeballs_attempt(race)) {
+      }
+   }
+
+   for(uint32_t index = 0; index < race->next; index++) {
+      if(race->fds[index] >= 0) {
+         return(-1);
+      }
+   }
+   if(race->next < race->qty) { // waiting to start the next attempt
+      return(-1);
+   }
+
+   XLOGD_WARN("host <%s> all <%u> attempts failed", xrsr_mask_pii() ? "***" : race->host, race->qty);
+   xrsr_eyeballs_family_set(race->host, XRSR_ADDRESS_FAMILY_INVALID);
+   xrsr_eyeballs_cancel(race);
+   *failed = true;
+   return(-1);
+}
+
+void xrsr_eyeballs_cancel(xrsr_eyeballs_t *race) {
+   for(uint32_t index = 0; index < race->next && index < XRSR_EYEBALLS_ADDR_QTY_MAX; index++) {
+      if(race->fds[index] >= 0) {
+         close(race->fds[index]);
+         race->fds[index] = -1;
+      }
+   }
+   race->qty  = 0;
+   race->next = 0;
+}
+
+bool xrsr_eyeballs_active(const xrsr_eyeballs_t *race) {
+   return(race->qty > 0);
+}
+
+bool xrsr_eyeballs_attempt(xrsr_eyeballs_t *race) {
+   uint32_t                       index = race->next++;
+   const struct sockaddr_storage *addr  = &race->addrs[index];
+
+   race->fds[index] = -1;
+
+   int fd = socket(addr->ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+   if(fd < 0) {
+      XLOGD_ERROR("attempt <%u> socket <%s>", index, strerror(errno));
+      return(false);
+   }
+   int flag = 1;
+   setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+   if(connect(fd, (const struct sockaddr *)addr, race->addr_lens[index]) != 0 && errno != EINPROGRESS) {
+      XLOGD_INFO("attempt <%u> connect <%s>", index, strerror(errno));
+      close(fd);
+      return(false);
+   }
+   race->fds[index] = fd;
+
+   rdkx_timestamp_get(&race->attempt_next);
+   rdkx_timestamp_add_ms(&race->attempt_next, race->attempt_delay);
+
+   XLOGD_DEBUG("attempt <%u> family <%s>", index, xrsr_address_family_str(xrsr_eyeballs_family(addr)));
+   return(true);
+}
+
+void xrsr_eyeballs_won(xrsr_eyeballs_t *race, uint32_t index) {
+   race->fds[index] = -1; // ownership passes to the caller
+   race->family     = xrsr_eyeballs_family(&race->addrs[index]);
+   race->ip[0]      = '\0';
+
+   if(race->family == XRSR_ADDRESS_FAMILY_IPV6) {
+      inet_ntop(AF_INET6, &((const struct sockaddr_in6 *)&race->addrs[index])->sin6_addr, race->ip, sizeof(race->ip));
+   } else {
+      inet_ntop(AF_INET, &((const struct sockaddr_in *)&race->addrs[index])->sin_addr, race->ip, sizeof(race->ip));
+   }
+
+   XLOGD_INFO("attempt <%u> of <%u> won family <%s> ip <%s>", index, race->next, xrsr_address_family_str(race->family), xrsr_mask_pii() ? "***" : race->ip);
+
+   xrsr_eyeballs_family_set(race->host, race->family);
+   xrsr_eyeballs_cancel(race);
+}
+
+xrsr_address_family_t xrsr_eyeballs_family(const struct sockaddr_storage *addr) {
+   return((addr->ss_family == AF_INET6) ? XRSR_ADDRESS_FAMILY_IPV6 : XRSR_ADDRESS_FAMILY_IPV4);
+}
+
+xrsr_address_family_t xrsr_eyeballs_family_get(const char *host) {
+   xrsr_eyeballs_cache_entry_t *entry = xrsr_eyeballs_cache_find(host);
+   if(entry == NULL) {
+      return(XRSR_ADDRESS_FAMILY_INVALID);
+   }
+   rdkx_timestamp_t now;
+   rdkx_timestamp_get(&now);
+   if(rdkx_timestamp_cmp(now, entry->expires) >= 0) {
+      entry->host[0] = '\0';
+      return(XRSR_ADDRESS_FAMILY_INVALID);
+   }
+   return(entry->family);
+}
+
+// Remember the winning family for a host, or forget it when the family is invalid
+void xrsr_eyeballs_family_set(const char *host, xrsr_address_family_t family) {
+   if(host == NULL || strlen(host) >= XRSR_EYEBALLS_HOST_LEN_MAX) {
+      return;
+   }
+   xrsr_eyeballs_cache_entry_t *entry = xrsr_eyeballs_cache_find(host);
+
+   if(family == XRSR_ADDRESS_FAMILY_INVALID) {
+      if(entry != NULL) {
+         entry->host[0] = '\0';
+      }
+      return;
+   }
+   if(entry == NULL) { // replace an empty entry or the one which expires first
+      entry = &g_xrsr_eyeballs_cache[0];
+      for(uint32_t index = 0; index < XRSR_EYEBALLS_CACHE_QTY; index++) {
+         if(g_xrsr_eyeballs_cache[index].host[0] == '\0') {
+            entry = &g_xrsr_eyeballs_cache[index];
+            break;
+         }
+         if(rdkx_timestamp_cmp(g_xrsr_eyeballs_cache[index].expires, entry->expires) < 0) {
+            entry = &g_xrsr_eyeballs_cache[index];
+         }
+      }
+      strlcpy(entry->host, host, sizeof(entry->host));
+   }
+   entry->family = family;
+   rdkx_timestamp_get(&entry->expires);
+   rdkx_timestamp_add_ms(&entry->expires, XRSR_EYEBALLS_CACHE_PERIOD);
+}
+
+xrsr_eyeballs_cache_entry_t *xrsr_eyeballs_cache_find(const char *host) {
+   if(host == NULL) {
+      return(NULL);
+   }
+   for(uint32_t index = 0; index < XRSR_EYEBALLS_CACHE_QTY; index++) {
+      if(g_xrsr_eyeballs_cache[index].host[0] != '\0' && 0 == strcmp(g_xrsr_eyeballs_cache[index].host, host)) {
+         return(&g_xrsr_eyeballs_cache[index]);
+      }
+   }
+   return(NULL);
+}
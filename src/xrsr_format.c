@@ -0,0 +1,216 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "xrsr_private.h"
+
+#define XRSR_FORMAT_EWMA_WEIGHT       (0.25)   // weight of the most recent throughput sample
+#define XRSR_FORMAT_BACKLOG_MIN       (8192)   // pipe backlog which indicates that the uplink is saturated (in bytes)
+#define XRSR_FORMAT_UPLINK_MARGIN     (1.5)    // uplink is constrained if it can't carry this multiple of the 16-bit PCM bitrate
+#define XRSR_FORMAT_RTT_SLOW          (300000) // round trip time above which the uplink is treated as constrained (in us)
+#define XRSR_FORMAT_ESTIMATE_LIFETIME (600000) // an uplink estimate is discarded after this time so that PCM is tried again (in ms)
+#define XRSR_FORMAT_CPU_HEADROOM_MIN  (0.25)   // fraction of idle CPU below which encoding is avoided
+#define XRSR_FORMAT_OPUS_BITRATE      (3000)   // bytes per second assumed for opus passed through from xraudio
+#define XRSR_FORMAT_CANDIDATE_QTY_MAX (8)
+
+typedef enum {
+   XRSR_FORMAT_COST_FORWARD = 0, // native audio is passed through
+   XRSR_FORMAT_COST_CONVERT = 1, // decode or sample size conversion
+   XRSR_FORMAT_COST_ENCODE  = 2, // compression on the device
+} xrsr_format_cost_t;
+
+static bool               xrsr_format_producible(xrsr_audio_format_t native, xrsr_audio_format_t format);
+static uint32_t           xrsr_format_bitrate(xrsr_audio_format_t format, uint32_t sample_rate, uint32_t opus_bitrate);
+static xrsr_format_cost_t xrsr_format_cost(xrsr_audio_format_t native, xrsr_audio_format_t format);
+static bool               xrsr_format_uplink_constrained(xrsr_format_link_t *link, uint32_t sample_rate);
+static bool               xrsr_format_cpu_limited(xrsr_power_mode_t power_mode);
+
+void xrsr_format_link_init(xrsr_format_link_t *link) {
+   memset(link, 0, sizeof(*link));
+}
+
+// Estimate the uplink throughput from the audio sent in each metrics interval.  The rate only measures the capacity when
+// audio is backing up, otherwise the capacity is at least the rate.
+void xrsr_format_link_update(xrsr_format_link_t *link, const xrsr_grouping_metrics_t *metrics) {
+   if(metrics->srtt_us != 0) {
+      link->srtt_us = metrics->srtt_us;
+   }
+   if(metrics->interval_ms == 0) {
+      return;
+   }
+   double rate      = (metrics->txd_bytes * 1000.0) / metrics->interval_ms;
+   bool   saturated = (metrics->would_block_qty > 0 || metrics->backlog_bytes > XRSR_FORMAT_BACKLOG_MIN);
+
+   if(saturated) {
+      if(!link->limited || link->uplink_bps == 0.0) {
+         link->uplink_bps = rate;
+      } else {
+         link->uplink_bps += XRSR_FORMAT_EWMA_WEIGHT * (rate - link->uplink_bps);
+      }
+      link->limited = true;
+      rdkx_timestamp_get(&link->measured);
+   } else if(rate > link->uplink_bps) {
+      link->uplink_bps = rate;
+      link->limited    = false;
+      rdkx_timestamp_get(&link->measured);
+   }
+}
+
+// Lower bitrate formats are only considered when the uplink is constrained, so a fast link gets the source format (or
+// PCM) and the device doesn't spend CPU on encoding.  opus_bitrate is the router's encoder bitrate in bits per second, or
+// zero if the router doesn't encode.
+xrsr_audio_format_t xrsr_format_select(xrsr_format_link_t *link, uint32_t formats_supported_dst, xraudio_input_format_t format_src, xrsr_power_mode_t power_mode, uint32_t opus_bitrate, xrsr_format_reason_t *reason) {
+   xrsr_audio_format_t native      = xrsr_xraudio_format_to_xrsr(format_src);
+   bool                constrained = xrsr_format_uplink_constrained(link, format_src.sample_rate);
+   bool                cpu_limited = constrained && xrsr_format_cpu_limited(power_mode);
+   xrsr_audio_format_t selected    = XRSR_AUDIO_FORMAT_NONE;
+   xrsr_audio_format_t lowest      = XRSR_AUDIO_FORMAT_NONE;
+
+   *reason = XRSR_FORMAT_REASON_DEFAULT;
+
+   // Native format first so that it wins ties
+   uint32_t candidates[XRSR_FORMAT_CANDIDATE_QTY_MAX];
+   uint32_t qty = 0;
+   if(native & formats_supported_dst) {
+      candidates[qty++] = native;
+   } else if(XRSR_AUDIO_FORMAT_PCM & formats_supported_dst) { // matches the previous behavior when no estimates are available
+      candidates[qty++] = XRSR_AUDIO_FORMAT_PCM;
+   }
+   if(constrained) {
+      for(uint32_t format = 1; format < XRSR_AUDIO_FORMAT_MAX; format <<= 1) {
+         if((format & formats_supported_dst) && format != native && xrsr_format_producible(native, format)) {
+            candidates[qty++] = format;
+         }
+      }
+   }
+
+   for(uint32_t index = 0; index < qty; index++) {
+      xrsr_audio_format_t format = (xrsr_audio_format_t)candidates[index];
+
+      if(selected == XRSR_AUDIO_FORMAT_NONE) {
+         selected = format;
+         lowest   = format;
+         continue;
+      }
+      uint32_t bitrate = xrsr_format_bitrate(format, format_src.sample_rate, opus_bitrate);
+
+      if(bitrate < xrsr_format_bitrate(lowest, format_src.sample_rate, opus_bitrate)) {
+         lowest = format;
+      }
+      if(cpu_limited && xrsr_format_cost(native, format) == XRSR_FORMAT_COST_ENCODE) {
+         continue;
+      }
+      if(bitrate < xrsr_format_bitrate(selected, format_src.sample_rate, opus_bitrate)) {
+         selected = format;
+      }
+   }
+
+   if(constrained && selected != candidates[0]) {
+      *reason = XRSR_FORMAT_REASON_BANDWIDTH;
+   } else if(lowest != selected) {
+      *reason = XRSR_FORMAT_REASON_CPU;
+   }
+
+   XLOGD_INFO("native <%s> supported <%s> uplink <%.0f> B/s limited <%s> srtt <%u> us power <%s> selected <%s> reason <%s>", xrsr_audio_format_str(native), xrsr_audio_format_bitmask_str(formats_supported_dst), link->uplink_bps, link->limited ? "YES" : "NO", link->srtt_us, xrsr_power_mode_str(power_mode), xrsr_audio_format_str(selected), xrsr_format_reason_str(*reason));
+
+   return(selected);
+}
+
+// xraudio decodes and converts to PCM but only passes compressed formats through.  PCM is encoded to constant bitrate
+// opus by the router.
+bool xrsr_format_producible(xrsr_audio_format_t native, xrsr_audio_format_t format) {
+   #ifdef OPUS_ENABLED
+   if(format == XRSR_AUDIO_FORMAT_OPUS_CBR && xrsr_encoder_supported(native)) {
+      return(true);
+   }
+   #endif
+   switch(format) {
+      case XRSR_AUDIO_FORMAT_PCM:
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT:
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI:
+      case XRSR_AUDIO_FORMAT_PCM_RAW: {
+         return(true);
+      }
+      default: {
+         break;
+      }
+   }
+   return(format == native);
+}
+
+// Returns the format's rate in bytes per second
+uint32_t xrsr_format_bitrate(xrsr_audio_format_t format, uint32_t sample_rate, uint32_t opus_bitrate) {
+   if(sample_rate == 0) {
+      sample_rate = XRAUDIO_INPUT_DEFAULT_SAMPLE_RATE;
+   }
+   switch(format) {
+      case XRSR_AUDIO_FORMAT_PCM:              return(sample_rate * 2);
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT:       return(sample_rate * 4);
+      case XRSR_AUDIO_FORMAT_PCM_32_BIT_MULTI: return(sample_rate * 4 * XRAUDIO_INPUT_MAX_CHANNEL_QTY);
+      case XRSR_AUDIO_FORMAT_PCM_RAW:          return(sample_rate * 4 * XRAUDIO_INPUT_MAX_CHANNEL_QTY);
+      case XRSR_AUDIO_FORMAT_ADPCM:            return(sample_rate / 2);
+      case XRSR_AUDIO_FORMAT_OPUS:             return(XRSR_FORMAT_OPUS_BITRATE);
+      case XRSR_AUDIO_FORMAT_OPUS_CBR:         return((opus_bitrate > 0) ? opus_bitrate / 8 : UINT32_MAX);
+      default: break;
+   }
+   return(UINT32_MAX);
+}
+
+xrsr_format_cost_t xrsr_format_cost(xrsr_audio_format_t native, xrsr_audio_format_t format) {
+   if(format == native) {
+      return(XRSR_FORMAT_COST_FORWARD);
+   }
+   if(format == XRSR_AUDIO_FORMAT_ADPCM || format == XRSR_AUDIO_FORMAT_OPUS || format == XRSR_AUDIO_FORMAT_OPUS_CBR) {
+      return(XRSR_FORMAT_COST_ENCODE);
+   }
+   return(XRSR_FORMAT_COST_CONVERT);
+}
+
+bool xrsr_format_uplink_constrained(xrsr_format_link_t *link, uint32_t sample_rate) {
+   if(link->srtt_us > XRSR_FORMAT_RTT_SLOW) {
+      return(true);
+   }
+   if(!link->limited) {
+      return(false);
+   }
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+   if(rdkx_timestamp_subtract_ms(link->measured, timestamp) > XRSR_FORMAT_ESTIMATE_LIFETIME) { // stale
+      link->limited    = false;
+      link->uplink_bps = 0.0;
+      return(false);
+   }
+   return(link->uplink_bps < XRSR_FORMAT_UPLINK_MARGIN * xrsr_format_bitrate(XRSR_AUDIO_FORMAT_PCM, sample_rate, 0));
+}
+
+bool xrsr_format_cpu_limited(xrsr_power_mode_t power_mode) {
+   if(power_mode != XRSR_POWER_MODE_FULL) {
+      return(true);
+   }
+   double load = 0.0;
+   long   cpus = sysconf(_SC_NPROCESSORS_ONLN);
+   if(cpus <= 0 || getloadavg(&load, 1) != 1) {
+      return(false);
+   }
+   return((1.0 - (load / cpus)) < XRSR_FORMAT_CPU_HEADROOM_MIN);
+}
@@ -0,0 +1,132 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "xrsr_private.h"
+
+#define XRSR_GROUPING_SIZE_MIN      (640)    // 20 ms of 16 kHz 16-bit audio
+#define XRSR_GROUPING_SIZE_DEFAULT  (4096)
+#define XRSR_GROUPING_SIZE_MAX      (16384)
+#define XRSR_GROUPING_RTT_FAST      (50000)  // round trip time below which the group delay dominates the response time (in us)
+#define XRSR_GROUPING_RTT_SLOW      (200000) // round trip time above which larger groups are used from the start (in us)
+#define XRSR_GROUPING_BACKLOG_RATIO (2)      // pipe backlog of this many groups indicates the connection is not keeping up
+#define XRSR_GROUPING_CLEAR_QTY     (4)      // consecutive uncongested intervals after which the group size is reduced
+
+static uint32_t xrsr_grouping_size_floor(uint32_t srtt_us);
+
+void xrsr_grouping_init(xrsr_grouping_t *grouping) {
+   memset(grouping, 0, sizeof(*grouping));
+   grouping->size = XRSR_GROUPING_SIZE_DEFAULT;
+}
+
+// Returns the group size in bytes for a new stream.  Zero is a single frame.
+uint32_t xrsr_grouping_begin(xrsr_grouping_t *grouping, bool low_latency) {
+   grouping->active         = true;
+   grouping->adaptive       = !low_latency;
+   grouping->measured       = false;
+   grouping->clear_qty      = 0;
+   grouping->adjust_qty     = 0;
+   grouping->congestion_qty = 0;
+
+   if(low_latency) { // requested by the application
+      grouping->size_floor = 0;
+      grouping->size       = 0;
+   } else {
+      grouping->size_floor = xrsr_grouping_size_floor(grouping->srtt_us);
+      if(grouping->congested && grouping->size > grouping->size_floor) { // start where the last stream settled
+         XLOGD_INFO("resume congested group size <%u>", grouping->size);
+      } else {
+         grouping->size = grouping->size_floor;
+      }
+   }
+   grouping->size_begin = grouping->size;
+
+   XLOGD_INFO("srtt <%u> us congested <%s> group size <%u>", grouping->srtt_us, grouping->congested ? "YES" : "NO", grouping->size);
+   return(grouping->size);
+}
+
+// Returns true if the group size changed
+bool xrsr_grouping_update(xrsr_grouping_t *grouping, const xrsr_grouping_metrics_t *metrics) {
+   if(metrics->srtt_us != 0) {
+      grouping->srtt_us = metrics->srtt_us;
+   }
+   if(!grouping->active || !grouping->adaptive) {
+      return(false);
+   }
+   grouping->measured = true;
+
+   uint32_t size      = grouping->size;
+   uint32_t threshold = XRSR_GROUPING_BACKLOG_RATIO * ((size > XRSR_GROUPING_SIZE_MIN) ? size : XRSR_GROUPING_SIZE_MIN);
+
+   if(metrics->would_block_qty > 0 || metrics->backlog_bytes > threshold) { // fewer, larger writes
+      grouping->clear_qty = 0;
+      grouping->congestion_qty++;
+      if(size < XRSR_GROUPING_SIZE_MIN) {
+         size = XRSR_GROUPING_SIZE_MIN;
+      } else if(size < XRSR_GROUPING_SIZE_MAX) {
+         size *= 2;
+      }
+   } else if(++grouping->clear_qty >= XRSR_GROUPING_CLEAR_QTY && size > grouping->size_floor) { // back off toward the latency target
+      grouping->clear_qty = 0;
+      size /= 2;
+      if(size < grouping->size_floor || size < XRSR_GROUPING_SIZE_MIN) {
+         size = grouping->size_floor;
+      }
+   }
+
+   if(size == grouping->size) {
+      return(false);
+   }
+   XLOGD_INFO("group size <%u> -> <%u> would block <%u> backlog <%u>", grouping->size, size, metrics->would_block_qty, metrics->backlog_bytes);
+   grouping->size = size;
+   grouping->adjust_qty++;
+   return(true);
+}
+
+void xrsr_grouping_end(xrsr_grouping_t *grouping, xrsr_stream_stats_t *stats) {
+   if(!grouping->active) {
+      return;
+   }
+   grouping->active = false;
+
+   if(grouping->adaptive) {
+      grouping->congested = (grouping->congestion_qty > 0 && grouping->size > grouping->size_floor);
+   }
+   if(stats != NULL) {
+      stats->group_size_begin = grouping->size_begin;
+      stats->group_size_end   = grouping->size;
+      stats->group_adjust_qty = grouping->adjust_qty;
+   }
+}
+
+uint32_t xrsr_grouping_size_floor(uint32_t srtt_us) {
+   if(srtt_us == 0) { // not measured
+      return(XRSR_GROUPING_SIZE_DEFAULT);
+   }
+   if(srtt_us < XRSR_GROUPING_RTT_FAST) {
+      return(XRSR_GROUPING_SIZE_MIN);
+   }
+   if(srtt_us > XRSR_GROUPING_RTT_SLOW) {
+      return(XRSR_GROUPING_SIZE_DEFAULT * 2);
+   }
+   return(XRSR_GROUPING_SIZE_DEFAULT);
+}
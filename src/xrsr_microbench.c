@@ -0,0 +1,819 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Microbenchmarks for the speech router's internal routines.  Each routine is run in batches which are sized to a
+// minimum duration, and the best and median cost per operation are reported in nanoseconds along with the quantity
+// of heap allocations per operation.  Allocations are counted by interposing the C library allocator (glibc only).
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <time.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <jansson.h>
+#include <xr_mq.h>
+#include "xrsr_private.h"
+
+#define XRSR_MICROBENCH_BATCH_TIME_DEFAULT   (100)
+#define XRSR_MICROBENCH_REPEAT_QTY_DEFAULT   (5)
+#define XRSR_MICROBENCH_REPEAT_QTY_MAX       (100)
+#define XRSR_MICROBENCH_CALIBRATE_TIME       (10)
+#define XRSR_MICROBENCH_HTTP_CHUNK_SIZE      (16384) // curl's maximum write callback size
+
+#ifdef __GLIBC__
+#define XRSR_MICROBENCH_ALLOC_COUNT
+#endif
+
+typedef struct {
+   const char *name;
+   uint32_t    ops;                      // operations performed by each call to run
+   bool      (*setup)(void **ctx);
+   void      (*run)(void *ctx, uint64_t iteration);
+   void      (*teardown)(void *ctx);
+} xrsr_microbench_t;
+
+typedef struct {
+   uint32_t    batch_time;
+   uint32_t    repeat_qty;
+   const char *benchmarks;
+   const char *output;
+} xrsr_microbench_params_t;
+
+typedef struct {
+   uint64_t iterations;
+   double   ns_per_op[XRSR_MICROBENCH_REPEAT_QTY_MAX];
+   uint64_t allocs;
+   uint64_t alloc_bytes;
+} xrsr_microbench_result_t;
+
+static void     xrsr_microbench_usage(const char *name);
+static bool     xrsr_microbench_selected(const char *list, const char *name);
+static bool     xrsr_microbench_run(const xrsr_microbench_params_t *params, const xrsr_microbench_t *bench, xrsr_microbench_result_t *result);
+static uint64_t xrsr_microbench_batch(const xrsr_microbench_t *bench, void *ctx, uint64_t iterations);
+static uint64_t xrsr_microbench_time_ns(void);
+static int      xrsr_microbench_compare(const void *a, const void *b);
+
+static bool xrsr_microbench_msgq_setup(void **ctx);
+static void xrsr_microbench_msgq_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_msgq_teardown(void *ctx);
+static void xrsr_microbench_url_parse_ws_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_url_parse_http_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_url_parse_sdt_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_thread_fds_set_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_thread_fds_handle_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_str_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_trace_record_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_trace_format_run(void *ctx, uint64_t iteration);
+static bool xrsr_microbench_convert_setup(void **ctx);
+static void xrsr_microbench_convert_scalar_chan_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_convert_simd_chan_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_convert_scalar_mix_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_convert_simd_mix_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_convert_teardown(void *ctx);
+static bool xrsr_microbench_resample_8k_setup(void **ctx);
+static bool xrsr_microbench_resample_24k_setup(void **ctx);
+static bool xrsr_microbench_resample_44k1_setup(void **ctx);
+static bool xrsr_microbench_resample_48k_setup(void **ctx);
+static void xrsr_microbench_resample_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_resample_teardown(void *ctx);
+#ifdef WS_ENABLED
+static bool xrsr_microbench_ws_setup(void **ctx);
+static void xrsr_microbench_ws_msg_out_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_teardown(void *ctx);
+static bool xrsr_microbench_ws_frame_setup(void **ctx);
+static void xrsr_microbench_ws_mask_nopoll_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_mask_scalar_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_mask_simd_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_send_nopoll_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_send_native_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_ws_frame_teardown(void *ctx);
+#endif
+#ifdef HTTP_ENABLED
+static bool xrsr_microbench_http_setup(void **ctx);
+static void xrsr_microbench_http_write_4k_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_http_write_32k_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_http_write_max_run(void *ctx, uint64_t iteration);
+static void xrsr_microbench_http_teardown(void *ctx);
+#endif
+
+#define XRSR_MICROBENCH_STR_QTY           (17)
+#define XRSR_MICROBENCH_CONVERT_FRAME_QTY (320) // 20 ms at 16 kHz
+#define XRSR_MICROBENCH_WS_FRAME_SIZE     (4096) // largest audio frame read from the pipe
+
+static const xrsr_microbench_t g_xrsr_microbenchmarks[] = {
+   { "msgq_push_pop",       1,                                 xrsr_microbench_msgq_setup,          xrsr_microbench_msgq_run,                xrsr_microbench_msgq_teardown },
+   { "url_parse_ws",        1,                                 NULL,                                xrsr_microbench_url_parse_ws_run,        NULL },
+   { "url_parse_http",      1,                                 NULL,                                xrsr_microbench_url_parse_http_run,      NULL },
+   { "url_parse_sdt",       1,                                 NULL,                                xrsr_microbench_url_parse_sdt_run,       NULL },
+   { "thread_fds_set",      1,                                 NULL,                                xrsr_microbench_thread_fds_set_run,      NULL },
+   { "thread_fds_handle",   1,                                 NULL,                                xrsr_microbench_thread_fds_handle_run,   NULL },
+   #ifdef WS_ENABLED
+   { "ws_msg_out",          1,                                 xrsr_microbench_ws_setup,            xrsr_microbench_ws_msg_out_run,          xrsr_microbench_ws_teardown },
+   { "ws_mask_nopoll",      1,                                 xrsr_microbench_ws_frame_setup,      xrsr_microbench_ws_mask_nopoll_run,      xrsr_microbench_ws_frame_teardown },
+   { "ws_mask_scalar",      1,                                 xrsr_microbench_ws_frame_setup,      xrsr_microbench_ws_mask_scalar_run,      xrsr_microbench_ws_frame_teardown },
+   { "ws_mask_simd",        1,                                 xrsr_microbench_ws_frame_setup,      xrsr_microbench_ws_mask_simd_run,        xrsr_microbench_ws_frame_teardown },
+   { "ws_send_nopoll",      1,                                 xrsr_microbench_ws_frame_setup,      xrsr_microbench_ws_send_nopoll_run,      xrsr_microbench_ws_frame_teardown },
+   { "ws_send_native",      1,                                 xrsr_microbench_ws_frame_setup,      xrsr_microbench_ws_send_native_run,      xrsr_microbench_ws_frame_teardown },
+   #endif
+   #ifdef HTTP_ENABLED
+   { "http_write_4k",       1,                                 xrsr_microbench_http_setup,          xrsr_microbench_http_write_4k_run,       xrsr_microbench_http_teardown },
+   { "http_write_32k",      1,                                 xrsr_microbench_http_setup,          xrsr_microbench_http_write_32k_run,      xrsr_microbench_http_teardown },
+   { "http_write_max",      1,                                 xrsr_microbench_http_setup,          xrsr_microbench_http_write_max_run,      xrsr_microbench_http_teardown },
+   #endif
+   { "str_helpers",         XRSR_MICROBENCH_STR_QTY,           NULL,                                xrsr_microbench_str_run,                 NULL },
+   { "trace_record",        1,                                 NULL,                                xrsr_microbench_trace_record_run,        NULL },
+   { "trace_format",        1,                                 NULL,                                xrsr_microbench_trace_format_run,        NULL },
+   { "convert_scalar_chan", XRSR_MICROBENCH_CONVERT_FRAME_QTY, xrsr_microbench_convert_setup,       xrsr_microbench_convert_scalar_chan_run, xrsr_microbench_convert_teardown },
+   { "convert_simd_chan",   XRSR_MICROBENCH_CONVERT_FRAME_QTY, xrsr_microbench_convert_setup,       xrsr_microbench_convert_simd_chan_run,   xrsr_microbench_convert_teardown },
+   { "convert_scalar_mix",  XRSR_MICROBENCH_CONVERT_FRAME_QTY, xrsr_microbench_convert_setup,       xrsr_microbench_convert_scalar_mix_run,  xrsr_microbench_convert_teardown },
+   { "convert_simd_mix",    XRSR_MICROBENCH_CONVERT_FRAME_QTY, xrsr_microbench_convert_setup,       xrsr_microbench_convert_simd_mix_run,    xrsr_microbench_convert_teardown },
+   { "resample_16k_8k",     1,                                 xrsr_microbench_resample_8k_setup,   xrsr_microbench_resample_run,            xrsr_microbench_resample_teardown },
+   { "resample_16k_24k",    1,                                 xrsr_microbench_resample_24k_setup,  xrsr_microbench_resample_run,            xrsr_microbench_resample_teardown },
+   { "resample_16k_44k1",   1,                                 xrsr_microbench_resample_44k1_setup, xrsr_microbench_resample_run,            xrsr_microbench_resample_teardown },
+   { "resample_16k_48k",    1,                                 xrsr_microbench_resample_48k_setup,  xrsr_microbench_resample_run,            xrsr_microbench_resample_teardown },
+};
+
+static volatile uintptr_t g_xrsr_microbench_sink;
+
+#ifdef XRSR_MICROBENCH_ALLOC_COUNT
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+extern void  __libc_free(void *ptr);
+
+static uint64_t g_xrsr_microbench_allocs;
+static uint64_t g_xrsr_microbench_alloc_bytes;
+
+void *malloc(size_t size) {
+   __atomic_fetch_add(&g_xrsr_microbench_allocs, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&g_xrsr_microbench_alloc_bytes, size, __ATOMIC_RELAXED);
+   return(__libc_malloc(size));
+}
+
+void *calloc(size_t nmemb, size_t size) {
+   __atomic_fetch_add(&g_xrsr_microbench_allocs, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&g_xrsr_microbench_alloc_bytes, nmemb * size, __ATOMIC_RELAXED);
+   return(__libc_calloc(nmemb, size));
+}
+
+void *realloc(void *ptr, size_t size) {
+   __atomic_fetch_add(&g_xrsr_microbench_allocs, 1, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&g_xrsr_microbench_alloc_bytes, size, __ATOMIC_RELAXED);
+   return(__libc_realloc(ptr, size));
+}
+
+void free(void *ptr) {
+   __libc_free(ptr);
+}
+#endif
+
+int main(int argc, char *argv[]) {
+   xrsr_microbench_params_t params;
+   int                      opt;
+   bool                     list = false;
+
+   memset(&params, 0, sizeof(params));
+   params.batch_time = XRSR_MICROBENCH_BATCH_TIME_DEFAULT;
+   params.repeat_qty = XRSR_MICROBENCH_REPEAT_QTY_DEFAULT;
+
+   while((opt = getopt(argc, argv, "b:t:r:o:lh")) != -1) {
+      switch(opt) {
+         case 'b': params.benchmarks = optarg;                    break;
+         case 't': params.batch_time = strtoul(optarg, NULL, 10); break;
+         case 'r': params.repeat_qty = strtoul(optarg, NULL, 10); break;
+         case 'o': params.output     = optarg;                    break;
+         case 'l': list              = true;                      break;
+         default: {
+            xrsr_microbench_usage(argv[0]);
+            return((opt == 'h') ? 0 : 1);
+         }
+      }
+   }
+   if(params.batch_time == 0 || params.repeat_qty == 0 || params.repeat_qty > XRSR_MICROBENCH_REPEAT_QTY_MAX) {
+      xrsr_microbench_usage(argv[0]);
+      return(1);
+   }
+
+   uint32_t bench_qty = sizeof(g_xrsr_microbenchmarks) / sizeof(g_xrsr_microbenchmarks[0]);
+
+   if(list) {
+      for(uint32_t index = 0; index < bench_qty; index++) {
+         printf("%s\n", g_xrsr_microbenchmarks[index].name);
+      }
+      return(0);
+   }
+
+   json_t *json_results    = json_object();
+   json_t *json_params     = json_object();
+   json_t *json_benchmarks = json_object();
+
+   json_object_set_new(json_params, "batch_time", json_integer(params.batch_time));
+   json_object_set_new(json_params, "repeat",     json_integer(params.repeat_qty));
+   json_object_set_new(json_results, "units",      json_string("ns"));
+   #ifdef XRSR_MICROBENCH_ALLOC_COUNT
+   json_object_set_new(json_results, "allocs",     json_true());
+   #else
+   json_object_set_new(json_results, "allocs",     json_false());
+   #endif
+   json_object_set_new(json_results, "params",     json_params);
+   json_object_set_new(json_results, "benchmarks", json_benchmarks);
+
+   bool result = true;
+   for(uint32_t index = 0; index < bench_qty; index++) {
+      const xrsr_microbench_t *bench = &g_xrsr_microbenchmarks[index];
+      xrsr_microbench_result_t bench_result;
+
+      if(!xrsr_microbench_selected(params.benchmarks, bench->name)) {
+         continue;
+      }
+      if(!xrsr_microbench_run(&params, bench, &bench_result)) {
+         XLOGD_ERROR("benchmark <%s> failed", bench->name);
+         result = false;
+         continue;
+      }
+      uint64_t ops = bench_result.iterations * bench->ops * params.repeat_qty;
+
+      qsort(bench_result.ns_per_op, params.repeat_qty, sizeof(double), xrsr_microbench_compare);
+
+      json_t *json_bench = json_object();
+      json_object_set_new(json_bench, "iterations", json_integer(bench_result.iterations));
+      json_object_set_new(json_bench, "ns_per_op",  json_real(bench_result.ns_per_op[0]));
+      json_object_set_new(json_bench, "ns_per_op_median", json_real(bench_result.ns_per_op[params.repeat_qty / 2]));
+      #ifdef XRSR_MICROBENCH_ALLOC_COUNT
+      json_object_set_new(json_bench, "allocs_per_op", json_real((double)bench_result.allocs / ops));
+      json_object_set_new(json_bench, "bytes_per_op",  json_real((double)bench_result.alloc_bytes / ops));
+      #else
+      (void)ops;
+      #endif
+      json_object_set_new(json_benchmarks, bench->name, json_bench);
+   }
+
+   FILE *file = (params.output != NULL) ? fopen(params.output, "w") : stdout;
+   if(file == NULL) {
+      XLOGD_ERROR("unable to open <%s> <%s>", params.output, strerror(errno));
+      result = false;
+   } else {
+      json_dumpf(json_results, file, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+      fprintf(file, "\n");
+      if(file != stdout) {
+         fclose(file);
+      }
+   }
+   json_decref(json_results);
+
+   return(result ? 0 : 1);
+}
+
+void xrsr_microbench_usage(const char *name) {
+   printf("usage: %s [options]\n", name);
+   printf("   -b <list>  benchmarks to run (default all)\n");
+   printf("   -t <ms>    minimum batch duration (default %u)\n", XRSR_MICROBENCH_BATCH_TIME_DEFAULT);
+   printf("   -r <qty>   batches per benchmark, 1 to %u (default %u)\n", XRSR_MICROBENCH_REPEAT_QTY_MAX, XRSR_MICROBENCH_REPEAT_QTY_DEFAULT);
+   printf("   -o <file>  json output file (default stdout)\n");
+   printf("   -l         list the benchmarks\n");
+}
+
+bool xrsr_microbench_selected(const char *list, const char *name) {
+   char buffer[256];
+
+   if(list == NULL) {
+      return(true);
+   }
+   snprintf(buffer, sizeof(buffer), "%s", list);
+   for(char *save = NULL, *token = strtok_r(buffer, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+      if(0 == strcmp(token, name)) {
+         return(true);
+      }
+   }
+   return(false);
+}
+
+bool xrsr_microbench_run(const xrsr_microbench_params_t *params, const xrsr_microbench_t *bench, xrsr_microbench_result_t *result) {
+   void *ctx = NULL;
+
+   memset(result, 0, sizeof(*result));
+
+   if(bench->setup != NULL && !(*bench->setup)(&ctx)) {
+      return(false);
+   }
+
+   // Grow the batch until it runs long enough to be timed, then scale it to the requested duration
+   uint64_t iterations = 1;
+   uint64_t elapsed    = 0;
+   do {
+      iterations *= 2;
+      elapsed = xrsr_microbench_batch(bench, ctx, iterations);
+   } while(elapsed < (uint64_t)XRSR_MICROBENCH_CALIBRATE_TIME * 1000000);
+
+   iterations = (iterations * params->batch_time * 1000000) / elapsed;
+   if(iterations == 0) {
+      iterations = 1;
+   }
+   result->iterations = iterations;
+
+   #ifdef XRSR_MICROBENCH_ALLOC_COUNT
+   uint64_t allocs      = __atomic_load_n(&g_xrsr_microbench_allocs, __ATOMIC_RELAXED);
+   uint64_t alloc_bytes = __atomic_load_n(&g_xrsr_microbench_alloc_bytes, __ATOMIC_RELAXED);
+   #endif
+
+   for(uint32_t repeat = 0; repeat < params->repeat_qty; repeat++) {
+      elapsed = xrsr_microbench_batch(bench, ctx, iterations);
+      result->ns_per_op[repeat] = (double)elapsed / (iterations * bench->ops);
+   }
+
+   #ifdef XRSR_MICROBENCH_ALLOC_COUNT
+   result->allocs      = __atomic_load_n(&g_xrsr_microbench_allocs, __ATOMIC_RELAXED) - allocs;
+   result->alloc_bytes = __atomic_load_n(&g_xrsr_microbench_alloc_bytes, __ATOMIC_RELAXED) - alloc_bytes;
+   #endif
+
+   if(bench->teardown != NULL) {
+      (*bench->teardown)(ctx);
+   }
+   return(true);
+}
+
+uint64_t xrsr_microbench_batch(const xrsr_microbench_t *bench, void *ctx, uint64_t iterations) {
+   uint64_t begin = xrsr_microbench_time_ns();
+   for(uint64_t iteration = 0; iteration < iterations; iteration++) {
+      (*bench->run)(ctx, iteration);
+   }
+   uint64_t elapsed = xrsr_microbench_time_ns() - begin;
+   return((elapsed == 0) ? 1 : elapsed);
+}
+
+uint64_t xrsr_microbench_time_ns(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return(((uint64_t)ts.tv_sec * 1000000000) + ts.tv_nsec);
+}
+
+int xrsr_microbench_compare(const void *a, const void *b) {
+   double value_a = *(const double *)a;
+   double value_b = *(const double *)b;
+   return((value_a > value_b) - (value_a < value_b));
+}
+
+// Message queue round trip, the path taken by every request into the router thread
+typedef struct {
+   int  msgq;
+   char msg[XRSR_MSG_QUEUE_MSG_SIZE_MAX];
+} xrsr_microbench_msgq_t;
+
+bool xrsr_microbench_msgq_setup(void **ctx) {
+   xrsr_microbench_msgq_t *msgq = (xrsr_microbench_msgq_t *)calloc(1, sizeof(xrsr_microbench_msgq_t));
+   if(msgq == NULL) {
+      return(false);
+   }
+   if(!xrsr_message_queue_open(&msgq->msgq, XRSR_MSG_QUEUE_MSG_SIZE_MAX)) {
+      XLOGD_ERROR("unable to open message queue");
+      free(msgq);
+      return(false);
+   }
+   *ctx = msgq;
+   return(true);
+}
+
+void xrsr_microbench_msgq_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_msgq_t *msgq = (xrsr_microbench_msgq_t *)ctx;
+   xrsr_queue_msg_thread_poll_t msg;
+
+   msg.header.type = XRSR_QUEUE_MSG_TYPE_THREAD_POLL;
+   msg.func        = NULL;
+
+   xrsr_queue_msg_push(msgq->msgq, (const char *)&msg, sizeof(msg));
+   g_xrsr_microbench_sink = xr_mq_pop(msgq->msgq, msgq->msg, sizeof(msgq->msg));
+}
+
+void xrsr_microbench_msgq_teardown(void *ctx) {
+   xrsr_microbench_msgq_t *msgq = (xrsr_microbench_msgq_t *)ctx;
+   xrsr_message_queue_close(&msgq->msgq);
+   free(msgq);
+}
+
+static void xrsr_microbench_url_parse(const char *url) {
+   xrsr_url_parts_t url_parts;
+   g_xrsr_microbench_sink = xrsr_url_parse(url, &url_parts);
+   xrsr_url_free(&url_parts);
+}
+
+void xrsr_microbench_url_parse_ws_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_url_parse("wss://speech.example.com:443/vrex/speech/websocket?codec=PCM_16_16K&trx=0123456789abcdef");
+}
+
+void xrsr_microbench_url_parse_http_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_url_parse("http://speech.example.com/vrex/speech/v1");
+}
+
+void xrsr_microbench_url_parse_sdt_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_url_parse("sdt://local");
+}
+
+// The router thread's per select() loops over every route, with no open connections
+void xrsr_microbench_thread_fds_set_run(void *ctx, uint64_t iteration) {
+   int    nfds = 1;
+   fd_set rfds;
+   fd_set wfds;
+
+   FD_ZERO(&rfds);
+   FD_ZERO(&wfds);
+   xrsr_thread_fds_set(&nfds, &rfds, &wfds);
+   g_xrsr_microbench_sink = nfds;
+}
+
+void xrsr_microbench_thread_fds_handle_run(void *ctx, uint64_t iteration) {
+   fd_set rfds;
+   fd_set wfds;
+
+   FD_ZERO(&rfds);
+   FD_ZERO(&wfds);
+   xrsr_thread_fds_handle(&rfds, &wfds);
+}
+
+// Each call runs every enum to string helper once, walking the valid range and one invalid value
+void xrsr_microbench_str_run(void *ctx, uint64_t iteration) {
+   uint32_t  value = (uint32_t)iteration;
+   uintptr_t sum   = 0;
+
+   sum += (uintptr_t)xrsr_src_str((xrsr_src_t)(value % (XRSR_SRC_INVALID + 1)));
+   sum += (uintptr_t)xrsr_result_str((xrsr_result_t)(value % (XRSR_RESULT_INVALID + 1)));
+   sum += (uintptr_t)xrsr_session_end_reason_str((xrsr_session_end_reason_t)(value % (XRSR_SESSION_END_REASON_INVALID + 1)));
+   sum += (uintptr_t)xrsr_stream_end_reason_str((xrsr_stream_end_reason_t)(value % (XRSR_STREAM_END_REASON_INVALID + 1)));
+   sum += (uintptr_t)xrsr_protocol_str((xrsr_protocol_t)(value % (XRSR_PROTOCOL_UNIX + 1)));
+   sum += (uintptr_t)xrsr_recv_msg_str((xrsr_recv_msg_t)(value % (XRSR_RECV_MSG_INVALID + 1)));
+   sum += (uintptr_t)xrsr_audio_container_str((xrsr_audio_container_t)(value % (XRSR_AUDIO_CONTAINER_INVALID + 1)));
+   sum += (uintptr_t)xrsr_queue_msg_type_str((xrsr_queue_msg_type_t)(value % (XRSR_QUEUE_MSG_TYPE_INVALID + 1)));
+   sum += (uintptr_t)xrsr_xraudio_state_str((xrsr_xraudio_state_t)(value % (XRSR_XRAUDIO_STATE_OPENED + 2)));
+   sum += (uintptr_t)xrsr_audio_format_str((xrsr_audio_format_t)((1 << (value % 8)) & ~XRSR_AUDIO_FORMAT_MAX));
+   sum += (uintptr_t)xrsr_audio_format_bitmask_str(value & (XRSR_AUDIO_FORMAT_MAX - 1));
+   sum += (uintptr_t)xrsr_stream_from_str((xrsr_stream_from_t)(value % (XRSR_STREAM_FROM_INVALID + 1)));
+   sum += (uintptr_t)xrsr_stream_until_str((xrsr_stream_until_t)(value % (XRSR_STREAM_UNTIL_INVALID + 1)));
+   sum += (uintptr_t)xrsr_power_mode_str((xrsr_power_mode_t)(value % (XRSR_POWER_MODE_INVALID + 1)));
+   sum += (uintptr_t)xrsr_address_family_str((xrsr_address_family_t)(value % (XRSR_ADDRESS_FAMILY_INVALID + 1)));
+   sum += (uintptr_t)xrsr_event_str((xrsr_event_t)(value % (XRSR_EVENT_INVALID + 1)));
+   sum += (uintptr_t)xrsr_recv_event_str((xrsr_recv_event_t)(value % (XRSR_RECV_EVENT_INVALID + 1)));
+
+   g_xrsr_microbench_sink = sum;
+}
+
+// An audio read recorded in the trace compared to formatting the log line which it replaced (without writing it)
+void xrsr_microbench_trace_record_run(void *ctx, uint64_t iteration) {
+   xrsr_trace_record(XRSR_TRACE_EVENT_WS_AUDIO_READ, XRSR_SRC_MICROPHONE, (int64_t)(iteration & 0xFFF), 0);
+}
+
+void xrsr_microbench_trace_format_run(void *ctx, uint64_t iteration) {
+   char line[128];
+   int  len = snprintf(line, sizeof(line), "src <%s> pipe read <%d>", xrsr_src_str(XRSR_SRC_MICROPHONE), (int)(iteration & 0xFFF));
+
+   g_xrsr_microbench_sink = (uintptr_t)len + (uintptr_t)line[len - 1];
+}
+
+// One 20 ms frame of four channel 32-bit audio converted to the keyword channel or a mix of all channels.  Setup
+// verifies that the vectorized kernel matches the scalar kernel.
+typedef struct {
+   xrsr_convert_kernel_t kernel;
+   float                 scale;
+   int32_t               in[XRSR_MICROBENCH_CONVERT_FRAME_QTY * XRAUDIO_INPUT_MAX_CHANNEL_QTY];
+   int16_t               out[XRSR_MICROBENCH_CONVERT_FRAME_QTY];
+} xrsr_microbench_convert_t;
+
+bool xrsr_microbench_convert_setup(void **ctx) {
+   xrsr_microbench_convert_t *convert = (xrsr_microbench_convert_t *)calloc(1, sizeof(xrsr_microbench_convert_t));
+   if(convert == NULL) {
+      return(false);
+   }
+   uint32_t seed = 1;
+   for(uint32_t index = 0; index < XRSR_MICROBENCH_CONVERT_FRAME_QTY * XRAUDIO_INPUT_MAX_CHANNEL_QTY; index++) {
+      seed = seed * 1103515245 + 12345;
+      convert->in[index] = (int32_t)seed;
+   }
+   convert->kernel = xrsr_convert_kernel_best();
+   convert->scale  = xrsr_convert_scale(6.0);
+
+   int16_t expected[XRSR_MICROBENCH_CONVERT_FRAME_QTY];
+   for(int32_t channel = -1; channel < XRAUDIO_INPUT_MAX_CHANNEL_QTY; channel++) {
+      xrsr_convert_s32_to_s16(XRSR_CONVERT_KERNEL_SCALAR, convert->in, XRAUDIO_INPUT_MAX_CHANNEL_QTY, channel, convert->scale, expected, XRSR_MICROBENCH_CONVERT_FRAME_QTY);
+      xrsr_convert_s32_to_s16(convert->kernel, convert->in, XRAUDIO_INPUT_MAX_CHANNEL_QTY, channel, convert->scale, convert->out, XRSR_MICROBENCH_CONVERT_FRAME_QTY);
+      if(memcmp(expected, convert->out, sizeof(expected)) != 0) {
+         XLOGD_ERROR("kernel <%s> channel <%d> does not match scalar output", xrsr_convert_kernel_str(convert->kernel), channel);
+         free(convert);
+         return(false);
+      }
+   }
+   *ctx = convert;
+   return(true);
+}
+
+static void xrsr_microbench_convert(xrsr_microbench_convert_t *convert, xrsr_convert_kernel_t kernel, int32_t channel) {
+   xrsr_convert_s32_to_s16(kernel, convert->in, XRAUDIO_INPUT_MAX_CHANNEL_QTY, channel, convert->scale, convert->out, XRSR_MICROBENCH_CONVERT_FRAME_QTY);
+   g_xrsr_microbench_sink = convert->out[0];
+}
+
+void xrsr_microbench_convert_scalar_chan_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_convert((xrsr_microbench_convert_t *)ctx, XRSR_CONVERT_KERNEL_SCALAR, 1);
+}
+
+void xrsr_microbench_convert_simd_chan_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_convert_t *convert = (xrsr_microbench_convert_t *)ctx;
+   xrsr_microbench_convert(convert, convert->kernel, 1);
+}
+
+void xrsr_microbench_convert_scalar_mix_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_convert((xrsr_microbench_convert_t *)ctx, XRSR_CONVERT_KERNEL_SCALAR, -1);
+}
+
+void xrsr_microbench_convert_simd_mix_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_convert_t *convert = (xrsr_microbench_convert_t *)ctx;
+   xrsr_microbench_convert(convert, convert->kernel, -1);
+}
+
+void xrsr_microbench_convert_teardown(void *ctx) {
+   free(ctx);
+}
+
+// One 20 ms chunk of 16 kHz audio resampled for a destination, as done by the resample stage.  A cost per operation
+// below 20000000 ns is faster than real time.
+typedef struct {
+   xrsr_resampler_t resampler;
+   int16_t          in[XRSR_MICROBENCH_CONVERT_FRAME_QTY];
+   int16_t *        out;
+} xrsr_microbench_resample_t;
+
+static bool xrsr_microbench_resample_setup(void **ctx, uint32_t rate_out) {
+   xrsr_microbench_resample_t *resample = (xrsr_microbench_resample_t *)calloc(1, sizeof(xrsr_microbench_resample_t));
+   if(resample == NULL) {
+      return(false);
+   }
+   if(!xrsr_resampler_init(&resample->resampler, 16000, rate_out, XRSR_MICROBENCH_CONVERT_FRAME_QTY)) {
+      free(resample);
+      return(false);
+   }
+   resample->out = (int16_t *)malloc(xrsr_resampler_output_max(&resample->resampler, XRSR_MICROBENCH_CONVERT_FRAME_QTY) * sizeof(int16_t));
+   if(resample->out == NULL) {
+      xrsr_resampler_term(&resample->resampler);
+      free(resample);
+      return(false);
+   }
+   uint32_t seed = 1;
+   for(uint32_t index = 0; index < XRSR_MICROBENCH_CONVERT_FRAME_QTY; index++) {
+      seed = seed * 1103515245 + 12345;
+      resample->in[index] = (int16_t)(seed >> 16);
+   }
+   *ctx = resample;
+   return(true);
+}
+
+bool xrsr_microbench_resample_8k_setup(void **ctx) {
+   return(xrsr_microbench_resample_setup(ctx, 8000));
+}
+
+bool xrsr_microbench_resample_24k_setup(void **ctx) {
+   return(xrsr_microbench_resample_setup(ctx, 24000));
+}
+
+bool xrsr_microbench_resample_44k1_setup(void **ctx) {
+   return(xrsr_microbench_resample_setup(ctx, 44100));
+}
+
+bool xrsr_microbench_resample_48k_setup(void **ctx) {
+   return(xrsr_microbench_resample_setup(ctx, 48000));
+}
+
+void xrsr_microbench_resample_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_resample_t *resample = (xrsr_microbench_resample_t *)ctx;
+   uint32_t out_qty = xrsr_resampler_process(&resample->resampler, resample->in, XRSR_MICROBENCH_CONVERT_FRAME_QTY, resample->out);
+   g_xrsr_microbench_sink = out_qty + resample->out[0];
+}
+
+void xrsr_microbench_resample_teardown(void *ctx) {
+   xrsr_microbench_resample_t *resample = (xrsr_microbench_resample_t *)ctx;
+   xrsr_resampler_term(&resample->resampler);
+   free(resample->out);
+   free(resample);
+}
+
+#ifdef WS_ENABLED
+// Outgoing text message queued by the application and dequeued by the websocket state machine
+static const char g_xrsr_microbench_ws_msg[] = "{\"msgType\":\"wuw\",\"trx\":\"0123456789abcdef0123456789abcdef\",\"sensitivity\":0.5,\"gain\":-12.5,\"dynamicGain\":true,\"audioModel\":\"far-field\"}";
+
+bool xrsr_microbench_ws_setup(void **ctx) {
+   xrsr_state_ws_t *ws = (xrsr_state_ws_t *)calloc(1, sizeof(xrsr_state_ws_t));
+   if(ws == NULL) {
+      return(false);
+   }
+   sem_init(&ws->msg_out_semaphore, 0, 1);
+   ws->audio_src = XRSR_SRC_MICROPHONE;
+   *ctx = ws;
+   return(true);
+}
+
+void xrsr_microbench_ws_msg_out_run(void *ctx, uint64_t iteration) {
+   xrsr_state_ws_t *ws  = (xrsr_state_ws_t *)ctx;
+   char *           msg = NULL;
+   uint32_t         length = 0;
+
+   xrsr_ws_queue_msg_out(ws, g_xrsr_microbench_ws_msg, sizeof(g_xrsr_microbench_ws_msg) - 1);
+   if(xrsr_ws_get_msg_out(ws, &msg, &length)) {
+      free(msg);
+   }
+}
+
+void xrsr_microbench_ws_teardown(void *ctx) {
+   xrsr_state_ws_t *ws = (xrsr_state_ws_t *)ctx;
+   sem_destroy(&ws->msg_out_semaphore);
+   free(ws);
+}
+
+// One binary audio frame masked and written to a local socket, which is drained after each frame.  The nopoll variants
+// follow the steps of nopoll_conn_send_frame: the header and payload are copied into a new buffer, the payload is
+// masked a byte at a time and the buffer is sent.  Setup verifies that the native kernels match nopoll's masking.
+typedef struct {
+   noPollCtx *           ctx;
+   xrsr_ws_frame_t       frame;
+   xrsr_convert_kernel_t kernel;
+   int                   fds[2];
+   uint8_t               mask[4];
+   uint8_t               in[XRSR_MICROBENCH_WS_FRAME_SIZE];
+   uint8_t               out[XRSR_MICROBENCH_WS_FRAME_SIZE];
+   uint8_t               drain[XRSR_MICROBENCH_WS_FRAME_SIZE + XRSR_WS_FRAME_HEADER_SIZE_MAX];
+} xrsr_microbench_ws_frame_t;
+
+bool xrsr_microbench_ws_frame_setup(void **ctx) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)calloc(1, sizeof(xrsr_microbench_ws_frame_t));
+   if(bench == NULL) {
+      return(false);
+   }
+   bench->fds[0] = -1;
+   bench->fds[1] = -1;
+   bench->ctx    = nopoll_ctx_new();
+   if(bench->ctx == NULL || !xrsr_ws_frame_init(&bench->frame, XRSR_MICROBENCH_WS_FRAME_SIZE) || socketpair(AF_UNIX, SOCK_STREAM, 0, bench->fds) != 0) {
+      xrsr_microbench_ws_frame_teardown(bench);
+      return(false);
+   }
+   uint32_t seed = 1;
+   for(uint32_t index = 0; index < XRSR_MICROBENCH_WS_FRAME_SIZE; index++) {
+      seed = seed * 1103515245 + 12345;
+      bench->in[index] = (uint8_t)(seed >> 16);
+   }
+   bench->mask[0] = 0x37;
+   bench->mask[1] = 0xFA;
+   bench->mask[2] = 0x21;
+   bench->mask[3] = 0x3D;
+   bench->kernel  = xrsr_convert_kernel_best();
+
+   // Odd lengths check the bytes after the last vector
+   uint32_t length = XRSR_MICROBENCH_WS_FRAME_SIZE - 3;
+   memcpy(bench->drain, bench->in, length);
+   nopoll_conn_mask_content(bench->ctx, (char *)bench->drain, (int)length, (char *)bench->mask, 0);
+   for(xrsr_convert_kernel_t kernel = XRSR_CONVERT_KERNEL_SCALAR; kernel < XRSR_CONVERT_KERNEL_INVALID; kernel++) {
+      if(!xrsr_convert_kernel_available(kernel)) {
+         continue;
+      }
+      xrsr_ws_frame_mask(kernel, bench->out, bench->in, length, bench->mask);
+      if(memcmp(bench->drain, bench->out, length) != 0) {
+         XLOGD_ERROR("kernel <%s> does not match nopoll output", xrsr_convert_kernel_str(kernel));
+         xrsr_microbench_ws_frame_teardown(bench);
+         return(false);
+      }
+   }
+   *ctx = bench;
+   return(true);
+}
+
+static void xrsr_microbench_ws_frame_drain(xrsr_microbench_ws_frame_t *bench, uint32_t length) {
+   while(length > 0) {
+      ssize_t rc = read(bench->fds[1], bench->drain, (length < sizeof(bench->drain)) ? length : sizeof(bench->drain));
+      if(rc <= 0) {
+         break;
+      }
+      length -= (uint32_t)rc;
+   }
+}
+
+void xrsr_microbench_ws_mask_nopoll_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)ctx;
+   memcpy(bench->out, bench->in, XRSR_MICROBENCH_WS_FRAME_SIZE);
+   nopoll_conn_mask_content(bench->ctx, (char *)bench->out, XRSR_MICROBENCH_WS_FRAME_SIZE, (char *)bench->mask, 0);
+   g_xrsr_microbench_sink = bench->out[0];
+}
+
+void xrsr_microbench_ws_mask_scalar_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)ctx;
+   xrsr_ws_frame_mask(XRSR_CONVERT_KERNEL_SCALAR, bench->out, bench->in, XRSR_MICROBENCH_WS_FRAME_SIZE, bench->mask);
+   g_xrsr_microbench_sink = bench->out[0];
+}
+
+void xrsr_microbench_ws_mask_simd_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)ctx;
+   xrsr_ws_frame_mask(bench->kernel, bench->out, bench->in, XRSR_MICROBENCH_WS_FRAME_SIZE, bench->mask);
+   g_xrsr_microbench_sink = bench->out[0];
+}
+
+void xrsr_microbench_ws_send_nopoll_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_ws_frame_t *bench  = (xrsr_microbench_ws_frame_t *)ctx;
+   uint32_t                    length = XRSR_MICROBENCH_WS_FRAME_SIZE + XRSR_WS_FRAME_HEADER_SIZE_MAX;
+   uint8_t *                   buffer = (uint8_t *)malloc(length);
+   if(buffer == NULL) {
+      return;
+   }
+   uint32_t header_len = xrsr_ws_frame_header(buffer, XRSR_WS_FRAME_OPCODE_BINARY, XRSR_MICROBENCH_WS_FRAME_SIZE, bench->mask);
+   memcpy(&buffer[header_len], bench->in, XRSR_MICROBENCH_WS_FRAME_SIZE);
+   nopoll_conn_mask_content(bench->ctx, (char *)&buffer[header_len], XRSR_MICROBENCH_WS_FRAME_SIZE, (char *)bench->mask, 0);
+   ssize_t rc = send(bench->fds[0], buffer, header_len + XRSR_MICROBENCH_WS_FRAME_SIZE, MSG_NOSIGNAL);
+   free(buffer);
+   if(rc > 0) {
+      xrsr_microbench_ws_frame_drain(bench, (uint32_t)rc);
+   }
+}
+
+void xrsr_microbench_ws_send_native_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)ctx;
+   // Masked from the input into a second buffer as on the replay path, so the input is unchanged between runs
+   int rc = xrsr_ws_frame_send_binary(&bench->frame, bench->fds[0], bench->out, bench->in, XRSR_MICROBENCH_WS_FRAME_SIZE);
+   if(rc > 0) {
+      xrsr_microbench_ws_frame_drain(bench, (uint32_t)rc + 8); // base header, 16-bit length and masking key
+   }
+}
+
+void xrsr_microbench_ws_frame_teardown(void *ctx) {
+   xrsr_microbench_ws_frame_t *bench = (xrsr_microbench_ws_frame_t *)ctx;
+   for(uint32_t index = 0; index < 2; index++) {
+      if(bench->fds[index] >= 0) {
+         close(bench->fds[index]);
+      }
+   }
+   xrsr_ws_frame_term(&bench->frame);
+   if(bench->ctx != NULL) {
+      nopoll_ctx_unref(bench->ctx);
+   }
+   free(bench);
+}
+#endif
+
+#ifdef HTTP_ENABLED
+// Response delivered in curl sized chunks into the response buffer, which is reset as it is at session start
+typedef struct {
+   xrsr_state_http_t http;
+   char              response[XRSR_PROTOCOL_HTTP_BUFFER_SIZE_MAX];
+} xrsr_microbench_http_t;
+
+bool xrsr_microbench_http_setup(void **ctx) {
+   xrsr_microbench_http_t *http = (xrsr_microbench_http_t *)calloc(1, sizeof(xrsr_microbench_http_t));
+   if(http == NULL) {
+      return(false);
+   }
+   for(uint32_t index = 0; index < sizeof(http->response); index++) {
+      http->response[index] = 'a' + (index % 26);
+   }
+   *ctx = http;
+   return(true);
+}
+
+static void xrsr_microbench_http_write(xrsr_microbench_http_t *http, uint32_t length) {
+   memset(&http->http.write_buffer, 0, sizeof(http->http.write_buffer));
+   for(uint32_t offset = 0; offset < length; offset += XRSR_MICROBENCH_HTTP_CHUNK_SIZE) {
+      uint32_t chunk = length - offset;
+      if(chunk > XRSR_MICROBENCH_HTTP_CHUNK_SIZE) {
+         chunk = XRSR_MICROBENCH_HTTP_CHUNK_SIZE;
+      }
+      _xrsr_http_write_function(&http->response[offset], 1, chunk, &http->http);
+   }
+}
+
+void xrsr_microbench_http_write_4k_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_http_write((xrsr_microbench_http_t *)ctx, 4096);
+}
+
+void xrsr_microbench_http_write_32k_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_http_write((xrsr_microbench_http_t *)ctx, 32768);
+}
+
+void xrsr_microbench_http_write_max_run(void *ctx, uint64_t iteration) {
+   xrsr_microbench_http_write((xrsr_microbench_http_t *)ctx, XRSR_PROTOCOL_HTTP_BUFFER_SIZE_MAX - 1);
+}
+
+void xrsr_microbench_http_teardown(void *ctx) {
+   free(ctx);
+}
+#endif
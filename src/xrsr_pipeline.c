@@ -0,0 +1,354 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "xrsr_private.h"
+
+// A destination's pipeline passes the audio from xraudio through each stage in order when the protocol reads it, so the
+// stages run on the protocol's thread and no other pipe or thread is involved.  The stages exchange audio in two
+// preallocated frames and the output of the last stage is held until the protocol has read all of it.
+
+static bool  xrsr_pipeline_input(xrsr_pipeline_t *pipeline, uint32_t size_out);
+static bool  xrsr_pipeline_run(xrsr_pipeline_t *pipeline, uint32_t index, const xrsr_frame_t *in);
+static bool  xrsr_pipeline_flush(xrsr_pipeline_t *pipeline);
+static bool  xrsr_pipeline_write(xrsr_pipeline_t *pipeline, const uint8_t *data, uint32_t size);
+static void  xrsr_pipeline_stage_time(xrsr_pipeline_stage_t *stage, rdkx_timestamp_t *begin);
+
+bool xrsr_pipeline_create(xrsr_pipeline_t **pipeline, uint32_t frame_size_in) {
+   if(pipeline == NULL || frame_size_in == 0 || frame_size_in * XRSR_PIPELINE_FRAME_QTY > XRSR_STAGE_FRAME_SIZE_MAX) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   xrsr_pipeline_t *obj = (xrsr_pipeline_t *)malloc(sizeof(xrsr_pipeline_t));
+   if(obj == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   memset(obj, 0, sizeof(*obj));
+   obj->buffers = (uint8_t *)malloc(3 * XRSR_STAGE_FRAME_SIZE_MAX);
+   if(obj->buffers == NULL) {
+      XLOGD_ERROR("out of memory");
+      free(obj);
+      return(false);
+   }
+   obj->fd_in         = -1;
+   obj->frame_size_in = frame_size_in;
+
+   obj->input.buffer   = obj->buffers;
+   obj->input.capacity = frame_size_in * XRSR_PIPELINE_FRAME_QTY;
+   for(uint32_t index = 0; index < 2; index++) {
+      obj->frames[index].buffer   = obj->buffers + (index + 1) * XRSR_STAGE_FRAME_SIZE_MAX;
+      obj->frames[index].capacity = XRSR_STAGE_FRAME_SIZE_MAX;
+   }
+
+   *pipeline = obj;
+   return(true);
+}
+
+// Appends a stage to the pipeline.  The stage is skipped if its open handler declines the stream.  Once added, the
+// stage is closed when the pipeline is destroyed.  If it cannot be added, the stage is closed before returning.
+bool xrsr_pipeline_stage_add(xrsr_pipeline_t *pipeline, const xrsr_stage_t *stage, xrsr_audio_format_t format, uint32_t sample_rate) {
+   if(pipeline == NULL || stage == NULL || stage->process == NULL || pipeline->started) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   const char *name = (stage->name == NULL) ? "" : stage->name;
+
+   if(stage->open != NULL && !(*stage->open)(stage->data, format, sample_rate)) {
+      XLOGD_INFO("stage <%s> not used for format <%s> sample rate <%u>", name, xrsr_audio_format_str(format), sample_rate);
+      return(true);
+   }
+   if(pipeline->stage_qty >= XRSR_STAGE_QTY_MAX) {
+      XLOGD_ERROR("stage <%s> exceeds maximum <%u>", name, XRSR_STAGE_QTY_MAX);
+      if(stage->close != NULL) {
+         (*stage->close)(stage->data);
+      }
+      return(false);
+   }
+   xrsr_pipeline_stage_t *entry = &pipeline->stages[pipeline->stage_qty++];
+   memset(entry, 0, sizeof(*entry));
+   entry->stage      = *stage;
+   entry->stage.name = name;
+   return(true);
+}
+
+uint32_t xrsr_pipeline_stage_qty(const xrsr_pipeline_t *pipeline) {
+   return(pipeline->stage_qty);
+}
+
+// Starts the pipeline on the pipe from xraudio, which the protocol keeps polling and closing.  The pipe is made
+// non-blocking so that a read returns when the stages are holding all of the audio that is available.
+bool xrsr_pipeline_start(xrsr_pipeline_t *pipeline, int fd_in, uint32_t byte_rate_in, uint32_t byte_rate_out) {
+   if(pipeline == NULL || fd_in < 0 || pipeline->started || pipeline->stage_qty == 0 || byte_rate_in == 0) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   // A flush at the end of the stream can output a frame from each stage
+   pipeline->output.buffer = (uint8_t *)malloc(pipeline->stage_qty * XRSR_STAGE_FRAME_SIZE_MAX);
+   if(pipeline->output.buffer == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   pipeline->output.capacity = pipeline->stage_qty * XRSR_STAGE_FRAME_SIZE_MAX;
+   pipeline->output.size     = 0;
+
+   int flags = fcntl(fd_in, F_GETFL);
+   if(flags < 0 || fcntl(fd_in, F_SETFL, flags | O_NONBLOCK) < 0) {
+      int errsv = errno;
+      XLOGD_ERROR("unable to set non-blocking <%s>", strerror(errsv));
+      free(pipeline->output.buffer);
+      pipeline->output.buffer = NULL;
+      return(false);
+   }
+   pipeline->fd_in         = fd_in;
+   pipeline->byte_rate_in  = byte_rate_in;
+   pipeline->byte_rate_out = (byte_rate_out == 0) ? byte_rate_in : byte_rate_out;
+   pipeline->started       = true;
+
+   char names[XRSR_STAGE_QTY_MAX * (XRSR_STAGE_NAME_LEN_MAX + 1)];
+   uint32_t offset = 0;
+   names[0] = '\0';
+   for(uint32_t index = 0; index < pipeline->stage_qty && offset < sizeof(names); index++) {
+      offset += snprintf(&names[offset], sizeof(names) - offset, "%s%.*s", (index == 0) ? "" : " ", XRSR_STAGE_NAME_LEN_MAX - 1, pipeline->stages[index].stage.name);
+   }
+   XLOGD_INFO("stages <%s>", names);
+   return(true);
+}
+
+// Reads audio from xraudio and passes it through the stages.  Returns the quantity of output bytes copied to buffer,
+// zero at the end of the stream, or -1 with errno set.  EAGAIN indicates that the stages are holding all of the audio
+// which has been read, so the protocol waits for the pipe to be readable again.
+int xrsr_pipeline_read(xrsr_pipeline_t *pipeline, uint8_t *buffer, uint32_t size) {
+   if(pipeline == NULL || !pipeline->started || buffer == NULL || size == 0) {
+      errno = EINVAL;
+      return(-1);
+   }
+   while(pipeline->output_offset == pipeline->output.size) {
+      if(pipeline->failed) {
+         errno = EIO;
+         return(-1);
+      }
+      if(pipeline->eos) {
+         return(0);
+      }
+      pipeline->output.size   = 0;
+      pipeline->output_offset = 0;
+      if(!xrsr_pipeline_input(pipeline, size)) {
+         return(-1);
+      }
+   }
+   uint32_t qty = pipeline->output.size - pipeline->output_offset;
+   if(qty > size) {
+      qty = size;
+   }
+   memcpy(buffer, pipeline->output.buffer + pipeline->output_offset, qty);
+   pipeline->output_offset += qty;
+   return((int)qty);
+}
+
+// Audio waiting to be read by the protocol, in output bytes.  bytes_in is the audio waiting in the pipe from xraudio.
+uint32_t xrsr_pipeline_backlog(const xrsr_pipeline_t *pipeline, uint32_t bytes_in) {
+   return(xrsr_pipeline_position(pipeline, bytes_in + pipeline->input_buffered) + (pipeline->output.size - pipeline->output_offset));
+}
+
+// Translates a position in the audio from xraudio to the position in the pipeline's output.  The stages do not drop
+// audio before the end of the keyword, so positions up to that point scale with the byte rates.
+uint32_t xrsr_pipeline_position(const xrsr_pipeline_t *pipeline, uint32_t bytes_in) {
+   return((uint32_t)(((uint64_t)bytes_in * pipeline->byte_rate_out) / pipeline->byte_rate_in));
+}
+
+// Closes the stages and reports their statistics.  The input pipe is closed by the protocol.
+void xrsr_pipeline_destroy(xrsr_pipeline_t *pipeline, xrsr_stream_stats_t *stats) {
+   if(pipeline == NULL) {
+      return;
+   }
+   if(pipeline->started) {
+      XLOGD_INFO("bytes in <%u> out <%u>%s", pipeline->bytes_in, pipeline->bytes_out, pipeline->failed ? " FAILED" : "");
+   }
+
+   if(stats != NULL) {
+      stats->stage_qty = pipeline->stage_qty;
+   }
+   for(uint32_t index = 0; index < pipeline->stage_qty; index++) {
+      xrsr_pipeline_stage_t *entry    = &pipeline->stages[index];
+      uint32_t               time_avg = (entry->frame_qty == 0) ? 0 : (uint32_t)(entry->time_total / entry->frame_qty);
+
+      if(pipeline->started) {
+         XLOGD_INFO("stage <%s> frames <%u> bytes in <%u> out <%u> time avg <%u> max <%u> us", entry->stage.name, entry->frame_qty, entry->bytes_in, entry->bytes_out, time_avg, entry->time_max);
+      }
+      if(stats != NULL) {
+         xrsr_stage_stats_t *stage_stats = &stats->stages[index];
+         snprintf(stage_stats->name, sizeof(stage_stats->name), "%s", entry->stage.name);
+         stage_stats->frame_qty = entry->frame_qty;
+         stage_stats->bytes_in  = entry->bytes_in;
+         stage_stats->bytes_out = entry->bytes_out;
+         stage_stats->time_avg  = time_avg;
+         stage_stats->time_max  = entry->time_max;
+      }
+      if(entry->stage.close != NULL) {
+         (*entry->stage.close)(entry->stage.data);
+      }
+   }
+   free(pipeline->output.buffer);
+   free(pipeline->buffers);
+   free(pipeline);
+}
+
+// Reads from the pipe until the stages output audio, the pipe is empty or the stream ends.  Each read is limited to
+// about the input which fills the protocol's buffer once processed, so that little output is left waiting.
+bool xrsr_pipeline_input(xrsr_pipeline_t *pipeline, uint32_t size_out) {
+   xrsr_frame_t *input = &pipeline->input;
+   uint32_t      size  = (uint32_t)(((uint64_t)size_out * pipeline->byte_rate_in) / pipeline->byte_rate_out);
+
+   if(size < pipeline->frame_size_in) {
+      size = pipeline->frame_size_in;
+   }
+   do {
+      uint32_t space = input->capacity - pipeline->input_buffered;
+      ssize_t  rc    = read(pipeline->fd_in, input->buffer + pipeline->input_buffered, (size < space) ? size : space);
+      if(rc < 0) {
+         if(errno == EINTR) {
+            continue;
+         }
+         if(errno != EAGAIN && errno != EWOULDBLOCK) {
+            int errsv = errno;
+            XLOGD_ERROR("read <%s>", strerror(errsv));
+            errno = errsv;
+         }
+         return(false);
+      }
+      if(rc == 0) { // end of stream, a partial sample frame is dropped
+         pipeline->eos = true;
+         if(!xrsr_pipeline_flush(pipeline)) {
+            pipeline->failed = true;
+         }
+         return(true);
+      }
+      pipeline->input_buffered += rc;
+      pipeline->bytes_in       += rc;
+      xrsr_trace_record(XRSR_TRACE_EVENT_PIPELINE_READ, XRSR_SRC_INVALID, rc, pipeline->input_buffered);
+
+      // Stages only receive whole sample frames
+      input->size = pipeline->input_buffered - (pipeline->input_buffered % pipeline->frame_size_in);
+      if(input->size == 0) {
+         continue;
+      }
+      if(!xrsr_pipeline_run(pipeline, 0, input)) {
+         pipeline->failed = true;
+         return(true);
+      }
+      pipeline->input_buffered -= input->size;
+      if(pipeline->input_buffered > 0) {
+         memmove(input->buffer, input->buffer + input->size, pipeline->input_buffered);
+      }
+   } while(pipeline->output.size == 0);
+
+   return(true);
+}
+
+// Passes a frame through the stages beginning at index and adds the result to the output
+bool xrsr_pipeline_run(xrsr_pipeline_t *pipeline, uint32_t index, const xrsr_frame_t *in) {
+   for(; index < pipeline->stage_qty; index++) {
+      xrsr_pipeline_stage_t *entry = &pipeline->stages[index];
+      xrsr_frame_t *         out   = (in == &pipeline->frames[0]) ? &pipeline->frames[1] : &pipeline->frames[0];
+      rdkx_timestamp_t       begin;
+
+      out->size = 0;
+      rdkx_timestamp_get(&begin);
+      if(!(*entry->stage.process)(entry->stage.data, in, out)) {
+         XLOGD_ERROR("stage <%s> process failed", entry->stage.name);
+         return(false);
+      }
+      xrsr_pipeline_stage_time(entry, &begin);
+      entry->bytes_in  += in->size;
+      entry->bytes_out += out->size;
+
+      if(out->size == 0) { // the stage is holding the audio
+         return(true);
+      }
+      in = out;
+   }
+   return(xrsr_pipeline_write(pipeline, in->buffer, in->size));
+}
+
+// Each stage outputs the audio that it is holding, which is passed through the remaining stages before they flush.  A
+// stage which fills the frame is flushed again.
+bool xrsr_pipeline_flush(xrsr_pipeline_t *pipeline) {
+   for(uint32_t index = 0; index < pipeline->stage_qty; index++) {
+      xrsr_pipeline_stage_t *entry = &pipeline->stages[index];
+      if(entry->stage.flush == NULL) {
+         continue;
+      }
+      bool full;
+      do {
+         xrsr_frame_t *   out = &pipeline->frames[0];
+         rdkx_timestamp_t begin;
+
+         out->size = 0;
+         rdkx_timestamp_get(&begin);
+         if(!(*entry->stage.flush)(entry->stage.data, out)) {
+            XLOGD_ERROR("stage <%s> flush failed", entry->stage.name);
+            return(false);
+         }
+         xrsr_pipeline_stage_time(entry, &begin);
+         entry->bytes_out += out->size;
+         full              = (out->size == out->capacity); // the frame is reused by the remaining stages
+
+         if(out->size > 0 && !xrsr_pipeline_run(pipeline, index + 1, out)) {
+            return(false);
+         }
+      } while(full);
+   }
+   return(true);
+}
+
+void xrsr_pipeline_stage_time(xrsr_pipeline_stage_t *entry, rdkx_timestamp_t *begin) {
+   rdkx_timestamp_t end;
+   rdkx_timestamp_get(&end);
+
+   uint32_t elapsed = (uint32_t)rdkx_timestamp_subtract_us(*begin, end);
+
+   entry->frame_qty++;
+   entry->time_total += elapsed;
+   if(elapsed > entry->time_max) {
+      entry->time_max = elapsed;
+   }
+}
+
+bool xrsr_pipeline_write(xrsr_pipeline_t *pipeline, const uint8_t *data, uint32_t size) {
+   xrsr_frame_t *output = &pipeline->output;
+   if(size > output->capacity - output->size) { // a stage flushed more than a frame at the end of the stream
+      uint8_t *buffer = (uint8_t *)realloc(output->buffer, output->size + size);
+      if(buffer == NULL) {
+         XLOGD_ERROR("output overflow size <%u> held <%u>", size, output->size);
+         return(false);
+      }
+      output->buffer   = buffer;
+      output->capacity = output->size + size;
+   }
+   memcpy(output->buffer + output->size, data, size);
+   output->size        += size;
+   pipeline->bytes_out += size;
+   return(true);
+}
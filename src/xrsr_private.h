@@ -22,6 +22,9 @@
 #define __XRSR_PRIVATE__
 
 #include <semaphore.h>
+#include <pthread.h>
+#include <sys/select.h>
+#include <sys/socket.h>
 #include <bsd/string.h>
 #include <errno.h>
 #include "safec_lib.h"
@@ -52,7 +55,8 @@ typedef enum {
    XRSR_QUEUE_MSG_TYPE_SESSION_CAPTURE_START                   = 16,
    XRSR_QUEUE_MSG_TYPE_SESSION_CAPTURE_STOP                    = 17,
    XRSR_QUEUE_MSG_TYPE_THREAD_POLL                             = 18,
-   XRSR_QUEUE_MSG_TYPE_INVALID                                 = 19,
+   XRSR_QUEUE_MSG_TYPE_CIRCUIT_PROBE                           = 19,
+   XRSR_QUEUE_MSG_TYPE_INVALID                                 = 20,
 } xrsr_queue_msg_type_t;
 
 typedef enum {
@@ -106,6 +110,169 @@ typedef struct {
    bool                  has_fragment;
 } xrsr_url_parts_t;
 
+#define XRSR_ENDPOINT_QTY_MAX (4)
+
+typedef struct {
+   xrsr_url_parts_t url_parts;
+   uint32_t         session_qty;   // quantity of sessions which ended on this endpoint
+   double           time_connect;  // moving average of the connect time (in seconds)
+   double           time_response; // moving average of the time to the first server response (in seconds)
+   double           failure_rate;  // moving average of the session failures (0.0 - 1.0)
+   uint32_t         failure_run;   // consecutive session failures
+   uint32_t         selected_last; // pool selection count when the endpoint was last selected
+   rdkx_timestamp_t skip_until;    // an unhealthy endpoint is not selected until this time
+} xrsr_endpoint_t;
+
+typedef struct {
+   uint32_t        qty;
+   uint32_t        index;          // endpoint selected for the current session
+   uint32_t        selection_cnt;
+   xrsr_endpoint_t endpoints[XRSR_ENDPOINT_QTY_MAX];
+} xrsr_endpoint_pool_t;
+
+#define XRSR_EYEBALLS_ADDR_QTY_MAX  (8)
+#define XRSR_EYEBALLS_ATTEMPT_DELAY (250) // delay before starting the next connection attempt (in ms, RFC 8305)
+
+typedef struct {
+   const char *            host;
+   uint32_t                qty;                               // quantity of resolved addresses
+   uint32_t                next;                              // index of the next address to attempt
+   uint32_t                attempt_delay;
+   rdkx_timestamp_t        attempt_next;                      // time to start the next attempt
+   int                     fds[XRSR_EYEBALLS_ADDR_QTY_MAX];
+   struct sockaddr_storage addrs[XRSR_EYEBALLS_ADDR_QTY_MAX];
+   socklen_t               addr_lens[XRSR_EYEBALLS_ADDR_QTY_MAX];
+   xrsr_address_family_t   family;                            // family of the winning address
+   char                    ip[XRSR_SESSION_IP_LEN_MAX];       // winning address
+} xrsr_eyeballs_t;
+
+typedef struct {
+   xrsr_src_t               src;
+   uint32_t                 dst_index;
+   rdkx_timer_object_t      timer_obj;
+   rdkx_timer_id_t          timer_id;
+   xrsr_circuit_state_t     state;
+   uint32_t                 threshold;       // consecutive session failures which open the circuit (0 disables the circuit breaker)
+   uint32_t                 open_period;     // time the circuit stays open before probing (in ms)
+   uint32_t                 open_period_cur; // doubles each time the destination fails to recover
+   uint32_t                 timeout_probe;   // time allowed for a probe to connect (in ms)
+   uint32_t                 failure_run;
+   bool                     trial;           // a half open trial session is in progress
+   uint32_t                 probe_id;        // identifies the probe in progress (results from earlier probes are ignored)
+   bool                     probe_started;   // probe_thread has been started and not joined
+   pthread_t                probe_thread;
+   const xrsr_url_parts_t * url_parts;       // destination which is probed
+} xrsr_circuit_t;
+
+typedef struct {
+   uint32_t srtt_us;         // smoothed round trip time to the destination (0 if not measured)
+   uint32_t would_block_qty; // writes to the connection which would have blocked since the last update
+   uint32_t backlog_bytes;   // audio waiting in the pipe to be sent
+   uint32_t txd_bytes;       // audio sent since the last update
+   uint32_t interval_ms;     // time since the last update
+} xrsr_grouping_metrics_t;
+
+typedef struct {
+   bool     active;         // a stream which this destination began is in progress
+   bool     adaptive;       // false if the application requested low latency
+   uint32_t size;           // current audio frame group size (in bytes, 0 is a single frame)
+   uint32_t size_begin;
+   uint32_t size_floor;     // smallest group size for the measured round trip time
+   uint32_t srtt_us;        // most recent round trip time reported by the protocol
+   bool     measured;       // the protocol reported network conditions during the stream
+   uint32_t clear_qty;      // consecutive uncongested updates
+   uint32_t adjust_qty;
+   uint32_t congestion_qty;
+   bool     congested;      // the previous stream ended with a larger group than its floor
+} xrsr_grouping_t;
+
+typedef struct {
+   double           uplink_bps; // estimated uplink throughput to the destination (bytes per second, 0 if not measured)
+   bool             limited;    // the estimate was measured while audio was backing up so it is the uplink's capacity
+   rdkx_timestamp_t measured;
+   uint32_t         srtt_us;
+} xrsr_format_link_t;
+
+typedef enum {
+   XRSR_TRACE_EVENT_HTTP_AUDIO_SENT    = 0,
+   XRSR_TRACE_EVENT_SDT_AUDIO_READ     = 1,
+   XRSR_TRACE_EVENT_WS_SOCKET_READ     = 2,
+   XRSR_TRACE_EVENT_WS_PENDING_WAIT    = 3,
+   XRSR_TRACE_EVENT_WS_PENDING_SENT    = 4,
+   XRSR_TRACE_EVENT_WS_AUDIO_READ      = 5,
+   XRSR_TRACE_EVENT_WS_AUDIO_QUEUED    = 6,
+   XRSR_TRACE_EVENT_WS_AUDIO_DRAIN     = 7,
+   XRSR_TRACE_EVENT_UNIX_AUDIO_SENT    = 8,
+   XRSR_TRACE_EVENT_UNIX_AUDIO_PENDING = 9,
+   XRSR_TRACE_EVENT_PIPELINE_READ      = 10,
+   XRSR_TRACE_EVENT_INVALID            = 11,
+} xrsr_trace_event_t;
+
+typedef enum {
+   XRSR_CONVERT_KERNEL_SCALAR  = 0,
+   XRSR_CONVERT_KERNEL_SSE2    = 1,
+   XRSR_CONVERT_KERNEL_AVX2    = 2,
+   XRSR_CONVERT_KERNEL_NEON    = 3,
+   XRSR_CONVERT_KERNEL_INVALID = 4,
+} xrsr_convert_kernel_t;
+
+typedef struct {
+   uint32_t channel_qty; // interleaved 32-bit channels from xraudio
+   int32_t  channel;     // channel to send, or less than zero to mix all channels
+   float    gain_db;
+} xrsr_convert_params_t;
+
+typedef struct {
+   uint32_t              rate_in;
+   uint32_t              rate_out;
+   uint32_t              up;            // interpolation factor
+   uint32_t              down;          // decimation factor
+   uint32_t              phase;         // filter phase of the next output sample
+   uint32_t              index;         // input sample aligned with the next output sample, relative to the next chunk
+   uint32_t              chunk_qty_max;
+   xrsr_convert_kernel_t kernel;
+   float *               coeffs;        // taps for each phase
+   float *               buffer;        // filter history followed by the current chunk
+} xrsr_resampler_t;
+
+#define XRSR_PIPELINE_FRAME_QTY     (320) // sample frames read from xraudio at a time (20 ms at 16 kHz)
+#define XRSR_PIPELINE_STAGE_QTY_APP (XRSR_STAGE_QTY_MAX - 4) // leaves room for the conversion, resampling, trimming and encoding stages
+
+typedef struct {
+   float    threshold; // level above the noise floor for speech (in dB)
+   uint32_t lead;      // silence passed before speech (in milliseconds)
+   uint32_t tail;      // silence passed after speech (in milliseconds)
+} xrsr_trim_config_t;
+
+typedef struct {
+   xrsr_stage_t stage;
+   uint32_t     frame_qty;
+   uint32_t     bytes_in;
+   uint32_t     bytes_out;
+   uint64_t     time_total; // in microseconds
+   uint32_t     time_max;   // in microseconds
+} xrsr_pipeline_stage_t;
+
+typedef struct {
+   bool                  started;
+   bool                  eos;            // the pipe from xraudio is at its end and the stages have been flushed
+   int                   fd_in;          // audio from xraudio, read by the protocol through the pipeline
+   uint32_t              frame_size_in;  // bytes per sample frame of the input, which is only passed to the stages in whole frames
+   uint32_t              byte_rate_in;
+   uint32_t              byte_rate_out;
+   uint32_t              stage_qty;
+   xrsr_pipeline_stage_t stages[XRSR_STAGE_QTY_MAX];
+   uint8_t *             buffers;       // input buffer followed by the two frames which are alternated between stages
+   xrsr_frame_t          input;
+   uint32_t              input_buffered; // bytes of a partial sample frame held in the input buffer
+   xrsr_frame_t          frames[2];
+   xrsr_frame_t          output;         // output of the last stage which the protocol has not read
+   uint32_t              output_offset;
+   uint32_t              bytes_in;
+   uint32_t              bytes_out;
+   bool                  failed;
+} xrsr_pipeline_t;
+
 typedef struct {
    bool     *debug;
    uint32_t *connect_check_interval;
@@ -114,6 +281,18 @@ typedef struct {
    uint32_t *timeout_session;
    bool     *ipv4_fallback;
    uint32_t *backoff_delay;
+   uint32_t *reconnect_buffer_size;
+   uint32_t *send_queue_size;
+   uint32_t *send_queue_latency;
+   uint32_t *hedge_delay;
+   xrsr_socket_profile_t *socket_profile;
+   bool     *deflate;
+   bool     *deflate_no_context_takeover;
+   bool     *http2_disabled;
+   bool     *fd_passing;
+   uint32_t *circuit_threshold;
+   uint32_t *circuit_open_period;
+   uint32_t *ping_interval;
 } xrsr_dst_param_ptrs_t;
 
 typedef struct {
@@ -248,6 +427,14 @@ typedef struct {
    xrsr_thread_poll_func_t func;
 } xrsr_queue_msg_thread_poll_t;
 
+typedef struct {
+   xrsr_queue_msg_header_t header;
+   xrsr_src_t              src;
+   uint32_t                dst_index;
+   uint32_t                probe_id;
+   bool                    result;
+} xrsr_queue_msg_circuit_probe_t;
+
 // Make sure all vrexm_queue_msg types are added to this union so
 // that XRSR_MSG_QUEUE_MSG_SIZE_MAX can be set to the max message size
 typedef union {
@@ -265,6 +452,7 @@ typedef union {
    xrsr_queue_msg_session_capture_stop_t           session_capture_stop;
    xrsr_queue_msg_privacy_mode_get_t               privacy_mode_get;
    xrsr_queue_msg_thread_poll_t                    thread_poll;
+   xrsr_queue_msg_circuit_probe_t                  circuit_probe;
 } xrsr_queue_msg_union_t;
 
 typedef void *xrsr_xraudio_object_t;
@@ -287,15 +475,29 @@ typedef void (*xrsr_timer_handler_t)(void *data);
 #include "xrsr_protocol_sdt.h"
 #endif
 
+#ifdef UNIX_ENABLED
+#include "xrsr_protocol_unix.h"
+#endif
+
+#ifdef OPUS_ENABLED
+#include "xrsr_encoder.h"
+#endif
+
 #include <xrsr_utils.h>
 
 bool xrsr_message_queue_open(int *msgq, size_t msgsize);
 void xrsr_message_queue_close(int *msgq);
 int  xrsr_queue_msg_push(int msgq, const char *msg, size_t msg_len);
 int  xrsr_msgq_fd_get(void);
+void xrsr_thread_fds_set(int *nfds, fd_set *rfds, fd_set *wfds);
+void xrsr_thread_fds_handle(fd_set *rfds, fd_set *wfds);
 xrsr_result_t xrsr_conn_send(void *param, const uint8_t *buffer, uint32_t length);
 bool xrsr_speech_stream_begin(const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xraudio_input_format_t native_format, bool user_initiated, bool low_latency, int *pipe_fd_read);
+uint32_t xrsr_speech_stream_frame_size(xrsr_src_t src, uint32_t dst_index);
+int      xrsr_speech_stream_read(xrsr_src_t src, uint32_t dst_index, int fd, uint8_t *buffer, uint32_t size);
+uint32_t xrsr_speech_stream_backlog(xrsr_src_t src, uint32_t dst_index, int fd, uint32_t bytes);
 bool xrsr_speech_stream_kwd(const uuid_t uuid, xrsr_src_t src, uint32_t dst_index);
+void xrsr_speech_stream_metrics(xrsr_src_t src, uint32_t dst_index, const xrsr_grouping_metrics_t *metrics);
 bool xrsr_speech_stream_end(const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_stream_end_reason_t reason, bool detect_resume, xrsr_audio_stats_t *audio_stats);
 
 void xrsr_session_stream_begin(const uuid_t uuid, const char *uuid_str, xrsr_src_t src, uint32_t dst_index);
@@ -314,7 +516,8 @@ void xrsr_xraudio_keyword_detect_params(xrsr_xraudio_object_t *obj, xraudio_keyw
 void xrsr_xraudio_keyword_detect_restart(xrsr_xraudio_object_t object);
 void xrsr_xraudio_keyword_detected(xrsr_xraudio_object_t object, xrsr_queue_msg_keyword_detected_t *msg, xrsr_src_t current_session_src);
 void xrsr_xraudio_keyword_detect_error(xrsr_xraudio_object_t object, xraudio_devices_input_t source);
-bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_id, xraudio_devices_input_t source, bool user_initiated, xraudio_input_format_t *format_decoded, xraudio_dst_pipe_t dsts[], uint16_t stream_time_min, uint32_t keyword_begin, uint32_t keyword_duration, uint32_t frame_duration, bool low_latency);
+bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_id, xraudio_devices_input_t source, bool user_initiated, xraudio_input_format_t *format_decoded, xraudio_dst_pipe_t dsts[], uint16_t stream_time_min, uint32_t keyword_begin, uint32_t keyword_duration, uint32_t frame_duration, bool low_latency, uint32_t group_size);
+bool xrsr_xraudio_stream_group_size_set(xrsr_xraudio_object_t object, xraudio_devices_input_t source, uint32_t group_size);
 bool xrsr_xraudio_stream_end(xrsr_xraudio_object_t object, xraudio_devices_input_t source, uint32_t dst_index, bool more_streams, bool detect_resume, xrsr_audio_stats_t *audio_stats);
 void xrsr_xraudio_stream_event_handler(xraudio_devices_input_t source, audio_in_callback_event_t event, xrsr_speech_event_t *speech_event);
 bool xrsr_xraudio_session_request(xrsr_xraudio_object_t object, xrsr_src_t src, xraudio_input_format_t xraudio_format, const char* transcription_in, bool low_latency);
@@ -332,4 +535,63 @@ void xrsr_session_begin(xrsr_src_t src, bool user_initiated, xraudio_input_forma
 void xrsr_keyword_detect_error(xrsr_src_t src);
 bool xrsr_mask_pii(void);
 
+bool              xrsr_endpoint_pool_init(xrsr_endpoint_pool_t *pool, const char *url, const char **urls);
+void              xrsr_endpoint_pool_free(xrsr_endpoint_pool_t *pool);
+xrsr_url_parts_t *xrsr_endpoint_select(xrsr_endpoint_pool_t *pool);
+void              xrsr_endpoint_result(xrsr_endpoint_pool_t *pool, const xrsr_session_stats_t *stats);
+bool              xrsr_endpoint_is_failure(xrsr_session_end_reason_t reason);
+bool              xrsr_endpoint_prot_match(xrsr_protocol_t a, xrsr_protocol_t b);
+
+void xrsr_circuit_init(xrsr_circuit_t *circuit, xrsr_src_t src, uint32_t dst_index, rdkx_timer_object_t timer_obj, const xrsr_url_parts_t *url_parts);
+void xrsr_circuit_term(xrsr_circuit_t *circuit);
+void xrsr_circuit_params_set(xrsr_circuit_t *circuit, uint32_t threshold, uint32_t open_period, uint32_t timeout_probe);
+bool xrsr_circuit_allow(xrsr_circuit_t *circuit);
+void xrsr_circuit_result(xrsr_circuit_t *circuit, const xrsr_session_stats_t *stats);
+void xrsr_circuit_probe_result(xrsr_circuit_t *circuit, uint32_t probe_id, bool result);
+void xrsr_circuit_state_notify(xrsr_src_t src, uint32_t dst_index, xrsr_circuit_state_t state);
+
+void     xrsr_grouping_init(xrsr_grouping_t *grouping);
+uint32_t xrsr_grouping_begin(xrsr_grouping_t *grouping, bool low_latency);
+bool     xrsr_grouping_update(xrsr_grouping_t *grouping, const xrsr_grouping_metrics_t *metrics);
+void     xrsr_grouping_end(xrsr_grouping_t *grouping, xrsr_stream_stats_t *stats);
+
+void                xrsr_format_link_init(xrsr_format_link_t *link);
+void                xrsr_format_link_update(xrsr_format_link_t *link, const xrsr_grouping_metrics_t *metrics);
+xrsr_audio_format_t xrsr_format_select(xrsr_format_link_t *link, uint32_t formats_supported_dst, xraudio_input_format_t format_src, xrsr_power_mode_t power_mode, uint32_t opus_bitrate, xrsr_format_reason_t *reason);
+
+bool                  xrsr_convert_kernel_available(xrsr_convert_kernel_t kernel);
+xrsr_convert_kernel_t xrsr_convert_kernel_best(void);
+float                 xrsr_convert_scale(float gain_db);
+void                  xrsr_convert_s32_to_s16(xrsr_convert_kernel_t kernel, const int32_t *in, uint32_t channel_qty, int32_t channel, float scale, int16_t *out, uint32_t frame_qty);
+bool                  xrsr_convert_stage_create(xrsr_stage_t *stage, const xrsr_convert_params_t *params);
+bool                  xrsr_resampler_init(xrsr_resampler_t *resampler, uint32_t rate_in, uint32_t rate_out, uint32_t chunk_qty_max);
+void                  xrsr_resampler_term(xrsr_resampler_t *resampler);
+uint32_t              xrsr_resampler_output_max(const xrsr_resampler_t *resampler, uint32_t in_qty);
+uint32_t              xrsr_resampler_process(xrsr_resampler_t *resampler, const int16_t *in, uint32_t in_qty, int16_t *out);
+bool                  xrsr_resample_stage_create(xrsr_stage_t *stage, uint32_t rate_in, uint32_t rate_out);
+bool                  xrsr_trim_stage_create(xrsr_stage_t *stage, const xrsr_trim_config_t *config, uint32_t sample_rate, uint32_t protect_qty);
+
+bool                  xrsr_pipeline_create(xrsr_pipeline_t **pipeline, uint32_t frame_size_in);
+bool                  xrsr_pipeline_stage_add(xrsr_pipeline_t *pipeline, const xrsr_stage_t *stage, xrsr_audio_format_t format, uint32_t sample_rate);
+uint32_t              xrsr_pipeline_stage_qty(const xrsr_pipeline_t *pipeline);
+bool                  xrsr_pipeline_start(xrsr_pipeline_t *pipeline, int fd_in, uint32_t byte_rate_in, uint32_t byte_rate_out);
+int                   xrsr_pipeline_read(xrsr_pipeline_t *pipeline, uint8_t *buffer, uint32_t size);
+uint32_t              xrsr_pipeline_position(const xrsr_pipeline_t *pipeline, uint32_t bytes_in);
+uint32_t              xrsr_pipeline_backlog(const xrsr_pipeline_t *pipeline, uint32_t bytes_in);
+void                  xrsr_pipeline_destroy(xrsr_pipeline_t *pipeline, xrsr_stream_stats_t *stats);
+
+bool                  xrsr_eyeballs_start(xrsr_eyeballs_t *race, const char *host, const char *port, uint32_t attempt_delay);
+int                   xrsr_eyeballs_poll(xrsr_eyeballs_t *race, bool *failed);
+void                  xrsr_eyeballs_cancel(xrsr_eyeballs_t *race);
+bool                  xrsr_eyeballs_active(const xrsr_eyeballs_t *race);
+xrsr_address_family_t xrsr_eyeballs_family_get(const char *host);
+void                  xrsr_eyeballs_family_set(const char *host, xrsr_address_family_t family);
+
+xrsr_socket_profile_t xrsr_socket_profile_from_str(const char *str);
+bool                  xrsr_socket_profile_apply(int fd, xrsr_socket_profile_t profile, xrsr_socket_stats_t *stats);
+void                  xrsr_socket_cork(int fd, const xrsr_socket_stats_t *stats, bool cork);
+
+void                  xrsr_trace_record(xrsr_trace_event_t event, xrsr_src_t src, int64_t arg0, int64_t arg1);
+void                  xrsr_trace_term(void);
+
 #endif
@@ -18,11 +18,13 @@
 # limitations under the License.
 ##########################################################################
 */
+#include <poll.h>
 #include "xrsr_private.h"
 #include "xrsr_protocol_http_sm.h"
 
 #define XRSR_HTTP_CURL_FD_MAX (5)
 #define XRSR_HTTP_MSG_TIMEOUT         (10000) // in milliseconds
+#define XRSR_HTTP_HEADER_QTY_MAX      (8)     // request headers remembered to estimate header compression
 
 #define CURL_EASY_SETOPT(curl, CURLoption, option) \
    do { \
@@ -42,6 +44,9 @@ typedef struct {
     rdkx_timer_id_t     timer_id_multi;
     int                 readfds[XRSR_HTTP_CURL_FD_MAX];
     int                 writefds[XRSR_HTTP_CURL_FD_MAX];
+    char                header_host[XRSR_PROTOCOL_HTTP_URL_SIZE_MAX]; // host of the last HTTP/2 request, copied since the url can be freed on route update
+    uint32_t            header_qty;
+    uint32_t            header_hashes[XRSR_HTTP_HEADER_QTY_MAX];  // request headers sent on the last HTTP/2 request
 } xrsr_state_http_global_t;
 
 static xrsr_state_http_global_t g_http = {0};
@@ -54,6 +59,8 @@ static void xrsr_http_sm_init(xrsr_state_http_t *http);
 static void xrsr_http_timeout_process(void *data);
 static void xrsr_http_timeout_response(void *data);
 static bool _xrsr_http_connect(xrsr_state_http_t *http);
+static void _xrsr_http_version_stats(xrsr_state_http_t *http);
+static uint32_t _xrsr_http_header_hash(const char *str);
 
 // Helper functions
 void _xrsr_http_fd_add(int fd, int *list) {
@@ -117,14 +124,21 @@ size_t _xrsr_http_read_function(char *ptr, size_t size, size_t nmemb, void *user
         XLOGD_ERROR("NULL xrsr_state_http_t");
     } else {
         if(http->audio_pipe_fd_read >= 0) {
-            int rc = read(http->audio_pipe_fd_read, ptr, size * nmemb);
+            if(http->http2) { // don't block streams sharing the connection, resume when the pipe is readable
+                struct pollfd pfd = { .fd = http->audio_pipe_fd_read, .events = POLLIN, .revents = 0 };
+                if(poll(&pfd, 1, 0) == 0) {
+                    http->audio_paused = true;
+                    return(CURL_READFUNC_PAUSE);
+                }
+            }
+            int rc = xrsr_speech_stream_read(http->audio_src, http->dst_index, http->audio_pipe_fd_read, (uint8_t *)ptr, size * nmemb);
             if(rc < 0) {
                 int errsv = errno;
-                if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
-                   XLOGD_INFO("read would block");
-                } else {
-                   XLOGD_ERROR("pipe read error <%s>", strerror(errsv));
+                if(errsv == EAGAIN || errsv == EWOULDBLOCK) { // the pipeline is holding the audio, resume when the pipe is readable
+                   http->audio_paused = true;
+                   return(CURL_READFUNC_PAUSE);
                 }
+                XLOGD_ERROR("pipe read error <%s>", strerror(errsv));
                 close(http->audio_pipe_fd_read);
                 http->audio_pipe_fd_read = -1;
                 rc = 0;
@@ -137,8 +151,8 @@ size_t _xrsr_http_read_function(char *ptr, size_t size, size_t nmemb, void *user
             }
             bytes = rc;
         }
+        xrsr_trace_record(XRSR_TRACE_EVENT_HTTP_AUDIO_SENT, http->audio_src, bytes, 0);
     }
-    XLOGD_INFO("sent %zu bytes", bytes);
     return(bytes);
 }
 
@@ -164,6 +178,16 @@ int _xrsr_http_debug_function(CURL *handle, curl_infotype type, char *data, size
     return(0);
 }
 
+int _xrsr_http_sockopt_function(void *clientp, curl_socket_t curlfd, curlsocktype purpose) {
+    xrsr_state_http_t *http = (xrsr_state_http_t *)clientp;
+    if(purpose == CURLSOCKTYPE_IPCXN && http != NULL) {
+        if(!xrsr_socket_profile_apply(curlfd, http->socket_profile, &http->session_stats.socket)) {
+            XLOGD_WARN("socket profile <%s> not fully applied", xrsr_socket_profile_str(http->socket_profile));
+        }
+    }
+    return(CURL_SOCKOPT_OK);
+}
+
 int _xrsr_http_socket_function(CURL *easy, curl_socket_t s, int what, void *userp, void *socketp) {
     switch(what) {
         case CURL_POLL_IN: {
@@ -274,6 +298,9 @@ bool xrsr_http_init(xrsr_state_http_t *http, bool debug) {
         curl_multi_setopt(g_http.multi_handle, CURLMOPT_SOCKETDATA,     NULL);
         curl_multi_setopt(g_http.multi_handle, CURLMOPT_TIMERFUNCTION,  _xrsr_http_timer_function);
         curl_multi_setopt(g_http.multi_handle, CURLMOPT_TIMERDATA,      NULL);
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        curl_multi_setopt(g_http.multi_handle, CURLMOPT_PIPELINING,     CURLPIPE_MULTIPLEX);
+#endif
 
         // Clear fs
         _xrsr_http_fd_clear(g_http.readfds);
@@ -289,6 +316,8 @@ bool xrsr_http_init(xrsr_state_http_t *http, bool debug) {
     http->audio_pipe_fd_read = -1;
     http->timer_obj          = RDXK_TIMER_OBJ_INVALID;
     http->timer_id_rsp       = RDXK_TIMER_ID_INVALID;
+    http->socket_profile     = XRSR_SOCKET_PROFILE_DEFAULT;
+    http->http2              = XRSR_HTTP_HTTP2_DEFAULT;
     xrsr_http_sm_init(http);
     xrsr_http_reset(http);
     return(true);
@@ -311,6 +340,8 @@ void xrsr_http_term(xrsr_state_http_t *http) {
                 curl_multi_cleanup(g_http.multi_handle);
                 g_http.multi_handle = NULL;
             }
+            g_http.header_host[0] = '\0';
+            g_http.header_qty     = 0;
         }
     }
 }
@@ -365,7 +396,9 @@ bool xrsr_http_connect(xrsr_state_http_t *http, xrsr_url_parts_t *url_parts, xrs
         transcription_payload[sizeof(transcription_payload)-1] = '\0';  //A bit redundant since snprintf does this, but let's be certain because CURLOPT_COPYPOSTFIELDS requires it
         CURL_EASY_SETOPT(http->easy_handle, CURLOPT_COPYPOSTFIELDS, transcription_payload);
     } else {
-        http->chunk = curl_slist_append(http->chunk, "Transfer-Encoding: chunked");
+        if(!http->http2) { // HTTP/2 has its own framing and curl still chunks the upload if it falls back to HTTP/1.1
+            http->chunk = curl_slist_append(http->chunk, "Transfer-Encoding: chunked");
+        }
         http->chunk = curl_slist_append(http->chunk, "Content-Type:application/octet-stream");
     }
 
@@ -385,6 +418,8 @@ bool xrsr_http_connect(xrsr_state_http_t *http, xrsr_url_parts_t *url_parts, xrs
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_READFUNCTION, _xrsr_http_read_function);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_READDATA, (void *)http);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_DEBUGFUNCTION, _xrsr_http_debug_function);
+    CURL_EASY_SETOPT(http->easy_handle, CURLOPT_SOCKOPTFUNCTION, _xrsr_http_sockopt_function);
+    CURL_EASY_SETOPT(http->easy_handle, CURLOPT_SOCKOPTDATA, (void *)http);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_XFERINFODATA, (void *)http);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_NOPROGRESS, 1L);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_CONNECTTIMEOUT, 5L);
@@ -393,7 +428,17 @@ bool xrsr_http_connect(xrsr_state_http_t *http, xrsr_url_parts_t *url_parts, xrs
     if(http->session_config_in.http.user_agent != NULL && http->session_config_in.http.user_agent[0] != '\0') {
        CURL_EASY_SETOPT(http->easy_handle, CURLOPT_USERAGENT, http->session_config_in.http.user_agent);
     }
-    CURL_EASY_SETOPT(http->easy_handle, CURLOPT_FORBID_REUSE, 1);
+    if(http->http2) {
+        // Offer HTTP/2 in the TLS handshake and wait for a connection that can be multiplexed instead of opening another
+#if LIBCURL_VERSION_NUM >= 0x072f00
+        CURL_EASY_SETOPT(http->easy_handle, CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_2TLS);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        CURL_EASY_SETOPT(http->easy_handle, CURLOPT_PIPEWAIT, 1L);
+#endif
+    } else {
+        CURL_EASY_SETOPT(http->easy_handle, CURLOPT_FORBID_REUSE, 1);
+    }
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_FOLLOWLOCATION, 1L);
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_NOSIGNAL, 1L);
 
@@ -449,6 +494,15 @@ bool xrsr_http_connect(xrsr_state_http_t *http, xrsr_url_parts_t *url_parts, xrs
 #endif
     CURL_EASY_SETOPT(http->easy_handle, CURLOPT_POST, 1L);
 
+    // Race IPv6 and IPv4 connection attempts.  If IPv4 won the last race for this host, skip IPv6 until the cache expires or IPv4 fails.
+#if LIBCURL_VERSION_NUM >= 0x073b00
+    CURL_EASY_SETOPT(http->easy_handle, CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS, (long)XRSR_EYEBALLS_ATTEMPT_DELAY);
+#endif
+    http->host = url_parts->host;
+    if(xrsr_eyeballs_family_get(http->host) == XRSR_ADDRESS_FAMILY_IPV4) {
+        CURL_EASY_SETOPT(http->easy_handle, CURLOPT_IPRESOLVE, CURL_IPRESOLVE_V4);
+    }
+
     if(false == delay) {
         xrsr_http_event(http, SM_EVENT_SESSION_BEGIN, false);
     } else {
@@ -473,6 +527,16 @@ void xrsr_http_timeout_process(void *data) {
    xrsr_http_handle_fds(NULL, 1, NULL, NULL, NULL);
 }
 
+void xrsr_http_update_dst_params(xrsr_state_http_t *http, const xrsr_dst_param_ptrs_t *params) {
+    if(NULL == http || NULL == params) {
+        XLOGD_ERROR("NULL params");
+        return;
+    }
+    http->socket_profile = (params->socket_profile != NULL && *params->socket_profile < XRSR_SOCKET_PROFILE_INVALID) ? *params->socket_profile : XRSR_SOCKET_PROFILE_DEFAULT;
+    http->http2          = (params->http2_disabled != NULL) ? !*params->http2_disabled : XRSR_HTTP_HTTP2_DEFAULT;
+    XLOGD_INFO("socket profile <%s> http2 <%s>", xrsr_socket_profile_str(http->socket_profile), http->http2 ? "YES" : "NO");
+}
+
 bool xrsr_http_conn_is_ready() {
     return((g_http.running > 0 ? true : false));
 }
@@ -535,6 +599,14 @@ void xrsr_http_fd_set(xrsr_state_http_t *http, int size, int *nfds, fd_set *read
             }
         }
     }
+
+    // Wait for more audio if the upload is paused
+    if(http->audio_paused && http->audio_pipe_fd_read >= 0) {
+        FD_SET(http->audio_pipe_fd_read, readfds);
+        if(http->audio_pipe_fd_read >= *nfds) {
+            *nfds = http->audio_pipe_fd_read + 1;
+        }
+    }
 }
 
 void xrsr_http_handle_fds(xrsr_state_http_t *http, int size, fd_set *readfds, fd_set *writefds, fd_set *exceptfds) {
@@ -546,6 +618,15 @@ void xrsr_http_handle_fds(xrsr_state_http_t *http, int size, fd_set *readfds, fd
             XLOGD_ERROR("curl multi error <%s>", xrsr_curlmcode_str(rc));
         }
     } else {
+        // Resume the upload when more audio is available.  curl only sends it as the stream's flow control window allows.
+        if(http != NULL && http->audio_paused && http->audio_pipe_fd_read >= 0 && FD_ISSET(http->audio_pipe_fd_read, readfds)) {
+            http->audio_paused = false;
+            CURLcode res = curl_easy_pause(http->easy_handle, CURLPAUSE_CONT);
+            if(res != CURLE_OK) {
+                XLOGD_ERROR("curl_easy_pause() failed with reason <%s>", curl_easy_strerror(res));
+            }
+        }
+
         // Check read fds
         for(i = 0; i < XRSR_HTTP_CURL_FD_MAX; i++) {
             if(g_http.readfds[i] >= 0) {
@@ -595,8 +676,19 @@ void xrsr_http_handle_fds(xrsr_state_http_t *http, int size, fd_set *readfds, fd
                        strncpy_s(temp->session_stats.server_ip, sizeof(temp->session_stats.server_ip), primary_ip, XRSR_SESSION_IP_LEN_MAX-1);
                        ERR_CHK(safe_rc);
                     }
+                    if(status->data.result == CURLE_COULDNT_CONNECT || status->data.result == CURLE_OPERATION_TIMEDOUT) {
+                       xrsr_eyeballs_family_set(temp->host, XRSR_ADDRESS_FAMILY_INVALID);
+                    } else if(primary_ip != NULL && primary_ip[0] != '\0') {
+                       xrsr_eyeballs_family_set(temp->host, (strchr(primary_ip, ':') != NULL) ? XRSR_ADDRESS_FAMILY_IPV6 : XRSR_ADDRESS_FAMILY_IPV4);
+                    }
                     curl_easy_getinfo(temp->easy_handle, CURLINFO_CONNECT_TIME, &temp->session_stats.time_connect);
                     curl_easy_getinfo(temp->easy_handle, CURLINFO_NAMELOOKUP_TIME, &temp->session_stats.time_dns);
+                    double time_start_transfer = 0.0;
+                    curl_easy_getinfo(temp->easy_handle, CURLINFO_STARTTRANSFER_TIME, &time_start_transfer);
+                    if(time_start_transfer > temp->session_stats.time_connect) {
+                       temp->session_stats.time_response = time_start_transfer - temp->session_stats.time_connect;
+                    }
+                    _xrsr_http_version_stats(temp);
 
                     xrsr_http_event(temp, SM_EVENT_MSG_RECV, false);
                 }
@@ -605,6 +697,89 @@ void xrsr_http_handle_fds(xrsr_state_http_t *http, int size, fd_set *readfds, fd
     } while(i > 0);
 }
 
+// Records the negotiated version, whether the connection was reused and the request header sizes.  libcurl doesn't report
+// the size of compressed headers, so the savings are estimated: request headers that match the previous HTTP/2 request
+// to the same host are assumed to be sent as a one byte reference to the dynamic table.
+void _xrsr_http_version_stats(xrsr_state_http_t *http) {
+    xrsr_session_stats_t *stats = &http->session_stats;
+    long version     = 0;
+    long connects    = 0;
+    long header_txd  = 0;
+    long header_rxd  = 0;
+
+#if LIBCURL_VERSION_NUM >= 0x073200
+    curl_easy_getinfo(http->easy_handle, CURLINFO_HTTP_VERSION, &version);
+#endif
+    curl_easy_getinfo(http->easy_handle, CURLINFO_NUM_CONNECTS, &connects);
+    curl_easy_getinfo(http->easy_handle, CURLINFO_REQUEST_SIZE, &header_txd);
+    curl_easy_getinfo(http->easy_handle, CURLINFO_HEADER_SIZE,  &header_rxd);
+
+    switch(version) {
+        case CURL_HTTP_VERSION_1_0: { stats->http_version = 10; break; }
+        case CURL_HTTP_VERSION_1_1: { stats->http_version = 11; break; }
+#if LIBCURL_VERSION_NUM >= 0x072100
+        case CURL_HTTP_VERSION_2_0: { stats->http_version = 20; break; }
+#endif
+        default:                    { stats->http_version = 0;  break; }
+    }
+    stats->connection_reused = (connects == 0);
+    stats->header_txd_bytes  = (header_txd > 0) ? header_txd : 0;
+    stats->header_rxd_bytes  = (header_rxd > 0) ? header_rxd : 0;
+
+    if(stats->http_version != 20) {
+        g_http.header_host[0] = '\0';
+        g_http.header_qty     = 0;
+    } else {
+        uint32_t           hashes[XRSR_HTTP_HEADER_QTY_MAX];
+        uint32_t           qty        = 0;
+        struct curl_slist *item       = http->chunk;
+        const char        *user_agent = http->session_config_in.http.user_agent;
+        bool               match      = (stats->connection_reused && g_http.header_host[0] != '\0' && http->host != NULL && 0 == strcmp(g_http.header_host, http->host));
+
+        while(qty < XRSR_HTTP_HEADER_QTY_MAX) {
+            const char *header = NULL;
+            if(item != NULL) {
+                header = item->data;
+                item   = item->next;
+            } else if(user_agent != NULL && user_agent[0] != '\0') {
+                header     = user_agent;
+                user_agent = NULL;
+            } else {
+                break;
+            }
+            size_t len = strlen(header);
+            if(len == 0 || header[len - 1] == ':') { // removed header
+                continue;
+            }
+            hashes[qty] = _xrsr_http_header_hash(header);
+            if(match) {
+                for(uint32_t i = 0; i < g_http.header_qty; i++) {
+                    if(g_http.header_hashes[i] == hashes[qty]) {
+                        stats->header_saved_bytes += len - 1;
+                        break;
+                    }
+                }
+            }
+            qty++;
+        }
+        memcpy(g_http.header_hashes, hashes, qty * sizeof(hashes[0]));
+        g_http.header_qty  = qty;
+        if(http->host == NULL || (size_t)snprintf(g_http.header_host, sizeof(g_http.header_host), "%s", http->host) >= sizeof(g_http.header_host)) {
+            g_http.header_host[0] = '\0';
+        }
+    }
+
+    XLOGD_INFO("http version <%u> connection reused <%s> header bytes txd <%u> rxd <%u> saved <%u>", stats->http_version, stats->connection_reused ? "YES" : "NO", stats->header_txd_bytes, stats->header_rxd_bytes, stats->header_saved_bytes);
+}
+
+uint32_t _xrsr_http_header_hash(const char *str) {
+    uint32_t hash = 5381;
+    while(*str != '\0') {
+        hash = ((hash << 5) + hash) + (uint8_t)*str++;
+    }
+    return(hash);
+}
+
 void xrsr_http_terminate(xrsr_state_http_t *http) {
     if(http) {
         xrsr_http_event(http, SM_EVENT_TERMINATE, false);
@@ -680,6 +855,7 @@ void xrsr_http_reset(xrsr_state_http_t *http) {
         http->detect_resume      = true;
         http->session_stats.reason = XRSR_SESSION_END_REASON_EOS;
         http->is_session_by_text   = false;
+        http->audio_paused         = false;
     }
 }
 
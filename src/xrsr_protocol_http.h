@@ -32,6 +32,7 @@
 #define XRSR_PROTOCOL_HTTP_BUFFER_SIZE_MAX (102400)
 #define XRSR_PROTOCOL_HTTP_URL_SIZE_MAX    (2048)
 #define XRSR_HTTP_SM_EVENTS_MAX            (5)
+#define XRSR_HTTP_HTTP2_DEFAULT            (true) // negotiate HTTP/2 when the destination params don't specify
 
 typedef struct {
    xrsr_protocol_t              prot;  // Used for identification
@@ -49,11 +50,15 @@ typedef struct {
    const char *                 user_agent;
    char                         transcription_in[XRSR_SESSION_BY_TEXT_MAX_LENGTH];
    char                        *transcription_ptr;
+   const char *                 host;  // used to cache the address family which connected
 
    /* HTTP Library Specific attributes */
    CURL                        *easy_handle;
    struct curl_slist           *chunk;
    bool                         debug;
+   xrsr_socket_profile_t        socket_profile;     // tcp options applied to the socket before it connects
+   bool                         http2;              // negotiate HTTP/2 over ALPN and share connections between sessions
+   bool                         audio_paused;       // upload is paused until the audio pipe is readable
    char                         write_buffer[XRSR_PROTOCOL_HTTP_BUFFER_SIZE_MAX];
    uint32_t                     write_buffer_index;
    rdkx_timer_id_t              timer_id_rsp;
@@ -77,9 +82,11 @@ void xrsr_http_handle_fds(xrsr_state_http_t *http, int size, fd_set *readfds, fd
 void xrsr_http_handle_speech_event(xrsr_state_http_t *http, xrsr_speech_event_t *event);
 bool xrsr_http_connect(xrsr_state_http_t *http, xrsr_url_parts_t *url_parts, xrsr_src_t audio_src, xraudio_input_format_t xraudio_format, rdkx_timer_object_t object, bool delay, const char **query_strs, const char* transcription_in);
 bool xrsr_http_conn_is_ready();
+void xrsr_http_update_dst_params(xrsr_state_http_t *http, const xrsr_dst_param_ptrs_t *params);
 int  xrsr_http_send(xrsr_state_http_t *http, const uint8_t *buffer, uint32_t length);
 int  xrsr_http_recv(xrsr_state_http_t *http, uint8_t *buffer, uint32_t length);
 int  xrsr_http_recv_pending(xrsr_state_http_t *http);
+size_t _xrsr_http_write_function(char *ptr, size_t size, size_t nmemb, void *userdata);
 
 // State check functions
 bool xrsr_http_is_connected(xrsr_state_http_t *http);
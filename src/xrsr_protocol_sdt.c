@@ -118,23 +118,20 @@ void xrsr_sdt_handle_fds(xrsr_state_sdt_t *sdt, fd_set *readfds, fd_set *writefd
    // Finally let's check if we have audio data available to send
    if(sdt->audio_pipe_fd_read >= 0 && FD_ISSET(sdt->audio_pipe_fd_read, readfds)) {
       // Read the audio data and write to websocket
-      int rc = read(sdt->audio_pipe_fd_read, sdt->buffer, sizeof(sdt->buffer));
+      int rc = xrsr_speech_stream_read(sdt->audio_src, sdt->dst_index, sdt->audio_pipe_fd_read, sdt->buffer, sizeof(sdt->buffer));
       if(rc < 0) {
          int errsv = errno;
-         if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
-            XLOGD_INFO("read would block");
-            xrsr_sdt_event(sdt, SM_EVENT_AUDIO_ERROR, false);
-         } else {
-            XLOGD_ERROR("pipe read error <%s>", strerror(errsv));
-            xrsr_sdt_event(sdt, SM_EVENT_AUDIO_ERROR, false);
+         if(errsv == EAGAIN || errsv == EWOULDBLOCK) { // the pipeline is holding the audio, wait for the pipe
+            return;
          }
+         XLOGD_ERROR("pipe read error <%s>", strerror(errsv));
+         xrsr_sdt_event(sdt, SM_EVENT_AUDIO_ERROR, false);
       } else if(rc == 0) { // EOF
          XLOGD_INFO("pipe read EOF");
          xrsr_sdt_event(sdt, SM_EVENT_EOS_PIPE, false);
       } else {
-         XLOGD_INFO("pipe read <%d>", rc);
          uint32_t bytes_read = (uint32_t)rc;
-	 XLOGD_INFO("pipe bytes read <%d>", bytes_read);
+         xrsr_trace_record(XRSR_TRACE_EVENT_SDT_AUDIO_READ, sdt->audio_src, bytes_read, 0);
 
          if(sdt->handlers.stream_audio == NULL) {
             XLOGD_INFO("stream data handler not available");
@@ -0,0 +1,838 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "xrsr_private.h"
+#include "xrsr_protocol_unix_sm.h"
+
+static void xrsr_unix_event(xrsr_state_unix_t *unx, tStEventID id, bool from_state_handler);
+static void xrsr_unix_reset(xrsr_state_unix_t *unx);
+static void xrsr_unix_sm_init(xrsr_state_unix_t *unx);
+static void xrsr_unix_process_timeout(void *data);
+static void xrsr_unix_speech_stream_end(xrsr_state_unix_t *unx, xrsr_stream_end_reason_t reason, bool detect_resume);
+static bool xrsr_unix_connect_new(xrsr_state_unix_t *unx);
+static int  xrsr_unix_msg_send(xrsr_state_unix_t *unx, uint8_t type, const uint8_t *payload, uint32_t length, int fd);
+static bool xrsr_unix_buffer_send(xrsr_state_unix_t *unx, uint32_t length);
+static void xrsr_unix_audio_read(xrsr_state_unix_t *unx);
+static void xrsr_unix_msg_read(xrsr_state_unix_t *unx);
+static void xrsr_unix_msg_recv(xrsr_state_unix_t *unx, const xrsr_unix_header_t *header, uint8_t *payload);
+static void xrsr_unix_kwd_send(xrsr_state_unix_t *unx);
+static void xrsr_unix_close(xrsr_state_unix_t *unx);
+
+// This function kicks off the session
+void xrsr_protocol_handler_unix(xrsr_src_t src, bool retry, bool user_initiated, xraudio_input_format_t xraudio_format, xraudio_keyword_detector_result_t *detector_result, const char* transcription_in, bool low_latency) {
+   xrsr_queue_msg_session_begin_t msg;
+   msg.header.type     = XRSR_QUEUE_MSG_TYPE_SESSION_BEGIN;
+   msg.src             = src;
+   msg.retry           = retry;
+   msg.user_initiated  = user_initiated;
+   msg.xraudio_format  = xraudio_format;
+   msg.low_latency     = low_latency;
+   if(detector_result == NULL) {
+      msg.has_result = false;
+      memset(&msg.detector_result, 0, sizeof(msg.detector_result));
+   } else {
+      msg.has_result      = true;
+      msg.detector_result = *detector_result;
+   }
+   rdkx_timestamp_get_realtime(&msg.timestamp);
+
+   if(transcription_in != NULL) {
+      strncpy(msg.transcription_in, transcription_in, sizeof(msg.transcription_in)-1);
+      msg.transcription_in[sizeof(msg.transcription_in)-1] = '\0';
+   } else {
+      msg.transcription_in[0] = '\0';
+   }
+
+   xrsr_queue_msg_push(xrsr_msgq_fd_get(), (const char *)&msg, sizeof(msg));
+}
+
+bool xrsr_unix_init(xrsr_state_unix_t *unx, xrsr_unix_params_t *params) {
+   if(unx == NULL || params == NULL) {
+      XLOGD_ERROR("invalid params - unix <%p> params <%p>", unx, params);
+      return(false);
+   }
+
+   memset(unx, 0, sizeof(*unx));
+
+   unx->prot               = params->prot;
+   unx->timer_obj          = params->timer_obj;
+   unx->timer_id           = RDXK_TIMER_ID_INVALID;
+   unx->fd                 = -1;
+   unx->audio_pipe_fd_read = -1;
+   unx->timeout_inactivity = XRSR_UNIX_TIMEOUT_INACTIVITY;
+
+   if(params->dst_params != NULL) {
+      xrsr_unix_update_dst_params(unx, params->dst_params);
+   }
+   xrsr_unix_reset(unx);
+   xrsr_unix_sm_init(unx);
+
+   return(true);
+}
+
+void xrsr_unix_term(xrsr_state_unix_t *unx) {
+   if(unx == NULL) {
+      XLOGD_ERROR("NULL xrsr_state_unix_t");
+      return;
+   }
+   if(!xrsr_unix_is_disconnected(unx)) {
+      xrsr_unix_event(unx, SM_EVENT_TERMINATE, false);
+   }
+   xrsr_unix_reset(unx);
+}
+
+void xrsr_unix_update_dst_params(xrsr_state_unix_t *unx, const xrsr_dst_param_ptrs_t *params) {
+   if(unx == NULL || params == NULL) {
+      XLOGD_ERROR("NULL params");
+      return;
+   }
+   unx->fd_passing         = (params->fd_passing != NULL) ? *params->fd_passing : false;
+   unx->timeout_inactivity = (params->timeout_inactivity != NULL && *params->timeout_inactivity > 0) ? *params->timeout_inactivity : XRSR_UNIX_TIMEOUT_INACTIVITY;
+   XLOGD_INFO("fd passing <%s> timeout inactivity <%u> ms", unx->fd_passing ? "YES" : "NO", unx->timeout_inactivity);
+}
+
+void xrsr_unix_fd_set(xrsr_state_unix_t *unx, int *nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds) {
+   if(unx->fd < 0) {
+      return;
+   }
+   FD_SET(unx->fd, readfds);
+   if(unx->fd >= *nfds) {
+      *nfds = unx->fd + 1;
+   }
+   if(unx->buffer_pending > 0) { // Don't read more audio until the socket takes the pending message
+      FD_SET(unx->fd, writefds);
+   } else if(unx->audio_pipe_fd_read >= 0) {
+      FD_SET(unx->audio_pipe_fd_read, readfds);
+      if(unx->audio_pipe_fd_read >= *nfds) {
+         *nfds = unx->audio_pipe_fd_read + 1;
+      }
+   }
+}
+
+void xrsr_unix_handle_fds(xrsr_state_unix_t *unx, fd_set *readfds, fd_set *writefds, fd_set *exceptfds) {
+   if(unx->fd >= 0 && unx->buffer_pending > 0 && FD_ISSET(unx->fd, writefds)) {
+      xrsr_unix_buffer_send(unx, unx->buffer_pending);
+   }
+   if(unx->fd >= 0 && FD_ISSET(unx->fd, readfds)) {
+      xrsr_unix_msg_read(unx);
+   }
+   if(unx->audio_pipe_fd_read >= 0 && unx->buffer_pending == 0 && FD_ISSET(unx->audio_pipe_fd_read, readfds)) {
+      xrsr_unix_audio_read(unx);
+   }
+}
+
+void xrsr_unix_process_timeout(void *data) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)data;
+   XLOGD_WARN("engine inactivity timeout");
+   unx->timer_id = RDXK_TIMER_ID_INVALID;
+   xrsr_unix_event(unx, SM_EVENT_TIMEOUT, false);
+}
+
+bool xrsr_unix_connect(xrsr_state_unix_t *unx, xrsr_url_parts_t *url_parts, xrsr_src_t audio_src, xraudio_input_format_t xraudio_format, uint32_t sample_rate, bool user_initiated, bool deferred) {
+   if(unx == NULL || url_parts == NULL || url_parts->path == NULL) {
+      XLOGD_ERROR("NULL params");
+      return(false);
+   }
+
+   // The socket path is the url path without a query string or fragment
+   size_t len = strcspn(url_parts->path, "?#");
+   if(len == 0 || len >= sizeof(unx->addr.sun_path)) {
+      XLOGD_ERROR("invalid socket path length <%zu>", len);
+      return(false);
+   }
+   memset(&unx->addr, 0, sizeof(unx->addr));
+   unx->addr.sun_family = AF_UNIX;
+   memcpy(unx->addr.sun_path, url_parts->path, len);
+   unx->addr_len = offsetof(struct sockaddr_un, sun_path) + len + 1;
+
+   unx->audio_src          = audio_src;
+   unx->xraudio_format     = xraudio_format;
+   unx->sample_rate        = sample_rate;
+   unx->user_initiated     = user_initiated;
+   unx->audio_kwd_notified = true; // if keyword is present in the stream, xraudio will inform
+   unx->audio_kwd_bytes    = 0;
+   unx->audio_txd_bytes    = 0;
+   unx->audio_passed       = false;
+   unx->response_rxd       = false;
+   unx->buffer_pending     = 0;
+   memset(&unx->stats, 0, sizeof(unx->stats));
+   memset(&unx->audio_stats, 0, sizeof(unx->audio_stats));
+
+   XLOGD_INFO("path <%s> deferred <%s> fd passing <%s>", unx->addr.sun_path, deferred ? "YES" : "NO", unx->fd_passing ? "YES" : "NO");
+
+   xrsr_unix_event(unx, deferred ? SM_EVENT_SESSION_BEGIN_STM : SM_EVENT_SESSION_BEGIN, false);
+   return(true);
+}
+
+bool xrsr_unix_connect_new(xrsr_state_unix_t *unx) {
+   rdkx_timestamp_get(&unx->connect_timestamp);
+
+   unx->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+   if(unx->fd < 0) {
+      int errsv = errno;
+      XLOGD_ERROR("socket <%s>", strerror(errsv));
+      return(false);
+   }
+   if(connect(unx->fd, (struct sockaddr *)&unx->addr, unx->addr_len) != 0) {
+      int errsv = errno;
+      XLOGD_ERROR("connect <%s> <%s>", unx->addr.sun_path, strerror(errsv));
+      xrsr_unix_close(unx);
+      return(false);
+   }
+
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+   unx->stats.time_connect = rdkx_timestamp_subtract_us(unx->connect_timestamp, timestamp) / 1000000.0;
+
+   // Describe the session and hand over the audio pipe if enabled
+   char uuid_str[37] = {'\0'};
+   char session[256];
+   bool pass       = (unx->fd_passing && unx->audio_pipe_fd_read >= 0);
+   uuid_unparse_lower(unx->uuid, uuid_str);
+   int length = snprintf(session, sizeof(session), "{\"uuid\":\"%s\",\"src\":\"%s\",\"format\":\"%s\",\"sample_rate\":%u,\"user_initiated\":%s,\"low_latency\":%s,\"audio\":\"%s\"}",
+                         uuid_str, xrsr_src_str(unx->audio_src), xrsr_audio_format_str(unx->session_config_out.format), unx->sample_rate,
+                         unx->user_initiated ? "true" : "false", unx->low_latency ? "true" : "false", pass ? "fd" : "msg");
+   if(length < 0 || (size_t)length >= sizeof(session)) {
+      XLOGD_ERROR("session description too long");
+      xrsr_unix_close(unx);
+      return(false);
+   }
+   if(xrsr_unix_msg_send(unx, XRSR_UNIX_MSG_TYPE_SESSION_BEGIN, (const uint8_t *)session, length, pass ? unx->audio_pipe_fd_read : -1) <= 0) {
+      XLOGD_ERROR("session begin not sent");
+      xrsr_unix_close(unx);
+      return(false);
+   }
+   if(pass) { // The engine has its own reference to the pipe, so the router no longer reads the audio
+      close(unx->audio_pipe_fd_read);
+      unx->audio_pipe_fd_read = -1;
+      unx->audio_passed       = true;
+   }
+   XLOGD_INFO("connected <%s> audio <%s>", unx->addr.sun_path, pass ? "fd" : "msg");
+   return(true);
+}
+
+void xrsr_unix_close(xrsr_state_unix_t *unx) {
+   if(unx->fd >= 0) {
+      close(unx->fd);
+      unx->fd = -1;
+   }
+   unx->buffer_pending = 0;
+}
+
+void xrsr_unix_terminate(xrsr_state_unix_t *unx) {
+   if(unx == NULL) {
+      XLOGD_ERROR("NULL xrsr_state_unix_t");
+      return;
+   }
+   xrsr_unix_event(unx, SM_EVENT_TERMINATE, false);
+}
+
+// Sends a message with the header and payload in one datagram.  Returns 1 if sent, 0 if the socket is full or -1 on error.
+int xrsr_unix_msg_send(xrsr_state_unix_t *unx, uint8_t type, const uint8_t *payload, uint32_t length, int fd) {
+   xrsr_unix_header_t header = { .type = type, .flags = (fd >= 0) ? XRSR_UNIX_MSG_FLAG_FD : 0, .reserved = 0, .length = length };
+   struct iovec  iov[2];
+   struct msghdr msg;
+   union {
+      struct cmsghdr align;
+      char           buf[CMSG_SPACE(sizeof(int))];
+   } control;
+
+   if(unx->fd < 0) {
+      return(-1);
+   }
+   if(sizeof(header) + length > XRSR_UNIX_MSG_SIZE_MAX) {
+      XLOGD_ERROR("message too long <%u>", length);
+      return(-1);
+   }
+   iov[0].iov_base = &header;
+   iov[0].iov_len  = sizeof(header);
+   iov[1].iov_base = (void *)payload;
+   iov[1].iov_len  = length;
+
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov    = iov;
+   msg.msg_iovlen = (length > 0) ? 2 : 1;
+
+   if(fd >= 0) {
+      memset(&control, 0, sizeof(control));
+      msg.msg_control    = control.buf;
+      msg.msg_controllen = sizeof(control.buf);
+      struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type  = SCM_RIGHTS;
+      cmsg->cmsg_len   = CMSG_LEN(sizeof(int));
+      memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+   }
+
+   if(sendmsg(unx->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
+         return(0);
+      }
+      XLOGD_ERROR("send type <%u> <%s>", type, strerror(errsv));
+      return(-1);
+   }
+   return(1);
+}
+
+// Sends the message at the start of buffer, holding it until the socket is writable if needed
+bool xrsr_unix_buffer_send(xrsr_state_unix_t *unx, uint32_t length) {
+   if(unx->fd < 0) {
+      unx->buffer_pending = 0;
+      return(false);
+   }
+   ssize_t rc = send(unx->fd, unx->buffer, length, MSG_DONTWAIT | MSG_NOSIGNAL);
+   if(rc < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
+         xrsr_trace_record(XRSR_TRACE_EVENT_UNIX_AUDIO_PENDING, unx->audio_src, length, 0);
+         unx->buffer_pending = length;
+         return(true);
+      }
+      XLOGD_ERROR("send <%s>", strerror(errsv));
+      unx->buffer_pending = 0;
+      xrsr_unix_event(unx, SM_EVENT_SOCKET_ERROR, false);
+      return(false);
+   }
+   unx->buffer_pending = 0;
+   return(true);
+}
+
+void xrsr_unix_audio_read(xrsr_state_unix_t *unx) {
+   xrsr_unix_header_t *header = (xrsr_unix_header_t *)unx->buffer;
+
+   int rc = xrsr_speech_stream_read(unx->audio_src, unx->dst_index, unx->audio_pipe_fd_read, &unx->buffer[sizeof(*header)], XRSR_UNIX_AUDIO_SIZE_MAX);
+   if(rc < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK) { // the pipeline is holding the audio, wait for the pipe
+         return;
+      }
+      XLOGD_ERROR("pipe read error <%s>", strerror(errsv));
+      xrsr_unix_event(unx, SM_EVENT_AUDIO_ERROR, false);
+      return;
+   }
+   header->flags    = 0;
+   header->reserved = 0;
+   if(rc == 0) { // EOF
+      XLOGD_INFO("pipe read EOF");
+      header->type   = XRSR_UNIX_MSG_TYPE_STREAM_END;
+      header->length = 0;
+      if(xrsr_unix_buffer_send(unx, sizeof(*header))) {
+         unx->stream_end_reason = XRSR_STREAM_END_REASON_AUDIO_EOF;
+         xrsr_unix_event(unx, SM_EVENT_EOS_PIPE, false);
+      }
+      return;
+   }
+   header->type   = XRSR_UNIX_MSG_TYPE_AUDIO;
+   header->length = rc;
+   if(!xrsr_unix_buffer_send(unx, sizeof(*header) + rc)) {
+      return;
+   }
+   unx->audio_txd_bytes += rc;
+   xrsr_trace_record(XRSR_TRACE_EVENT_UNIX_AUDIO_SENT, unx->audio_src, rc, 0);
+
+   if(!unx->audio_kwd_notified && (unx->audio_txd_bytes >= unx->audio_kwd_bytes)) {
+      if(!xrsr_speech_stream_kwd(unx->uuid, unx->audio_src, unx->dst_index)) {
+         XLOGD_ERROR("xrsr_speech_stream_kwd failed");
+      }
+      unx->audio_kwd_notified = true;
+   }
+}
+
+void xrsr_unix_msg_read(xrsr_state_unix_t *unx) {
+   // Messages are handled one at a time since a handler may end the session and close the socket
+   while(unx->fd >= 0) {
+      struct iovec  iov = { .iov_base = unx->buffer_rx, .iov_len = XRSR_UNIX_MSG_SIZE_MAX };
+      struct msghdr msg;
+      memset(&msg, 0, sizeof(msg));
+      msg.msg_iov    = &iov;
+      msg.msg_iovlen = 1;
+
+      ssize_t rc = recvmsg(unx->fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+      if(rc < 0) {
+         int errsv = errno;
+         if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
+            return;
+         }
+         XLOGD_ERROR("recv <%s>", strerror(errsv));
+         xrsr_unix_event(unx, SM_EVENT_SOCKET_ERROR, false);
+         return;
+      } else if(rc == 0) {
+         XLOGD_INFO("engine closed the connection");
+         xrsr_unix_event(unx, SM_EVENT_SOCKET_CLOSE, false);
+         return;
+      }
+      xrsr_unix_header_t header;
+      if(msg.msg_flags & MSG_TRUNC) {
+         XLOGD_ERROR("message truncated");
+         continue;
+      }
+      if((size_t)rc < sizeof(header)) {
+         XLOGD_ERROR("message too short <%zd>", rc);
+         continue;
+      }
+      memcpy(&header, unx->buffer_rx, sizeof(header));
+      if(header.length != rc - sizeof(header)) {
+         XLOGD_ERROR("invalid length <%u> rxd <%zd>", header.length, rc);
+         continue;
+      }
+      xrsr_unix_msg_recv(unx, &header, &unx->buffer_rx[sizeof(header)]);
+   }
+}
+
+void xrsr_unix_msg_recv(xrsr_state_unix_t *unx, const xrsr_unix_header_t *header, uint8_t *payload) {
+   switch(header->type) {
+      case XRSR_UNIX_MSG_TYPE_TEXT:
+      case XRSR_UNIX_MSG_TYPE_SESSION_END: {
+         if(!unx->response_rxd) {
+            rdkx_timestamp_t timestamp;
+            rdkx_timestamp_get(&timestamp);
+            unx->stats.time_response = rdkx_timestamp_subtract_us(unx->connect_timestamp, timestamp) / 1000000.0;
+            unx->response_rxd        = true;
+         }
+         xrsr_unix_event(unx, SM_EVENT_MSG_RECV, false);
+
+         xrsr_recv_event_t recv_event = XRSR_RECV_EVENT_NONE;
+         bool              close      = false;
+         if(header->length > 0) {
+            payload[header->length] = '\0'; // the receive buffer has room for the terminator
+            if(unx->handlers.recv_msg == NULL) {
+               XLOGD_ERROR("src <%s> recv msg handler not available", xrsr_src_str(unx->audio_src));
+            } else {
+               close = (*unx->handlers.recv_msg)(unx->handlers.data, XRSR_RECV_MSG_TEXT, payload, header->length, &recv_event);
+            }
+         }
+         if(header->type == XRSR_UNIX_MSG_TYPE_SESSION_END) {
+            unx->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_REMOTE;
+            unx->session_end_reason = XRSR_SESSION_END_REASON_DISCONNECT_REMOTE;
+            xrsr_unix_event(unx, SM_EVENT_SOCKET_CLOSE, false);
+         } else if(close) {
+            xrsr_unix_event(unx, SM_EVENT_APP_CLOSE, false);
+         } else if((unsigned int)recv_event < XRSR_RECV_EVENT_NONE) {
+            unx->stream_end_reason  = (recv_event == XRSR_RECV_EVENT_EOS_SERVER ? XRSR_STREAM_END_REASON_AUDIO_EOF : XRSR_STREAM_END_REASON_DISCONNECT_REMOTE);
+            XLOGD_INFO("src <%s> recv_event %s", xrsr_src_str(unx->audio_src), xrsr_recv_event_str(recv_event));
+            xrsr_unix_event(unx, SM_EVENT_EOS_PIPE, false);
+         }
+         break;
+      }
+      case XRSR_UNIX_MSG_TYPE_STREAM_END: {
+         if(!unx->audio_passed) {
+            XLOGD_WARN("unexpected stream end");
+            break;
+         }
+         XLOGD_INFO("engine read the end of the audio pipe");
+         unx->stream_end_reason = XRSR_STREAM_END_REASON_AUDIO_EOF;
+         xrsr_unix_event(unx, SM_EVENT_EOS_PIPE, false);
+         break;
+      }
+      default: {
+         XLOGD_WARN("unhandled message type <%u>", header->type);
+         break;
+      }
+   }
+}
+
+// The keyword's position is forwarded when the engine reads the audio itself
+void xrsr_unix_kwd_send(xrsr_state_unix_t *unx) {
+   if(unx->audio_kwd_notified || !unx->audio_passed) {
+      return;
+   }
+   uint32_t byte_qty = unx->audio_kwd_bytes;
+   if(xrsr_unix_msg_send(unx, XRSR_UNIX_MSG_TYPE_KEYWORD, (const uint8_t *)&byte_qty, sizeof(byte_qty), -1) <= 0) {
+      XLOGD_ERROR("keyword not sent");
+   }
+   if(!xrsr_speech_stream_kwd(unx->uuid, unx->audio_src, unx->dst_index)) {
+      XLOGD_ERROR("xrsr_speech_stream_kwd failed");
+   }
+   unx->audio_kwd_notified = true;
+}
+
+int xrsr_unix_send_text(xrsr_state_unix_t *unx, const uint8_t *buffer, uint32_t length) {
+   if(unx == NULL) {
+      XLOGD_ERROR("NULL xrsr_state_unix_t");
+      return(-1);
+   } else if(!xrsr_unix_is_connected(unx)) {
+      XLOGD_ERROR("invalid state");
+      return(-1);
+   }
+   XLOGD_DEBUG("length <%u>", length);
+   return(xrsr_unix_msg_send(unx, XRSR_UNIX_MSG_TYPE_TEXT, buffer, length, -1));
+}
+
+void xrsr_unix_speech_stream_end(xrsr_state_unix_t *unx, xrsr_stream_end_reason_t reason, bool detect_resume) {
+   XLOGD_INFO("fd <%d> reason <%s>", unx->audio_pipe_fd_read, xrsr_stream_end_reason_str(reason));
+
+   xrsr_speech_stream_end(unx->uuid, unx->audio_src, unx->dst_index, reason, detect_resume, &unx->audio_stats);
+
+   if(unx->audio_pipe_fd_read >= 0) {
+      close(unx->audio_pipe_fd_read);
+      unx->audio_pipe_fd_read = -1;
+   }
+}
+
+void xrsr_unix_speech_session_end(xrsr_state_unix_t *unx, xrsr_session_end_reason_t reason) {
+   XLOGD_INFO("fd <%d> reason <%s>", unx->audio_pipe_fd_read, xrsr_session_end_reason_str(reason));
+
+   unx->stats.reason = reason;
+
+   char uuid_str[37] = {'\0'};
+   uuid_unparse_lower(unx->uuid, uuid_str);
+   xrsr_session_end(unx->uuid, uuid_str, unx->audio_src, unx->dst_index, &unx->stats);
+}
+
+void xrsr_unix_handle_speech_event(xrsr_state_unix_t *unx, xrsr_speech_event_t *event) {
+   if(NULL == event) {
+      XLOGD_ERROR("speech event is NULL");
+      return;
+   }
+
+   switch(event->event) {
+      case XRSR_EVENT_EOS: {
+         xrsr_unix_event(unx, SM_EVENT_EOS, false);
+         break;
+      }
+      case XRSR_EVENT_STREAM_KWD_INFO: {
+         unx->audio_kwd_notified = false;
+         unx->audio_kwd_bytes    = event->data.byte_qty;
+         xrsr_unix_kwd_send(unx);
+         break;
+      }
+      case XRSR_EVENT_STREAM_TIME_MINIMUM: {
+         unx->stream_time_min_rxd = true;
+         xrsr_unix_event(unx, SM_EVENT_STM, false);
+         break;
+      }
+      default: {
+         XLOGD_WARN("unhandled speech event <%s>", xrsr_event_str(event->event));
+         break;
+      }
+   }
+}
+
+void xrsr_unix_reset(xrsr_state_unix_t *unx) {
+   if(unx) {
+      if(unx->timer_obj != NULL && unx->timer_id >= 0) {
+         if(!rdkx_timer_remove(unx->timer_obj, unx->timer_id)) {
+            XLOGD_ERROR("timer remove");
+         }
+      }
+      unx->timer_id           = RDXK_TIMER_ID_INVALID;
+      unx->audio_src          = XRSR_SRC_INVALID;
+      unx->detect_resume      = true;
+      unx->audio_passed       = false;
+      unx->stream_end_reason  = XRSR_STREAM_END_REASON_INVALID;
+      unx->session_end_reason = XRSR_SESSION_END_REASON_EOS;
+      if(unx->audio_pipe_fd_read >= 0) {
+         close(unx->audio_pipe_fd_read);
+         unx->audio_pipe_fd_read = -1;
+      }
+      xrsr_unix_close(unx);
+   }
+}
+
+void xrsr_unix_sm_init(xrsr_state_unix_t *unx) {
+   if(unx) {
+      unx->state_machine.mInstanceName = "unixSM";
+      unx->state_machine.bInitFinished = FALSE;
+      unx->state_machine.activeEvtQueue.mpQData = unx->state_machine_events_active;
+      unx->state_machine.activeEvtQueue.mQSize = XRSR_UNIX_SM_EVENTS_MAX;
+      unx->state_machine.deferredEvtQueue.mpQData = NULL;
+      unx->state_machine.deferredEvtQueue.mQSize = 0;
+
+      SmInit( &unx->state_machine, &St_Unix_Disconnected_Info );
+   }
+}
+
+void xrsr_unix_event(xrsr_state_unix_t *unx, tStEventID id, bool from_state_handler) {
+   if(unx) {
+      SmEnqueueEvent(&unx->state_machine, id, (void *)unx);
+      if(!from_state_handler) {
+         SmProcessEvents(&unx->state_machine);
+      }
+   }
+}
+
+void St_Unix_Disconnected(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResponse) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)pEvent->mData;
+   switch(eAction) {
+      case ACT_GUARD: {
+         if(bGuardResponse) {
+            *bGuardResponse = true;
+         }
+         break;
+      }
+      case ACT_ENTER: {
+         xrsr_unix_close(unx);
+         rdkx_timestamp_t timestamp;
+         rdkx_timestamp_get_realtime(&timestamp);
+         if(unx->handlers.disconnected == NULL) {
+            XLOGD_INFO("disconnected handler not available");
+         } else {
+            (*unx->handlers.disconnected)(unx->handlers.data, unx->uuid, unx->session_end_reason, false, &unx->detect_resume, &timestamp);
+         }
+         xrsr_unix_speech_session_end(unx, unx->session_end_reason);
+         xrsr_unix_reset(unx);
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void St_Unix_Buffering(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResponse) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)pEvent->mData;
+   switch(eAction) {
+      case ACT_GUARD: {
+         if(bGuardResponse) {
+            *bGuardResponse = true;
+         }
+         break;
+      }
+      case ACT_EXIT: {
+         switch(pEvent->mID) {
+            case SM_EVENT_EOS: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_AUDIO_DURATION;
+               xrsr_unix_speech_stream_end(unx, XRSR_STREAM_END_REASON_DID_NOT_BEGIN, unx->detect_resume);
+               break;
+            }
+            case SM_EVENT_TERMINATE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_TERMINATE;
+               xrsr_unix_speech_stream_end(unx, XRSR_STREAM_END_REASON_DID_NOT_BEGIN, unx->detect_resume);
+               break;
+            }
+            default: {
+               break;
+            }
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void St_Unix_Connecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResponse) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)pEvent->mData;
+   switch(eAction) {
+      case ACT_GUARD: {
+         if(bGuardResponse) {
+            *bGuardResponse = true;
+         }
+         break;
+      }
+      case ACT_ENTER: {
+         // Connecting to a local socket completes (or fails) immediately
+         xrsr_unix_event(unx, xrsr_unix_connect_new(unx) ? SM_EVENT_CONNECTED : SM_EVENT_CONNECT_FAILURE, true);
+         break;
+      }
+      case ACT_EXIT: {
+         switch(pEvent->mID) {
+            case SM_EVENT_CONNECT_FAILURE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_CONNECT_FAILURE;
+               xrsr_unix_speech_stream_end(unx, XRSR_STREAM_END_REASON_DID_NOT_BEGIN, unx->detect_resume);
+               break;
+            }
+            case SM_EVENT_TERMINATE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_TERMINATE;
+               xrsr_unix_speech_stream_end(unx, XRSR_STREAM_END_REASON_DID_NOT_BEGIN, unx->detect_resume);
+               break;
+            }
+            default: {
+               break;
+            }
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void St_Unix_Streaming(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResponse) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)pEvent->mData;
+   switch(eAction) {
+      case ACT_GUARD: {
+         if(bGuardResponse) {
+            *bGuardResponse = true;
+         }
+         break;
+      }
+      case ACT_ENTER: {
+         if(unx->handlers.connected == NULL) {
+            XLOGD_INFO("connected handler not available");
+         } else {
+            rdkx_timestamp_t timestamp;
+            rdkx_timestamp_get_realtime(&timestamp);
+            (*unx->handlers.connected)(unx->handlers.data, unx->uuid, xrsr_conn_send, (void *)unx, &timestamp);
+         }
+
+         char uuid_str[37] = {'\0'};
+         uuid_unparse_lower(unx->uuid, uuid_str);
+         xrsr_session_stream_begin(unx->uuid, uuid_str, unx->audio_src, unx->dst_index);
+         xrsr_unix_kwd_send(unx);
+         break;
+      }
+      case ACT_EXIT: {
+         switch(pEvent->mID) {
+            case SM_EVENT_EOS_PIPE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_EOS;
+               break;
+            }
+            case SM_EVENT_AUDIO_ERROR: {
+               unx->stream_end_reason  = XRSR_STREAM_END_REASON_ERROR_AUDIO_READ;
+               unx->session_end_reason = XRSR_SESSION_END_REASON_EOS;
+               break;
+            }
+            case SM_EVENT_TERMINATE: {
+               unx->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_LOCAL;
+               unx->session_end_reason = XRSR_SESSION_END_REASON_TERMINATE;
+               break;
+            }
+            case SM_EVENT_APP_CLOSE: {
+               unx->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_LOCAL;
+               unx->session_end_reason = XRSR_SESSION_END_REASON_EOS;
+               break;
+            }
+            case SM_EVENT_SOCKET_ERROR: {
+               unx->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_REMOTE;
+               unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_DISCONNECT_REMOTE;
+               break;
+            }
+            case SM_EVENT_SOCKET_CLOSE: {
+               if(unx->stream_end_reason == XRSR_STREAM_END_REASON_INVALID) { // closed without a session end message
+                  unx->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_REMOTE;
+                  unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_DISCONNECT_REMOTE;
+               }
+               break;
+            }
+            default: {
+               break;
+            }
+         }
+         xrsr_unix_speech_stream_end(unx, unx->stream_end_reason, unx->detect_resume);
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void St_Unix_Established(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResponse) {
+   xrsr_state_unix_t *unx = (xrsr_state_unix_t *)pEvent->mData;
+   switch(eAction) {
+      case ACT_GUARD: {
+         if(bGuardResponse) {
+            *bGuardResponse = true;
+         }
+         break;
+      }
+      case ACT_ENTER: {
+         // The audio is complete, wait for the engine to finish the session
+         rdkx_timestamp_t timeout;
+         rdkx_timestamp_get(&timeout);
+         rdkx_timestamp_add_ms(&timeout, unx->timeout_inactivity);
+         unx->timer_id = rdkx_timer_insert(unx->timer_obj, timeout, xrsr_unix_process_timeout, unx);
+         break;
+      }
+      case ACT_INTERNAL: {
+         switch(pEvent->mID) {
+            case SM_EVENT_MSG_RECV: {
+               rdkx_timestamp_t timeout;
+               rdkx_timestamp_get(&timeout);
+               rdkx_timestamp_add_ms(&timeout, unx->timeout_inactivity);
+               if(unx->timer_obj && unx->timer_id >= 0) {
+                  if(!rdkx_timer_update(unx->timer_obj, unx->timer_id, timeout)) {
+                     XLOGD_ERROR("timer update");
+                  }
+               }
+               break;
+            }
+            default: {
+               break;
+            }
+         }
+         break;
+      }
+      case ACT_EXIT: {
+         switch(pEvent->mID) {
+            case SM_EVENT_TIMEOUT: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_SESSION_TIMEOUT;
+               break;
+            }
+            case SM_EVENT_TERMINATE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_TERMINATE;
+               break;
+            }
+            case SM_EVENT_SOCKET_ERROR: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_ERROR_DISCONNECT_REMOTE;
+               break;
+            }
+            case SM_EVENT_APP_CLOSE:
+            case SM_EVENT_SOCKET_CLOSE: {
+               unx->session_end_reason = XRSR_SESSION_END_REASON_EOS;
+               break;
+            }
+            default: {
+               break;
+            }
+         }
+         if(unx->timer_obj != NULL && unx->timer_id >= 0) {
+            if(!rdkx_timer_remove(unx->timer_obj, unx->timer_id)) {
+               XLOGD_ERROR("timer remove");
+            }
+            unx->timer_id = RDXK_TIMER_ID_INVALID;
+         }
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+bool xrsr_unix_is_connected(xrsr_state_unix_t *unx) {
+   bool ret = false;
+   if(unx) {
+      if(SmInThisState(&unx->state_machine, &St_Unix_Streaming_Info) ||
+         SmInThisState(&unx->state_machine, &St_Unix_Established_Info)) {
+         ret = true;
+      }
+   }
+   return(ret);
+}
+
+bool xrsr_unix_is_disconnected(xrsr_state_unix_t *unx) {
+   bool ret = false;
+   if(unx) {
+      if(SmInThisState(&unx->state_machine, &St_Unix_Disconnected_Info)) {
+         ret = true;
+      }
+   }
+   return(ret);
+}
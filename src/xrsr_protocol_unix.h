@@ -0,0 +1,124 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#ifndef __XRSR_PROTOCOL_UNIX_H__
+#define __XRSR_PROTOCOL_UNIX_H__
+
+#include "xrpSMEngine.h"
+#include <sys/un.h>
+
+// Sessions with an on-device engine are sent over a SOCK_SEQPACKET unix domain socket, one connection per session.  Each
+// message starts with a header in host byte order and the socket keeps the message boundaries.
+//
+// router -> engine  SESSION_BEGIN  JSON describing the session.  Carries the audio pipe with SCM_RIGHTS when fd passing is enabled.
+// router -> engine  AUDIO          Audio in the session's format (only when the audio pipe is not passed)
+// router -> engine  KEYWORD        Byte offset (uint32_t) of the end of the keyword in the audio
+// router -> engine  STREAM_END     End of the audio stream (only when the audio pipe is not passed)
+// both directions   TEXT           Text message to or from the application
+// engine -> router  STREAM_END     The engine read the end of the passed audio pipe
+// engine -> router  SESSION_END    The engine is finished with the session, the payload is an optional final text message
+
+#define XRSR_UNIX_SM_EVENTS_MAX           (5)
+#define XRSR_UNIX_MSG_SIZE_MAX            (16384) // largest message including the header
+#define XRSR_UNIX_AUDIO_SIZE_MAX          (4096)  // audio read from the pipe per message
+#define XRSR_UNIX_TIMEOUT_INACTIVITY      (10000) // in milliseconds, when the destination params don't specify
+
+#define XRSR_UNIX_MSG_TYPE_SESSION_BEGIN  (1)
+#define XRSR_UNIX_MSG_TYPE_AUDIO          (2)
+#define XRSR_UNIX_MSG_TYPE_KEYWORD        (3)
+#define XRSR_UNIX_MSG_TYPE_STREAM_END     (4)
+#define XRSR_UNIX_MSG_TYPE_TEXT           (5)
+#define XRSR_UNIX_MSG_TYPE_SESSION_END    (6)
+
+#define XRSR_UNIX_MSG_FLAG_FD             (0x01) // an fd is attached to the message
+
+typedef struct {
+   uint8_t  type;
+   uint8_t  flags;
+   uint16_t reserved;
+   uint32_t length;   // payload length (in bytes)
+} xrsr_unix_header_t;
+
+typedef struct {
+   xrsr_protocol_t     prot;
+   rdkx_timer_object_t timer_obj;
+   xrsr_dst_param_ptrs_t *dst_params;
+} xrsr_unix_params_t;
+
+typedef struct {
+   xrsr_protocol_t              prot;  // Used for identification
+   xrsr_handlers_t              handlers;
+   uuid_t                       uuid;
+   xrsr_session_config_out_t    session_config_out;
+   xrsr_session_config_in_t     session_config_in;
+   rdkx_timer_object_t          timer_obj;
+   rdkx_timer_id_t              timer_id;
+   bool                         stream_time_min_rxd;
+   struct sockaddr_un           addr;
+   socklen_t                    addr_len;
+   int                          fd;
+   xrsr_src_t                   audio_src;
+   uint32_t                     dst_index;
+   xraudio_input_format_t       xraudio_format;
+   uint32_t                     sample_rate;
+   bool                         user_initiated;
+   bool                         low_latency;
+   rdkx_timestamp_t             connect_timestamp;
+   bool                         response_rxd;
+   int                          audio_pipe_fd_read;
+   bool                         audio_passed;       // the audio pipe was passed to the engine for this session
+   uint8_t                      buffer[sizeof(xrsr_unix_header_t) + XRSR_UNIX_AUDIO_SIZE_MAX];
+   uint32_t                     buffer_pending;     // length of a message in buffer waiting for the socket to be writable
+   uint8_t                      buffer_rx[XRSR_UNIX_MSG_SIZE_MAX + 1];
+   xrsr_session_stats_t         stats;
+   xrsr_audio_stats_t           audio_stats;
+
+   bool                         audio_kwd_notified;
+   uint32_t                     audio_kwd_bytes;
+   uint32_t                     audio_txd_bytes;
+
+   bool                         fd_passing;
+   uint32_t                     timeout_inactivity;
+
+   /* State Machine */
+   tSmInstance                  state_machine;
+   tStateEvent                  state_machine_events_active[XRSR_UNIX_SM_EVENTS_MAX];
+   xrsr_stream_end_reason_t     stream_end_reason;
+   xrsr_session_end_reason_t    session_end_reason;
+   bool                         detect_resume;
+} xrsr_state_unix_t;
+
+void xrsr_protocol_handler_unix(xrsr_src_t src, bool retry, bool user_initiated, xraudio_input_format_t xraudio_format, xraudio_keyword_detector_result_t *detector_result, const char* transcription_in, bool low_latency);
+bool xrsr_unix_init(xrsr_state_unix_t *unx, xrsr_unix_params_t *params);
+void xrsr_unix_term(xrsr_state_unix_t *unx);
+void xrsr_unix_update_dst_params(xrsr_state_unix_t *unx, const xrsr_dst_param_ptrs_t *params);
+void xrsr_unix_fd_set(xrsr_state_unix_t *unx, int *nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds);
+void xrsr_unix_handle_fds(xrsr_state_unix_t *unx, fd_set *readfds, fd_set *writefds, fd_set *exceptfds);
+bool xrsr_unix_connect(xrsr_state_unix_t *unx, xrsr_url_parts_t *url_parts, xrsr_src_t audio_src, xraudio_input_format_t xraudio_format, uint32_t sample_rate, bool user_initiated, bool deferred);
+void xrsr_unix_terminate(xrsr_state_unix_t *unx);
+int  xrsr_unix_send_text(xrsr_state_unix_t *unx, const uint8_t *buffer, uint32_t length);
+void xrsr_unix_speech_session_end(xrsr_state_unix_t *unx, xrsr_session_end_reason_t reason);
+void xrsr_unix_handle_speech_event(xrsr_state_unix_t *unx, xrsr_speech_event_t *event);
+
+// State check functions
+bool xrsr_unix_is_connected(xrsr_state_unix_t *unx);
+bool xrsr_unix_is_disconnected(xrsr_state_unix_t *unx);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include "xrpSMEngine.h"
+
+//-------------------------------------------------------------------------------
+// State Events
+//-------------------------------------------------------------------------------
+#define SM_EVENT_SESSION_BEGIN            (0)
+#define SM_EVENT_SESSION_BEGIN_STM        (1)
+#define SM_EVENT_STM                      (2)
+#define SM_EVENT_EOS                      (3)
+#define SM_EVENT_TERMINATE                (4)
+#define SM_EVENT_CONNECTED                (5)
+#define SM_EVENT_CONNECT_FAILURE          (6)
+#define SM_EVENT_EOS_PIPE                 (7)
+#define SM_EVENT_AUDIO_ERROR              (8)
+#define SM_EVENT_SOCKET_ERROR             (9)
+#define SM_EVENT_SOCKET_CLOSE             (10)
+#define SM_EVENT_MSG_RECV                 (11)
+#define SM_EVENT_APP_CLOSE                (12)
+#define SM_EVENT_TIMEOUT                  (13)
+
+//-------------------------------------------------------------------------------
+// States
+//-------------------------------------------------------------------------------
+
+STATE_DECLARE( St_Unix_Disconnected );
+STATE_DECLARE( St_Unix_Buffering );
+STATE_DECLARE( St_Unix_Connecting );
+STATE_DECLARE( St_Unix_Streaming );
+STATE_DECLARE( St_Unix_Established );
+
+// St_Unix_Disconnected State Description ----------------------------------------------------------------
+tStateGuard St_Unix_Disconnected_NextStates[] =
+{
+    { SM_EVENT_SESSION_BEGIN, &St_Unix_Connecting_Info },
+    { SM_EVENT_SESSION_BEGIN_STM, &St_Unix_Buffering_Info }
+};
+
+tStateInfo St_Unix_Disconnected_Info =
+{
+    SHOW_ST_NAME( "St_Unix_Disconnected" )
+    St_Unix_Disconnected,
+    ARRAY_COUNT( St_Unix_Disconnected_NextStates ),
+    St_Unix_Disconnected_NextStates,
+    0,
+    NULL
+};
+
+// St_Unix_Buffering State Description ----------------------------------------------------------------
+tStateGuard St_Unix_Buffering_NextStates[] =
+{
+    { SM_EVENT_EOS, &St_Unix_Disconnected_Info },
+    { SM_EVENT_TERMINATE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_STM, &St_Unix_Connecting_Info }
+};
+
+tStateInfo St_Unix_Buffering_Info =
+{
+    SHOW_ST_NAME( "St_Unix_Buffering" )
+    St_Unix_Buffering,
+    ARRAY_COUNT( St_Unix_Buffering_NextStates ),
+    St_Unix_Buffering_NextStates,
+    0,
+    NULL
+};
+
+// St_Unix_Connecting State Description ----------------------------------------------------------------
+tStateGuard St_Unix_Connecting_NextStates[] =
+{
+    { SM_EVENT_CONNECT_FAILURE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_TERMINATE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_CONNECTED, &St_Unix_Streaming_Info }
+};
+
+tStateInfo St_Unix_Connecting_Info =
+{
+    SHOW_ST_NAME( "St_Unix_Connecting" )
+    St_Unix_Connecting,
+    ARRAY_COUNT( St_Unix_Connecting_NextStates ),
+    St_Unix_Connecting_NextStates,
+    0,
+    NULL
+};
+
+// St_Unix_Streaming State Description ----------------------------------------------------------------
+tStateGuard St_Unix_Streaming_NextStates[] =
+{
+    { SM_EVENT_EOS_PIPE, &St_Unix_Established_Info },
+    { SM_EVENT_AUDIO_ERROR, &St_Unix_Established_Info },
+    { SM_EVENT_TERMINATE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_APP_CLOSE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_SOCKET_ERROR, &St_Unix_Disconnected_Info },
+    { SM_EVENT_SOCKET_CLOSE, &St_Unix_Disconnected_Info }
+};
+
+tStateInfo St_Unix_Streaming_Info =
+{
+    SHOW_ST_NAME( "St_Unix_Streaming" )
+    St_Unix_Streaming,
+    ARRAY_COUNT( St_Unix_Streaming_NextStates ),
+    St_Unix_Streaming_NextStates,
+    0,
+    NULL
+};
+
+// St_Unix_Established State Description ----------------------------------------------------------------
+tStateGuard St_Unix_Established_NextStates[] =
+{
+    { SM_EVENT_MSG_RECV, &St_Unix_Established_Info },
+    { SM_EVENT_TIMEOUT, &St_Unix_Disconnected_Info },
+    { SM_EVENT_TERMINATE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_APP_CLOSE, &St_Unix_Disconnected_Info },
+    { SM_EVENT_SOCKET_ERROR, &St_Unix_Disconnected_Info },
+    { SM_EVENT_SOCKET_CLOSE, &St_Unix_Disconnected_Info }
+};
+
+tStateInfo St_Unix_Established_Info =
+{
+    SHOW_ST_NAME( "St_Unix_Established" )
+    St_Unix_Established,
+    ARRAY_COUNT( St_Unix_Established_NextStates ),
+    St_Unix_Established_NextStates,
+    0,
+    NULL
+};
@@ -22,25 +22,67 @@
 #include <stdio.h>
 #include <string.h>
 #include <mqueue.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <poll.h>
 #include "xrsr_private.h"
 #include "xrsr_protocol_ws_sm.h"
 
 static void xrsr_ws_event(xrsr_state_ws_t *ws, tStEventID id, bool from_state_handler);
 static void xrsr_ws_reset(xrsr_state_ws_t *ws);
+static bool xrsr_ws_race_poll(xrsr_state_ws_t *ws);
 static void xrsr_ws_sm_init(xrsr_state_ws_t *ws);
 
 static void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg);
+static void xrsr_ws_recv_msg(xrsr_state_ws_t *ws, xrsr_recv_msg_t msg_type, const uint8_t *payload, uint32_t size, bool compressed);
+static void xrsr_ws_read_native(xrsr_state_ws_t *ws);
 static void xrsr_ws_on_close(noPollCtx *ctx,  noPollConn *conn, noPollPtr user_data);
+static void xrsr_ws_on_control_msg(noPollCtx *ctx, noPollConn *conn, noPollMsg *msg, noPollPtr user_data);
 static void xrsr_ws_nopoll_log(noPollCtx * ctx, noPollDebugLevel level, const char * log_msg, noPollPtr user_data);
 static void xrsr_ws_process_timeout(void *data);
+static bool xrsr_ws_audio_read(xrsr_state_ws_t *ws);
+static void xrsr_ws_audio_drain(xrsr_state_ws_t *ws);
+static void xrsr_ws_audio_sent(xrsr_state_ws_t *ws, uint64_t offset);
+static int  xrsr_ws_audio_send(xrsr_state_ws_t *ws, uint8_t *dst, const uint8_t *src, uint32_t length);
+static int  xrsr_ws_pending_bytes(xrsr_state_ws_t *ws);
+static int  xrsr_ws_pending_send(xrsr_state_ws_t *ws);
+static int  xrsr_ws_text_send(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t length);
+
+static uint32_t xrsr_ws_send_queue_space(xrsr_state_ws_t *ws);
+static bool     xrsr_ws_send_queue_stalled(xrsr_state_ws_t *ws);
 static void xrsr_ws_speech_stream_end(xrsr_state_ws_t *ws, xrsr_stream_end_reason_t reason, bool detect_resume);
 static bool xrsr_ws_connect_new(xrsr_state_ws_t *ws);
-static noPollConnOpts *xrsr_conn_opts_get(const char *sat_token);
+static noPollConnOpts *xrsr_conn_opts_get(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts);
+static bool            xrsr_ws_deflate_offered(xrsr_state_ws_t *ws, bool tls);
+static bool            xrsr_ws_handshake_peek(xrsr_state_ws_t *ws, noPollConn *conn, xrsr_ws_handshake_t *handshake);
 
-static bool xrsr_ws_queue_msg_out(xrsr_state_ws_t *ws, const char *msg, uint32_t length);
 static bool xrsr_ws_is_msg_out(xrsr_state_ws_t *ws);
-static bool xrsr_ws_get_msg_out(xrsr_state_ws_t *ws, char **msg, uint32_t *length);
 static void xrsr_ws_clear_msg_out(xrsr_state_ws_t *ws);
+static void xrsr_ws_conn_close(xrsr_state_ws_t *ws);
+static void xrsr_ws_transport_error(xrsr_state_ws_t *ws, tStEventID id);
+static bool xrsr_ws_reconnect_allowed(xrsr_state_ws_t *ws, tStEventID id);
+static void xrsr_ws_reconnect_failed(xrsr_state_ws_t *ws);
+
+static bool xrsr_ws_replay_init(xrsr_state_ws_t *ws);
+static void xrsr_ws_replay_append(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t length);
+static bool xrsr_ws_replay_offset(xrsr_state_ws_t *ws, uint64_t *offset);
+static bool xrsr_ws_replay_pending(xrsr_state_ws_t *ws);
+static void xrsr_ws_replay_send(xrsr_state_ws_t *ws);
+
+static void        xrsr_ws_url_build(char *url, size_t size, xrsr_url_parts_t *url_parts, const char **query_strs);
+static noPollConn *xrsr_ws_conn_open(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts, const char *url);
+static void        xrsr_ws_hedge_arm(xrsr_state_ws_t *ws);
+static void        xrsr_ws_hedge_timeout(void *data);
+static void        xrsr_ws_hedge_won(xrsr_state_ws_t *ws);
+static void        xrsr_ws_hedge_cancel(xrsr_state_ws_t *ws);
+
+static void        xrsr_ws_ping_start(xrsr_state_ws_t *ws);
+static void        xrsr_ws_ping_timeout(void *data);
+static void        xrsr_ws_ping_cancel(xrsr_state_ws_t *ws);
+static void        xrsr_ws_pong_rxd(xrsr_state_ws_t *ws);
+static uint32_t    xrsr_ws_pong_timeout(xrsr_state_ws_t *ws);
+static void        xrsr_ws_rtt_update(xrsr_state_ws_t *ws, uint64_t rtt_us);
+static void        xrsr_ws_metrics_report(xrsr_state_ws_t *ws);
 
 // This function kicks off the session
 void xrsr_protocol_handler_ws(xrsr_src_t src, bool retry, bool user_initiated, xraudio_input_format_t xraudio_format, xraudio_keyword_detector_result_t *detector_result, const char* transcription_in, bool low_latency) {
@@ -85,6 +127,10 @@ bool xrsr_ws_init(xrsr_state_ws_t *ws, xrsr_ws_params_t *params) {
    }
    ws->pending_msg   = NULL;
 
+   if(!xrsr_ws_frame_init(&ws->frame, sizeof(ws->buffer))) {
+      XLOGD_WARN("native framing is not available");
+   }
+
    sem_init(&ws->msg_out_semaphore, 0, 1);
    ws->msg_out_count = 0;
    memset(ws->msg_out, 0, sizeof(ws->msg_out));
@@ -92,6 +138,7 @@ bool xrsr_ws_init(xrsr_state_ws_t *ws, xrsr_ws_params_t *params) {
    xrsr_ws_update_dst_params(ws, params->dst_params);
    ws->timer_obj          = params->timer_obj;
    ws->prot               = params->prot;
+   ws->url_parts_hedge    = params->url_parts_hedge;
    ws->audio_pipe_fd_read = -1;
    xrsr_ws_reset(ws);
 
@@ -157,8 +204,48 @@ bool xrsr_ws_update_dst_params(xrsr_state_ws_t *ws, xrsr_dst_param_ptrs_t *param
       } else {
          ws->backoff_delay = JSON_INT_VALUE_WS_FPM_BACKOFF_DELAY;
       }
+      if(params->reconnect_buffer_size != NULL && *params->reconnect_buffer_size <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+         ws->reconnect_buffer_size = *params->reconnect_buffer_size;
+      } else {
+         ws->reconnect_buffer_size = JSON_INT_VALUE_WS_FPM_RECONNECT_BUFFER_SIZE;
+      }
+      if(params->send_queue_size != NULL && *params->send_queue_size <= XRSR_WS_RECONNECT_BUFFER_SIZE_MAX) {
+         ws->send_queue_size = *params->send_queue_size;
+      } else {
+         ws->send_queue_size = JSON_INT_VALUE_WS_FPM_SEND_QUEUE_SIZE;
+      }
+      if(params->send_queue_latency != NULL) {
+         ws->send_queue_latency = *params->send_queue_latency;
+      } else {
+         ws->send_queue_latency = JSON_INT_VALUE_WS_FPM_SEND_QUEUE_LATENCY;
+      }
+      if(params->hedge_delay != NULL) {
+         ws->hedge_delay = *params->hedge_delay;
+      } else {
+         ws->hedge_delay = JSON_INT_VALUE_WS_FPM_HEDGE_DELAY;
+      }
+      if(params->ping_interval != NULL) {
+         ws->ping_interval = *params->ping_interval;
+      } else {
+         ws->ping_interval = JSON_INT_VALUE_WS_FPM_PING_INTERVAL;
+      }
+      if(params->socket_profile != NULL && *params->socket_profile < XRSR_SOCKET_PROFILE_INVALID) {
+         ws->socket_profile = *params->socket_profile;
+      } else {
+         ws->socket_profile = xrsr_socket_profile_from_str(JSON_STR_VALUE_WS_FPM_SOCKET_PROFILE);
+      }
+      if(params->deflate != NULL) {
+         ws->deflate_enabled = *params->deflate;
+      } else {
+         ws->deflate_enabled = JSON_BOOL_VALUE_WS_FPM_DEFLATE;
+      }
+      if(params->deflate_no_context_takeover != NULL) {
+         ws->deflate_context_takeover = !*params->deflate_no_context_takeover;
+      } else {
+         ws->deflate_context_takeover = JSON_BOOL_VALUE_WS_FPM_DEFLATE_CONTEXT_TAKEOVER;
+      }
 
-      XLOGD_INFO("debug <%s> connect <%u, %u> inactivity <%u> session <%u> ipv4 fallback <%s> backoff delay <%u>", ws->debug_enabled ? "YES" : "NO", ws->connect_check_interval, ws->timeout_connect, ws->timeout_inactivity, ws->timeout_session, ws->ipv4_fallback ? "YES" : "NO", ws->backoff_delay);
+      XLOGD_INFO("debug <%s> connect <%u, %u> inactivity <%u> session <%u> ipv4 fallback <%s> backoff delay <%u> reconnect buffer <%u> send queue <%u, %u> hedge delay <%u> ping interval <%u> socket profile <%s> deflate <%s, %s>", ws->debug_enabled ? "YES" : "NO", ws->connect_check_interval, ws->timeout_connect, ws->timeout_inactivity, ws->timeout_session, ws->ipv4_fallback ? "YES" : "NO", ws->backoff_delay, ws->reconnect_buffer_size, ws->send_queue_size, ws->send_queue_latency, ws->hedge_delay, ws->ping_interval, xrsr_socket_profile_str(ws->socket_profile), ws->deflate_enabled ? "YES" : "NO", ws->deflate_context_takeover ? "YES" : "NO");
    } else {
       XLOGD_WARN("ws state NULL");
    }
@@ -200,6 +287,15 @@ void xrsr_ws_term(xrsr_state_ws_t *ws) {
    xrsr_ws_event(ws, SM_EVENT_TERMINATE, false);
    sem_destroy(&ws->msg_out_semaphore);
 
+   if(ws->replay_buffer != NULL) {
+      free(ws->replay_buffer);
+      ws->replay_buffer      = NULL;
+      ws->replay_buffer_size = 0;
+   }
+   xrsr_ws_frame_term(&ws->frame);
+   xrsr_ws_frame_rx_term(&ws->frame_rx);
+   xrsr_ws_deflate_term(&ws->deflate);
+
    nopoll_ctx_unref(ws->obj_ctx);
    ws->obj_ctx = NULL;
 }
@@ -214,19 +310,22 @@ void xrsr_ws_host_name_set(xrsr_state_ws_t *ws, const char *host_name) {
 void xrsr_ws_fd_set(xrsr_state_ws_t *ws, int *nfds, fd_set *readfds, fd_set *writefds, fd_set *exceptfds) {
    if(xrsr_ws_is_established(ws) && ws->socket >= 0) {
       //XLOGD_INFO("src <%s> socket <%d> audio pipe <%d> write pending bytes <%d>", xrsr_src_str(ws->audio_src), ws->socket, ws->audio_pipe_fd_read, ws->write_pending_bytes);
-      // Always check for incoming messages if ws is established
-      FD_SET(ws->socket, readfds);
+      // Check for incoming messages if ws is established.  Reading is deferred while a native frame is partially
+      // written since nopoll answers pings from the read path, and while any write is pending when frames are read natively.
+      if(xrsr_ws_frame_pending_bytes(&ws->frame) == 0 && !(ws->deflate.active && ws->write_pending_bytes)) {
+         FD_SET(ws->socket, readfds);
+      }
       if(ws->socket >= *nfds) {
          *nfds = ws->socket + 1;
       }
 
-      // If we need to send an outgoing message or waiting on data to go out
-      if(ws->write_pending_bytes || xrsr_ws_is_msg_out(ws)) {
+      // If we need to send an outgoing message, replay audio or waiting on data to go out
+      if(ws->write_pending_bytes || xrsr_ws_is_msg_out(ws) || xrsr_ws_replay_pending(ws)) {
          FD_SET(ws->socket, writefds);
       }
 
-      // We don't want to wake up for the audio pipe if we can't write it to the pipe
-      if(ws->audio_pipe_fd_read >= 0 && !ws->write_pending_bytes) {
+      // We don't want to wake up for the audio pipe if the send queue is full or the pipe has already reached EOF
+      if(ws->audio_pipe_fd_read >= 0 && !ws->eof_pending && ((!ws->write_pending_bytes && !xrsr_ws_replay_pending(ws)) || xrsr_ws_send_queue_space(ws) > 0)) {
          FD_SET(ws->audio_pipe_fd_read, readfds);
          if(ws->audio_pipe_fd_read >= *nfds) {
             *nfds = ws->audio_pipe_fd_read + 1;
@@ -238,7 +337,7 @@ void xrsr_ws_fd_set(xrsr_state_ws_t *ws, int *nfds, fd_set *readfds, fd_set *wri
 void xrsr_ws_handle_fds(xrsr_state_ws_t *ws, fd_set *readfds, fd_set *writefds, fd_set *exceptfds) {
    // First, let's check if we have received a message over the websocket
    if(ws->socket >= 0 && FD_ISSET(ws->socket, readfds)) {
-      XLOGD_INFO("src <%s> data available for read", xrsr_src_str(ws->audio_src));
+      xrsr_trace_record(XRSR_TRACE_EVENT_WS_SOCKET_READ, ws->audio_src, 0, 0);
       xrsr_ws_read_pending(ws);
    }
 
@@ -246,23 +345,28 @@ void xrsr_ws_handle_fds(xrsr_state_ws_t *ws, fd_set *readfds, fd_set *writefds,
    if(ws->socket >= 0 && FD_ISSET(ws->socket, writefds)) {
       // First check if we are trying to send pending bytes
       if(ws->write_pending_bytes) {
-         int bytes = nopoll_conn_pending_write_bytes(ws->obj_conn);
-         if(bytes != (nopoll_conn_complete_pending_write(ws->obj_conn))) {
-            XLOGD_WARN("src <%s> still waiting to write pending bytes...", xrsr_src_str(ws->audio_src));
-            ws->write_pending_retries++;
-            if(ws->write_pending_retries > XRSR_WS_WRITE_PENDING_RETRY_MAX) {
-               xrsr_ws_event(ws, SM_EVENT_WS_ERROR, false);
+         int bytes   = xrsr_ws_pending_bytes(ws);
+         int written = xrsr_ws_pending_send(ws);
+         if(bytes != written) {
+            xrsr_trace_record(XRSR_TRACE_EVENT_WS_PENDING_WAIT, ws->audio_src, bytes, written);
+            if(written > 0) { // the connection is slow but not stalled
+               ws->write_pending_retries = 0;
+            } else {
+               ws->write_pending_retries++;
+               if(ws->write_pending_retries > XRSR_WS_WRITE_PENDING_RETRY_MAX) {
+                  xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+                  return;
+               }
             }
-            // No point in continuing, as we haven't sent the pending data yet.
-            return;
+         } else {
+            xrsr_trace_record(XRSR_TRACE_EVENT_WS_PENDING_SENT, ws->audio_src, bytes, 0);
+            ws->write_pending_bytes   = false;
+            ws->write_pending_retries = 0;
          }
-         XLOGD_INFO("src <%s> pending bytes written successfully", xrsr_src_str(ws->audio_src));
-         ws->write_pending_bytes   = false;
-         ws->write_pending_retries = 0;
       }
 
       // Now lets see if we have a message to send out
-      if(xrsr_ws_is_msg_out(ws)) {
+      if(!ws->write_pending_bytes && xrsr_ws_is_msg_out(ws)) {
          int bytes    = 0;
          char *buf    = NULL;
          uint32_t len = 0;
@@ -270,13 +374,14 @@ void xrsr_ws_handle_fds(xrsr_state_ws_t *ws, fd_set *readfds, fd_set *writefds,
          if(xrsr_ws_get_msg_out(ws, &buf, &len)) {
             if(buf) {
                XLOGD_INFO("src <%s> sending outgoing message", xrsr_src_str(ws->audio_src));
-               bytes = nopoll_conn_send_text(ws->obj_conn, (const char *)buf, (long)len);
+               bytes = xrsr_ws_text_send(ws, (const uint8_t *)buf, len);
                // NoPoll now has the data copied into an internal buffer
                free(buf);
                buf = NULL;
                if(bytes == 0 || bytes == -1) {
                   XLOGD_ERROR("src <%s> failed to write to websocket", xrsr_src_str(ws->audio_src));
-                  xrsr_ws_event(ws, SM_EVENT_WS_ERROR, false);
+                  xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+                  return;
                } else if(bytes == -2 || bytes != len) {
                   if(bytes == -2) {
                      XLOGD_WARN("src <%s> websocket would block sending outgoing message", xrsr_src_str(ws->audio_src));
@@ -284,62 +389,205 @@ void xrsr_ws_handle_fds(xrsr_state_ws_t *ws, fd_set *readfds, fd_set *writefds,
                      XLOGD_WARN("src <%s> partial message sent", xrsr_src_str(ws->audio_src));
                   }
                   ws->write_pending_bytes = true;
-                  // No point in continuing, as we haven't sent this message yet.
-                  return;
                }
             }
          }
       }
+
+      // Then any audio retained from before a reconnect or queued while the socket was not writable
+      if(xrsr_ws_replay_pending(ws)) {
+         xrsr_ws_replay_send(ws);
+      }
+      if(ws->eof_pending && !xrsr_ws_replay_pending(ws)) {
+         XLOGD_INFO("src <%s> send queue empty after pipe EOF", xrsr_src_str(ws->audio_src));
+         ws->eof_pending = false;
+         xrsr_ws_event(ws, SM_EVENT_EOS_PIPE, false);
+         return;
+      }
    }
 
-   // Finally let's check if we have audio data available to send
-   if(ws->audio_pipe_fd_read >= 0 && FD_ISSET(ws->audio_pipe_fd_read, readfds)) {
-      // Read the audio data and write to websocket
-      int rc = read(ws->audio_pipe_fd_read, ws->buffer, sizeof(ws->buffer));
-      if(rc < 0) {
+   if(xrsr_ws_send_queue_stalled(ws)) {
+      XLOGD_ERROR("src <%s> send queue <%llu> bytes not sent within <%u> ms", xrsr_src_str(ws->audio_src), (unsigned long long)(ws->replay_rxd_bytes - ws->replay_txd_offset), ws->send_queue_latency);
+      xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+      return;
+   }
+
+   // Finally let's check if we have audio data available to send (audio is held in the pipe while reconnecting)
+   if(ws->audio_pipe_fd_read >= 0 && !ws->reconnecting && FD_ISSET(ws->audio_pipe_fd_read, readfds)) {
+      if(ws->eos_rxd) {
+         xrsr_ws_audio_drain(ws);
+      } else {
+         xrsr_ws_audio_read(ws);
+      }
+   }
+}
+
+// Reads a block of audio from the pipe and sends it.  While the socket is not writable, the audio is added to the send
+// queue instead.  Returns true if the pipe can be read again without waiting on the websocket.
+bool xrsr_ws_audio_read(xrsr_state_ws_t *ws) {
+   bool     queue = (ws->write_pending_bytes || xrsr_ws_replay_pending(ws));
+   uint32_t size  = sizeof(ws->buffer);
+   if(queue) {
+      uint32_t space = xrsr_ws_send_queue_space(ws);
+      if(space == 0) {
+         return(false);
+      }
+      if(size > space) {
+         size = space;
+      }
+   }
+
+   // Read the audio data and write to websocket
+   int rc = xrsr_speech_stream_read(ws->audio_src, ws->dst_index, ws->audio_pipe_fd_read, ws->buffer, size);
+   if(rc < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK) { // the pipeline is holding the audio, wait for the pipe
+         return(false);
+      }
+      XLOGD_ERROR("src <%s> pipe read error <%s>", xrsr_src_str(ws->audio_src), strerror(errsv));
+      xrsr_ws_event(ws, SM_EVENT_AUDIO_ERROR, false);
+   } else if(rc == 0) { // EOF
+      if(queue) { // the stream ends once the queue is sent
+         XLOGD_INFO("src <%s> pipe read EOF with <%llu> bytes queued", xrsr_src_str(ws->audio_src), (unsigned long long)(ws->replay_rxd_bytes - ws->replay_txd_offset));
+         ws->eof_pending = true;
+         return(false);
+      }
+      XLOGD_INFO("src <%s> pipe read EOF", xrsr_src_str(ws->audio_src));
+      xrsr_ws_event(ws, SM_EVENT_EOS_PIPE, false);
+   } else if(queue) {
+      if(ws->replay_txd_offset == ws->replay_rxd_bytes) {
+         rdkx_timestamp_get(&ws->send_queue_timestamp);
+      }
+      xrsr_ws_replay_append(ws, ws->buffer, (uint32_t)rc);
+
+      uint64_t queued = ws->replay_rxd_bytes - ws->replay_txd_offset;
+      xrsr_trace_record(XRSR_TRACE_EVENT_WS_AUDIO_QUEUED, ws->audio_src, rc, queued);
+      if(queued > ws->stats.send_queue_max) {
+         ws->stats.send_queue_max = (uint32_t)queued;
+      }
+      xrsr_ws_metrics_report(ws);
+   } else {
+      uint32_t bytes_read = (uint32_t)rc;
+      xrsr_trace_record(XRSR_TRACE_EVENT_WS_AUDIO_READ, ws->audio_src, bytes_read, 0);
+
+      xrsr_ws_replay_append(ws, ws->buffer, bytes_read);
+      ws->replay_txd_offset = ws->replay_rxd_bytes; // sent directly
+
+      rc = xrsr_ws_audio_send(ws, ws->buffer, ws->buffer, bytes_read);
+      if(rc == -2) { // NOPOLL_EWOULDBLOCK
+         XLOGD_WARN("src <%s> websocket would block", xrsr_src_str(ws->audio_src));
+         // Set flag to wait for socket write ready.  nopoll retains the frame.
+         ws->write_pending_bytes = true;
+         ws->would_block_qty++;
+         xrsr_ws_audio_sent(ws, ws->replay_rxd_bytes);
+      } else if(rc == 0) { // no bytes sent (see errno indication)
          int errsv = errno;
-         if(errsv == EAGAIN || errsv == EWOULDBLOCK) {
-            XLOGD_INFO("src <%s> read would block", xrsr_src_str(ws->audio_src));
-            xrsr_ws_event(ws, SM_EVENT_AUDIO_ERROR, false);
-         } else {
-            XLOGD_ERROR("src <%s> pipe read error <%s>", xrsr_src_str(ws->audio_src), strerror(errsv));
-            xrsr_ws_event(ws, SM_EVENT_AUDIO_ERROR, false);
-         }
-      } else if(rc == 0) { // EOF
-         XLOGD_INFO("src <%s> pipe read EOF", xrsr_src_str(ws->audio_src));
-         xrsr_ws_event(ws, SM_EVENT_EOS_PIPE, false);
+         XLOGD_ERROR("src <%s> websocket failure <%s>", xrsr_src_str(ws->audio_src), strerror(errsv));
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+      } else if(rc < 0) { // failure found
+         XLOGD_ERROR("src <%s> websocket failure <%d>", xrsr_src_str(ws->audio_src), rc);
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+      } else if(rc != bytes_read) { // partial bytes sent
+         XLOGD_WARN("src <%s> websocket size mismatch req <%u> sent <%d>", xrsr_src_str(ws->audio_src), bytes_read, rc);
+         // Set flag to wait for socket write ready.  nopoll retains the rest of the frame.
+         ws->write_pending_bytes = true;
+         ws->would_block_qty++;
+         xrsr_ws_audio_sent(ws, ws->replay_rxd_bytes);
       } else {
-         XLOGD_DEBUG("src <%s> pipe read <%d>", xrsr_src_str(ws->audio_src), rc);
-         uint32_t bytes_read = (uint32_t)rc;
+         xrsr_ws_audio_sent(ws, ws->replay_rxd_bytes);
+      }
+      if(ws->audio_pipe_fd_read >= 0) {
+         xrsr_ws_metrics_report(ws);
+      }
+   }
+   if(ws->audio_pipe_fd_read < 0) {
+      return(false);
+   }
+   return((!ws->write_pending_bytes && !xrsr_ws_replay_pending(ws)) || xrsr_ws_send_queue_space(ws) > 0);
+}
 
-         rc = nopoll_conn_send_binary(ws->obj_conn, (const char *)ws->buffer, (long)bytes_read);
-         if(rc == -2) { // NOPOLL_EWOULDBLOCK
-            XLOGD_WARN("src <%s> websocket would block", xrsr_src_str(ws->audio_src));
-            // Set flag to wait for socket write ready
-            ws->write_pending_bytes = true;
-         } else if(rc == 0) { // no bytes sent (see errno indication)
-            int errsv = errno;
-            XLOGD_ERROR("src <%s> websocket failure <%s>", xrsr_src_str(ws->audio_src), strerror(errsv));
-            xrsr_ws_event(ws, SM_EVENT_WS_ERROR, false);
-         } else if(rc < 0) { // failure found
-            XLOGD_ERROR("src <%s> websocket failure <%d>", xrsr_src_str(ws->audio_src), rc);
-            xrsr_ws_event(ws, SM_EVENT_WS_ERROR, false);
-         } else if(rc != bytes_read) { // partial bytes sent
-            XLOGD_WARN("src <%s> websocket size mismatch req <%u> sent <%d>", xrsr_src_str(ws->audio_src), bytes_read, rc);
-            // Set flag to wait for socket write ready
-            ws->write_pending_bytes = true;
-            ws->audio_txd_bytes    += (uint32_t) rc;
-         } else {
-            ws->audio_txd_bytes += bytes_read;
-         }
-         if(!ws->audio_kwd_notified && (ws->audio_txd_bytes >= ws->audio_kwd_bytes)) {
-            if(!xrsr_speech_stream_kwd(ws->uuid,  ws->audio_src, ws->dst_index)) {
-               XLOGD_ERROR("src <%s> xrsr_speech_stream_kwd failed", xrsr_src_str(ws->audio_src));
-            }
-            ws->audio_kwd_notified = true;
-         }
+// Sends a binary audio frame with the native framer when the connection allows it, otherwise through nopoll.  The
+// native framer masks the payload from src into dst.  Return values follow nopoll_conn_send_binary.
+int xrsr_ws_audio_send(xrsr_state_ws_t *ws, uint8_t *dst, const uint8_t *src, uint32_t length) {
+   if(ws->frame_native) {
+      return(xrsr_ws_frame_send_binary(&ws->frame, ws->socket, dst, src, length));
+   }
+   return(nopoll_conn_send_binary(ws->obj_conn, (const char *)src, (long)length));
+}
+
+int xrsr_ws_pending_bytes(xrsr_state_ws_t *ws) {
+   uint32_t bytes = xrsr_ws_frame_pending_bytes(&ws->frame);
+   if(bytes > 0) {
+      return((int)bytes);
+   }
+   return(nopoll_conn_pending_write_bytes(ws->obj_conn));
+}
+
+int xrsr_ws_pending_send(xrsr_state_ws_t *ws) {
+   if(xrsr_ws_frame_pending_bytes(&ws->frame) > 0) {
+      return(xrsr_ws_frame_pending_send(&ws->frame, ws->socket));
+   }
+   return(nopoll_conn_complete_pending_write(ws->obj_conn));
+}
+
+// Sends an outgoing text message.  nopoll can't mark a message as compressed, so when the server accepted
+// permessage-deflate in the handshake the message is compressed and framed natively.  Return values follow
+// nopoll_conn_send_text.
+int xrsr_ws_text_send(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t length) {
+   ws->stats.text_txd_bytes += length;
+
+   if(ws->deflate.active && !ws->deflate.txd_disabled && ws->frame_native) {
+      const uint8_t *out        = NULL;
+      uint32_t       out_length = 0;
+      if(xrsr_ws_deflate_compress(&ws->deflate, buffer, length, &out, &out_length) && out_length <= ws->frame.payload_max) {
+         ws->stats.text_txd_compressed_bytes += out_length;
+         int rc = xrsr_ws_frame_send(&ws->frame, ws->socket, XRSR_WS_FRAME_OPCODE_TEXT | XRSR_WS_FRAME_RSV1, (uint8_t *)out, out, out_length);
+         return((rc == (int)out_length) ? (int)length : rc);
+      }
+      // The compression context now includes a message that the server won't see, so stop compressing on this connection
+      XLOGD_WARN("src <%s> unable to compress message <%u> bytes - compression disabled", xrsr_src_str(ws->audio_src), length);
+      ws->deflate.txd_disabled = true;
+   }
+   return(nopoll_conn_send_text(ws->obj_conn, (const char *)buffer, (long)length));
+}
+
+// Records audio handed to the socket up to the stream offset and notifies when the keyword has been sent
+void xrsr_ws_audio_sent(xrsr_state_ws_t *ws, uint64_t offset) {
+   if(offset > ws->audio_txd_bytes) {
+      ws->audio_txd_bytes = (uint32_t)offset;
+   }
+   if(!ws->audio_kwd_notified && (ws->audio_txd_bytes >= ws->audio_kwd_bytes)) {
+      if(!xrsr_speech_stream_kwd(ws->uuid,  ws->audio_src, ws->dst_index)) {
+         XLOGD_ERROR("src <%s> xrsr_speech_stream_kwd failed", xrsr_src_str(ws->audio_src));
+      }
+      ws->audio_kwd_notified = true;
+   }
+}
+
+// After end of speech, the audio left in the pipe is sent in one pass instead of one block per poll, so the stream ends
+// as soon as the pipe is closed.
+void xrsr_ws_audio_drain(xrsr_state_ws_t *ws) {
+   uint32_t qty  = 0;
+   bool     cork = xrsr_ws_is_established(ws);
+   if(cork) { // send the remaining frames in full segments
+      xrsr_socket_cork(ws->socket, &ws->stats.socket, true);
+   }
+   while(ws->audio_pipe_fd_read >= 0 && !ws->reconnecting && !ws->eof_pending) {
+      struct pollfd pfd;
+      pfd.fd     = ws->audio_pipe_fd_read;
+      pfd.events = POLLIN;
+      if(poll(&pfd, 1, 0) <= 0 || !(pfd.revents & (POLLIN | POLLHUP))) { // the rest of the audio has not been written yet
+         break;
+      }
+      qty++;
+      if(!xrsr_ws_audio_read(ws)) {
+         break;
       }
    }
+   if(cork) {
+      xrsr_socket_cork(ws->socket, &ws->stats.socket, false);
+   }
+   xrsr_trace_record(XRSR_TRACE_EVENT_WS_AUDIO_DRAIN, ws->audio_src, qty, 0);
 }
 
 void xrsr_ws_process_timeout(void *data) {
@@ -364,25 +612,9 @@ bool xrsr_ws_connect(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts, xrsr_src_
    ws->audio_src      = audio_src;
    ws->xraudio_format = xraudio_format;
 
-   errno_t safe_rc = -1;
-   safe_rc = strncpy_s(ws->url, sizeof(ws->url), url_parts->urle, XRSR_WS_URL_SIZE_MAX-1); // Copy main url
-   ERR_CHK(safe_rc);
-
-   if(query_strs != NULL && *query_strs != NULL) { // add attribute-value pairs to the query string
-      bool delimit = true;
-      if(!url_parts->has_query) {
-         strlcat(ws->url, "?", sizeof(ws->url));
-         delimit = false;
-      }
-
-      do {
-         if(delimit) {
-            strlcat(ws->url, "&", sizeof(ws->url));
-         }
-         strlcat(ws->url, *query_strs, sizeof(ws->url));
-         delimit = true;
-         query_strs++;
-      } while(*query_strs != NULL);
+   xrsr_ws_url_build(ws->url, sizeof(ws->url), url_parts, query_strs);
+   if(ws->url_parts_hedge != NULL) {
+      xrsr_ws_url_build(ws->url_hedge, sizeof(ws->url_hedge), ws->url_parts_hedge, query_strs);
    }
 
    XLOGD_INFO("src <%s> local host <%s> remote host <%s> port <%s> url <%s> deferred <%s> family <%s> retry period <%u> ms", xrsr_src_str(ws->audio_src), ws->local_host_name, url_parts->host, url_parts->port_str, xrsr_mask_pii() ? "***" : ws->url, (deferred) ? "YES" : "NO", xrsr_address_family_str(url_parts->family), ws->timeout_session);
@@ -394,12 +626,24 @@ bool xrsr_ws_connect(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts, xrsr_src_
    ws->audio_kwd_notified = true; // if keyword is present in the stream, xraudio will inform
    ws->audio_kwd_bytes    = 0;
    ws->audio_txd_bytes    = 0;
+   ws->eos_rxd            = false;
+   ws->eof_pending        = false;
    ws->connect_wait_time  = ws->timeout_connect;
    ws->on_close           = false;
    ws->close_status       = -1;
+   ws->reconnecting       = false;
+   ws->hedge_armed        = false;
+   ws->would_block_qty    = 0;
+   ws->metrics_txd_bytes  = 0;
+   rdkx_timestamp_get(&ws->metrics_timestamp);
+   ws->metrics_timestamp_last = ws->metrics_timestamp;
    memset(&ws->stats, 0, sizeof(ws->stats));
    memset(&ws->audio_stats, 0, sizeof(ws->audio_stats));
 
+   if(!xrsr_ws_replay_init(ws)) {
+      XLOGD_WARN("src <%s> mid-stream reconnect is not available", xrsr_src_str(ws->audio_src));
+   }
+
    if(!deferred) {
       xrsr_ws_event(ws, SM_EVENT_SESSION_BEGIN, false);
       return(true);
@@ -408,9 +652,61 @@ bool xrsr_ws_connect(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts, xrsr_src_
    return(true);
 }
 
+void xrsr_ws_url_build(char *url, size_t size, xrsr_url_parts_t *url_parts, const char **query_strs) {
+   errno_t safe_rc = -1;
+   safe_rc = strncpy_s(url, size, url_parts->urle, size-1); // Copy main url
+   ERR_CHK(safe_rc);
+
+   if(query_strs != NULL && *query_strs != NULL) { // add attribute-value pairs to the query string
+      bool delimit = true;
+      if(!url_parts->has_query) {
+         strlcat(url, "?", size);
+         delimit = false;
+      }
+
+      do {
+         if(delimit) {
+            strlcat(url, "&", size);
+         }
+         strlcat(url, *query_strs, size);
+         delimit = true;
+         query_strs++;
+      } while(*query_strs != NULL);
+   }
+}
+
 bool xrsr_ws_connect_new(xrsr_state_ws_t *ws) {
+   XLOGD_INFO("src <%s> attempt <%u>", xrsr_src_str(ws->audio_src), ws->retry_cnt);
+
+   memset(&ws->handshake, 0, sizeof(ws->handshake));
+
+   if(ws->ipv4_fallback) { // race the address families instead of waiting for IPv6 to time out.  the websocket is opened on the winning socket.
+      ws->obj_conn = NULL;
+      return(xrsr_eyeballs_start(&ws->eyeballs, ws->url_parts->host, ws->url_parts->port_str, XRSR_EYEBALLS_ATTEMPT_DELAY));
+   }
+
+   ws->obj_conn = xrsr_ws_conn_open(ws, ws->url_parts, ws->url);
+   
+   if(ws->obj_conn == NULL) {
+      XLOGD_ERROR("src <%s> conn new", xrsr_src_str(ws->audio_src));
+      return(false);
+   }
+   nopoll_conn_set_on_close(ws->obj_conn, xrsr_ws_on_close, ws);
+   nopoll_conn_set_on_msg(ws->obj_conn, xrsr_ws_on_control_msg, ws);
+   return(true);
+}
+
+// Returns false if every connection attempt failed
+bool xrsr_ws_race_poll(xrsr_state_ws_t *ws) {
+   bool failed = false;
+   int  fd     = xrsr_eyeballs_poll(&ws->eyeballs, &failed);
+
+   if(fd < 0) {
+      return(!failed);
+   }
+
    xrsr_url_parts_t *url_parts = ws->url_parts;
-   noPollConnOpts *nopoll_opts = xrsr_conn_opts_get(ws->session_config_in.ws.sat_token);
+   noPollConnOpts *nopoll_opts = xrsr_conn_opts_get(ws, url_parts);
 
    const char *origin_fmt = "http://%s:%s";
    uint32_t origin_size = strlen(url_parts->host) + strlen(url_parts->port_str) + strlen(origin_fmt) - 3;
@@ -418,40 +714,110 @@ bool xrsr_ws_connect_new(xrsr_state_ws_t *ws) {
 
    snprintf(origin, sizeof(origin), origin_fmt, url_parts->host, url_parts->port_str);
 
-   XLOGD_INFO("src <%s> attempt <%u>", xrsr_src_str(ws->audio_src), ws->retry_cnt);
-
-   if(ws->prot == XRSR_PROTOCOL_WSS) {
+   if(url_parts->prot == XRSR_PROTOCOL_WSS) {
       const char *ptr_path = strchrnul(&ws->url[6], '/'); // skip over wss:// and locate next /
-      ws->obj_conn = nopoll_conn_tls_new_auto(ws->obj_ctx, nopoll_opts, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin);
+      ws->obj_conn = nopoll_conn_tls_new_with_socket(ws->obj_ctx, nopoll_opts, fd, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin);
    } else {
       const char *ptr_path = strchrnul(&ws->url[5], '/'); // skip over ws:// and locate next /
-      ws->obj_conn = nopoll_conn_new_opts_auto(ws->obj_ctx, nopoll_opts, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin);
+      ws->obj_conn = nopoll_conn_new_with_socket(ws->obj_ctx, nopoll_opts, fd, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin);
    }
-   
+
    if(ws->obj_conn == NULL) {
-      XLOGD_ERROR("src <%s> conn new", xrsr_src_str(ws->audio_src));
+      XLOGD_ERROR("src <%s> conn new with socket", xrsr_src_str(ws->audio_src));
+      close(fd);
       return(false);
    }
+   url_parts->family = ws->eyeballs.family;
+   strlcpy(ws->stats.server_ip, ws->eyeballs.ip, sizeof(ws->stats.server_ip));
    nopoll_conn_set_on_close(ws->obj_conn, xrsr_ws_on_close, ws);
+   nopoll_conn_set_on_msg(ws->obj_conn, xrsr_ws_on_control_msg, ws);
    return(true);
 }
 
-noPollConnOpts *xrsr_conn_opts_get(const char *sat_token) {
+noPollConn *xrsr_ws_conn_open(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts, const char *url) {
+   noPollConnOpts *nopoll_opts = xrsr_conn_opts_get(ws, url_parts);
+
+   const char *origin_fmt = "http://%s:%s";
+   uint32_t origin_size = strlen(url_parts->host) + strlen(url_parts->port_str) + strlen(origin_fmt) - 3;
+   char origin[origin_size];
+
+   snprintf(origin, sizeof(origin), origin_fmt, url_parts->host, url_parts->port_str);
+
+   if(url_parts->prot == XRSR_PROTOCOL_WSS) {
+      const char *ptr_path = strchrnul(&url[6], '/'); // skip over wss:// and locate next /
+      return(nopoll_conn_tls_new_auto(ws->obj_ctx, nopoll_opts, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin));
+   }
+   const char *ptr_path = strchrnul(&url[5], '/'); // skip over ws:// and locate next /
+   return(nopoll_conn_new_opts_auto(ws->obj_ctx, nopoll_opts, url_parts->host, url_parts->port_str, NULL, ptr_path, NULL, origin));
+}
+
+noPollConnOpts *xrsr_conn_opts_get(xrsr_state_ws_t *ws, xrsr_url_parts_t *url_parts) {
    noPollConnOpts *nopoll_opts = NULL;
-   if(sat_token != NULL) {
+   const char *    sat_token   = ws->session_config_in.ws.sat_token;
+   bool            deflate     = xrsr_ws_deflate_offered(ws, url_parts->prot == XRSR_PROTOCOL_WSS);
+   if(sat_token != NULL || deflate) {
       nopoll_opts = nopoll_conn_opts_new();
       if(nopoll_opts == NULL) {
          XLOGD_ERROR("NULL nopoll opts");
       } else {
          char sat_token_str[24 + XRSR_SAT_TOKEN_LEN_MAX] = {'\0'};
+         char deflate_str[96] = {'\0'};
+         char headers[sizeof(sat_token_str) + sizeof(deflate_str)];
          // String must match the format: "\r\nheader:value\r\nheader2:value2" with no trailing \r\n.
-         snprintf(sat_token_str, sizeof(sat_token_str), "\r\nAuthorization: Bearer %s", sat_token);
-         nopoll_conn_opts_set_extra_headers(nopoll_opts, sat_token_str);
+         if(sat_token != NULL) {
+            snprintf(sat_token_str, sizeof(sat_token_str), "\r\nAuthorization: Bearer %s", sat_token);
+         }
+         if(deflate) {
+            xrsr_ws_deflate_offer(ws->deflate_context_takeover, deflate_str, sizeof(deflate_str));
+         }
+         snprintf(headers, sizeof(headers), "%s%s", sat_token_str, deflate_str);
+         nopoll_conn_opts_set_extra_headers(nopoll_opts, headers);
       }
    }
    return(nopoll_opts);
 }
 
+// Compressed messages are marked by RSV1, which nopoll doesn't report, so permessage-deflate is only offered when the
+// frames can be read natively.  nopoll owns the TLS session, so that rules out encrypted connections.
+bool xrsr_ws_deflate_offered(xrsr_state_ws_t *ws, bool tls) {
+   return(ws->deflate_enabled && !tls && ws->frame.payload_max > 0);
+}
+
+// nopoll doesn't expose the handshake response, so it is peeked from the socket before nopoll reads it to find the
+// extensions which the server accepted.  Returns false until the whole response has arrived.
+bool xrsr_ws_handshake_peek(xrsr_state_ws_t *ws, noPollConn *conn, xrsr_ws_handshake_t *handshake) {
+   if(handshake->rxd) {
+      return(true);
+   }
+   if(!xrsr_ws_deflate_offered(ws, nopoll_true == nopoll_conn_is_tls_on(conn))) {
+      handshake->rxd = true;
+      return(true);
+   }
+   char    response[XRSR_WS_HANDSHAKE_SIZE_MAX];
+   ssize_t rc = recv(nopoll_conn_socket(conn), response, sizeof(response) - 1, MSG_PEEK | MSG_DONTWAIT);
+   if(rc < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK || errsv == EINTR || errsv == ENOTCONN) {
+         return(false);
+      }
+   }
+   if(rc <= 0) { // nopoll reports the failure
+      handshake->rxd = true;
+      return(true);
+   }
+   response[rc] = '\0';
+   if(strstr(response, "\r\n\r\n") == NULL) {
+      if((size_t)rc < sizeof(response) - 1) {
+         return(false);
+      }
+      XLOGD_WARN("src <%s> handshake response too large - permessage-deflate not used", xrsr_src_str(ws->audio_src));
+   } else {
+      handshake->deflate = xrsr_ws_deflate_accepted(response, &handshake->context_takeover);
+   }
+   handshake->rxd = true;
+   return(true);
+}
+
 bool xrsr_ws_conn_is_ready(xrsr_state_ws_t *ws) {
    if(ws == NULL) {
       XLOGD_ERROR("NULL xrsr_state_ws_t");
@@ -460,7 +826,7 @@ bool xrsr_ws_conn_is_ready(xrsr_state_ws_t *ws) {
       XLOGD_ERROR("src <%s> NULL param", xrsr_src_str(ws->audio_src));
       return(false);
    }
-   if(nopoll_true != nopoll_conn_is_ready(ws->obj_conn)) {
+   if(!xrsr_ws_handshake_peek(ws, ws->obj_conn, &ws->handshake) || nopoll_true != nopoll_conn_is_ready(ws->obj_conn)) {
       return(false);
    }
 
@@ -469,6 +835,22 @@ bool xrsr_ws_conn_is_ready(xrsr_state_ws_t *ws) {
    if(nopoll_true != nopoll_conn_set_sock_block(ws->socket, nopoll_false)) {
       XLOGD_WARN("src <%s> unable to set non-blocking", xrsr_src_str(ws->audio_src));
    }
+   // nopoll owns the TLS session, so encrypted connections send audio through nopoll
+   xrsr_ws_frame_reset(&ws->frame);
+   ws->frame_native = (ws->frame.payload_max > 0 && nopoll_true != nopoll_conn_is_tls_on(ws->obj_conn));
+   XLOGD_INFO("src <%s> native framing <%s>", xrsr_src_str(ws->audio_src), ws->frame_native ? "YES" : "NO");
+
+   // Each connection negotiates permessage-deflate with fresh contexts
+   xrsr_ws_deflate_term(&ws->deflate);
+   xrsr_ws_deflate_init(&ws->deflate, ws->deflate_context_takeover && ws->handshake.context_takeover);
+   ws->deflate.active = (ws->handshake.deflate && ws->frame_native);
+   xrsr_ws_frame_rx_reset(&ws->frame_rx);
+   if(ws->deflate.active) {
+      XLOGD_INFO("src <%s> permessage-deflate in use - context takeover <%s>", xrsr_src_str(ws->audio_src), ws->deflate.context_takeover ? "YES" : "NO");
+   }
+   if(!xrsr_socket_profile_apply(ws->socket, ws->socket_profile, &ws->stats.socket)) {
+      XLOGD_WARN("src <%s> socket profile <%s> not fully applied", xrsr_src_str(ws->audio_src), xrsr_socket_profile_str(ws->socket_profile));
+   }
    return(true);
 }
 
@@ -521,6 +903,11 @@ int xrsr_ws_read_pending(xrsr_state_ws_t *ws) {
       return(-1);
    }
 
+   if(ws->deflate.active) {
+      xrsr_ws_read_native(ws);
+      return(0);
+   }
+
    noPollMsg *msg = nopoll_conn_get_msg(ws->obj_conn);
 
    if(msg == NULL) {
@@ -570,7 +957,6 @@ int xrsr_ws_send_text(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t lengt
 void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
    XLOGD_INFO("src <%s>", xrsr_src_str(ws->audio_src));
    xrsr_recv_msg_t msg_type      = XRSR_RECV_MSG_INVALID;
-   xrsr_recv_event_t recv_event  = XRSR_RECV_EVENT_NONE;
 
    // Check if we are building up a message
    if(ws->pending_msg != NULL && nopoll_msg_is_final(msg) == nopoll_true) {
@@ -586,6 +972,8 @@ void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
       return;
    }
 
+   ws->pong_missed = 0; // any message shows that the connection is alive
+
    noPollOpCode opcode = nopoll_msg_opcode(msg);
    switch(opcode) {
       case NOPOLL_TEXT_FRAME: {
@@ -596,6 +984,11 @@ void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
          msg_type = XRSR_RECV_MSG_BINARY;
          break;
       }
+      case NOPOLL_PONG_FRAME: {
+         xrsr_ws_pong_rxd(ws);
+         nopoll_msg_unref(msg);
+         return;
+      }
       default: {
          XLOGD_ERROR("src <%s> invalid opcode <%s>", xrsr_src_str(ws->audio_src), xrsr_ws_opcode_str(opcode));
          break;
@@ -604,11 +997,102 @@ void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
    if(msg_type == XRSR_RECV_MSG_INVALID) {
       return;
    }
-   const unsigned char *payload = nopoll_msg_get_payload(msg);
    int size = nopoll_msg_get_payload_size(msg);
 
+   // Messages read by nopoll are never compressed since permessage-deflate connections are read natively
+   xrsr_ws_recv_msg(ws, msg_type, nopoll_msg_get_payload(msg), (size > 0) ? (uint32_t)size : 0, false);
+   nopoll_msg_unref(msg);
+}
+
+// Reads a message natively while permessage-deflate is in use.  Pings are answered here, so reading is deferred while a
+// write is pending.
+void xrsr_ws_read_native(xrsr_state_ws_t *ws) {
+   uint8_t        opcode     = 0;
+   const uint8_t *payload    = NULL;
+   uint32_t       length     = 0;
+   bool           compressed = false;
+
+   int rc = xrsr_ws_frame_recv(&ws->frame_rx, ws->socket, &opcode, &payload, &length, &compressed);
+   if(rc == 0) {
+      return;
+   } else if(rc < 0) {
+      int errsv = errno;
+      XLOGD_ERROR("src <%s> read failed <%s>", xrsr_src_str(ws->audio_src), strerror(errsv));
+      ws->on_close     = true;
+      ws->close_status = 1006; // abnormal closure
+      xrsr_ws_transport_error(ws, SM_EVENT_WS_CLOSE);
+      return;
+   }
+
+   switch(opcode) {
+      case XRSR_WS_FRAME_OPCODE_TEXT: {
+         ws->pong_missed = 0;
+         xrsr_ws_recv_msg(ws, XRSR_RECV_MSG_TEXT, payload, length, compressed);
+         break;
+      }
+      case XRSR_WS_FRAME_OPCODE_BINARY: {
+         ws->pong_missed = 0;
+         xrsr_ws_recv_msg(ws, XRSR_RECV_MSG_BINARY, payload, length, compressed);
+         break;
+      }
+      case XRSR_WS_FRAME_OPCODE_PING: {
+         uint8_t pong[XRSR_WS_FRAME_CONTROL_SIZE_MAX];
+         int     ret = xrsr_ws_frame_send(&ws->frame, ws->socket, XRSR_WS_FRAME_OPCODE_PONG, pong, payload, length);
+         if(ret == -2) {
+            ws->write_pending_bytes = true;
+         } else if(ret < 0) {
+            XLOGD_ERROR("src <%s> pong failed", xrsr_src_str(ws->audio_src));
+            xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+         }
+         break;
+      }
+      case XRSR_WS_FRAME_OPCODE_PONG: {
+         xrsr_ws_pong_rxd(ws);
+         break;
+      }
+      case XRSR_WS_FRAME_OPCODE_CLOSE: {
+         XLOGD_INFO("src <%s> close frame", xrsr_src_str(ws->audio_src));
+         ws->on_close     = true;
+         ws->close_status = (length >= 2) ? ((payload[0] << 8) | payload[1]) : 1005; // no status received
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_CLOSE);
+         break;
+      }
+      default: {
+         break;
+      }
+   }
+}
+
+void xrsr_ws_recv_msg(xrsr_state_ws_t *ws, xrsr_recv_msg_t msg_type, const uint8_t *payload, uint32_t size, bool compressed) {
+   xrsr_recv_event_t recv_event = XRSR_RECV_EVENT_NONE;
+
+   if(compressed) {
+      const uint8_t *inflated      = NULL;
+      uint32_t       inflated_size = 0;
+      if(!xrsr_ws_deflate_decompress(&ws->deflate, payload, size, &inflated, &inflated_size)) {
+         XLOGD_ERROR("src <%s> unable to inflate message <%u> bytes", xrsr_src_str(ws->audio_src), size);
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+         return;
+      }
+      if(msg_type == XRSR_RECV_MSG_TEXT) {
+         ws->stats.text_rxd_compressed_bytes += size;
+      }
+      payload = inflated;
+      size    = inflated_size;
+   }
+   if(msg_type == XRSR_RECV_MSG_TEXT) {
+      ws->stats.text_rxd_bytes += size;
+   }
+
    xrsr_ws_event(ws, SM_EVENT_MSG_RECV, false);
 
+   if(!ws->response_rxd) {
+      rdkx_timestamp_t timestamp;
+      rdkx_timestamp_get(&timestamp);
+      ws->stats.time_response = rdkx_timestamp_subtract_us(ws->connected_timestamp, timestamp) / 1000000.0;
+      ws->response_rxd        = true;
+   }
+
    // Call recv msg handler
    if(ws->handlers.recv_msg == NULL) {
       XLOGD_ERROR("src <%s> recv msg handler not available", xrsr_src_str(ws->audio_src));
@@ -618,7 +1102,6 @@ void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
          xrsr_ws_event(ws, SM_EVENT_APP_CLOSE, false);
       }
    }
-   nopoll_msg_unref(msg);
 
   if((unsigned int)recv_event < XRSR_RECV_EVENT_NONE) {
      ws->stream_end_reason  = (recv_event == XRSR_RECV_EVENT_EOS_SERVER ? XRSR_STREAM_END_REASON_AUDIO_EOF : XRSR_STREAM_END_REASON_DISCONNECT_REMOTE);
@@ -628,6 +1111,17 @@ void xrsr_ws_on_msg(xrsr_state_ws_t *ws, noPollConn *conn, noPollMsg *msg) {
   }
 }
 
+// nopoll answers pings and consumes pongs before nopoll_conn_get_msg returns, so pongs are only seen by the message handler
+void xrsr_ws_on_control_msg(noPollCtx *ctx, noPollConn *conn, noPollMsg *msg, noPollPtr user_data) {
+   xrsr_state_ws_t *ws = (xrsr_state_ws_t *)user_data;
+   if(ws == NULL || msg == NULL) {
+      return;
+   }
+   if(nopoll_msg_opcode(msg) == NOPOLL_PONG_FRAME) {
+      xrsr_ws_pong_rxd(ws);
+   }
+}
+
 void xrsr_ws_on_close(noPollCtx *ctx, noPollConn *conn, noPollPtr user_data) {
    xrsr_state_ws_t *ws = (xrsr_state_ws_t *)user_data;
    XLOGD_INFO("src <%s>", xrsr_src_str(ws->audio_src));
@@ -639,7 +1133,7 @@ void xrsr_ws_on_close(noPollCtx *ctx, noPollConn *conn, noPollPtr user_data) {
    }
    ws->close_status = nopoll_conn_get_close_status(conn);
 
-   xrsr_ws_event(ws, SM_EVENT_WS_CLOSE, false);
+   xrsr_ws_transport_error(ws, SM_EVENT_WS_CLOSE);
 }
 
 void xrsr_ws_speech_stream_end(xrsr_state_ws_t *ws, xrsr_stream_end_reason_t reason, bool detect_resume) {
@@ -656,7 +1150,16 @@ void xrsr_ws_speech_stream_end(xrsr_state_ws_t *ws, xrsr_stream_end_reason_t rea
 void xrsr_ws_speech_session_end(xrsr_state_ws_t *ws, xrsr_session_end_reason_t reason) {
    XLOGD_INFO("src <%s> fd <%d> reason <%s> close code <%d>", xrsr_src_str(ws->audio_src), ws->audio_pipe_fd_read, xrsr_session_end_reason_str(reason), ws->close_status);
 
-   ws->stats.reason = reason;
+   ws->stats.reason       = reason;
+   ws->stats.rtt_smoothed = ws->srtt_us   / 1000000.0;
+   ws->stats.rtt_variance = ws->rttvar_us / 1000000.0;
+
+   if(ws->stats.send_queue_max > 0) {
+      XLOGD_INFO("src <%s> send queue max <%u> bytes", xrsr_src_str(ws->audio_src), ws->stats.send_queue_max);
+   }
+   if(ws->deflate.active) {
+      XLOGD_INFO("src <%s> text txd <%u, %u> rxd <%u, %u> bytes", xrsr_src_str(ws->audio_src), ws->stats.text_txd_bytes, ws->stats.text_txd_compressed_bytes, ws->stats.text_rxd_bytes, ws->stats.text_rxd_compressed_bytes);
+   }
 
    char uuid_str[37] = {'\0'};
    uuid_unparse_lower(ws->uuid, uuid_str);
@@ -684,7 +1187,12 @@ void xrsr_ws_handle_speech_event(xrsr_state_ws_t *ws, xrsr_speech_event_t *event
 
    switch(event->event) {
       case XRSR_EVENT_EOS: {
+         ws->eos_rxd = true;
          xrsr_ws_event(ws, SM_EVENT_EOS, false);
+         // Send the audio which is already in the pipe without waiting for the next poll
+         if(ws->audio_pipe_fd_read >= 0 && xrsr_ws_is_established(ws) && ws->socket >= 0) {
+            xrsr_ws_audio_drain(ws);
+         }
          break;
       }
       case XRSR_EVENT_STREAM_KWD_INFO: {
@@ -770,6 +1278,438 @@ void xrsr_ws_clear_msg_out(xrsr_state_ws_t *ws) {
    sem_post(&ws->msg_out_semaphore);
 }
 
+void xrsr_ws_conn_close(xrsr_state_ws_t *ws) {
+   if(ws->obj_conn != NULL) {
+      // Remove on_close handler
+      nopoll_conn_set_on_close(ws->obj_conn, NULL, NULL);
+      nopoll_conn_set_on_msg(ws->obj_conn, NULL, NULL);
+
+      // only call close if network is available
+      XLOG_DEBUG("src <%s> nopoll ref count %d, should be 2...", xrsr_src_str(ws->audio_src), nopoll_conn_ref_count(ws->obj_conn));
+      if(ws->on_close == false) {
+         nopoll_conn_close(ws->obj_conn);
+      } else {
+         XLOG_DEBUG("src <%s> server closed the connection", xrsr_src_str(ws->audio_src));
+      }
+      ws->obj_conn = NULL;
+   }
+}
+
+// Resume the stream on a new connection when the transport fails mid-stream, otherwise raise the original event
+void xrsr_ws_transport_error(xrsr_state_ws_t *ws, tStEventID id) {
+   if(xrsr_ws_reconnect_allowed(ws, id)) {
+      xrsr_ws_event(ws, SM_EVENT_RECONNECT, false);
+   } else {
+      xrsr_ws_event(ws, id, false);
+   }
+}
+
+bool xrsr_ws_reconnect_allowed(xrsr_state_ws_t *ws, tStEventID id) {
+   if(!SmInThisState(&ws->state_machine, &St_Ws_Streaming_Info) || ws->is_session_by_text || ws->replay_buffer == NULL || ws->reconnect_buffer_size == 0) {
+      return(false);
+   }
+   if(id == SM_EVENT_WS_CLOSE && ws->close_status >= 1000 && ws->close_status != 1006) { // the server ended the session on purpose
+      return(false);
+   }
+   if(ws->stats.reconnect_qty >= XRSR_WS_RECONNECT_QTY_MAX) {
+      XLOGD_WARN("src <%s> reconnect limit <%u> reached", xrsr_src_str(ws->audio_src), XRSR_WS_RECONNECT_QTY_MAX);
+      return(false);
+   }
+   if(!xrsr_ws_replay_offset(ws, NULL)) {
+      XLOGD_WARN("src <%s> stream can not be replayed from a frame boundary", xrsr_src_str(ws->audio_src));
+      return(false);
+   }
+   ws->reconnect_reason = (id == SM_EVENT_WS_CLOSE) ? XRSR_SESSION_END_REASON_ERROR_DISCONNECT_REMOTE : XRSR_SESSION_END_REASON_ERROR_WS_SEND;
+   return(true);
+}
+
+// A connection attempt to resume the stream failed so report the failure which caused the reconnect
+void xrsr_ws_reconnect_failed(xrsr_state_ws_t *ws) {
+   if(ws->reconnecting) {
+      ws->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_REMOTE;
+      ws->session_end_reason = ws->reconnect_reason;
+   }
+}
+
+// The replay buffer holds both the audio retained for reconnects and the send queue, so it is allocated if either is enabled
+bool xrsr_ws_replay_init(xrsr_state_ws_t *ws) {
+   uint32_t size = (ws->reconnect_buffer_size > ws->send_queue_size) ? ws->reconnect_buffer_size : ws->send_queue_size;
+
+   ws->replay_rxd_bytes  = 0;
+   ws->replay_txd_offset = 0;
+   ws->replay_frame_size = 0;
+
+   if(ws->replay_buffer_size != size) {
+      if(ws->replay_buffer != NULL) {
+         free(ws->replay_buffer);
+         ws->replay_buffer = NULL;
+      }
+      ws->replay_buffer_size = 0;
+
+      if(size > 0) {
+         ws->replay_buffer = (uint8_t *)malloc(size);
+         if(ws->replay_buffer == NULL) {
+            XLOGD_ERROR("src <%s> unable to allocate replay buffer <%u>", xrsr_src_str(ws->audio_src), size);
+            return(false);
+         }
+         ws->replay_buffer_size = size;
+      }
+   }
+
+   // Frame boundaries are only known for PCM read directly from xraudio, so other streams can only be replayed from the beginning
+   ws->replay_frame_size = xrsr_speech_stream_frame_size(ws->audio_src, ws->dst_index);
+   return(size == 0 || ws->replay_buffer != NULL);
+}
+
+void xrsr_ws_replay_append(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t length) {
+   uint64_t rxd_bytes = ws->replay_rxd_bytes + length;
+
+   if(ws->replay_buffer != NULL) {
+      uint64_t offset = ws->replay_rxd_bytes;
+      if(length > ws->replay_buffer_size) { // only the most recent data is retained
+         buffer += length - ws->replay_buffer_size;
+         offset += length - ws->replay_buffer_size;
+         length  = ws->replay_buffer_size;
+      }
+      uint32_t index = offset % ws->replay_buffer_size;
+      uint32_t first = ws->replay_buffer_size - index;
+      if(first > length) {
+         first = length;
+      }
+      memcpy(&ws->replay_buffer[index], buffer, first);
+      memcpy(ws->replay_buffer, &buffer[first], length - first);
+   }
+   ws->replay_rxd_bytes = rxd_bytes;
+}
+
+// Returns the offset in the stream of the oldest retained audio which can be replayed
+bool xrsr_ws_replay_offset(xrsr_state_ws_t *ws, uint64_t *offset) {
+   uint64_t start = 0;
+
+   if(ws->replay_buffer == NULL) {
+      return(false);
+   }
+   if(ws->replay_rxd_bytes > ws->replay_buffer_size) { // beginning of the stream was overwritten
+      if(ws->replay_frame_size == 0) {
+         return(false);
+      }
+      start = ws->replay_rxd_bytes - ws->replay_buffer_size;
+      start = ((start + ws->replay_frame_size - 1) / ws->replay_frame_size) * ws->replay_frame_size;
+   }
+   if(offset != NULL) {
+      *offset = start;
+   }
+   return(true);
+}
+
+bool xrsr_ws_replay_pending(xrsr_state_ws_t *ws) {
+   return(ws->replay_buffer != NULL && ws->obj_conn != NULL && !ws->reconnecting && ws->replay_txd_offset < ws->replay_rxd_bytes);
+}
+
+void xrsr_ws_replay_send(xrsr_state_ws_t *ws) {
+   if(ws->write_pending_bytes || !xrsr_ws_replay_pending(ws)) {
+      return;
+   }
+   xrsr_socket_cork(ws->socket, &ws->stats.socket, true);
+   while(!ws->write_pending_bytes && xrsr_ws_replay_pending(ws)) {
+      uint32_t index  = ws->replay_txd_offset % ws->replay_buffer_size;
+      uint64_t length = ws->replay_rxd_bytes - ws->replay_txd_offset;
+
+      if(length > ws->replay_buffer_size - index) {
+         length = ws->replay_buffer_size - index;
+      }
+      if(length > sizeof(ws->buffer)) {
+         length = sizeof(ws->buffer);
+      }
+
+      // The retained audio is masked into the read buffer so that it can be replayed again
+      int ret = xrsr_ws_audio_send(ws, ws->buffer, &ws->replay_buffer[index], (uint32_t)length);
+      if(ret == -2 || (ret > 0 && ret != (int)length)) { // the rest of the frame is retained
+         XLOGD_INFO("src <%s> replay pending bytes <%d>", xrsr_src_str(ws->audio_src), xrsr_ws_pending_bytes(ws));
+         ws->write_pending_bytes = true;
+      } else if(ret <= 0) {
+         XLOGD_ERROR("src <%s> replay failed <%d>", xrsr_src_str(ws->audio_src), ret);
+         xrsr_socket_cork(ws->socket, &ws->stats.socket, false);
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+         return;
+      }
+      // Audio beyond what was already sent is from the send queue rather than a replay
+      uint64_t offset = ws->replay_txd_offset + length;
+      uint64_t fresh  = (offset > ws->audio_txd_bytes) ? offset - ws->audio_txd_bytes : 0;
+      if(fresh > length) {
+         fresh = length;
+      }
+      uint32_t resent = (uint32_t)(length - fresh);
+
+      ws->replay_txd_offset   = offset;
+      ws->stats.replay_bytes += resent;
+      xrsr_ws_audio_sent(ws, offset);
+
+      if(resent > 0 && ws->replay_txd_offset == ws->replay_rxd_bytes) {
+         XLOGD_INFO("src <%s> replay complete <%u> bytes", xrsr_src_str(ws->audio_src), ws->stats.replay_bytes);
+      }
+   }
+   xrsr_socket_cork(ws->socket, &ws->stats.socket, false);
+}
+
+// Returns the room left in the send queue.  The queue is the unsent audio at the end of the replay buffer, which is
+// allocated whenever the send queue is enabled, even if audio isn't retained for reconnects.
+uint32_t xrsr_ws_send_queue_space(xrsr_state_ws_t *ws) {
+   if(ws->replay_buffer == NULL) {
+      return(0);
+   }
+   uint64_t queued = ws->replay_rxd_bytes - ws->replay_txd_offset;
+   uint32_t size   = (ws->send_queue_size < ws->replay_buffer_size) ? ws->send_queue_size : ws->replay_buffer_size;
+   return((queued >= size) ? 0 : (uint32_t)(size - queued));
+}
+
+// The connection is stalled if the send queue has not been empty within the latency budget
+bool xrsr_ws_send_queue_stalled(xrsr_state_ws_t *ws) {
+   if(ws->send_queue_latency == 0 || !xrsr_ws_replay_pending(ws)) {
+      return(false);
+   }
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+   return(rdkx_timestamp_subtract_ms(ws->send_queue_timestamp, timestamp) > ws->send_queue_latency);
+}
+
+// Start a second connection to the alternate url if the connection is slow.  The user is already waiting on push to talk so don't delay.
+void xrsr_ws_hedge_arm(xrsr_state_ws_t *ws) {
+   if(ws->url_parts_hedge == NULL || ws->hedge_armed || ws->reconnecting) {
+      return;
+   }
+   ws->hedge_armed = true;
+
+   rdkx_timestamp_t timeout;
+   rdkx_timestamp_get(&timeout);
+   rdkx_timestamp_add_ms(&timeout, ws->user_initiated ? 0 : ws->hedge_delay);
+
+   ws->hedge_timer_id = rdkx_timer_insert(ws->timer_obj, timeout, xrsr_ws_hedge_timeout, ws);
+}
+
+void xrsr_ws_hedge_timeout(void *data) {
+   xrsr_state_ws_t *ws = (xrsr_state_ws_t *)data;
+
+   if(!SmInThisState(&ws->state_machine, &St_Ws_Connecting_Info) &&
+      !SmInThisState(&ws->state_machine, &St_Ws_Connected_Info) &&
+      !SmInThisState(&ws->state_machine, &St_Ws_Connection_Retry_Info)) {
+      xrsr_ws_hedge_cancel(ws);
+      return;
+   }
+
+   if(ws->obj_conn_hedge == NULL) {
+      XLOGD_INFO("src <%s> hedge url <%s>", xrsr_src_str(ws->audio_src), xrsr_mask_pii() ? "***" : ws->url_hedge);
+      ws->stats.hedged    = true;
+      ws->hedge_wait_time = ws->timeout_connect;
+      memset(&ws->handshake_hedge, 0, sizeof(ws->handshake_hedge));
+      ws->obj_conn_hedge  = xrsr_ws_conn_open(ws, ws->url_parts_hedge, ws->url_hedge);
+      if(ws->obj_conn_hedge == NULL) {
+         XLOGD_ERROR("src <%s> hedge conn new", xrsr_src_str(ws->audio_src));
+         xrsr_ws_hedge_cancel(ws);
+         return;
+      }
+   } else if(nopoll_conn_is_ok(ws->obj_conn_hedge) && xrsr_ws_handshake_peek(ws, ws->obj_conn_hedge, &ws->handshake_hedge) && nopoll_conn_is_ready(ws->obj_conn_hedge)) {
+      xrsr_ws_hedge_won(ws);
+      return;
+   } else if(ws->hedge_wait_time <= 0) {
+      XLOGD_WARN("src <%s> hedge connection timeout", xrsr_src_str(ws->audio_src));
+      xrsr_ws_hedge_cancel(ws);
+      return;
+   } else {
+      ws->hedge_wait_time -= ws->connect_check_interval;
+   }
+
+   rdkx_timestamp_t timeout;
+   rdkx_timestamp_get(&timeout);
+   rdkx_timestamp_add_ms(&timeout, ws->connect_check_interval);
+
+   if(!rdkx_timer_update(ws->timer_obj, ws->hedge_timer_id, timeout)) {
+      XLOGD_ERROR("src <%s> timer update", xrsr_src_str(ws->audio_src));
+   }
+}
+
+// The hedged connection completed the handshake first so it replaces the primary connection attempt
+void xrsr_ws_hedge_won(xrsr_state_ws_t *ws) {
+   XLOGD_INFO("src <%s> hedge connection won", xrsr_src_str(ws->audio_src));
+
+   noPollConn *obj_conn = ws->obj_conn_hedge;
+   ws->obj_conn_hedge   = NULL;
+   xrsr_ws_hedge_cancel(ws);
+
+   xrsr_ws_conn_close(ws);
+   ws->obj_conn        = obj_conn;
+   ws->handshake       = ws->handshake_hedge;
+   ws->url_parts       = ws->url_parts_hedge; // later reconnects use the winning url
+   ws->stats.hedge_won = true;
+   strlcpy(ws->url, ws->url_hedge, sizeof(ws->url));
+   nopoll_conn_set_on_close(ws->obj_conn, xrsr_ws_on_close, ws);
+   nopoll_conn_set_on_msg(ws->obj_conn, xrsr_ws_on_control_msg, ws);
+
+   if(!SmInThisState(&ws->state_machine, &St_Ws_Connected_Info)) {
+      xrsr_ws_event(ws, SM_EVENT_CONNECTED, false);
+   }
+   if(xrsr_ws_conn_is_ready(ws)) {
+      xrsr_ws_event(ws, SM_EVENT_ESTABLISHED, false);
+   }
+}
+
+void xrsr_ws_hedge_cancel(xrsr_state_ws_t *ws) {
+   if(ws->timer_obj != NULL && ws->hedge_timer_id >= 0) {
+      if(!rdkx_timer_remove(ws->timer_obj, ws->hedge_timer_id)) {
+         XLOGD_ERROR("src <%s> timer remove", xrsr_src_str(ws->audio_src));
+      }
+      ws->hedge_timer_id = RDXK_TIMER_ID_INVALID;
+   }
+   if(ws->obj_conn_hedge != NULL) {
+      XLOGD_INFO("src <%s> hedge connection cancelled", xrsr_src_str(ws->audio_src));
+      nopoll_conn_close(ws->obj_conn_hedge);
+      ws->obj_conn_hedge = NULL;
+   }
+}
+
+// Ping the server periodically while connected to keep the connection alive through NATs and proxies, detect a half-open
+// connection well before the inactivity timeout and measure the round trip time.
+void xrsr_ws_ping_start(xrsr_state_ws_t *ws) {
+   if(ws->ping_interval == 0 || ws->ping_timer_id >= 0) {
+      return;
+   }
+   ws->ping_outstanding = false;
+   ws->pong_missed      = 0;
+
+   rdkx_timestamp_t timeout;
+   rdkx_timestamp_get(&timeout);
+   rdkx_timestamp_add_ms(&timeout, ws->ping_interval);
+
+   ws->ping_timer_id = rdkx_timer_insert(ws->timer_obj, timeout, xrsr_ws_ping_timeout, ws);
+}
+
+void xrsr_ws_ping_timeout(void *data) {
+   xrsr_state_ws_t *ws = (xrsr_state_ws_t *)data;
+
+   if(!xrsr_ws_is_established(ws) || ws->obj_conn == NULL) {
+      xrsr_ws_ping_cancel(ws);
+      return;
+   }
+
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+
+   uint32_t interval = ws->ping_interval;
+
+   if(ws->ping_outstanding) {
+      uint32_t deadline = xrsr_ws_pong_timeout(ws);
+      uint64_t elapsed  = rdkx_timestamp_subtract_us(ws->ping_timestamp, timestamp) / 1000;
+
+      if(elapsed < deadline) { // check again when the pong is overdue
+         interval = deadline - elapsed;
+      } else {
+         ws->ping_outstanding = false;
+         ws->pong_missed++;
+         XLOGD_WARN("src <%s> pong not received in <%u> ms - missed <%u>", xrsr_src_str(ws->audio_src), deadline, ws->pong_missed);
+
+         if(ws->pong_missed >= XRSR_WS_PONG_MISSED_MAX) {
+            XLOGD_ERROR("src <%s> connection is not responding", xrsr_src_str(ws->audio_src));
+            xrsr_ws_ping_cancel(ws);
+            xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+            return;
+         }
+      }
+   }
+
+   if(!ws->ping_outstanding && xrsr_ws_frame_pending_bytes(&ws->frame) == 0) { // a ping can't be sent inside a partially written frame
+      if(!nopoll_conn_send_ping(ws->obj_conn)) {
+         XLOGD_ERROR("src <%s> ping failed", xrsr_src_str(ws->audio_src));
+         xrsr_ws_ping_cancel(ws);
+         xrsr_ws_transport_error(ws, SM_EVENT_WS_ERROR);
+         return;
+      }
+      ws->ping_timestamp   = timestamp;
+      ws->ping_outstanding = true;
+   }
+
+   rdkx_timestamp_add_ms(&timestamp, interval);
+
+   if(!rdkx_timer_update(ws->timer_obj, ws->ping_timer_id, timestamp)) {
+      XLOGD_ERROR("src <%s> timer update", xrsr_src_str(ws->audio_src));
+   }
+}
+
+void xrsr_ws_ping_cancel(xrsr_state_ws_t *ws) {
+   if(ws->timer_obj != NULL && ws->ping_timer_id >= 0) {
+      if(!rdkx_timer_remove(ws->timer_obj, ws->ping_timer_id)) {
+         XLOGD_ERROR("src <%s> timer remove", xrsr_src_str(ws->audio_src));
+      }
+      ws->ping_timer_id = RDXK_TIMER_ID_INVALID;
+   }
+   ws->ping_outstanding = false;
+   ws->pong_missed      = 0;
+}
+
+void xrsr_ws_pong_rxd(xrsr_state_ws_t *ws) {
+   if(!ws->ping_outstanding) { // unsolicited pong
+      XLOGD_DEBUG("src <%s> pong without ping", xrsr_src_str(ws->audio_src));
+      return;
+   }
+   ws->ping_outstanding = false;
+   ws->pong_missed      = 0;
+
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+   xrsr_ws_rtt_update(ws, rdkx_timestamp_subtract_us(ws->ping_timestamp, timestamp));
+}
+
+// Same bound as the TCP retransmission timeout (RFC 6298) so that a slow network is not mistaken for a dead connection
+uint32_t xrsr_ws_pong_timeout(xrsr_state_ws_t *ws) {
+   uint32_t timeout = (ws->srtt_us + (4 * ws->rttvar_us)) / 1000;
+   return((timeout > XRSR_WS_PONG_TIMEOUT_MIN) ? timeout : XRSR_WS_PONG_TIMEOUT_MIN);
+}
+
+void xrsr_ws_rtt_update(xrsr_state_ws_t *ws, uint64_t rtt_us) {
+   if(rtt_us == 0) {
+      rtt_us = 1;
+   } else if(rtt_us > UINT32_MAX / 8) {
+      rtt_us = UINT32_MAX / 8;
+   }
+   if(ws->srtt_us == 0) { // first measurement
+      ws->srtt_us   = rtt_us;
+      ws->rttvar_us = rtt_us / 2;
+   } else {
+      uint32_t delta = (ws->srtt_us > rtt_us) ? (ws->srtt_us - rtt_us) : (rtt_us - ws->srtt_us);
+      ws->rttvar_us  = ((3 * (uint64_t)ws->rttvar_us) + delta) / 4;
+      ws->srtt_us    = ((7 * (uint64_t)ws->srtt_us) + rtt_us) / 8;
+   }
+   XLOGD_DEBUG("src <%s> rtt <%llu> srtt <%u> rttvar <%u> us", xrsr_src_str(ws->audio_src), (unsigned long long)rtt_us, ws->srtt_us, ws->rttvar_us);
+}
+
+// Report the network conditions periodically while streaming so that the frame grouping can follow them
+void xrsr_ws_metrics_report(xrsr_state_ws_t *ws) {
+   rdkx_timestamp_t timestamp;
+   rdkx_timestamp_get(&timestamp);
+   if(rdkx_timestamp_cmp(timestamp, ws->metrics_timestamp) < 0) {
+      return;
+   }
+
+   int backlog = 0;
+   if(ioctl(ws->audio_pipe_fd_read, FIONREAD, &backlog) < 0) {
+      backlog = 0;
+   }
+
+   xrsr_grouping_metrics_t metrics;
+   metrics.srtt_us         = ws->srtt_us;
+   metrics.would_block_qty = ws->would_block_qty;
+   metrics.backlog_bytes   = xrsr_speech_stream_backlog(ws->audio_src, ws->dst_index, ws->audio_pipe_fd_read, (uint32_t)backlog) + (uint32_t)(ws->replay_rxd_bytes - ws->replay_txd_offset); // includes the send queue
+   metrics.txd_bytes       = ws->audio_txd_bytes - ws->metrics_txd_bytes;
+   metrics.interval_ms     = rdkx_timestamp_subtract_ms(ws->metrics_timestamp_last, timestamp);
+
+   xrsr_speech_stream_metrics(ws->audio_src, ws->dst_index, &metrics);
+
+   ws->would_block_qty        = 0;
+   ws->metrics_txd_bytes      = ws->audio_txd_bytes;
+   ws->metrics_timestamp_last = timestamp;
+   ws->metrics_timestamp      = timestamp;
+   rdkx_timestamp_add_ms(&ws->metrics_timestamp, XRSR_WS_METRICS_INTERVAL);
+}
+
 void xrsr_ws_reset(xrsr_state_ws_t *ws) {
    if(ws) {
       ws->socket                = -1;
@@ -777,10 +1717,17 @@ void xrsr_ws_reset(xrsr_state_ws_t *ws) {
       ws->audio_src             = XRSR_SRC_INVALID;
       ws->write_pending_bytes   = false;
       ws->write_pending_retries = 0;
+      xrsr_ws_frame_reset(&ws->frame);
       ws->detect_resume         = true;
       ws->on_close              = false;
       ws->retry_cnt             = 1;
       ws->is_session_by_text    = false;
+      ws->reconnecting          = false;
+      ws->hedge_armed           = false;
+      ws->hedge_timer_id        = RDXK_TIMER_ID_INVALID;
+      ws->ping_timer_id         = RDXK_TIMER_ID_INVALID;
+      ws->ping_outstanding      = false;
+      ws->pong_missed           = 0;
       if(ws->audio_pipe_fd_read > -1) {
          close(ws->audio_pipe_fd_read);
          ws->audio_pipe_fd_read = -1;
@@ -825,6 +1772,8 @@ void St_Ws_Disconnected(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardR
       case ACT_ENTER: {
          rdkx_timestamp_t timestamp;
          rdkx_timestamp_get_realtime(&timestamp);
+         xrsr_ws_hedge_cancel(ws);
+         xrsr_ws_ping_cancel(ws);
          if(ws->handlers.disconnected == NULL) {
             XLOGD_INFO("src <%s> disconnected handler not available", xrsr_src_str(ws->audio_src));
          } else {
@@ -850,19 +1799,8 @@ void St_Ws_Disconnecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuard
          break;
       }
       case ACT_ENTER: {
-         if(ws->obj_conn != NULL) {
-            // Remove on_close handler
-            nopoll_conn_set_on_close(ws->obj_conn, NULL, NULL);
-
-            // only call close if network is available
-            XLOG_DEBUG("src <%s> nopoll ref count %d, should be 2...", xrsr_src_str(ws->audio_src), nopoll_conn_ref_count(ws->obj_conn));
-            if(ws->on_close == false) {
-               nopoll_conn_close(ws->obj_conn);
-            } else {
-               XLOG_DEBUG("src <%s> server closed the connection", xrsr_src_str(ws->audio_src));
-            }
-            ws->obj_conn = NULL;
-         }
+         xrsr_ws_ping_cancel(ws);
+         xrsr_ws_conn_close(ws);
          xrsr_ws_event(ws, SM_EVENT_DISCONNECTED, true);
          break;
       }
@@ -917,6 +1855,16 @@ void St_Ws_Connecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardRes
          break;
       }
       case ACT_ENTER: {
+         if(pEvent->mID == SM_EVENT_SESSION_BEGIN || pEvent->mID == SM_EVENT_STM) { // first connection attempt
+            rdkx_timestamp_get(&ws->connect_timestamp);
+            ws->response_rxd = false;
+         }
+         if(ws->fast_fail) { // destination's circuit is open so fail without waiting for the connect timeout
+            ws->fast_fail = false;
+            xrsr_ws_event(ws, SM_EVENT_CONNECT_TIMEOUT, true);
+            break;
+         }
+         xrsr_ws_hedge_arm(ws);
          if(!xrsr_ws_connect_new(ws)) {
             rdkx_timestamp_t timestamp;
             rdkx_timestamp_get(&timestamp);
@@ -937,7 +1885,15 @@ void St_Ws_Connecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardRes
       case ACT_INTERNAL: {
          switch(pEvent->mID) {
             case SM_EVENT_TIMEOUT: {
-               if(!nopoll_conn_is_ok(ws->obj_conn)) {
+               if(ws->obj_conn == NULL && xrsr_eyeballs_active(&ws->eyeballs) && !xrsr_ws_race_poll(ws)) { // every address failed
+                  rdkx_timestamp_t timestamp;
+                  rdkx_timestamp_get(&timestamp);
+                  if(rdkx_timestamp_cmp(timestamp, ws->retry_timestamp_end) >= 0) {
+                     xrsr_ws_event(ws, SM_EVENT_CONNECT_TIMEOUT, true);
+                  } else {
+                     xrsr_ws_event(ws, SM_EVENT_RETRY, true);
+                  }
+               } else if(!nopoll_conn_is_ok(ws->obj_conn)) {
                   if(ws->connect_wait_time <= 0) { // overall timeout reached
                      rdkx_timestamp_t timestamp;
                      rdkx_timestamp_get(&timestamp);
@@ -979,6 +1935,7 @@ void St_Ws_Connecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardRes
                // After attempting to connect until connect timeout, we failed. Consider this a failure.
                ws->stream_end_reason  = XRSR_STREAM_END_REASON_DID_NOT_BEGIN;
                ws->session_end_reason = XRSR_SESSION_END_REASON_ERROR_CONNECT_FAILURE;
+               xrsr_ws_reconnect_failed(ws);
                xrsr_ws_speech_stream_end(ws, ws->stream_end_reason, ws->detect_resume);
                break;
             }
@@ -992,6 +1949,7 @@ void St_Ws_Connecting(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardRes
                break;
             }
          }
+         xrsr_eyeballs_cancel(&ws->eyeballs); // close the attempts which lost or are still in progress
          if(ws->timer_obj != NULL && ws->timer_id >= 0) {
             if(!rdkx_timer_remove(ws->timer_obj, ws->timer_id)) {
                XLOGD_ERROR("src <%s> timer remove", xrsr_src_str(ws->audio_src));
@@ -1060,12 +2018,14 @@ void St_Ws_Connected(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResp
             case SM_EVENT_WS_CLOSE: {
                ws->stream_end_reason  = XRSR_STREAM_END_REASON_DISCONNECT_REMOTE;
                ws->session_end_reason = XRSR_SESSION_END_REASON_ERROR_CONNECT_FAILURE;
+               xrsr_ws_reconnect_failed(ws);
                xrsr_ws_speech_stream_end(ws, ws->stream_end_reason, ws->detect_resume);
                break;
             }
             case SM_EVENT_ESTABLISH_TIMEOUT: {
                ws->stream_end_reason  = XRSR_STREAM_END_REASON_DID_NOT_BEGIN;
                ws->session_end_reason = XRSR_SESSION_END_REASON_ERROR_CONNECT_TIMEOUT;
+               xrsr_ws_reconnect_failed(ws);
                xrsr_ws_speech_stream_end(ws, ws->stream_end_reason, ws->detect_resume);
                break;
             }
@@ -1144,6 +2104,10 @@ void St_Ws_Established(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardRe
                ws->session_end_reason = XRSR_SESSION_END_REASON_ERROR_SESSION_TIMEOUT;
                break;
             }
+            case SM_EVENT_WS_ERROR: {
+               ws->session_end_reason = XRSR_SESSION_END_REASON_ERROR_WS_SEND;
+               break;
+            }
             case SM_EVENT_WS_CLOSE: {
                ws->session_end_reason = XRSR_SESSION_END_REASON_EOS;
                break;
@@ -1177,7 +2141,8 @@ void St_Ws_Streaming(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResp
       }
       case ACT_ENTER: {
          bool success = false;
-         // Call connected handler
+         bool resumed = ws->reconnecting;
+         // Call connected handler (again after a reconnect so the session is initialized on the new connection)
          if(ws->handlers.connected == NULL) {
             XLOGD_INFO("src <%s> connected handler not available", xrsr_src_str(ws->audio_src));
          } else {
@@ -1186,9 +2151,24 @@ void St_Ws_Streaming(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResp
             success = (*ws->handlers.connected)(ws->handlers.data, ws->uuid, xrsr_conn_send, (void *)ws, &timestamp);
          }
 
-         char uuid_str[37] = {'\0'};
-         uuid_unparse_lower(ws->uuid, uuid_str);
-         xrsr_session_stream_begin(ws->uuid, uuid_str, ws->audio_src, ws->dst_index);
+         if(resumed) {
+            uint64_t offset = 0;
+            xrsr_ws_replay_offset(ws, &offset);
+            ws->reconnecting      = false;
+            ws->replay_txd_offset = offset;
+            rdkx_timestamp_get(&ws->send_queue_timestamp);
+            XLOGD_INFO("src <%s> stream resumed - replay <%llu> bytes from offset <%llu>", xrsr_src_str(ws->audio_src), (unsigned long long)(ws->replay_rxd_bytes - offset), (unsigned long long)offset);
+         } else {
+            xrsr_ws_hedge_cancel(ws); // the race is over
+
+            rdkx_timestamp_get(&ws->connected_timestamp);
+            ws->stats.time_connect = rdkx_timestamp_subtract_us(ws->connect_timestamp, ws->connected_timestamp) / 1000000.0;
+
+            char uuid_str[37] = {'\0'};
+            uuid_unparse_lower(ws->uuid, uuid_str);
+            xrsr_session_stream_begin(ws->uuid, uuid_str, ws->audio_src, ws->dst_index);
+         }
+         xrsr_ws_ping_start(ws);
 
          if (success && ws->is_session_by_text) {
             xrsr_ws_event(ws, SM_EVENT_TEXT_SESSION_SUCCESS, true);
@@ -1231,11 +2211,34 @@ void St_Ws_Streaming(tStateEvent *pEvent, eStateAction eAction, BOOL *bGuardResp
                XLOGD_INFO("src <%s> SM_EVENT_TEXT_SESSION_SUCCESS - text-only session init message sent successfully.", xrsr_src_str(ws->audio_src));
                break;
             }
+            case SM_EVENT_RECONNECT: {
+               XLOGD_WARN("src <%s> connection lost mid-stream - reconnect <%u>", xrsr_src_str(ws->audio_src), ws->stats.reconnect_qty + 1);
+               // Drop the failed connection but keep the audio stream open.  Audio is held in the pipe until the stream resumes.
+               xrsr_ws_ping_cancel(ws);
+               xrsr_ws_conn_close(ws);
+               if(ws->pending_msg != NULL) {
+                  nopoll_msg_unref(ws->pending_msg);
+                  ws->pending_msg = NULL;
+               }
+               xrsr_ws_clear_msg_out(ws);
+               ws->socket                = -1;
+               ws->write_pending_bytes   = false;
+               ws->write_pending_retries = 0;
+               xrsr_ws_frame_reset(&ws->frame);
+               ws->on_close              = false;
+               ws->close_status          = -1;
+               ws->connect_wait_time     = ws->timeout_connect;
+               ws->retry_cnt             = 0;
+               ws->reconnecting          = true;
+               ws->stats.reconnect_qty++;
+               // retry_timestamp_end is left at the session deadline so reconnects can't extend the session
+               break;
+            }
             default: {
                break;
             }
          }
-         if (pEvent->mID != SM_EVENT_TEXT_SESSION_SUCCESS) {
+         if (pEvent->mID != SM_EVENT_TEXT_SESSION_SUCCESS && pEvent->mID != SM_EVENT_RECONNECT) {
             xrsr_ws_speech_stream_end(ws, ws->stream_end_reason, ws->detect_resume);
          }
          break;
@@ -1316,7 +2319,11 @@ void St_Ws_Connection_Retry(tStateEvent *pEvent, eStateAction eAction, BOOL *bGu
          ws->retry_cnt++;
          // Calculate retry delay
          uint32_t slots = 1 << ws->retry_cnt;
-         uint32_t retry_delay_ms = ws->backoff_delay * (rand() % slots);
+         uint32_t slot_ms = ws->backoff_delay;
+         if(ws->srtt_us / 1000 > slot_ms) { // don't retry faster than the network to the destination can respond
+            slot_ms = ws->srtt_us / 1000;
+         }
+         uint32_t retry_delay_ms = slot_ms * (rand() % slots);
 
          XLOGD_INFO("src <%s> retry connection - delay <%u> ms", xrsr_src_str(ws->audio_src), retry_delay_ms);
 
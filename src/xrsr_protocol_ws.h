@@ -22,20 +22,83 @@
 #define __XRSR_PROTOCOL_WS_H__
 
 #include <nopoll.h>
+#include <zlib.h>
 #include "xrpSMEngine.h"
 #include <semaphore.h>
 
-#define XRSR_WS_HOST_NAME_LEN_MAX       (64)
-#define XRSR_WS_URL_SIZE_MAX            (2048)
-#define XRSR_WS_SM_EVENTS_MAX           (5)
-#define XRSR_WS_MSG_OUT_MAX             (5)
-#define XRSR_WS_WRITE_PENDING_RETRY_MAX (5)
+#define XRSR_WS_HOST_NAME_LEN_MAX         (64)
+#define XRSR_WS_URL_SIZE_MAX              (2048)
+#define XRSR_WS_SM_EVENTS_MAX             (5)
+#define XRSR_WS_MSG_OUT_MAX               (5)
+#define XRSR_WS_WRITE_PENDING_RETRY_MAX   (5)
+#define XRSR_WS_RECONNECT_QTY_MAX         (3)
+#define XRSR_WS_RECONNECT_BUFFER_SIZE_MAX (1048576)
+#define XRSR_WS_PONG_TIMEOUT_MIN          (2000)   // minimum time to wait for a pong (in ms)
+#define XRSR_WS_PONG_MISSED_MAX           (2)      // consecutive missed pongs after which the connection is considered dead
+#define XRSR_WS_METRICS_INTERVAL          (500)    // period for reporting network conditions during the stream (in ms)
+#define XRSR_WS_FRAME_HEADER_SIZE_MAX     (14)     // base header, 64-bit extended length and masking key
+#define XRSR_WS_FRAME_OPCODE_TEXT         (0x1)
+#define XRSR_WS_FRAME_OPCODE_BINARY       (0x2)
+#define XRSR_WS_FRAME_OPCODE_CLOSE        (0x8)
+#define XRSR_WS_FRAME_OPCODE_PING         (0x9)
+#define XRSR_WS_FRAME_OPCODE_PONG         (0xA)
+#define XRSR_WS_FRAME_MASK_KEY_BATCH      (64)     // masking keys read from the random source at a time
+#define XRSR_WS_FRAME_RSV1                (0x40)   // set on messages compressed with permessage-deflate
+#define XRSR_WS_FRAME_CONTROL_SIZE_MAX    (125)    // largest control frame payload
+#define XRSR_WS_FRAME_RECV_SIZE_MAX       (1048576) // largest incoming message read natively (in bytes)
+#define XRSR_WS_HANDSHAKE_SIZE_MAX        (4096)   // largest handshake response which is checked for the negotiated extensions
+
+typedef struct {
+   xrsr_convert_kernel_t        kernel;             // payload masking kernel
+   uint8_t                      mask_keys[4 * XRSR_WS_FRAME_MASK_KEY_BATCH]; // random masking keys not yet used
+   uint32_t                     mask_index;
+   uint32_t                     payload_max;
+   uint8_t *                    pending;            // rest of a frame that the socket did not accept
+   uint32_t                     pending_len;
+   uint32_t                     pending_offset;
+} xrsr_ws_frame_t;
+
+typedef struct {
+   uint8_t                      header[XRSR_WS_FRAME_HEADER_SIZE_MAX];
+   uint32_t                     header_len;         // bytes of the current frame's header received
+   bool                         header_done;        // the header has been parsed and the payload is being read
+   uint8_t                      opcode;             // opcode of the current frame
+   bool                         final;
+   uint64_t                     payload_len;
+   uint64_t                     payload_rxd;
+   uint8_t                      control[XRSR_WS_FRAME_CONTROL_SIZE_MAX]; // control frames may arrive between the fragments of a message
+   bool                         msg_active;         // a fragmented message is being received
+   uint8_t                      msg_opcode;
+   bool                         msg_compressed;     // RSV1 was set on the message's first frame
+   uint8_t *                    msg;
+   uint32_t                     msg_len;
+   uint32_t                     msg_size;
+} xrsr_ws_frame_rx_t;
+
+typedef struct {
+   bool                         rxd;                // the handshake response has been checked
+   bool                         deflate;            // the server accepted permessage-deflate
+   bool                         context_takeover;   // the server allows the client to keep its compression context
+} xrsr_ws_handshake_t;
+
+typedef struct {
+   bool                         context_takeover;   // keep the compression context between outgoing messages
+   bool                         active;             // the server accepted permessage-deflate in the handshake
+   bool                         txd_disabled;       // an outgoing message could not be compressed, so the rest are sent uncompressed
+   bool                         deflate_init;
+   bool                         inflate_init;
+   z_stream                     deflate;
+   z_stream                     inflate;
+   uint8_t *                    buffer;
+   uint32_t                     buffer_size;
+} xrsr_ws_deflate_t;
 
 typedef struct {
    xrsr_protocol_t        prot;
    const char *           host_name;
    rdkx_timer_object_t    timer_obj;
    xrsr_dst_param_ptrs_t *dst_params;
+   xrsr_url_parts_t *     url_parts_hedge;
 } xrsr_ws_params_t;
 
 typedef struct {
@@ -49,6 +112,10 @@ typedef struct {
    rdkx_timer_id_t              timer_id;
    uint32_t                     retry_cnt;
    rdkx_timestamp_t             retry_timestamp_end;
+   rdkx_timestamp_t             connect_timestamp;
+   rdkx_timestamp_t             connected_timestamp;
+   bool                         response_rxd;
+   bool                         fast_fail;
    int32_t                      connect_wait_time;
    bool                         stream_time_min_rxd;
    xrsr_url_parts_t *           url_parts;
@@ -76,6 +143,8 @@ typedef struct {
    bool                         audio_kwd_notified;
    uint32_t                     audio_kwd_bytes;
    uint32_t                     audio_txd_bytes;
+   bool                         eos_rxd;            // end of speech was detected, so the pipe is drained whenever it is readable
+   bool                         eof_pending;        // the pipe reached EOF while audio was in the send queue
 
    uint32_t                     connect_check_interval;
    uint32_t                     timeout_connect;
@@ -83,14 +152,65 @@ typedef struct {
    uint32_t                     timeout_session;
    bool                         ipv4_fallback;
    uint32_t                     backoff_delay;
+   uint32_t                     reconnect_buffer_size;
+   uint32_t                     hedge_delay;
+   xrsr_socket_profile_t        socket_profile;     // tcp options applied to the socket once connected
+   uint32_t                     ping_interval;
 
    bool                         is_session_by_text;
 
+   /* Mid-stream reconnect */
+   bool                         reconnecting;
+   xrsr_session_end_reason_t    reconnect_reason;
+   uint8_t *                    replay_buffer;      // audio sent in the current stream, retained for replay on a new connection and holding the send queue
+   uint32_t                     replay_buffer_size; // larger of the reconnect buffer and send queue sizes
+   uint32_t                     replay_frame_size;  // replay can start mid-stream on a frame boundary (0 if the format has no fixed frame size)
+   uint64_t                     replay_rxd_bytes;   // stream offset of the next byte read from the audio pipe
+   uint64_t                     replay_txd_offset;  // stream offset of the next byte to replay
+
+   /* Send queue */
+   uint32_t                     send_queue_size;      // unsent audio read from the pipe while the socket is not writable (in bytes, held in the replay buffer)
+   uint32_t                     send_queue_latency;   // longest time the send queue may stay non-empty before the connection is considered stalled (in milliseconds, 0 for no limit)
+   rdkx_timestamp_t             send_queue_timestamp; // time that the send queue was last empty
+
+   /* Hedged connection */
+   xrsr_url_parts_t *           url_parts_hedge;    // alternate url raced against url_parts (NULL if not configured)
+   char                         url_hedge[XRSR_WS_URL_SIZE_MAX];
+   bool                         hedge_armed;
+   rdkx_timer_id_t              hedge_timer_id;
+   int32_t                      hedge_wait_time;
+   noPollConn *                 obj_conn_hedge;
+
+   /* Dual stack connection racing */
+   xrsr_eyeballs_t              eyeballs;           // in progress until a TCP connection to url_parts is established
+
+   /* Keepalive and round trip time */
+   rdkx_timer_id_t              ping_timer_id;
+   rdkx_timestamp_t             ping_timestamp;
+   bool                         ping_outstanding;
+   uint32_t                     pong_missed;
+   uint32_t                     srtt_us;            // smoothed round trip time, retained across connections to the destination (0 until measured)
+   uint32_t                     rttvar_us;          // round trip time variation
+
+   /* Network conditions reported for frame grouping */
+   rdkx_timestamp_t             metrics_timestamp;  // time of the next report
+   rdkx_timestamp_t             metrics_timestamp_last;
+   uint32_t                     metrics_txd_bytes;  // audio sent as of the last report
+   uint32_t                     would_block_qty;
+
    /* WS Library Specific attributes */
    noPollCtx *                  obj_ctx;
    noPollConn *                 obj_conn;
    NOPOLL_SOCKET                socket;
    noPollMsg *                  pending_msg;
+   xrsr_ws_frame_t              frame;              // binary audio frames are written directly to the socket
+   xrsr_ws_frame_rx_t           frame_rx;           // frames are read directly from the socket while permessage-deflate is in use
+   xrsr_ws_handshake_t          handshake;
+   xrsr_ws_handshake_t          handshake_hedge;
+   bool                         deflate_enabled;    // offer permessage-deflate for text messages
+   bool                         deflate_context_takeover;
+   xrsr_ws_deflate_t            deflate;
+   bool                         frame_native;       // true if the connection is not encrypted so the framer can be used
 
    /* State Machine */
    tSmInstance                  state_machine;
@@ -116,10 +236,34 @@ int  xrsr_ws_send_text(xrsr_state_ws_t *ws, const uint8_t *buffer, uint32_t leng
 int  xrsr_ws_read_pending(xrsr_state_ws_t *ws);
 void xrsr_ws_speech_session_end(xrsr_state_ws_t *ws, xrsr_session_end_reason_t reason);
 void xrsr_ws_handle_speech_event(xrsr_state_ws_t *ws, xrsr_speech_event_t *event);
+bool xrsr_ws_queue_msg_out(xrsr_state_ws_t *ws, const char *msg, uint32_t length);
+bool xrsr_ws_get_msg_out(xrsr_state_ws_t *ws, char **msg, uint32_t *length);
 
 // State check functions
 bool xrsr_ws_is_established(xrsr_state_ws_t *ws);
 bool xrsr_ws_is_disconnected(xrsr_state_ws_t *ws);
 
 const char *xrsr_ws_opcode_str(noPollOpCode type);
+
+// Native framing
+bool     xrsr_ws_frame_init(xrsr_ws_frame_t *frame, uint32_t payload_max);
+void     xrsr_ws_frame_term(xrsr_ws_frame_t *frame);
+void     xrsr_ws_frame_reset(xrsr_ws_frame_t *frame);
+uint32_t xrsr_ws_frame_header(uint8_t *header, uint8_t opcode, uint64_t length, const uint8_t *mask);
+void     xrsr_ws_frame_mask(xrsr_convert_kernel_t kernel, uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+int      xrsr_ws_frame_send(xrsr_ws_frame_t *frame, int fd, uint8_t opcode, uint8_t *dst, const uint8_t *src, uint32_t length);
+int      xrsr_ws_frame_send_binary(xrsr_ws_frame_t *frame, int fd, uint8_t *dst, const uint8_t *src, uint32_t length);
+uint32_t xrsr_ws_frame_pending_bytes(const xrsr_ws_frame_t *frame);
+int      xrsr_ws_frame_pending_send(xrsr_ws_frame_t *frame, int fd);
+void     xrsr_ws_frame_rx_reset(xrsr_ws_frame_rx_t *rx);
+void     xrsr_ws_frame_rx_term(xrsr_ws_frame_rx_t *rx);
+int      xrsr_ws_frame_recv(xrsr_ws_frame_rx_t *rx, int fd, uint8_t *opcode, const uint8_t **payload, uint32_t *length, bool *compressed);
+
+// permessage-deflate
+void     xrsr_ws_deflate_init(xrsr_ws_deflate_t *pmd, bool context_takeover);
+void     xrsr_ws_deflate_term(xrsr_ws_deflate_t *pmd);
+void     xrsr_ws_deflate_offer(bool context_takeover, char *str, size_t size);
+bool     xrsr_ws_deflate_accepted(const char *response, bool *context_takeover);
+bool     xrsr_ws_deflate_compress(xrsr_ws_deflate_t *pmd, const uint8_t *in, uint32_t length, const uint8_t **out, uint32_t *out_length);
+bool     xrsr_ws_deflate_decompress(xrsr_ws_deflate_t *pmd, const uint8_t *in, uint32_t length, const uint8_t **out, uint32_t *out_length);
 #endif
@@ -43,6 +43,7 @@
 #define SM_EVENT_AUDIO_ERROR              (17)
 #define SM_EVENT_ESTABLISH_TIMEOUT        (18)
 #define SM_EVENT_TEXT_SESSION_SUCCESS     (19)
+#define SM_EVENT_RECONNECT                (20)
 
 //-------------------------------------------------------------------------------
 // States
@@ -161,6 +162,7 @@ tStateGuard St_Ws_Established_NextStates[] =
     { SM_EVENT_MSG_RECV, &St_Ws_Established_Info },
     { SM_EVENT_EOS,      &St_Ws_Established_Info },
     { SM_EVENT_EOS_PIPE, &St_Ws_Established_Info },
+    { SM_EVENT_WS_ERROR, &St_Ws_Disconnecting_Info },
     { SM_EVENT_WS_CLOSE, &St_Ws_Disconnected_Info }
 };
 
@@ -184,7 +186,8 @@ tStateGuard St_Ws_Streaming_NextStates[] =
     { SM_EVENT_WS_ERROR, &St_Ws_Disconnecting_Info },
     { SM_EVENT_WS_CLOSE, &St_Ws_Disconnected_Info },
     { SM_EVENT_AUDIO_ERROR, &St_Ws_Established_Info },
-    { SM_EVENT_TEXT_SESSION_SUCCESS, &St_Ws_TextOnlySession_Info }
+    { SM_EVENT_TEXT_SESSION_SUCCESS, &St_Ws_TextOnlySession_Info },
+    { SM_EVENT_RECONNECT, &St_Ws_Connection_Retry_Info }
 };
 
 tStateInfo St_Ws_Streaming_Info = 
@@ -221,7 +224,8 @@ tStateInfo St_Ws_TextOnlySession_Info =
 tStateGuard St_Ws_Connection_Retry_NextStates[] = 
 {
     { SM_EVENT_TERMINATE, &St_Ws_Disconnected_Info },
-    { SM_EVENT_TIMEOUT, &St_Ws_Connecting_Info }
+    { SM_EVENT_TIMEOUT, &St_Ws_Connecting_Info },
+    { SM_EVENT_CONNECTED, &St_Ws_Connected_Info }
 };
 
 tStateInfo St_Ws_Connection_Retry_Info = 
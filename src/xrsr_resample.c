@@ -0,0 +1,277 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "xrsr_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XRSR_RESAMPLE_X86
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define XRSR_RESAMPLE_NEON
+#endif
+
+#define XRSR_RESAMPLE_TAP_QTY       (32)   // taps per phase, a multiple of the widest vector
+#define XRSR_RESAMPLE_PHASE_QTY_MAX (512)  // limits the ratio of the rates after reducing by their common divisor
+#define XRSR_RESAMPLE_ALIGNMENT     (32)
+#define XRSR_RESAMPLE_CUTOFF        (0.90) // pass band edge as a fraction of the lower nyquist frequency
+
+// Rational resampling by up / down.  The low pass prototype filter at up times the input rate is split into up
+// phases of XRSR_RESAMPLE_TAP_QTY taps.  Each output sample is the dot product of one phase with the most recent
+// input samples, so the zeros of the upsampled signal are never computed.
+typedef float (*xrsr_resample_dot_t)(const float *coeffs, const float *samples);
+
+static uint32_t xrsr_resample_gcd(uint32_t a, uint32_t b);
+static bool     xrsr_resample_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out);
+static bool     xrsr_resample_stage_flush(void *data, xrsr_frame_t *out);
+static void     xrsr_resample_stage_close(void *data);
+static float    xrsr_resample_dot_scalar(const float *coeffs, const float *samples);
+#ifdef XRSR_RESAMPLE_X86
+static float    xrsr_resample_dot_sse2(const float *coeffs, const float *samples);
+static float    xrsr_resample_dot_avx2(const float *coeffs, const float *samples);
+#endif
+#ifdef XRSR_RESAMPLE_NEON
+static float    xrsr_resample_dot_neon(const float *coeffs, const float *samples);
+#endif
+
+bool xrsr_resampler_init(xrsr_resampler_t *resampler, uint32_t rate_in, uint32_t rate_out, uint32_t chunk_qty_max) {
+   memset(resampler, 0, sizeof(*resampler));
+   if(rate_in == 0 || rate_out == 0 || chunk_qty_max == 0) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   uint32_t gcd  = xrsr_resample_gcd(rate_in, rate_out);
+   uint32_t up   = rate_out / gcd;
+   uint32_t down = rate_in / gcd;
+
+   if(up > XRSR_RESAMPLE_PHASE_QTY_MAX) {
+      XLOGD_ERROR("unsupported ratio <%u> -> <%u>", rate_in, rate_out);
+      return(false);
+   }
+   resampler->rate_in       = rate_in;
+   resampler->rate_out      = rate_out;
+   resampler->up            = up;
+   resampler->down          = down;
+   resampler->chunk_qty_max = chunk_qty_max;
+   resampler->kernel        = xrsr_convert_kernel_best();
+
+   // All memory is allocated here so that processing does not allocate
+   size_t size_coeffs = up * XRSR_RESAMPLE_TAP_QTY * sizeof(float);
+   size_t size_buffer = (XRSR_RESAMPLE_TAP_QTY - 1 + chunk_qty_max) * sizeof(float);
+   size_buffer = (size_buffer + XRSR_RESAMPLE_ALIGNMENT - 1) & ~(XRSR_RESAMPLE_ALIGNMENT - 1);
+
+   resampler->coeffs = (float *)aligned_alloc(XRSR_RESAMPLE_ALIGNMENT, size_coeffs);
+   resampler->buffer = (float *)aligned_alloc(XRSR_RESAMPLE_ALIGNMENT, size_buffer);
+   if(resampler->coeffs == NULL || resampler->buffer == NULL) {
+      XLOGD_ERROR("out of memory");
+      xrsr_resampler_term(resampler);
+      return(false);
+   }
+   memset(resampler->buffer, 0, (XRSR_RESAMPLE_TAP_QTY - 1) * sizeof(float));
+
+   // Windowed sinc at the upsampled rate with a gain of up to restore the level lost to the inserted zeros
+   uint32_t length = up * XRSR_RESAMPLE_TAP_QTY;
+   double   cutoff = XRSR_RESAMPLE_CUTOFF * 0.5 / ((up > down) ? up : down); // cycles per upsampled sample
+   double   center = (length - 1) / 2.0;
+
+   for(uint32_t phase = 0; phase < up; phase++) {
+      for(uint32_t tap = 0; tap < XRSR_RESAMPLE_TAP_QTY; tap++) {
+         // Taps are stored in the order of the input samples that they multiply (oldest first)
+         uint32_t index  = phase + (XRSR_RESAMPLE_TAP_QTY - 1 - tap) * up;
+         double   x      = index - center;
+         double   sinc   = (x == 0.0) ? 2.0 * cutoff : sin(2.0 * M_PI * cutoff * x) / (M_PI * x);
+         double   window = 0.42 - 0.5 * cos(2.0 * M_PI * index / (length - 1)) + 0.08 * cos(4.0 * M_PI * index / (length - 1)); // Blackman
+         resampler->coeffs[phase * XRSR_RESAMPLE_TAP_QTY + tap] = (float)(sinc * window * up);
+      }
+   }
+
+   XLOGD_INFO("rate <%u> -> <%u> up <%u> down <%u> taps <%u> kernel <%s>", rate_in, rate_out, up, down, length, xrsr_convert_kernel_str(resampler->kernel));
+   return(true);
+}
+
+void xrsr_resampler_term(xrsr_resampler_t *resampler) {
+   free(resampler->coeffs);
+   free(resampler->buffer);
+   resampler->coeffs = NULL;
+   resampler->buffer = NULL;
+}
+
+// The largest quantity of samples produced from a chunk of in_qty samples
+uint32_t xrsr_resampler_output_max(const xrsr_resampler_t *resampler, uint32_t in_qty) {
+   return(((in_qty * resampler->up) / resampler->down) + 1);
+}
+
+// Resamples a chunk of no more than chunk_qty_max samples.  The filter state is carried to the next chunk.  Returns
+// the quantity of samples written to out.
+uint32_t xrsr_resampler_process(xrsr_resampler_t *resampler, const int16_t *in, uint32_t in_qty, int16_t *out) {
+   xrsr_resample_dot_t dot = xrsr_resample_dot_scalar;
+   switch(resampler->kernel) {
+      #ifdef XRSR_RESAMPLE_X86
+      case XRSR_CONVERT_KERNEL_SSE2: dot = xrsr_resample_dot_sse2; break;
+      case XRSR_CONVERT_KERNEL_AVX2: dot = xrsr_resample_dot_avx2; break;
+      #endif
+      #ifdef XRSR_RESAMPLE_NEON
+      case XRSR_CONVERT_KERNEL_NEON: dot = xrsr_resample_dot_neon; break;
+      #endif
+      default: break;
+   }
+   if(in_qty > resampler->chunk_qty_max) {
+      in_qty = resampler->chunk_qty_max;
+   }
+   float *samples = &resampler->buffer[XRSR_RESAMPLE_TAP_QTY - 1];
+   for(uint32_t index = 0; index < in_qty; index++) {
+      samples[index] = (float)in[index];
+   }
+
+   uint32_t out_qty = 0;
+   uint32_t phase   = resampler->phase;
+   uint32_t index   = resampler->index; // newest input sample for the next output
+
+   while(index < in_qty) {
+      float value = (*dot)(&resampler->coeffs[phase * XRSR_RESAMPLE_TAP_QTY], &resampler->buffer[index]);
+      long  sample = lrintf(value);
+      out[out_qty++] = (sample > INT16_MAX) ? INT16_MAX : (sample < INT16_MIN) ? INT16_MIN : (int16_t)sample;
+
+      phase += resampler->down;
+      index += phase / resampler->up;
+      phase %= resampler->up;
+   }
+   resampler->phase = phase;
+   resampler->index = index - in_qty;
+
+   // Keep the most recent samples as history for the next chunk
+   memmove(resampler->buffer, &resampler->buffer[in_qty], (XRSR_RESAMPLE_TAP_QTY - 1) * sizeof(float));
+   return(out_qty);
+}
+
+// Creates a stage which resamples 16-bit mono audio
+bool xrsr_resample_stage_create(xrsr_stage_t *stage, uint32_t rate_in, uint32_t rate_out) {
+   xrsr_resampler_t *resampler = (xrsr_resampler_t *)malloc(sizeof(xrsr_resampler_t));
+   if(resampler == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   if(!xrsr_resampler_init(resampler, rate_in, rate_out, XRSR_PIPELINE_FRAME_QTY)) {
+      free(resampler);
+      return(false);
+   }
+   memset(stage, 0, sizeof(*stage));
+   stage->name    = "resample";
+   stage->data    = resampler;
+   stage->process = xrsr_resample_stage_process;
+   stage->flush   = xrsr_resample_stage_flush;
+   stage->close   = xrsr_resample_stage_close;
+   return(true);
+}
+
+bool xrsr_resample_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out) {
+   xrsr_resampler_t *resampler = (xrsr_resampler_t *)data;
+   const int16_t *   samples   = (const int16_t *)in->buffer;
+   uint32_t          remaining = in->size / sizeof(int16_t);
+
+   while(remaining > 0) {
+      uint32_t qty = (remaining > resampler->chunk_qty_max) ? resampler->chunk_qty_max : remaining;
+      if(out->size + xrsr_resampler_output_max(resampler, qty) * sizeof(int16_t) > out->capacity) {
+         XLOGD_ERROR("sample qty <%u> exceeds capacity <%u>", remaining, out->capacity);
+         return(false);
+      }
+      out->size += xrsr_resampler_process(resampler, samples, qty, (int16_t *)(out->buffer + out->size)) * sizeof(int16_t);
+      samples   += qty;
+      remaining -= qty;
+   }
+   return(true);
+}
+
+// Push silence through the filter so that the end of the audio is not held in its history
+bool xrsr_resample_stage_flush(void *data, xrsr_frame_t *out) {
+   static const int16_t silence[XRSR_RESAMPLE_TAP_QTY / 2] = { 0 };
+   xrsr_frame_t in;
+   in.buffer   = (uint8_t *)silence;
+   in.size     = sizeof(silence);
+   in.capacity = sizeof(silence);
+   return(xrsr_resample_stage_process(data, &in, out));
+}
+
+void xrsr_resample_stage_close(void *data) {
+   xrsr_resampler_term((xrsr_resampler_t *)data);
+   free(data);
+}
+
+uint32_t xrsr_resample_gcd(uint32_t a, uint32_t b) {
+   while(b != 0) {
+      uint32_t t = a % b;
+      a = b;
+      b = t;
+   }
+   return(a);
+}
+
+float xrsr_resample_dot_scalar(const float *coeffs, const float *samples) {
+   float sum = 0.0f;
+   for(uint32_t tap = 0; tap < XRSR_RESAMPLE_TAP_QTY; tap++) {
+      sum += coeffs[tap] * samples[tap];
+   }
+   return(sum);
+}
+
+#ifdef XRSR_RESAMPLE_X86
+__attribute__((target("sse2")))
+float xrsr_resample_dot_sse2(const float *coeffs, const float *samples) {
+   __m128 sum = _mm_setzero_ps();
+   for(uint32_t tap = 0; tap < XRSR_RESAMPLE_TAP_QTY; tap += 4) {
+      sum = _mm_add_ps(sum, _mm_mul_ps(_mm_load_ps(&coeffs[tap]), _mm_loadu_ps(&samples[tap])));
+   }
+   sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+   sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+   return(_mm_cvtss_f32(sum));
+}
+
+__attribute__((target("avx2")))
+float xrsr_resample_dot_avx2(const float *coeffs, const float *samples) {
+   __m256 sum = _mm256_setzero_ps();
+   for(uint32_t tap = 0; tap < XRSR_RESAMPLE_TAP_QTY; tap += 8) {
+      sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_load_ps(&coeffs[tap]), _mm256_loadu_ps(&samples[tap])));
+   }
+   __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+   half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+   half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+   return(_mm_cvtss_f32(half));
+}
+#endif
+
+#ifdef XRSR_RESAMPLE_NEON
+float xrsr_resample_dot_neon(const float *coeffs, const float *samples) {
+   float32x4_t sum = vdupq_n_f32(0.0f);
+   for(uint32_t tap = 0; tap < XRSR_RESAMPLE_TAP_QTY; tap += 4) {
+      sum = vmlaq_f32(sum, vld1q_f32(&coeffs[tap]), vld1q_f32(&samples[tap]));
+   }
+   #ifdef __aarch64__
+   return(vaddvq_f32(sum));
+   #else
+   float32x2_t pair = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+   return(vget_lane_f32(vpadd_f32(pair, pair), 0));
+   #endif
+}
+#endif
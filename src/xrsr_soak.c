@@ -0,0 +1,510 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Session throughput and resource leak soak test.  Back-to-back sessions are requested with xrsr_session_request()
+// against the local stand-in server and the mock xraudio backend.  Sessions rotate through the enabled protocols
+// and through normal, text-only, terminated and retried (the server rejects the first connection) scenarios.
+// After each batch the open fd count, RSS and heap in use are sampled along with the session rate.  The test fails
+// if a session hangs or if resources grow past the limits once the warm-up batches have set the baseline.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <getopt.h>
+#include <malloc.h>
+#include <time.h>
+#include <pthread.h>
+#include <uuid/uuid.h>
+#include <jansson.h>
+#include <rdkx_logger.h>
+#include <xr_timestamp.h>
+#include <xrsr.h>
+#include "xrsr_bench_server.h"
+
+#define XRSR_SOAK_BATCH_QTY_DEFAULT    (10)
+#define XRSR_SOAK_BATCH_SIZE_DEFAULT   (40)
+#define XRSR_SOAK_WARMUP_DEFAULT       (1)
+#define XRSR_SOAK_AUDIO_DURATION       (500)
+#define XRSR_SOAK_SESSION_TIMEOUT      (10000)
+#define XRSR_SOAK_FD_GROWTH_MAX        (0)
+#define XRSR_SOAK_HEAP_GROWTH_MAX      (256)  // in KB
+#define XRSR_SOAK_RSS_GROWTH_MAX       (4096) // in KB
+#define XRSR_SOAK_URL_LEN_MAX          (64)
+#define XRSR_SOAK_TRANSCRIPTION        "soak test transcription"
+
+typedef enum {
+   XRSR_SOAK_SCENARIO_NORMAL    = 0, // audio session which runs to end of stream
+   XRSR_SOAK_SCENARIO_TEXT      = 1, // text-only session
+   XRSR_SOAK_SCENARIO_TERMINATE = 2, // audio session which is terminated once connected
+   XRSR_SOAK_SCENARIO_RETRY     = 3, // audio session whose first connection attempt is rejected by the server
+   XRSR_SOAK_SCENARIO_QTY       = 4,
+} xrsr_soak_scenario_t;
+
+typedef struct {
+   const char *name;
+   const char *scheme;
+   bool        server;
+   bool        text;   // text-only sessions are supported
+} xrsr_soak_protocol_t;
+
+typedef struct {
+   uint32_t                   batch_qty;
+   uint32_t                   batch_size;
+   uint32_t                   warmup;
+   uint32_t                   audio_duration;
+   double                     rate;
+   uint32_t                   session_timeout;
+   uint32_t                   fd_growth_max;
+   uint32_t                   heap_growth_max;
+   uint32_t                   rss_growth_max;
+   const char *               protocols;
+   const char *               output;
+   xrsr_bench_server_params_t server;
+} xrsr_soak_params_t;
+
+typedef struct {
+   uint32_t fds;
+   uint64_t rss;  // in bytes
+   uint64_t heap; // in bytes
+} xrsr_soak_resources_t;
+
+typedef struct {
+   pthread_mutex_t mutex;
+   pthread_cond_t  cond;
+   bool            connected;
+   bool            ended;
+   uint32_t        reasons[XRSR_SESSION_END_REASON_INVALID + 1];
+} xrsr_soak_state_t;
+
+static const xrsr_soak_protocol_t g_xrsr_soak_protocols[] = {
+   { "ws",   "ws",   true,  true  },
+   { "http", "http", true,  true  },
+   { "sdt",  "sdt",  false, false },
+};
+
+static const char *g_xrsr_soak_scenario_names[XRSR_SOAK_SCENARIO_QTY] = {
+   "normal",
+   "text",
+   "terminate",
+   "retry",
+};
+
+static xrsr_soak_state_t g_xrsr_soak;
+
+static void xrsr_soak_usage(const char *name);
+static void xrsr_soak_route(xrsr_route_t *routes, xrsr_dst_params_t *dst_params, char *url, size_t url_size, const xrsr_soak_protocol_t *protocol, uint16_t port);
+static bool xrsr_soak_session(const xrsr_soak_params_t *params, const xrsr_soak_protocol_t *protocol, xrsr_soak_scenario_t scenario, xrsr_bench_server_t server);
+static bool xrsr_soak_wait(bool *flag, uint32_t timeout);
+static void xrsr_soak_resources_get(xrsr_soak_resources_t *resources);
+static json_t *xrsr_soak_resources_json(const xrsr_soak_resources_t *resources);
+
+static void xrsr_soak_handler_session_begin(void *data, const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_keyword_detector_result_t *detector_result, xrsr_session_config_out_t *config_out, xrsr_session_config_in_t *config_in, rdkx_timestamp_t *timestamp, const char *transcription_in);
+static void xrsr_soak_handler_session_end(void *data, const uuid_t uuid, xrsr_session_stats_t *stats, rdkx_timestamp_t *timestamp);
+static int  xrsr_soak_handler_stream_audio(unsigned char *buffer, uint32_t length);
+static bool xrsr_soak_handler_connected(void *data, const uuid_t uuid, xrsr_handler_send_t send, void *param, rdkx_timestamp_t *timestamp);
+static bool xrsr_soak_handler_recv_msg(void *data, xrsr_recv_msg_t type, const uint8_t *buffer, uint32_t length, xrsr_recv_event_t *event);
+
+int main(int argc, char *argv[]) {
+   xrsr_soak_params_t params;
+   int                opt;
+
+   memset(&params, 0, sizeof(params));
+   params.batch_qty       = XRSR_SOAK_BATCH_QTY_DEFAULT;
+   params.batch_size      = XRSR_SOAK_BATCH_SIZE_DEFAULT;
+   params.warmup          = XRSR_SOAK_WARMUP_DEFAULT;
+   params.audio_duration  = XRSR_SOAK_AUDIO_DURATION;
+   params.rate            = 0.0;
+   params.session_timeout = XRSR_SOAK_SESSION_TIMEOUT;
+   params.fd_growth_max   = XRSR_SOAK_FD_GROWTH_MAX;
+   params.heap_growth_max = XRSR_SOAK_HEAP_GROWTH_MAX;
+   params.rss_growth_max  = XRSR_SOAK_RSS_GROWTH_MAX;
+   params.protocols       = "ws,http,sdt";
+   params.server.eos_idle = 50;
+
+   while((opt = getopt(argc, argv, "n:b:w:p:a:r:T:f:m:M:o:h")) != -1) {
+      switch(opt) {
+         case 'n': params.batch_qty       = strtoul(optarg, NULL, 10); break;
+         case 'b': params.batch_size      = strtoul(optarg, NULL, 10); break;
+         case 'w': params.warmup          = strtoul(optarg, NULL, 10); break;
+         case 'p': params.protocols       = optarg;                    break;
+         case 'a': params.audio_duration  = strtoul(optarg, NULL, 10); break;
+         case 'r': params.rate            = strtod(optarg, NULL);      break;
+         case 'T': params.session_timeout = strtoul(optarg, NULL, 10); break;
+         case 'f': params.fd_growth_max   = strtoul(optarg, NULL, 10); break;
+         case 'm': params.heap_growth_max = strtoul(optarg, NULL, 10); break;
+         case 'M': params.rss_growth_max  = strtoul(optarg, NULL, 10); break;
+         case 'o': params.output          = optarg;                    break;
+         default: {
+            xrsr_soak_usage(argv[0]);
+            return((opt == 'h') ? 0 : 1);
+         }
+      }
+   }
+   if(params.batch_size == 0 || params.warmup == 0 || params.batch_qty <= params.warmup) {
+      xrsr_soak_usage(argv[0]);
+      return(1);
+   }
+
+   const xrsr_soak_protocol_t *protocols[sizeof(g_xrsr_soak_protocols) / sizeof(g_xrsr_soak_protocols[0])];
+   uint32_t                    protocol_qty = 0;
+   for(uint32_t index = 0; index < sizeof(g_xrsr_soak_protocols) / sizeof(g_xrsr_soak_protocols[0]); index++) {
+      char list[64];
+      snprintf(list, sizeof(list), "%s", params.protocols);
+      for(char *save = NULL, *token = strtok_r(list, ",", &save); token != NULL; token = strtok_r(NULL, ",", &save)) {
+         if(0 == strcmp(token, g_xrsr_soak_protocols[index].name)) {
+            protocols[protocol_qty++] = &g_xrsr_soak_protocols[index];
+            break;
+         }
+      }
+   }
+   if(protocol_qty == 0) {
+      xrsr_soak_usage(argv[0]);
+      return(1);
+   }
+
+   pthread_mutex_init(&g_xrsr_soak.mutex, NULL);
+   pthread_cond_init(&g_xrsr_soak.cond, NULL);
+
+   xrsr_bench_server_t server = xrsr_bench_server_create(&params.server);
+   if(server == NULL) {
+      XLOGD_ERROR("unable to start server");
+      return(1);
+   }
+   uint16_t port = xrsr_bench_server_port(server);
+
+   // Sessions are only started by request so keyword detection is disabled in the mock
+   json_t *json_vsdk    = json_object();
+   json_t *json_xraudio = json_object();
+   json_t *json_mock    = json_object();
+   json_object_set_new(json_mock, "audio_duration", json_integer(params.audio_duration));
+   json_object_set_new(json_mock, "rate",           json_real(params.rate));
+   json_object_set_new(json_mock, "keyword_delay",  json_integer(0));
+   json_object_set_new(json_xraudio, "mock", json_mock);
+   json_object_set_new(json_vsdk, "xraudio", json_xraudio);
+
+   char              url[XRSR_SOAK_URL_LEN_MAX];
+   xrsr_dst_params_t dst_params;
+   xrsr_route_t      routes[2];
+
+   xrsr_soak_route(routes, &dst_params, url, sizeof(url), protocols[0], port);
+   if(!xrsr_open(NULL, routes, NULL, NULL, XRSR_POWER_MODE_FULL, false, false, json_vsdk)) {
+      XLOGD_ERROR("unable to open speech router");
+      json_decref(json_vsdk);
+      xrsr_bench_server_destroy(server);
+      return(1);
+   }
+
+   json_t *json_results = json_object();
+   json_t *json_batches = json_array();
+   json_object_set_new(json_results, "batches", json_batches);
+
+   xrsr_soak_resources_t baseline;
+   xrsr_soak_resources_t resources;
+   uint32_t              session_index = 0;
+   uint32_t              protocol_prev = 0;
+   bool                  result        = true;
+
+   memset(&baseline, 0, sizeof(baseline));
+
+   for(uint32_t batch = 0; batch < params.batch_qty && result; batch++) {
+      struct timespec begin;
+      struct timespec end;
+
+      clock_gettime(CLOCK_MONOTONIC, &begin);
+      for(uint32_t index = 0; index < params.batch_size; index++, session_index++) {
+         // Rotate the scenario every session and the protocol every full set of scenarios
+         uint32_t                    protocol_index = (session_index / XRSR_SOAK_SCENARIO_QTY) % protocol_qty;
+         const xrsr_soak_protocol_t *protocol       = protocols[protocol_index];
+         xrsr_soak_scenario_t        scenario       = (xrsr_soak_scenario_t)(session_index % XRSR_SOAK_SCENARIO_QTY);
+
+         if(protocol_index != protocol_prev) {
+            xrsr_soak_route(routes, &dst_params, url, sizeof(url), protocol, port);
+            if(!xrsr_route(routes)) {
+               XLOGD_ERROR("unable to set route <%s>", url);
+               result = false;
+               break;
+            }
+            protocol_prev = protocol_index;
+         }
+         if(!xrsr_soak_session(&params, protocol, scenario, server)) {
+            XLOGD_ERROR("batch <%u> session <%u> protocol <%s> scenario <%s> did not end", batch, session_index, protocol->name, g_xrsr_soak_scenario_names[scenario]);
+            result = false;
+            break;
+         }
+      }
+      clock_gettime(CLOCK_MONOTONIC, &end);
+
+      xrsr_soak_resources_get(&resources);
+      double secs = (double)(end.tv_sec - begin.tv_sec) + ((double)(end.tv_nsec - begin.tv_nsec) / 1000000000.0);
+
+      json_t *json_batch = xrsr_soak_resources_json(&resources);
+      json_object_set_new(json_batch, "batch",            json_integer(batch));
+      json_object_set_new(json_batch, "sessions_per_sec", json_real((secs > 0.0) ? params.batch_size / secs : 0.0));
+      json_array_append_new(json_batches, json_batch);
+
+      XLOGD_INFO("batch <%u> fds <%u> rss <%llu> heap <%llu> sessions/sec <%.2f>", batch, resources.fds, (unsigned long long)resources.rss, (unsigned long long)resources.heap, (secs > 0.0) ? params.batch_size / secs : 0.0);
+
+      if(batch + 1 == params.warmup) {
+         baseline = resources;
+      }
+   }
+
+   xrsr_close();
+   json_decref(json_vsdk);
+   xrsr_bench_server_destroy(server);
+
+   // The final sample is taken with the router still open so it is comparable with the baseline
+   json_t *json_failures = json_array();
+   if(result) {
+      if(resources.fds > baseline.fds + params.fd_growth_max) {
+         json_array_append_new(json_failures, json_string("fds"));
+      }
+      if(resources.heap > baseline.heap + ((uint64_t)params.heap_growth_max * 1024)) {
+         json_array_append_new(json_failures, json_string("heap"));
+      }
+      if(resources.rss > baseline.rss + ((uint64_t)params.rss_growth_max * 1024)) {
+         json_array_append_new(json_failures, json_string("rss"));
+      }
+      if(json_array_size(json_failures) > 0) {
+         result = false;
+      }
+   } else {
+      json_array_append_new(json_failures, json_string("session"));
+   }
+
+   json_t *json_reasons = json_object();
+   pthread_mutex_lock(&g_xrsr_soak.mutex);
+   for(uint32_t index = 0; index < XRSR_SESSION_END_REASON_INVALID + 1; index++) {
+      if(g_xrsr_soak.reasons[index] > 0) {
+         json_object_set_new(json_reasons, xrsr_session_end_reason_str((xrsr_session_end_reason_t)index), json_integer(g_xrsr_soak.reasons[index]));
+      }
+   }
+   pthread_mutex_unlock(&g_xrsr_soak.mutex);
+
+   json_object_set_new(json_results, "sessions", json_integer(session_index));
+   json_object_set_new(json_results, "reasons",  json_reasons);
+   json_object_set_new(json_results, "baseline", xrsr_soak_resources_json(&baseline));
+   json_object_set_new(json_results, "failures", json_failures);
+   json_object_set_new(json_results, "result",   json_string(result ? "PASS" : "FAIL"));
+
+   FILE *file = (params.output != NULL) ? fopen(params.output, "w") : stdout;
+   if(file == NULL) {
+      XLOGD_ERROR("unable to open <%s> <%s>", params.output, strerror(errno));
+      result = false;
+   } else {
+      json_dumpf(json_results, file, JSON_INDENT(3) | JSON_PRESERVE_ORDER);
+      fprintf(file, "\n");
+      if(file != stdout) {
+         fclose(file);
+      }
+   }
+   json_decref(json_results);
+
+   pthread_cond_destroy(&g_xrsr_soak.cond);
+   pthread_mutex_destroy(&g_xrsr_soak.mutex);
+   return(result ? 0 : 1);
+}
+
+void xrsr_soak_usage(const char *name) {
+   printf("usage: %s [options]\n", name);
+   printf("   -n <qty>   batches (default %u)\n", XRSR_SOAK_BATCH_QTY_DEFAULT);
+   printf("   -b <qty>   sessions per batch (default %u)\n", XRSR_SOAK_BATCH_SIZE_DEFAULT);
+   printf("   -w <qty>   warm-up batches before the baseline is sampled (default %u)\n", XRSR_SOAK_WARMUP_DEFAULT);
+   printf("   -p <list>  protocols to rotate through (default ws,http,sdt)\n");
+   printf("   -a <ms>    utterance duration (default %u)\n", XRSR_SOAK_AUDIO_DURATION);
+   printf("   -r <rate>  audio source rate, 1.0 is real-time and 0 is unthrottled (default 0)\n");
+   printf("   -T <ms>    session timeout (default %u)\n", XRSR_SOAK_SESSION_TIMEOUT);
+   printf("   -f <qty>   allowed fd growth (default %u)\n", XRSR_SOAK_FD_GROWTH_MAX);
+   printf("   -m <kb>    allowed heap growth (default %u)\n", XRSR_SOAK_HEAP_GROWTH_MAX);
+   printf("   -M <kb>    allowed rss growth (default %u)\n", XRSR_SOAK_RSS_GROWTH_MAX);
+   printf("   -o <file>  json output file (default stdout)\n");
+}
+
+void xrsr_soak_route(xrsr_route_t *routes, xrsr_dst_params_t *dst_params, char *url, size_t url_size, const xrsr_soak_protocol_t *protocol, uint16_t port) {
+   if(protocol->server) {
+      snprintf(url, url_size, "%s://127.0.0.1:%u/soak", protocol->scheme, port);
+   } else {
+      snprintf(url, url_size, "%s://127.0.0.1/soak", protocol->scheme);
+   }
+
+   memset(dst_params, 0, sizeof(*dst_params));
+   dst_params->connect_check_interval = 50;
+   dst_params->timeout_connect        = 2000;
+   dst_params->timeout_inactivity     = 2000;
+   dst_params->timeout_session        = 5000;
+   dst_params->ipv4_fallback          = true;
+   dst_params->backoff_delay          = 10;
+
+   memset(routes, 0, sizeof(xrsr_route_t) * 2);
+   routes[0].src     = XRSR_SRC_MICROPHONE;
+   routes[0].dst_qty = 1;
+   routes[1].src     = XRSR_SRC_INVALID;
+
+   xrsr_dst_t *dst = &routes[0].dsts[0];
+   dst->url                    = url;
+   dst->handlers.session_begin = xrsr_soak_handler_session_begin;
+   dst->handlers.session_end   = xrsr_soak_handler_session_end;
+   dst->handlers.stream_audio  = xrsr_soak_handler_stream_audio;
+   dst->handlers.connected     = xrsr_soak_handler_connected;
+   dst->handlers.recv_msg      = xrsr_soak_handler_recv_msg;
+   dst->formats                = XRSR_AUDIO_FORMAT_PCM;
+   dst->stream_from            = XRSR_STREAM_FROM_BEGINNING;
+   dst->stream_until           = XRSR_STREAM_UNTIL_END_OF_SPEECH;
+   for(uint32_t index = 0; index < XRSR_POWER_MODE_INVALID; index++) {
+      dst->params[index] = dst_params;
+   }
+}
+
+bool xrsr_soak_session(const xrsr_soak_params_t *params, const xrsr_soak_protocol_t *protocol, xrsr_soak_scenario_t scenario, xrsr_bench_server_t server) {
+   if(scenario == XRSR_SOAK_SCENARIO_TEXT && !protocol->text) {
+      scenario = XRSR_SOAK_SCENARIO_NORMAL;
+   } else if(scenario == XRSR_SOAK_SCENARIO_RETRY && !protocol->server) {
+      scenario = XRSR_SOAK_SCENARIO_TERMINATE;
+   }
+
+   pthread_mutex_lock(&g_xrsr_soak.mutex);
+   g_xrsr_soak.connected = false;
+   g_xrsr_soak.ended     = false;
+   pthread_mutex_unlock(&g_xrsr_soak.mutex);
+
+   if(scenario == XRSR_SOAK_SCENARIO_RETRY) {
+      xrsr_bench_server_reject(server, 1);
+   }
+
+   const char *transcription = (scenario == XRSR_SOAK_SCENARIO_TEXT) ? XRSR_SOAK_TRANSCRIPTION : NULL;
+   if(!xrsr_session_request(XRSR_SRC_MICROPHONE, XRSR_AUDIO_FORMAT_PCM, transcription, false)) {
+      XLOGD_ERROR("session request failed");
+      xrsr_bench_server_reject(server, 0);
+      return(false);
+   }
+
+   if(scenario == XRSR_SOAK_SCENARIO_TERMINATE) {
+      if(xrsr_soak_wait(&g_xrsr_soak.connected, params->session_timeout)) {
+         xrsr_session_terminate(XRSR_SRC_MICROPHONE);
+      }
+   }
+   bool result = xrsr_soak_wait(&g_xrsr_soak.ended, params->session_timeout);
+
+   xrsr_bench_server_reject(server, 0);
+   return(result);
+}
+
+bool xrsr_soak_wait(bool *flag, uint32_t timeout) {
+   struct timespec deadline;
+   int             rc = 0;
+
+   clock_gettime(CLOCK_REALTIME, &deadline);
+   deadline.tv_sec  += timeout / 1000;
+   deadline.tv_nsec += (timeout % 1000) * 1000000;
+   if(deadline.tv_nsec >= 1000000000) {
+      deadline.tv_sec++;
+      deadline.tv_nsec -= 1000000000;
+   }
+   pthread_mutex_lock(&g_xrsr_soak.mutex);
+   while(!*flag && !g_xrsr_soak.ended && rc == 0) {
+      rc = pthread_cond_timedwait(&g_xrsr_soak.cond, &g_xrsr_soak.mutex, &deadline);
+   }
+   bool result = *flag;
+   pthread_mutex_unlock(&g_xrsr_soak.mutex);
+   return(result);
+}
+
+void xrsr_soak_resources_get(xrsr_soak_resources_t *resources) {
+   memset(resources, 0, sizeof(*resources));
+
+   DIR *dir = opendir("/proc/self/fd");
+   if(dir != NULL) {
+      struct dirent *entry;
+      while((entry = readdir(dir)) != NULL) {
+         if(entry->d_name[0] != '.') {
+            resources->fds++;
+         }
+      }
+      resources->fds--; // exclude the fd used by opendir
+      closedir(dir);
+   }
+
+   FILE *file = fopen("/proc/self/statm", "r");
+   if(file != NULL) {
+      unsigned long size     = 0;
+      unsigned long resident = 0;
+      if(fscanf(file, "%lu %lu", &size, &resident) == 2) {
+         resources->rss = (uint64_t)resident * sysconf(_SC_PAGESIZE);
+      }
+      fclose(file);
+   }
+
+   #if defined(__GLIBC__) && ((__GLIBC__ > 2) || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+   struct mallinfo2 info = mallinfo2();
+   resources->heap = info.uordblks + info.hblkhd;
+   #else
+   struct mallinfo info = mallinfo();
+   resources->heap = (uint32_t)info.uordblks + (uint32_t)info.hblkhd;
+   #endif
+}
+
+json_t *xrsr_soak_resources_json(const xrsr_soak_resources_t *resources) {
+   json_t *json_obj = json_object();
+   json_object_set_new(json_obj, "fds",  json_integer(resources->fds));
+   json_object_set_new(json_obj, "rss",  json_integer(resources->rss));
+   json_object_set_new(json_obj, "heap", json_integer(resources->heap));
+   return(json_obj);
+}
+
+void xrsr_soak_handler_session_begin(void *data, const uuid_t uuid, xrsr_src_t src, uint32_t dst_index, xrsr_keyword_detector_result_t *detector_result, xrsr_session_config_out_t *config_out, xrsr_session_config_in_t *config_in, rdkx_timestamp_t *timestamp, const char *transcription_in) {
+   if(config_in != NULL) {
+      config_in->src = src;
+   }
+}
+
+void xrsr_soak_handler_session_end(void *data, const uuid_t uuid, xrsr_session_stats_t *stats, rdkx_timestamp_t *timestamp) {
+   xrsr_session_end_reason_t reason = (stats != NULL) ? stats->reason : XRSR_SESSION_END_REASON_INVALID;
+   if((uint32_t)reason > XRSR_SESSION_END_REASON_INVALID) {
+      reason = XRSR_SESSION_END_REASON_INVALID;
+   }
+   pthread_mutex_lock(&g_xrsr_soak.mutex);
+   g_xrsr_soak.reasons[reason]++;
+   g_xrsr_soak.ended = true;
+   pthread_cond_broadcast(&g_xrsr_soak.cond);
+   pthread_mutex_unlock(&g_xrsr_soak.mutex);
+}
+
+int xrsr_soak_handler_stream_audio(unsigned char *buffer, uint32_t length) {
+   return(length);
+}
+
+bool xrsr_soak_handler_connected(void *data, const uuid_t uuid, xrsr_handler_send_t send, void *param, rdkx_timestamp_t *timestamp) {
+   pthread_mutex_lock(&g_xrsr_soak.mutex);
+   g_xrsr_soak.connected = true;
+   pthread_cond_broadcast(&g_xrsr_soak.cond);
+   pthread_mutex_unlock(&g_xrsr_soak.mutex);
+   return(true);
+}
+
+bool xrsr_soak_handler_recv_msg(void *data, xrsr_recv_msg_t type, const uint8_t *buffer, uint32_t length, xrsr_recv_event_t *event) {
+   if(event != NULL) {
+      *event = XRSR_RECV_EVENT_EOS_SERVER;
+   }
+   return(false);
+}
@@ -0,0 +1,178 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include "xrsr_private.h"
+
+// Options applied for each socket profile.  A value of zero leaves the system default in place.
+typedef struct {
+   bool     nodelay;
+   uint32_t notsent_lowat;
+   uint32_t sndbuf;
+   uint32_t rcvbuf;
+   uint32_t user_timeout;
+   bool     keepalive;
+   uint32_t keepalive_idle;
+   uint32_t keepalive_interval;
+   uint32_t keepalive_count;
+   uint8_t  tos;
+   bool     cork;
+} xrsr_socket_options_t;
+
+static const xrsr_socket_options_t g_xrsr_socket_options[XRSR_SOCKET_PROFILE_INVALID] = {
+   // DEFAULT - keep the behavior that the router has always had
+   { .nodelay = true },
+   // LOW_LATENCY - keep the unsent backlog small so audio isn't queued behind stale data, detect dead paths quickly and mark as AF41
+   { .nodelay = true,  .notsent_lowat = 16384, .sndbuf = 65536, .rcvbuf = 0, .user_timeout = 10000, .keepalive = true, .keepalive_idle = 10, .keepalive_interval = 5,  .keepalive_count = 3, .tos = 0x88, .cork = false },
+   // BULK - large buffers and full segments for throughput, mark as CS1
+   { .nodelay = false, .notsent_lowat = 0, .sndbuf = 262144, .rcvbuf = 262144, .user_timeout = 30000, .keepalive = true, .keepalive_idle = 30, .keepalive_interval = 10, .keepalive_count = 3, .tos = 0x20, .cork = true },
+};
+
+static bool xrsr_socket_opt_set(int fd, int level, int name, const char *str, int value);
+static int  xrsr_socket_opt_get(int fd, int level, int name);
+
+xrsr_socket_profile_t xrsr_socket_profile_from_str(const char *str) {
+   if(str == NULL) {
+      return(XRSR_SOCKET_PROFILE_INVALID);
+   }
+   if(0 == strcmp(str, "default")) {
+      return(XRSR_SOCKET_PROFILE_DEFAULT);
+   }
+   if(0 == strcmp(str, "low_latency")) {
+      return(XRSR_SOCKET_PROFILE_LOW_LATENCY);
+   }
+   if(0 == strcmp(str, "bulk")) {
+      return(XRSR_SOCKET_PROFILE_BULK);
+   }
+   return(XRSR_SOCKET_PROFILE_INVALID);
+}
+
+bool xrsr_socket_profile_apply(int fd, xrsr_socket_profile_t profile, xrsr_socket_stats_t *stats) {
+   if(fd < 0 || stats == NULL) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   if((uint32_t)profile >= XRSR_SOCKET_PROFILE_INVALID) {
+      XLOGD_WARN("invalid profile <%s>", xrsr_socket_profile_str(profile));
+      profile = XRSR_SOCKET_PROFILE_DEFAULT;
+   }
+   const xrsr_socket_options_t *options = &g_xrsr_socket_options[profile];
+   bool result = true;
+
+   struct sockaddr_storage addr;
+   socklen_t addr_len = sizeof(addr);
+   bool ipv6 = (getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0 && addr.ss_family == AF_INET6);
+
+   result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_NODELAY, "TCP_NODELAY", options->nodelay ? 1 : 0);
+
+   if(options->sndbuf) {
+      result &= xrsr_socket_opt_set(fd, SOL_SOCKET, SO_SNDBUF, "SO_SNDBUF", options->sndbuf);
+   }
+   if(options->rcvbuf) {
+      result &= xrsr_socket_opt_set(fd, SOL_SOCKET, SO_RCVBUF, "SO_RCVBUF", options->rcvbuf);
+   }
+   #ifdef TCP_NOTSENT_LOWAT
+   if(options->notsent_lowat) {
+      result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, "TCP_NOTSENT_LOWAT", options->notsent_lowat);
+   }
+   #endif
+   #ifdef TCP_USER_TIMEOUT
+   if(options->user_timeout) {
+      result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, "TCP_USER_TIMEOUT", options->user_timeout);
+   }
+   #endif
+   if(options->keepalive) {
+      result &= xrsr_socket_opt_set(fd, SOL_SOCKET, SO_KEEPALIVE, "SO_KEEPALIVE", 1);
+      result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_KEEPIDLE, "TCP_KEEPIDLE", options->keepalive_idle);
+      result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_KEEPINTVL, "TCP_KEEPINTVL", options->keepalive_interval);
+      result &= xrsr_socket_opt_set(fd, IPPROTO_TCP, TCP_KEEPCNT, "TCP_KEEPCNT", options->keepalive_count);
+   }
+   if(options->tos) {
+      if(ipv6) {
+         result &= xrsr_socket_opt_set(fd, IPPROTO_IPV6, IPV6_TCLASS, "IPV6_TCLASS", options->tos);
+      } else {
+         result &= xrsr_socket_opt_set(fd, IPPROTO_IP, IP_TOS, "IP_TOS", options->tos);
+      }
+   }
+
+   // Read back the values in effect since the kernel may adjust them (ie. buffer sizes are doubled and capped)
+   memset(stats, 0, sizeof(*stats));
+   stats->valid         = true;
+   stats->profile       = profile;
+   stats->nodelay       = (xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_NODELAY) > 0);
+   stats->sndbuf        = xrsr_socket_opt_get(fd, SOL_SOCKET, SO_SNDBUF);
+   stats->rcvbuf        = xrsr_socket_opt_get(fd, SOL_SOCKET, SO_RCVBUF);
+   #ifdef TCP_NOTSENT_LOWAT
+   stats->notsent_lowat = options->notsent_lowat ? xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT) : 0;
+   #endif
+   #ifdef TCP_USER_TIMEOUT
+   stats->user_timeout  = xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_USER_TIMEOUT);
+   #endif
+   stats->keepalive     = (xrsr_socket_opt_get(fd, SOL_SOCKET, SO_KEEPALIVE) > 0);
+   if(stats->keepalive) {
+      stats->keepalive_idle     = xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_KEEPIDLE);
+      stats->keepalive_interval = xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_KEEPINTVL);
+      stats->keepalive_count    = xrsr_socket_opt_get(fd, IPPROTO_TCP, TCP_KEEPCNT);
+   }
+   stats->tos           = (uint8_t)(ipv6 ? xrsr_socket_opt_get(fd, IPPROTO_IPV6, IPV6_TCLASS) : xrsr_socket_opt_get(fd, IPPROTO_IP, IP_TOS));
+   #ifdef TCP_CORK
+   stats->cork          = options->cork;
+   #endif
+
+   XLOGD_INFO("profile <%s> nodelay <%s> notsent lowat <%u> sndbuf <%u> rcvbuf <%u> user timeout <%u> ms keepalive <%s> <%u, %u, %u> tos <0x%02x> cork <%s>", xrsr_socket_profile_str(stats->profile), stats->nodelay ? "YES" : "NO", stats->notsent_lowat, stats->sndbuf, stats->rcvbuf, stats->user_timeout, stats->keepalive ? "YES" : "NO", stats->keepalive_idle, stats->keepalive_interval, stats->keepalive_count, stats->tos, stats->cork ? "YES" : "NO");
+
+   return(result);
+}
+
+void xrsr_socket_cork(int fd, const xrsr_socket_stats_t *stats, bool cork) {
+   #ifdef TCP_CORK
+   if(fd < 0 || stats == NULL || !stats->cork) {
+      return;
+   }
+   // Uncorking flushes any partial segment immediately
+   int value = cork ? 1 : 0;
+   if(setsockopt(fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value)) != 0) {
+      XLOGD_WARN("TCP_CORK <%d> <%s>", value, strerror(errno));
+   }
+   #endif
+}
+
+bool xrsr_socket_opt_set(int fd, int level, int name, const char *str, int value) {
+   if(setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+      XLOGD_WARN("%s <%d> <%s>", str, value, strerror(errno));
+      return(false);
+   }
+   return(true);
+}
+
+int xrsr_socket_opt_get(int fd, int level, int name) {
+   int value = 0;
+   socklen_t len = sizeof(value);
+   if(getsockopt(fd, level, name, &value, &len) != 0 || value < 0) {
+      return(0);
+   }
+   return(value);
+}
@@ -0,0 +1,210 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Binary trace of audio path events.  Each thread writes fixed size records to its own ring without locking or
+// formatting, and the records are only formatted when the rings are written to the log.  A record's sequence number
+// is cleared while it is being written so a reader on another thread can skip records which change under it.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "xrsr_private.h"
+
+#define XRSR_TRACE_RECORD_QTY (256) // per thread, must be a power of two
+#define XRSR_TRACE_LINE_SIZE  (160)
+
+typedef struct {
+   uint32_t seq;     // index of the record plus one, zero while the record is being written
+   uint16_t event;
+   uint16_t src;
+   uint64_t time_us; // monotonic
+   int64_t  args[2];
+} xrsr_trace_record_t;
+
+typedef struct xrsr_trace_ring_t {
+   struct xrsr_trace_ring_t *next;
+   bool                      owned;      // a thread is writing to the ring
+   pid_t                     tid;        // last thread to own the ring
+   pid_t                     tid_prev;   // thread which owned the ring before it
+   uint32_t                  head_owned; // index of the first record written by the last owner
+   uint32_t                  head;       // index of the next record, only written by the owner
+   xrsr_trace_record_t       records[XRSR_TRACE_RECORD_QTY];
+} xrsr_trace_ring_t;
+
+typedef struct {
+   const char *name;
+   const char *args[2]; // argument names, NULL if not used
+} xrsr_trace_event_info_t;
+
+static const xrsr_trace_event_info_t g_xrsr_trace_events[XRSR_TRACE_EVENT_INVALID] = {
+   [XRSR_TRACE_EVENT_HTTP_AUDIO_SENT]    = { "http audio sent",    { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_SDT_AUDIO_READ]     = { "sdt audio read",     { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_WS_SOCKET_READ]     = { "ws socket read",     { NULL,      NULL      } },
+   [XRSR_TRACE_EVENT_WS_PENDING_WAIT]    = { "ws pending wait",    { "bytes",   "written" } },
+   [XRSR_TRACE_EVENT_WS_PENDING_SENT]    = { "ws pending sent",    { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_WS_AUDIO_READ]      = { "ws audio read",      { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_WS_AUDIO_QUEUED]    = { "ws audio queued",    { "bytes",   "queued"  } },
+   [XRSR_TRACE_EVENT_WS_AUDIO_DRAIN]     = { "ws audio drain",     { "reads",   NULL      } },
+   [XRSR_TRACE_EVENT_UNIX_AUDIO_SENT]    = { "unix audio sent",    { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_UNIX_AUDIO_PENDING] = { "unix audio pending", { "bytes",   NULL      } },
+   [XRSR_TRACE_EVENT_PIPELINE_READ]      = { "pipeline read",      { "bytes",   "buffered"} },
+};
+
+static xrsr_trace_ring_t *xrsr_trace_ring_get(void);
+static void               xrsr_trace_key_create(void);
+static void               xrsr_trace_thread_exit(void *data);
+
+static __thread xrsr_trace_ring_t *t_xrsr_trace_ring;
+
+static pthread_once_t     g_xrsr_trace_once  = PTHREAD_ONCE_INIT;
+static pthread_key_t      g_xrsr_trace_key;
+static pthread_mutex_t    g_xrsr_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+static xrsr_trace_ring_t *g_xrsr_trace_rings = NULL;
+
+void xrsr_trace_record(xrsr_trace_event_t event, xrsr_src_t src, int64_t arg0, int64_t arg1) {
+   xrsr_trace_ring_t *ring = t_xrsr_trace_ring;
+   if(ring == NULL) {
+      ring = xrsr_trace_ring_get();
+      if(ring == NULL) {
+         return;
+      }
+   }
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+
+   uint32_t             index  = ring->head;
+   xrsr_trace_record_t *record = &ring->records[index & (XRSR_TRACE_RECORD_QTY - 1)];
+
+   __atomic_store_n(&record->seq, 0, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   record->event   = (uint16_t)event;
+   record->src     = (uint16_t)src;
+   record->time_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+   record->args[0] = arg0;
+   record->args[1] = arg1;
+   __atomic_store_n(&record->seq, index + 1, __ATOMIC_RELEASE);
+   __atomic_store_n(&ring->head, index + 1, __ATOMIC_RELEASE);
+}
+
+// Takes over a ring left by a thread which has exited, otherwise adds a new one.  Only called on a thread's first record.
+xrsr_trace_ring_t *xrsr_trace_ring_get(void) {
+   pthread_once(&g_xrsr_trace_once, xrsr_trace_key_create);
+
+   pthread_mutex_lock(&g_xrsr_trace_mutex);
+   xrsr_trace_ring_t *ring = g_xrsr_trace_rings;
+   while(ring != NULL && ring->owned) {
+      ring = ring->next;
+   }
+   if(ring == NULL) {
+      ring = (xrsr_trace_ring_t *)calloc(1, sizeof(*ring));
+      if(ring == NULL) {
+         pthread_mutex_unlock(&g_xrsr_trace_mutex);
+         XLOGD_ERROR("out of memory");
+         return(NULL);
+      }
+      ring->next         = g_xrsr_trace_rings;
+      g_xrsr_trace_rings = ring;
+   }
+   ring->owned      = true;
+   ring->tid_prev   = ring->tid;
+   ring->tid        = (pid_t)syscall(SYS_gettid);
+   ring->head_owned = ring->head;
+   pthread_mutex_unlock(&g_xrsr_trace_mutex);
+
+   pthread_setspecific(g_xrsr_trace_key, ring); // releases the ring when the thread exits
+   t_xrsr_trace_ring = ring;
+   return(ring);
+}
+
+void xrsr_trace_key_create(void) {
+   if(0 != pthread_key_create(&g_xrsr_trace_key, xrsr_trace_thread_exit)) {
+      XLOGD_ERROR("unable to create key");
+   }
+}
+
+void xrsr_trace_thread_exit(void *data) {
+   xrsr_trace_ring_t *ring = (xrsr_trace_ring_t *)data;
+   pthread_mutex_lock(&g_xrsr_trace_mutex);
+   ring->owned = false;
+   pthread_mutex_unlock(&g_xrsr_trace_mutex);
+   t_xrsr_trace_ring = NULL;
+}
+
+void xrsr_trace_dump(uint32_t record_qty) {
+   pthread_mutex_lock(&g_xrsr_trace_mutex);
+   for(xrsr_trace_ring_t *ring = g_xrsr_trace_rings; ring != NULL; ring = ring->next) {
+      uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+      uint32_t qty  = (head < XRSR_TRACE_RECORD_QTY) ? head : XRSR_TRACE_RECORD_QTY;
+      if(record_qty > 0 && qty > record_qty) {
+         qty = record_qty;
+      }
+      if(qty == 0) {
+         continue;
+      }
+      uint64_t time_prev = 0;
+      for(uint32_t index = head - qty; index != head; index++) {
+         if(index == head - qty || index == ring->head_owned) {
+            bool prev = (head - index > head - ring->head_owned); // written by the previous owner
+            XLOGD_INFO("tid <%d> records <%u> of <%u>%s", prev ? ring->tid_prev : ring->tid, prev ? ring->head_owned - index : head - index, head, (prev || !ring->owned) ? " (exited)" : "");
+         }
+         const xrsr_trace_record_t *entry = &ring->records[index & (XRSR_TRACE_RECORD_QTY - 1)];
+         xrsr_trace_record_t        record;
+
+         // Copy the record and check that the owner didn't overwrite it in the meantime
+         uint32_t seq = __atomic_load_n(&entry->seq, __ATOMIC_ACQUIRE);
+         record = *entry;
+         __atomic_thread_fence(__ATOMIC_ACQUIRE);
+         if(seq != index + 1 || __atomic_load_n(&entry->seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+         }
+
+         const xrsr_trace_event_info_t *info = (record.event < XRSR_TRACE_EVENT_INVALID) ? &g_xrsr_trace_events[record.event] : NULL;
+         char line[XRSR_TRACE_LINE_SIZE];
+         int  len = snprintf(line, sizeof(line), "%llu.%06llu +%llu us src <%s> %s", (unsigned long long)(record.time_us / 1000000), (unsigned long long)(record.time_us % 1000000),
+                             (unsigned long long)(time_prev ? record.time_us - time_prev : 0), xrsr_src_str((xrsr_src_t)record.src), info ? info->name : "INVALID");
+         for(uint32_t arg = 0; info != NULL && arg < 2 && len > 0 && (size_t)len < sizeof(line); arg++) {
+            if(info->args[arg] != NULL) {
+               len += snprintf(&line[len], sizeof(line) - len, " %s <%lld>", info->args[arg], (long long)record.args[arg]);
+            }
+         }
+         XLOGD_INFO("%s", line);
+         time_prev = record.time_us;
+      }
+   }
+   pthread_mutex_unlock(&g_xrsr_trace_mutex);
+}
+
+// Frees the rings of threads which have exited
+void xrsr_trace_term(void) {
+   pthread_mutex_lock(&g_xrsr_trace_mutex);
+   xrsr_trace_ring_t **link = &g_xrsr_trace_rings;
+   while(*link != NULL) {
+      xrsr_trace_ring_t *ring = *link;
+      if(ring->owned) {
+         link = &ring->next;
+      } else {
+         *link = ring->next;
+         free(ring);
+      }
+   }
+   pthread_mutex_unlock(&g_xrsr_trace_mutex);
+}
@@ -0,0 +1,312 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "xrsr_private.h"
+
+#define XRSR_TRIM_FRAME_DURATION (10)    // voice activity is decided for each frame (in milliseconds)
+#define XRSR_TRIM_LEVEL_MIN      (40.0)  // frames quieter than this are never speech (in dB relative to one LSB)
+#define XRSR_TRIM_FLOOR_RISE     (0.02)  // noise floor increase per frame while the level is above it (in dB)
+#define XRSR_TRIM_HOLD_MAX       (10000) // silence held after speech, beyond which a pause is shortened (in milliseconds)
+
+// Silence is trimmed with an energy detector which compares each frame to a tracked noise floor.  Silence before the
+// first speech is dropped except for the lead, so that the onset is not clipped.  Speech is passed with the tail that
+// follows it.  Longer silence is held until speech resumes, when it is passed so that pauses within the utterance are
+// kept, or until the end of the stream, when it is dropped.  A pause longer than XRSR_TRIM_HOLD_MAX is shortened to
+// that length.  The audio up to the end of the keyword is never dropped, which keeps the keyword's position in the
+// stream unchanged.
+typedef struct {
+   uint32_t  frame_qty;     // samples per frame
+   float     threshold;     // level above the noise floor for speech (in dB)
+   uint32_t  tail_qty;      // silent samples passed after speech
+   uint32_t  hold_qty_max;
+   uint32_t  protect_qty;   // samples at the beginning of the stream which are always passed
+   uint32_t  position;      // samples received
+   bool      speech_seen;
+   uint32_t  silence_qty;   // silent samples since the last speech
+   bool      floor_valid;
+   float     floor;         // noise floor (in dB)
+   int16_t * frame;         // partial frame waiting for more samples
+   uint32_t  buffered;
+   int16_t * lead;          // most recent dropped samples which are passed when speech begins
+   uint32_t  lead_qty_max;
+   uint32_t  lead_qty;
+   uint32_t  lead_pos;      // next sample written in the lead ring
+   int16_t * queue;         // samples waiting for output space, followed by the held silence
+   uint32_t  queue_size;
+   uint32_t  queue_head;
+   uint32_t  queue_qty;
+   uint32_t  held_qty;      // silent samples at the end of the queue which are passed only if speech resumes
+   uint32_t  dropped_qty;
+} xrsr_trim_t;
+
+static bool xrsr_trim_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out);
+static bool xrsr_trim_stage_flush(void *data, xrsr_frame_t *out);
+static void xrsr_trim_stage_close(void *data);
+static bool xrsr_trim_frame(xrsr_trim_t *trim, const int16_t *samples, xrsr_frame_t *out);
+static bool xrsr_trim_is_speech(xrsr_trim_t *trim, const int16_t *samples);
+static void xrsr_trim_lead_push(xrsr_trim_t *trim, const int16_t *samples, uint32_t qty);
+static bool xrsr_trim_lead_pop(xrsr_trim_t *trim);
+static bool xrsr_trim_queue_push(xrsr_trim_t *trim, const int16_t *samples, uint32_t qty);
+static void xrsr_trim_queue_pop(xrsr_trim_t *trim, xrsr_frame_t *out);
+
+// Creates a stage which trims silence from 16-bit mono audio.  protect_qty samples at the beginning of the stream are
+// not trimmed.
+bool xrsr_trim_stage_create(xrsr_stage_t *stage, const xrsr_trim_config_t *config, uint32_t sample_rate, uint32_t protect_qty) {
+   if(stage == NULL || config == NULL || sample_rate < 1000) {
+      XLOGD_ERROR("invalid params");
+      return(false);
+   }
+   xrsr_trim_t *obj = (xrsr_trim_t *)malloc(sizeof(xrsr_trim_t));
+   if(obj == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   memset(obj, 0, sizeof(*obj));
+   obj->frame_qty    = sample_rate * XRSR_TRIM_FRAME_DURATION / 1000;
+   obj->threshold    = config->threshold;
+   obj->tail_qty     = (uint32_t)(((uint64_t)sample_rate * config->tail) / 1000);
+   obj->hold_qty_max = (uint32_t)(((uint64_t)sample_rate * XRSR_TRIM_HOLD_MAX) / 1000);
+   obj->protect_qty  = protect_qty;
+   obj->lead_qty_max = (uint32_t)(((uint64_t)sample_rate * config->lead) / 1000);
+   obj->frame = (int16_t *)malloc((obj->frame_qty + obj->lead_qty_max) * sizeof(int16_t));
+   if(obj->frame == NULL) {
+      XLOGD_ERROR("out of memory");
+      free(obj);
+      return(false);
+   }
+   obj->lead = &obj->frame[obj->frame_qty];
+
+   XLOGD_INFO("threshold <%.1f> dB lead <%u> tail <%u> protect <%u> samples", obj->threshold, obj->lead_qty_max, obj->tail_qty, obj->protect_qty);
+
+   memset(stage, 0, sizeof(*stage));
+   stage->name    = "trim";
+   stage->data    = obj;
+   stage->process = xrsr_trim_stage_process;
+   stage->flush   = xrsr_trim_stage_flush;
+   stage->close   = xrsr_trim_stage_close;
+   return(true);
+}
+
+bool xrsr_trim_stage_process(void *data, const xrsr_frame_t *in, xrsr_frame_t *out) {
+   xrsr_trim_t *  trim    = (xrsr_trim_t *)data;
+   const int16_t *samples = (const int16_t *)in->buffer;
+   uint32_t       qty     = in->size / sizeof(int16_t);
+
+   while(qty > 0) {
+      if(trim->buffered == 0 && qty >= trim->frame_qty) { // decide directly from the input
+         if(!xrsr_trim_frame(trim, samples, out)) {
+            return(false);
+         }
+         samples += trim->frame_qty;
+         qty     -= trim->frame_qty;
+         continue;
+      }
+      uint32_t count = trim->frame_qty - trim->buffered;
+      if(count > qty) {
+         count = qty;
+      }
+      memcpy(&trim->frame[trim->buffered], samples, count * sizeof(int16_t));
+      trim->buffered += count;
+      samples        += count;
+      qty            -= count;
+
+      if(trim->buffered == trim->frame_qty) {
+         trim->buffered = 0;
+         if(!xrsr_trim_frame(trim, trim->frame, out)) {
+            return(false);
+         }
+      }
+   }
+   return(true);
+}
+
+// A partial frame at the end of the stream follows the decision for the previous frame.  The held silence follows the
+// last speech, so it is dropped.  The queue is output over repeated calls when it doesn't fit in one frame.
+bool xrsr_trim_stage_flush(void *data, xrsr_frame_t *out) {
+   xrsr_trim_t *trim = (xrsr_trim_t *)data;
+
+   if(trim->buffered > 0) {
+      if(trim->position < trim->protect_qty || (trim->speech_seen && trim->silence_qty <= trim->tail_qty)) {
+         if(!xrsr_trim_queue_push(trim, trim->frame, trim->buffered)) {
+            return(false);
+         }
+      } else {
+         trim->dropped_qty += trim->buffered;
+      }
+      trim->buffered = 0;
+   }
+   trim->dropped_qty += trim->held_qty;
+   trim->queue_qty   -= trim->held_qty;
+   trim->held_qty     = 0;
+
+   xrsr_trim_queue_pop(trim, out);
+   return(true);
+}
+
+void xrsr_trim_stage_close(void *data) {
+   xrsr_trim_t *trim = (xrsr_trim_t *)data;
+   XLOGD_INFO("samples <%u> dropped <%u>", trim->position, trim->dropped_qty);
+   free(trim->queue);
+   free(trim->frame);
+   free(trim);
+}
+
+bool xrsr_trim_frame(xrsr_trim_t *trim, const int16_t *samples, xrsr_frame_t *out) {
+   bool protect = (trim->position < trim->protect_qty);
+   bool speech  = xrsr_trim_is_speech(trim, samples); // always run to keep the noise floor current
+
+   trim->position += trim->frame_qty;
+
+   if(protect || speech) {
+      if(!trim->speech_seen && !xrsr_trim_lead_pop(trim)) {
+         return(false);
+      }
+      trim->speech_seen = true;
+      trim->silence_qty = 0;
+      trim->held_qty    = 0; // the pause is within the utterance
+   } else if(!trim->speech_seen) {
+      xrsr_trim_lead_push(trim, samples, trim->frame_qty);
+      return(true);
+   } else {
+      trim->silence_qty += trim->frame_qty;
+      if(trim->silence_qty > trim->tail_qty) {
+         if(trim->held_qty >= trim->hold_qty_max) {
+            trim->dropped_qty += trim->frame_qty;
+            return(true);
+         }
+         uint32_t held = trim->silence_qty - trim->tail_qty;
+         trim->held_qty = (held < trim->frame_qty) ? held : trim->held_qty + trim->frame_qty;
+      }
+   }
+   if(!xrsr_trim_queue_push(trim, samples, trim->frame_qty)) {
+      return(false);
+   }
+   xrsr_trim_queue_pop(trim, out);
+   return(true);
+}
+
+bool xrsr_trim_is_speech(xrsr_trim_t *trim, const int16_t *samples) {
+   int64_t sum = 0;
+   for(uint32_t index = 0; index < trim->frame_qty; index++) {
+      sum += (int32_t)samples[index] * samples[index];
+   }
+   float level = 10.0f * log10f(((float)sum / trim->frame_qty) + 1.0f);
+
+   if(!trim->floor_valid) {
+      trim->floor       = level;
+      trim->floor_valid = true;
+   }
+   bool speech = (level >= XRSR_TRIM_LEVEL_MIN && level > trim->floor + trim->threshold);
+
+   // The floor follows quiet frames down immediately and rises slowly, so speech barely moves it
+   if(level < trim->floor) {
+      trim->floor = level;
+   } else {
+      trim->floor += XRSR_TRIM_FLOOR_RISE;
+   }
+   return(speech);
+}
+
+// Keeps the most recent dropped samples in a ring.  Samples pushed out of the ring are dropped.
+void xrsr_trim_lead_push(xrsr_trim_t *trim, const int16_t *samples, uint32_t qty) {
+   if(trim->lead_qty_max == 0) {
+      trim->dropped_qty += qty;
+      return;
+   }
+   for(uint32_t index = 0; index < qty; index++) {
+      trim->lead[trim->lead_pos] = samples[index];
+      if(++trim->lead_pos == trim->lead_qty_max) {
+         trim->lead_pos = 0;
+      }
+   }
+   uint32_t total = trim->lead_qty + qty;
+   if(total > trim->lead_qty_max) {
+      trim->dropped_qty += total - trim->lead_qty_max;
+      total              = trim->lead_qty_max;
+   }
+   trim->lead_qty = total;
+}
+
+// Queues the lead ring, oldest sample first
+bool xrsr_trim_lead_pop(xrsr_trim_t *trim) {
+   if(trim->lead_qty == 0) {
+      return(true);
+   }
+   uint32_t oldest = (trim->lead_pos + trim->lead_qty_max - trim->lead_qty) % trim->lead_qty_max;
+   uint32_t first  = trim->lead_qty_max - oldest;
+   if(first > trim->lead_qty) {
+      first = trim->lead_qty;
+   }
+   if(!xrsr_trim_queue_push(trim, &trim->lead[oldest], first) || !xrsr_trim_queue_push(trim, trim->lead, trim->lead_qty - first)) {
+      return(false);
+   }
+   trim->lead_qty = 0;
+   trim->lead_pos = 0;
+   return(true);
+}
+
+// Adds samples to the end of the queue, which grows as silence is held
+bool xrsr_trim_queue_push(xrsr_trim_t *trim, const int16_t *samples, uint32_t qty) {
+   if(trim->queue_head + trim->queue_qty + qty > trim->queue_size) {
+      if(trim->queue_head > 0) {
+         memmove(trim->queue, &trim->queue[trim->queue_head], trim->queue_qty * sizeof(int16_t));
+         trim->queue_head = 0;
+      }
+      if(trim->queue_qty + qty > trim->queue_size) {
+         uint32_t size = (trim->queue_size == 0) ? trim->frame_qty * 8 : trim->queue_size * 2;
+         if(size < trim->queue_qty + qty) {
+            size = trim->queue_qty + qty;
+         }
+         int16_t *queue = (int16_t *)realloc(trim->queue, size * sizeof(int16_t));
+         if(queue == NULL) {
+            XLOGD_ERROR("out of memory");
+            return(false);
+         }
+         trim->queue      = queue;
+         trim->queue_size = size;
+      }
+   }
+   memcpy(&trim->queue[trim->queue_head + trim->queue_qty], samples, qty * sizeof(int16_t));
+   trim->queue_qty += qty;
+   return(true);
+}
+
+// Outputs the queued samples which precede the held silence, as far as they fit in the frame
+void xrsr_trim_queue_pop(xrsr_trim_t *trim, xrsr_frame_t *out) {
+   uint32_t qty   = trim->queue_qty - trim->held_qty;
+   uint32_t space = (out->capacity - out->size) / sizeof(int16_t);
+   if(qty > space) {
+      qty = space;
+   }
+   if(qty == 0) {
+      return;
+   }
+   memcpy(&out->buffer[out->size], &trim->queue[trim->queue_head], qty * sizeof(int16_t));
+   out->size        += qty * sizeof(int16_t);
+   trim->queue_head += qty;
+   trim->queue_qty  -= qty;
+   if(trim->queue_qty == 0) {
+      trim->queue_head = 0;
+   }
+}
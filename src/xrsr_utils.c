@@ -83,6 +83,7 @@ const char *xrsr_queue_msg_type_str(xrsr_queue_msg_type_t type) {
       case XRSR_QUEUE_MSG_TYPE_SESSION_CAPTURE_START:                   return("SESSION_CAPTURE_START");
       case XRSR_QUEUE_MSG_TYPE_SESSION_CAPTURE_STOP:                    return("SESSION_CAPTURE_STOP");
       case XRSR_QUEUE_MSG_TYPE_THREAD_POLL:                             return("THREAD_POLL");
+      case XRSR_QUEUE_MSG_TYPE_CIRCUIT_PROBE:                           return("CIRCUIT_PROBE");
       case XRSR_QUEUE_MSG_TYPE_INVALID:                                 return("INVALID");
    }
    return(xrsr_invalid_return(type));
@@ -105,6 +106,7 @@ const char *xrsr_protocol_str(xrsr_protocol_t type) {
       case XRSR_PROTOCOL_WS:      return("WS");
       case XRSR_PROTOCOL_WSS:     return("WSS");
       case XRSR_PROTOCOL_SDT:     return("SDT");
+      case XRSR_PROTOCOL_UNIX:    return("UNIX");
       case XRSR_PROTOCOL_INVALID: return("INVALID");
    }
    return(xrsr_invalid_return(type));
@@ -158,6 +160,7 @@ const char *xrsr_audio_format_str(xrsr_audio_format_t format) {
       case XRSR_AUDIO_FORMAT_PCM_RAW:          return("PCM_RAW");
       case XRSR_AUDIO_FORMAT_ADPCM:            return("ADPCM");
       case XRSR_AUDIO_FORMAT_OPUS:             return("OPUS");
+      case XRSR_AUDIO_FORMAT_OPUS_CBR:         return("OPUS_CBR");
       case XRSR_AUDIO_FORMAT_NONE:             return("NONE");
       default: break;
    }
@@ -228,6 +231,17 @@ const char *xrsr_address_family_str(xrsr_address_family_t family) {
    return(xrsr_invalid_return(family));
 }
 
+const char *xrsr_convert_kernel_str(xrsr_convert_kernel_t kernel) {
+   switch(kernel) {
+      case XRSR_CONVERT_KERNEL_SCALAR:  return("SCALAR");
+      case XRSR_CONVERT_KERNEL_SSE2:    return("SSE2");
+      case XRSR_CONVERT_KERNEL_AVX2:    return("AVX2");
+      case XRSR_CONVERT_KERNEL_NEON:    return("NEON");
+      case XRSR_CONVERT_KERNEL_INVALID: return("INVALID");
+   }
+   return(xrsr_invalid_return(kernel));
+}
+
 const char *xrsr_event_str(xrsr_event_t event) {
    switch(event) {
       case XRSR_EVENT_EOS:                 return("EOS");
@@ -239,6 +253,36 @@ const char *xrsr_event_str(xrsr_event_t event) {
    return(xrsr_invalid_return(event));
 }
 
+const char *xrsr_circuit_state_str(xrsr_circuit_state_t type) {
+   switch(type) {
+      case XRSR_CIRCUIT_STATE_CLOSED:    return("CLOSED");
+      case XRSR_CIRCUIT_STATE_OPEN:      return("OPEN");
+      case XRSR_CIRCUIT_STATE_HALF_OPEN: return("HALF_OPEN");
+      case XRSR_CIRCUIT_STATE_INVALID:   return("INVALID");
+   }
+   return(xrsr_invalid_return(type));
+}
+
+const char *xrsr_format_reason_str(xrsr_format_reason_t type) {
+   switch(type) {
+      case XRSR_FORMAT_REASON_DEFAULT:   return("DEFAULT");
+      case XRSR_FORMAT_REASON_BANDWIDTH: return("BANDWIDTH");
+      case XRSR_FORMAT_REASON_CPU:       return("CPU");
+      case XRSR_FORMAT_REASON_INVALID:   return("INVALID");
+   }
+   return(xrsr_invalid_return(type));
+}
+
+const char *xrsr_socket_profile_str(xrsr_socket_profile_t profile) {
+   switch(profile) {
+      case XRSR_SOCKET_PROFILE_DEFAULT:     return("DEFAULT");
+      case XRSR_SOCKET_PROFILE_LOW_LATENCY: return("LOW_LATENCY");
+      case XRSR_SOCKET_PROFILE_BULK:        return("BULK");
+      case XRSR_SOCKET_PROFILE_INVALID:     return("INVALID");
+   }
+   return(xrsr_invalid_return(profile));
+}
+
 const char *xrsr_audio_container_str(xrsr_audio_container_t container) {
    switch(container) {
       case XRSR_AUDIO_CONTAINER_NONE:    return("NONE");
@@ -307,6 +351,10 @@ bool xrsr_url_parse(const char *url, xrsr_url_parts_t *url_parts) {
       tmp_prot = XRSR_PROTOCOL_SDT;
       tmp_port = 80;
       index = 6;
+   } else if(0 == strncmp(tmp_url, "unix://", 7)) { // unix:///path/to/socket
+      tmp_prot = XRSR_PROTOCOL_UNIX;
+      tmp_port = 0;
+      index = 7;
    } else {
       XLOGD_WARN("invalid protocol");
       #ifdef USE_CURL_UNESCAPE
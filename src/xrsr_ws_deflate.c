@@ -0,0 +1,243 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// permessage-deflate (RFC 7692) for websocket text messages.  The offer always asks the server not to take over its
+// context, so each incoming message is inflated on its own.  The client context is kept between outgoing messages
+// unless context takeover is disabled to save memory.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include "xrsr_private.h"
+
+#define XRSR_WS_DEFLATE_WINDOW_BITS  (15)
+#define XRSR_WS_DEFLATE_MEM_LEVEL    (8)
+#define XRSR_WS_DEFLATE_BUFFER_MIN   (1024)
+#define XRSR_WS_DEFLATE_MSG_SIZE_MAX (1048576) // largest inflated message (in bytes)
+
+static const uint8_t g_xrsr_ws_deflate_tail[4] = { 0x00, 0x00, 0xFF, 0xFF }; // removed from each compressed message
+
+static bool xrsr_ws_deflate_buffer(xrsr_ws_deflate_t *pmd, uint32_t size);
+static bool xrsr_ws_deflate_token(const char **str, const char *end, const char **token, size_t *length);
+
+void xrsr_ws_deflate_init(xrsr_ws_deflate_t *pmd, bool context_takeover) {
+   memset(pmd, 0, sizeof(*pmd));
+   pmd->context_takeover = context_takeover;
+}
+
+void xrsr_ws_deflate_term(xrsr_ws_deflate_t *pmd) {
+   if(pmd->deflate_init) {
+      deflateEnd(&pmd->deflate);
+   }
+   if(pmd->inflate_init) {
+      inflateEnd(&pmd->inflate);
+   }
+   if(pmd->buffer != NULL) {
+      free(pmd->buffer);
+   }
+   xrsr_ws_deflate_init(pmd, pmd->context_takeover);
+}
+
+// Header added to the opening handshake.  Formatted for nopoll's extra headers.
+void xrsr_ws_deflate_offer(bool context_takeover, char *str, size_t size) {
+   snprintf(str, size, "\r\nSec-WebSocket-Extensions: permessage-deflate; server_no_context_takeover%s", context_takeover ? "" : "; client_no_context_takeover");
+}
+
+// Checks the handshake response for the extensions that the server accepted (RFC 7692 section 5).  Returns true if
+// permessage-deflate was accepted with parameters that match the offer.
+bool xrsr_ws_deflate_accepted(const char *response, bool *context_takeover) {
+   static const char header[] = "Sec-WebSocket-Extensions:";
+   const char *line = strstr(response, "\r\n"); // skip the status line
+
+   while(line != NULL && strncmp(line, "\r\n\r\n", 4) != 0) {
+      line += 2;
+      const char *end = strstr(line, "\r\n");
+      if(end == NULL) {
+         break;
+      }
+      if(0 == strncasecmp(line, header, sizeof(header) - 1)) {
+         const char *str = line + sizeof(header) - 1;
+         const char *token;
+         size_t      length;
+
+         // Each extension is a name followed by parameters separated by ';', and extensions are separated by ','
+         while(xrsr_ws_deflate_token(&str, end, &token, &length)) {
+            bool deflate = (length == 18 && 0 == strncasecmp(token, "permessage-deflate", length));
+            bool valid   = deflate;
+            bool server_no_context_takeover = false;
+
+            *context_takeover = true;
+            while(str < end && *str == ';' && xrsr_ws_deflate_token(&str, end, &token, &length)) {
+               if(length == 26 && 0 == strncasecmp(token, "server_no_context_takeover", length)) {
+                  server_no_context_takeover = true;
+               } else if(length == 26 && 0 == strncasecmp(token, "client_no_context_takeover", length)) {
+                  *context_takeover = false;
+               } else if(length < 22 || 0 != strncasecmp(token, "server_max_window_bits", 22)) { // a smaller server window can be inflated with the default one
+                  valid = false;
+               }
+            }
+            if(deflate) {
+               if(!valid || !server_no_context_takeover) {
+                  XLOGD_WARN("permessage-deflate accepted with parameters which weren't offered");
+                  return(false);
+               }
+               return(true);
+            }
+         }
+      }
+      line = end;
+   }
+   return(false);
+}
+
+// Compresses an outgoing message.  The output is valid until the next call.
+bool xrsr_ws_deflate_compress(xrsr_ws_deflate_t *pmd, const uint8_t *in, uint32_t length, const uint8_t **out, uint32_t *out_length) {
+   if(!pmd->deflate_init) {
+      memset(&pmd->deflate, 0, sizeof(pmd->deflate));
+      if(Z_OK != deflateInit2(&pmd->deflate, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -XRSR_WS_DEFLATE_WINDOW_BITS, XRSR_WS_DEFLATE_MEM_LEVEL, Z_DEFAULT_STRATEGY)) {
+         XLOGD_ERROR("deflate init <%s>", pmd->deflate.msg ? pmd->deflate.msg : "");
+         return(false);
+      }
+      pmd->deflate_init = true;
+   }
+   z_stream *z    = &pmd->deflate;
+   uint32_t  used = 0;
+
+   if(!xrsr_ws_deflate_buffer(pmd, deflateBound(z, length) + sizeof(g_xrsr_ws_deflate_tail))) {
+      return(false);
+   }
+   z->next_in  = (Bytef *)in;
+   z->avail_in = length;
+   do {
+      if(used == pmd->buffer_size && !xrsr_ws_deflate_buffer(pmd, pmd->buffer_size * 2)) {
+         deflateReset(z);
+         return(false);
+      }
+      z->next_out  = &pmd->buffer[used];
+      z->avail_out = pmd->buffer_size - used;
+      int rc = deflate(z, Z_SYNC_FLUSH);
+      if(rc != Z_OK && rc != Z_BUF_ERROR) {
+         XLOGD_ERROR("deflate <%d>", rc);
+         deflateReset(z);
+         return(false);
+      }
+      used = pmd->buffer_size - z->avail_out;
+   } while(z->avail_out == 0);
+
+   if(!pmd->context_takeover) {
+      deflateReset(z);
+   }
+   if(used < sizeof(g_xrsr_ws_deflate_tail) || memcmp(&pmd->buffer[used - sizeof(g_xrsr_ws_deflate_tail)], g_xrsr_ws_deflate_tail, sizeof(g_xrsr_ws_deflate_tail)) != 0) {
+      XLOGD_ERROR("missing sync flush");
+      deflateReset(z);
+      return(false);
+   }
+   *out        = pmd->buffer;
+   *out_length = used - sizeof(g_xrsr_ws_deflate_tail);
+   return(true);
+}
+
+// Inflates an incoming message.  Returns false if the payload is not a complete compressed message.  The output is NULL terminated and valid until the next call.
+bool xrsr_ws_deflate_decompress(xrsr_ws_deflate_t *pmd, const uint8_t *in, uint32_t length, const uint8_t **out, uint32_t *out_length) {
+   if(!pmd->inflate_init) {
+      memset(&pmd->inflate, 0, sizeof(pmd->inflate));
+      if(Z_OK != inflateInit2(&pmd->inflate, -XRSR_WS_DEFLATE_WINDOW_BITS)) {
+         XLOGD_ERROR("inflate init <%s>", pmd->inflate.msg ? pmd->inflate.msg : "");
+         return(false);
+      }
+      pmd->inflate_init = true;
+   } else {
+      inflateReset(&pmd->inflate);
+   }
+   z_stream *z    = &pmd->inflate;
+   uint32_t  used = 0;
+
+   if(length == 0 || !xrsr_ws_deflate_buffer(pmd, length * 4)) {
+      return(false);
+   }
+   for(uint32_t pass = 0; pass < 2; pass++) { // the payload, then the tail which the sender removed
+      z->next_in  = (pass == 0) ? (Bytef *)in : (Bytef *)g_xrsr_ws_deflate_tail;
+      z->avail_in = (pass == 0) ? length : sizeof(g_xrsr_ws_deflate_tail);
+      while(z->avail_in > 0) {
+         if(used + 1 >= pmd->buffer_size) { // room for the terminator
+            if(pmd->buffer_size >= XRSR_WS_DEFLATE_MSG_SIZE_MAX || !xrsr_ws_deflate_buffer(pmd, pmd->buffer_size * 2)) {
+               return(false);
+            }
+         }
+         z->next_out  = &pmd->buffer[used];
+         z->avail_out = pmd->buffer_size - used - 1;
+         int rc = inflate(z, Z_SYNC_FLUSH);
+         used = pmd->buffer_size - 1 - z->avail_out;
+         if(rc == Z_STREAM_END) {
+            break;
+         }
+         if(rc != Z_OK && !(rc == Z_BUF_ERROR && z->avail_out == 0)) {
+            return(false);
+         }
+      }
+      if(pass == 0 && z->avail_in > 0) { // data after the final block
+         return(false);
+      }
+   }
+   pmd->buffer[used] = '\0';
+   *out        = pmd->buffer;
+   *out_length = used;
+   return(true);
+}
+
+// Returns the next token up to a ';' or ',' delimiter with the surrounding white space removed
+bool xrsr_ws_deflate_token(const char **str, const char *end, const char **token, size_t *length) {
+   const char *ptr = *str;
+   if(ptr < end && (*ptr == ';' || *ptr == ',')) {
+      ptr++;
+   }
+   while(ptr < end && (*ptr == ' ' || *ptr == '\t')) {
+      ptr++;
+   }
+   const char *begin = ptr;
+   while(ptr < end && *ptr != ';' && *ptr != ',') {
+      ptr++;
+   }
+   const char *last = ptr;
+   while(last > begin && (last[-1] == ' ' || last[-1] == '\t')) {
+      last--;
+   }
+   *str    = ptr;
+   *token  = begin;
+   *length = (size_t)(last - begin);
+   return(last > begin);
+}
+
+bool xrsr_ws_deflate_buffer(xrsr_ws_deflate_t *pmd, uint32_t size) {
+   if(size < XRSR_WS_DEFLATE_BUFFER_MIN) {
+      size = XRSR_WS_DEFLATE_BUFFER_MIN;
+   }
+   if(size <= pmd->buffer_size) {
+      return(true);
+   }
+   uint8_t *buffer = (uint8_t *)realloc(pmd->buffer, size);
+   if(buffer == NULL) {
+      XLOGD_ERROR("out of memory <%u>", size);
+      return(false);
+   }
+   pmd->buffer      = buffer;
+   pmd->buffer_size = size;
+   return(true);
+}
@@ -0,0 +1,517 @@
+/*
+##########################################################################
+# If not stated otherwise in this file or this component's LICENSE
+# file the following copyright and licenses apply:
+#
+# Copyright 2019 RDK Management
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+##########################################################################
+*/
+// Websocket framing for binary audio and compressed text.  Frames are built in place so the payload is masked once in
+// the caller's buffer and written with the header in a single call, instead of being copied and masked a byte at a time
+// by nopoll.  Other messages (uncompressed text, ping, close) continue to go through nopoll.  Incoming frames are also
+// read here while permessage-deflate is in use, since nopoll doesn't report the RSV1 bit which marks a compressed message.
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/random.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include "xrsr_private.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define XRSR_WS_FRAME_X86
+#endif
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define XRSR_WS_FRAME_NEON
+#endif
+
+#define XRSR_WS_FRAME_FIN          (0x80)
+#define XRSR_WS_FRAME_MASKED       (0x80)
+#define XRSR_WS_FRAME_LENGTH_16    (126)
+#define XRSR_WS_FRAME_LENGTH_64    (127)
+#define XRSR_WS_FRAME_RSV23        (0x30)
+#define XRSR_WS_FRAME_RECV_SIZE_MIN (4096)
+
+typedef void (*xrsr_ws_frame_mask_func_t)(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+
+static bool xrsr_ws_frame_mask_key(xrsr_ws_frame_t *frame, uint8_t *mask);
+static bool xrsr_ws_frame_random(uint8_t *buffer, size_t size);
+static bool xrsr_ws_frame_rx_header(xrsr_ws_frame_rx_t *rx);
+static int  xrsr_ws_frame_read(int fd, uint8_t *buffer, uint64_t size);
+static void xrsr_ws_frame_mask_scalar(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+#ifdef XRSR_WS_FRAME_X86
+static void xrsr_ws_frame_mask_sse2(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+static void xrsr_ws_frame_mask_avx2(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+#endif
+#ifdef XRSR_WS_FRAME_NEON
+static void xrsr_ws_frame_mask_neon(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask);
+#endif
+
+bool xrsr_ws_frame_init(xrsr_ws_frame_t *frame, uint32_t payload_max) {
+   memset(frame, 0, sizeof(*frame));
+
+   frame->pending = (uint8_t *)malloc(XRSR_WS_FRAME_HEADER_SIZE_MAX + payload_max);
+   if(frame->pending == NULL) {
+      XLOGD_ERROR("out of memory");
+      return(false);
+   }
+   frame->payload_max = payload_max;
+   frame->kernel      = xrsr_convert_kernel_best();
+   frame->mask_index  = sizeof(frame->mask_keys); // filled on the first frame
+
+   XLOGD_INFO("mask kernel <%s>", xrsr_convert_kernel_str(frame->kernel));
+   return(true);
+}
+
+void xrsr_ws_frame_term(xrsr_ws_frame_t *frame) {
+   if(frame->pending != NULL) {
+      free(frame->pending);
+      frame->pending = NULL;
+   }
+   frame->payload_max = 0;
+   xrsr_ws_frame_reset(frame);
+}
+
+void xrsr_ws_frame_reset(xrsr_ws_frame_t *frame) {
+   frame->pending_len    = 0;
+   frame->pending_offset = 0;
+}
+
+uint32_t xrsr_ws_frame_header(uint8_t *header, uint8_t opcode, uint64_t length, const uint8_t *mask) {
+   uint32_t size = 2;
+
+   header[0] = XRSR_WS_FRAME_FIN | (opcode & (XRSR_WS_FRAME_RSV1 | 0x0F));
+   if(length < XRSR_WS_FRAME_LENGTH_16) {
+      header[1] = (uint8_t)length;
+   } else if(length <= 0xFFFF) {
+      header[1] = XRSR_WS_FRAME_LENGTH_16;
+      header[2] = (uint8_t)(length >> 8);
+      header[3] = (uint8_t)(length);
+      size = 4;
+   } else {
+      header[1] = XRSR_WS_FRAME_LENGTH_64;
+      for(uint32_t index = 0; index < 8; index++) {
+         header[2 + index] = (uint8_t)(length >> (56 - 8 * index));
+      }
+      size = 10;
+   }
+   if(mask != NULL) {
+      header[1] |= XRSR_WS_FRAME_MASKED;
+      memcpy(&header[size], mask, 4);
+      size += 4;
+   }
+   return(size);
+}
+
+// Applies the masking key to the payload.  The destination may be the same as the source.
+void xrsr_ws_frame_mask(xrsr_convert_kernel_t kernel, uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask) {
+   xrsr_ws_frame_mask_func_t func = xrsr_ws_frame_mask_scalar;
+   switch(kernel) {
+      #ifdef XRSR_WS_FRAME_X86
+      case XRSR_CONVERT_KERNEL_SSE2: func = xrsr_ws_frame_mask_sse2; break;
+      case XRSR_CONVERT_KERNEL_AVX2: func = xrsr_ws_frame_mask_avx2; break;
+      #endif
+      #ifdef XRSR_WS_FRAME_NEON
+      case XRSR_CONVERT_KERNEL_NEON: func = xrsr_ws_frame_mask_neon; break;
+      #endif
+      default: break;
+   }
+   (*func)(dst, src, length, mask);
+}
+
+int xrsr_ws_frame_send_binary(xrsr_ws_frame_t *frame, int fd, uint8_t *dst, const uint8_t *src, uint32_t length) {
+   return(xrsr_ws_frame_send(frame, fd, XRSR_WS_FRAME_OPCODE_BINARY, dst, src, length));
+}
+
+// Sends a masked frame.  The opcode may include XRSR_WS_FRAME_RSV1.  The payload is masked from src into dst, which may
+// be the same buffer.  Returns the payload length if the frame was written, -2 if the socket did not accept all of it
+// (the rest is retained until xrsr_ws_frame_pending_send completes it) or -1 on error.
+int xrsr_ws_frame_send(xrsr_ws_frame_t *frame, int fd, uint8_t opcode, uint8_t *dst, const uint8_t *src, uint32_t length) {
+   if(frame->pending == NULL || length > frame->payload_max) {
+      XLOGD_ERROR("invalid params - length <%u> max <%u>", length, frame->payload_max);
+      errno = EINVAL;
+      return(-1);
+   }
+   if(frame->pending_offset < frame->pending_len) {
+      XLOGD_ERROR("previous frame pending <%u> bytes", frame->pending_len - frame->pending_offset);
+      errno = EBUSY;
+      return(-1);
+   }
+   uint8_t  header[XRSR_WS_FRAME_HEADER_SIZE_MAX];
+   uint8_t  mask[4];
+
+   if(!xrsr_ws_frame_mask_key(frame, mask)) {
+      errno = EIO;
+      return(-1);
+   }
+   uint32_t header_len = xrsr_ws_frame_header(header, opcode, length, mask);
+   xrsr_ws_frame_mask(frame->kernel, dst, src, length, mask);
+
+   struct iovec  iov[2];
+   struct msghdr msg;
+   iov[0].iov_base = header;
+   iov[0].iov_len  = header_len;
+   iov[1].iov_base = dst;
+   iov[1].iov_len  = length;
+   memset(&msg, 0, sizeof(msg));
+   msg.msg_iov     = iov;
+   msg.msg_iovlen  = 2;
+
+   ssize_t written = sendmsg(fd, &msg, MSG_NOSIGNAL);
+   if(written < 0) {
+      int errsv = errno;
+      if(errsv != EAGAIN && errsv != EWOULDBLOCK && errsv != EINTR) {
+         return(-1);
+      }
+      written = 0;
+   }
+   if((uint32_t)written == header_len + length) {
+      return((int)length);
+   }
+
+   // Retain the rest of the frame.  Nothing else may be written to the socket until it is sent.
+   uint32_t offset = 0;
+   if((uint32_t)written < header_len) {
+      offset = header_len - (uint32_t)written;
+      memcpy(frame->pending, &header[written], offset);
+      written = 0;
+   } else {
+      written -= header_len;
+   }
+   memcpy(&frame->pending[offset], &dst[written], length - (uint32_t)written);
+   frame->pending_len    = offset + length - (uint32_t)written;
+   frame->pending_offset = 0;
+   return(-2);
+}
+
+uint32_t xrsr_ws_frame_pending_bytes(const xrsr_ws_frame_t *frame) {
+   return(frame->pending_len - frame->pending_offset);
+}
+
+// Writes more of the retained frame.  Returns the quantity of bytes written or -1 on error.
+int xrsr_ws_frame_pending_send(xrsr_ws_frame_t *frame, int fd) {
+   uint32_t remaining = frame->pending_len - frame->pending_offset;
+   if(remaining == 0) {
+      return(0);
+   }
+   ssize_t written = send(fd, &frame->pending[frame->pending_offset], remaining, MSG_NOSIGNAL);
+   if(written < 0) {
+      int errsv = errno;
+      if(errsv == EAGAIN || errsv == EWOULDBLOCK || errsv == EINTR) {
+         return(0);
+      }
+      return(-1);
+   }
+   frame->pending_offset += (uint32_t)written;
+   if(frame->pending_offset == frame->pending_len) {
+      xrsr_ws_frame_reset(frame);
+   }
+   return((int)written);
+}
+
+void xrsr_ws_frame_rx_reset(xrsr_ws_frame_rx_t *rx) {
+   rx->header_len  = 0;
+   rx->header_done = false;
+   rx->msg_active  = false;
+   rx->msg_len     = 0;
+}
+
+void xrsr_ws_frame_rx_term(xrsr_ws_frame_rx_t *rx) {
+   if(rx->msg != NULL) {
+      free(rx->msg);
+      rx->msg = NULL;
+   }
+   rx->msg_size = 0;
+   xrsr_ws_frame_rx_reset(rx);
+}
+
+// Reads the next message or control frame from the socket.  The fragments of a message are joined, and control frames
+// which arrive between them are returned on their own.  Returns 1 when a message or control frame is complete, 0 if
+// more data is needed or -1 on a protocol error or when the socket is closed.  The payload is valid until the next call.
+int xrsr_ws_frame_recv(xrsr_ws_frame_rx_t *rx, int fd, uint8_t *opcode, const uint8_t **payload, uint32_t *length, bool *compressed) {
+   while(true) {
+      if(!rx->header_done) {
+         uint32_t header_size = 2;
+         if(rx->header_len >= 2) {
+            uint8_t length_7 = rx->header[1] & ~XRSR_WS_FRAME_MASKED;
+            header_size += (length_7 == XRSR_WS_FRAME_LENGTH_16) ? 2 : (length_7 == XRSR_WS_FRAME_LENGTH_64) ? 8 : 0;
+         }
+         if(rx->header_len < header_size) {
+            int rc = xrsr_ws_frame_read(fd, &rx->header[rx->header_len], header_size - rx->header_len);
+            if(rc <= 0) {
+               return(rc);
+            }
+            rx->header_len += (uint32_t)rc;
+            continue;
+         }
+         if(!xrsr_ws_frame_rx_header(rx)) {
+            return(-1);
+         }
+      }
+      uint8_t *dst = (rx->opcode >= XRSR_WS_FRAME_OPCODE_CLOSE) ? rx->control : &rx->msg[rx->msg_len];
+      while(rx->payload_rxd < rx->payload_len) {
+         int rc = xrsr_ws_frame_read(fd, &dst[rx->payload_rxd], rx->payload_len - rx->payload_rxd);
+         if(rc <= 0) {
+            return(rc);
+         }
+         rx->payload_rxd += (uint32_t)rc;
+      }
+      rx->header_len  = 0;
+      rx->header_done = false;
+
+      if(rx->opcode >= XRSR_WS_FRAME_OPCODE_CLOSE) {
+         *opcode     = rx->opcode;
+         *payload    = rx->control;
+         *length     = (uint32_t)rx->payload_len;
+         *compressed = false;
+         return(1);
+      }
+      rx->msg_len += (uint32_t)rx->payload_len;
+      if(rx->final) {
+         rx->msg_active = false;
+         *opcode        = rx->msg_opcode;
+         *payload       = rx->msg;
+         *length        = rx->msg_len;
+         *compressed    = rx->msg_compressed;
+         rx->msg_len    = 0;
+         return(1);
+      }
+   }
+}
+
+// Checks a frame header from the server (RFC 6455 section 5.2) and makes room for its payload
+bool xrsr_ws_frame_rx_header(xrsr_ws_frame_rx_t *rx) {
+   uint8_t  opcode = rx->header[0] & 0x0F;
+   bool     rsv1   = (rx->header[0] & XRSR_WS_FRAME_RSV1) != 0;
+   uint64_t length = rx->header[1] & ~XRSR_WS_FRAME_MASKED;
+
+   if(rx->header[1] & XRSR_WS_FRAME_MASKED) {
+      XLOGD_ERROR("masked frame from server");
+      return(false);
+   } else if(rx->header[0] & XRSR_WS_FRAME_RSV23) {
+      XLOGD_ERROR("reserved bits set <0x%02X>", rx->header[0]);
+      return(false);
+   }
+   if(length == XRSR_WS_FRAME_LENGTH_16) {
+      length = ((uint64_t)rx->header[2] << 8) | rx->header[3];
+   } else if(length == XRSR_WS_FRAME_LENGTH_64) {
+      length = 0;
+      for(uint32_t index = 0; index < 8; index++) {
+         length = (length << 8) | rx->header[2 + index];
+      }
+   }
+   rx->opcode      = opcode;
+   rx->final       = (rx->header[0] & XRSR_WS_FRAME_FIN) != 0;
+   rx->payload_len = length;
+   rx->payload_rxd = 0;
+
+   if(opcode >= XRSR_WS_FRAME_OPCODE_CLOSE) {
+      if(opcode > XRSR_WS_FRAME_OPCODE_PONG || !rx->final || rsv1 || length > XRSR_WS_FRAME_CONTROL_SIZE_MAX) {
+         XLOGD_ERROR("invalid control frame - opcode <0x%X> final <%s> rsv1 <%s> length <%llu>", opcode, rx->final ? "YES" : "NO", rsv1 ? "YES" : "NO", (unsigned long long)length);
+         return(false);
+      }
+      rx->header_done = true;
+      return(true);
+   }
+   if(opcode == 0) { // continuation
+      if(!rx->msg_active || rsv1) {
+         XLOGD_ERROR("invalid continuation frame - active <%s> rsv1 <%s>", rx->msg_active ? "YES" : "NO", rsv1 ? "YES" : "NO");
+         return(false);
+      }
+   } else if(opcode == XRSR_WS_FRAME_OPCODE_TEXT || opcode == XRSR_WS_FRAME_OPCODE_BINARY) {
+      if(rx->msg_active) {
+         XLOGD_ERROR("new message inside a fragmented message");
+         return(false);
+      }
+      rx->msg_active     = true;
+      rx->msg_opcode     = opcode;
+      rx->msg_compressed = rsv1;
+      rx->msg_len        = 0;
+   } else {
+      XLOGD_ERROR("reserved opcode <0x%X>", opcode);
+      return(false);
+   }
+   if(length > XRSR_WS_FRAME_RECV_SIZE_MAX - rx->msg_len) {
+      XLOGD_ERROR("message too large <%llu> bytes", (unsigned long long)(rx->msg_len + length));
+      return(false);
+   }
+   uint32_t size = rx->msg_len + (uint32_t)length;
+   if(rx->msg == NULL || size > rx->msg_size) {
+      uint32_t msg_size = (rx->msg_size > 0) ? rx->msg_size : XRSR_WS_FRAME_RECV_SIZE_MIN;
+      while(msg_size < size) {
+         msg_size *= 2;
+      }
+      uint8_t *msg = (uint8_t *)realloc(rx->msg, msg_size);
+      if(msg == NULL) {
+         XLOGD_ERROR("out of memory");
+         return(false);
+      }
+      rx->msg      = msg;
+      rx->msg_size = msg_size;
+   }
+   rx->header_done = true;
+   return(true);
+}
+
+// Returns the quantity of bytes read, 0 if the socket has no data or -1 on error or when the socket is closed
+int xrsr_ws_frame_read(int fd, uint8_t *buffer, uint64_t size) {
+   if(size > INT32_MAX) {
+      size = INT32_MAX;
+   }
+   ssize_t rc = recv(fd, buffer, (size_t)size, 0);
+   if(rc > 0) {
+      return((int)rc);
+   } else if(rc == 0) {
+      errno = ECONNRESET;
+      return(-1);
+   }
+   int errsv = errno;
+   if(errsv == EAGAIN || errsv == EWOULDBLOCK || errsv == EINTR) {
+      return(0);
+   }
+   return(-1);
+}
+
+// Masking keys must be unpredictable (RFC 6455 section 10.3), so they are taken from the kernel's random source.  Keys
+// are read in batches to keep the system call out of the per-frame path.
+bool xrsr_ws_frame_mask_key(xrsr_ws_frame_t *frame, uint8_t *mask) {
+   if(frame->mask_index + 4 > sizeof(frame->mask_keys)) {
+      if(!xrsr_ws_frame_random(frame->mask_keys, sizeof(frame->mask_keys))) {
+         XLOGD_ERROR("unable to generate masking keys");
+         return(false);
+      }
+      frame->mask_index = 0;
+   }
+   memcpy(mask, &frame->mask_keys[frame->mask_index], 4);
+   frame->mask_index += 4;
+   return(true);
+}
+
+bool xrsr_ws_frame_random(uint8_t *buffer, size_t size) {
+   size_t offset = 0;
+   while(offset < size) {
+      ssize_t rc = getrandom(&buffer[offset], size - offset, 0);
+      if(rc < 0) {
+         if(errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      offset += (size_t)rc;
+   }
+   if(offset == size) {
+      return(true);
+   }
+   // Kernels before 3.17 don't have getrandom
+   int fd = open("/dev/urandom", O_RDONLY | O_CLOEXEC);
+   if(fd < 0) {
+      return(false);
+   }
+   while(offset < size) {
+      ssize_t rc = read(fd, &buffer[offset], size - offset);
+      if(rc <= 0) {
+         if(rc < 0 && errno == EINTR) {
+            continue;
+         }
+         break;
+      }
+      offset += (size_t)rc;
+   }
+   close(fd);
+   return(offset == size);
+}
+
+void xrsr_ws_frame_mask_scalar(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask) {
+   uint64_t pattern;
+   uint32_t index = 0;
+
+   memcpy(&pattern, mask, 4);
+   memcpy(((uint8_t *)&pattern) + 4, mask, 4);
+
+   for(; index + 8 <= length; index += 8) {
+      uint64_t word;
+      memcpy(&word, &src[index], 8);
+      word ^= pattern;
+      memcpy(&dst[index], &word, 8);
+   }
+   for(; index < length; index++) {
+      dst[index] = src[index] ^ mask[index & 3];
+   }
+}
+
+#ifdef XRSR_WS_FRAME_X86
+__attribute__((target("sse2")))
+void xrsr_ws_frame_mask_sse2(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask) {
+   uint32_t key;
+   uint32_t index = 0;
+
+   memcpy(&key, mask, 4);
+   __m128i pattern = _mm_set1_epi32((int)key);
+
+   for(; index + 16 <= length; index += 16) {
+      __m128i v = _mm_loadu_si128((const __m128i *)&src[index]);
+      _mm_storeu_si128((__m128i *)&dst[index], _mm_xor_si128(v, pattern));
+   }
+   // Each block is a multiple of four bytes so the key is still aligned with the remaining bytes
+   xrsr_ws_frame_mask_scalar(&dst[index], &src[index], length - index, mask);
+}
+
+__attribute__((target("avx2")))
+void xrsr_ws_frame_mask_avx2(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask) {
+   uint32_t key;
+   uint32_t index = 0;
+
+   memcpy(&key, mask, 4);
+   __m256i pattern = _mm256_set1_epi32((int)key);
+
+   for(; index + 64 <= length; index += 64) {
+      __m256i v0 = _mm256_loadu_si256((const __m256i *)&src[index]);
+      __m256i v1 = _mm256_loadu_si256((const __m256i *)&src[index + 32]);
+      _mm256_storeu_si256((__m256i *)&dst[index],      _mm256_xor_si256(v0, pattern));
+      _mm256_storeu_si256((__m256i *)&dst[index + 32], _mm256_xor_si256(v1, pattern));
+   }
+   for(; index + 32 <= length; index += 32) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)&src[index]);
+      _mm256_storeu_si256((__m256i *)&dst[index], _mm256_xor_si256(v, pattern));
+   }
+   xrsr_ws_frame_mask_scalar(&dst[index], &src[index], length - index, mask);
+}
+#endif
+
+#ifdef XRSR_WS_FRAME_NEON
+void xrsr_ws_frame_mask_neon(uint8_t *dst, const uint8_t *src, uint32_t length, const uint8_t *mask) {
+   uint32_t key;
+   uint32_t index = 0;
+
+   memcpy(&key, mask, 4);
+   uint8x16_t pattern = vreinterpretq_u8_u32(vdupq_n_u32(key));
+
+   for(; index + 32 <= length; index += 32) {
+      uint8x16_t v0 = vld1q_u8(&src[index]);
+      uint8x16_t v1 = vld1q_u8(&src[index + 16]);
+      vst1q_u8(&dst[index],      veorq_u8(v0, pattern));
+      vst1q_u8(&dst[index + 16], veorq_u8(v1, pattern));
+   }
+   for(; index + 16 <= length; index += 16) {
+      vst1q_u8(&dst[index], veorq_u8(vld1q_u8(&src[index]), pattern));
+   }
+   xrsr_ws_frame_mask_scalar(&dst[index], &src[index], length - index, mask);
+}
+#endif
@@ -26,10 +26,9 @@
 
 #define XRSR_XRAUDIO_IDENTIFIER (0x93482578)
 
-#define FRAME_GROUP_SIZE_MAX (4096)
-
 typedef struct {
    bool                          active;
+   uint64_t                      frame_byte_qty;
    bool                          detecting;
    bool                          audio_stats_rxd;
    xrsr_audio_stats_t            audio_stats;
@@ -567,7 +566,7 @@ void xrsr_xraudio_keyword_detect_error(xrsr_xraudio_object_t object, xraudio_dev
    }
 }
 
-bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_id, xraudio_devices_input_t source, bool user_initiated, xraudio_input_format_t *format_decoded, xraudio_dst_pipe_t dsts[], uint16_t stream_time_min, uint32_t keyword_begin, uint32_t keyword_duration, uint32_t frame_duration, bool low_latency) {
+bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_id, xraudio_devices_input_t source, bool user_initiated, xraudio_input_format_t *format_decoded, xraudio_dst_pipe_t dsts[], uint16_t stream_time_min, uint32_t keyword_begin, uint32_t keyword_duration, uint32_t frame_duration, bool low_latency, uint32_t group_size) {
    xrsr_xraudio_obj_t *obj = (xrsr_xraudio_obj_t *)object;
 
    if(!xrsr_xraudio_object_is_valid(obj)) {
@@ -588,7 +587,7 @@ bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_
    } else {
       frame_byte_qty = (XRAUDIO_INPUT_DEFAULT_SAMPLE_RATE * XRAUDIO_INPUT_DEFAULT_SAMPLE_SIZE * XRAUDIO_INPUT_DEFAULT_CHANNEL_QTY) * ((uint64_t) frame_duration) / (1000000);
    }
-   uint32_t frame_group_quantity = (low_latency) ? 1 : FRAME_GROUP_SIZE_MAX / frame_byte_qty;
+   uint32_t frame_group_quantity = group_size / frame_byte_qty;
    if(frame_group_quantity > XRAUDIO_INPUT_MAX_FRAME_GROUP_QTY) {
       frame_group_quantity = XRAUDIO_INPUT_MAX_FRAME_GROUP_QTY;
    } else if(frame_group_quantity < XRAUDIO_INPUT_MIN_FRAME_GROUP_QTY) {
@@ -637,7 +636,38 @@ bool xrsr_xraudio_stream_begin(xrsr_xraudio_object_t object, const char *stream_
    }
 
    xrsr_xraudio_stream_t *stream = &obj->xraudio_streams[xrsr_xraudio_source_to_group(source)];
-   stream->active = true;
+   stream->active         = true;
+   stream->frame_byte_qty = frame_byte_qty;
+   return(true);
+}
+
+bool xrsr_xraudio_stream_group_size_set(xrsr_xraudio_object_t object, xraudio_devices_input_t source, uint32_t group_size) {
+   xrsr_xraudio_obj_t *obj = (xrsr_xraudio_obj_t *)object;
+
+   if(!xrsr_xraudio_object_is_valid(obj)) {
+      XLOGD_ERROR("invalid xrsr xraudio object");
+      return(false);
+   }
+
+   xrsr_xraudio_stream_t *stream = &obj->xraudio_streams[xrsr_xraudio_source_to_group(source)];
+   if(!stream->active || stream->frame_byte_qty == 0) {
+      return(false);
+   }
+
+   uint32_t frame_group_quantity = group_size / stream->frame_byte_qty;
+   if(frame_group_quantity > XRAUDIO_INPUT_MAX_FRAME_GROUP_QTY) {
+      frame_group_quantity = XRAUDIO_INPUT_MAX_FRAME_GROUP_QTY;
+   } else if(frame_group_quantity < XRAUDIO_INPUT_MIN_FRAME_GROUP_QTY) {
+      frame_group_quantity = XRAUDIO_INPUT_MIN_FRAME_GROUP_QTY;
+   }
+
+   XLOGD_INFO("src <%s> group size <%u> qty <%u>", xraudio_devices_input_str(source), group_size, frame_group_quantity);
+
+   xraudio_result_t result = xraudio_stream_frame_group_quantity_set(obj->xraudio_obj, source, frame_group_quantity);
+   if(result != XRAUDIO_RESULT_OK) {
+      XLOGD_WARN("unable to set frame group quantity <%s>", xraudio_result_str(result));
+      return(false);
+   }
    return(true);
 }
 